@@ -0,0 +1,166 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Extracts frames written by CompressedFileAppender.
+//
+// Usage: framereader [-l] [-f from] [-t to] file
+//
+//   -l       list frames (offset, size and time range) instead of
+//            printing their contents
+//   -f from  skip frames whose last event is older than from
+//   -t to    skip frames whose first event is newer than to
+//
+// Times are given in seconds since the Epoch. Only headers of
+// skipped frames are read, the rest of each frame is seeked over.
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/helpers/compress.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+
+static
+int
+usage ()
+{
+    cerr << "Usage: framereader [-l] [-f from] [-t to] file" << endl;
+    return 1;
+}
+
+
+int
+main (int argc, char ** argv)
+{
+    bool list = false;
+    Time from (0, 0);
+    Time to (static_cast<time_t>(0x7fffffff), 0);
+    char const * file_name = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp (argv[i], "-l") == 0)
+            list = true;
+        else if (std::strcmp (argv[i], "-f") == 0 && i + 1 < argc)
+            from = Time (static_cast<time_t>(std::atol (argv[++i])), 0);
+        else if (std::strcmp (argv[i], "-t") == 0 && i + 1 < argc)
+            to = Time (static_cast<time_t>(std::atol (argv[++i])), 999999);
+        else if (argv[i][0] != '-' && ! file_name)
+            file_name = argv[i];
+        else
+            return usage ();
+    }
+
+    if (! file_name)
+        return usage ();
+
+    std::FILE * file = std::fopen (file_name, "rb");
+    if (! file)
+    {
+        cerr << "Could not open " << file_name << endl;
+        return 1;
+    }
+
+    std::vector<unsigned char> buf;
+    std::string text;
+    long offset = 0;
+    int ret = 0;
+
+    while (true)
+    {
+        buf.resize (COMPRESSED_FRAME_HEADER_SIZE);
+        std::size_t n = std::fread (&buf[0], 1, buf.size (), file);
+        if (n == 0)
+            break;
+
+        CompressedFrameInfo info;
+        if (! parseCompressedFrameHeader (info, &buf[0], n))
+        {
+            cerr << "Invalid frame header at offset " << offset << endl;
+            ret = 1;
+            break;
+        }
+
+        bool const wanted = ! (info.last < from) && ! (to < info.first);
+        if (list)
+        {
+            cout << offset << '\t' << info.size
+                 << '\t' << info.first.sec () << '.' << info.first.usec ()
+                 << '\t' << info.last.sec () << '.' << info.last.usec ()
+                 << endl;
+        }
+
+        if (list || ! wanted)
+        {
+            if (std::fseek (file, static_cast<long>(info.size - n),
+                    SEEK_CUR) != 0)
+            {
+                ret = 1;
+                break;
+            }
+        }
+        else
+        {
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+            buf.resize (info.size);
+            std::size_t const rest = info.size - n;
+            if (std::fread (&buf[n], 1, rest, file) != rest)
+            {
+                cerr << "Truncated frame at offset " << offset << endl;
+                ret = 1;
+                break;
+            }
+
+            text.clear ();
+            if (! decodeCompressedFrame (text, &buf[0], buf.size ()))
+            {
+                cerr << "Corrupted frame at offset " << offset << endl;
+                ret = 1;
+                break;
+            }
+
+            cout.write (text.data (), static_cast<std::streamsize>(text.size ()));
+
+#else
+            cerr << "framereader has been built without zlib." << endl;
+            ret = 1;
+            break;
+
+#endif
+        }
+
+        offset += static_cast<long>(info.size);
+    }
+
+    std::fclose (file);
+    return ret;
+}
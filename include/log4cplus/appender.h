@@ -32,7 +32,9 @@
 #include <log4cplus/helpers/property.h>
 #include <log4cplus/spi/filter.h>
 
+#include <deque>
 #include <memory>
+#include <vector>
 
 
 namespace log4cplus {
@@ -93,13 +95,62 @@ namespace log4cplus {
          */
         virtual void close() = 0;
 
+        /**
+         * Closes and reopens files written by this appender by their
+         * names, e.g. after the files have been renamed or removed by
+         * external log rotation. Buffered data is written into the
+         * old files first. The default implementation does nothing.
+         */
+        virtual void reopenFiles();
+
+        /**
+         * Appends names of files written by this appender to
+         * <code>names</code>. The default implementation does
+         * nothing.
+         */
+        virtual void getFileNames(std::vector<log4cplus::tstring>& names);
+
+        /**
+         * Acquires resources whose acquisition was deferred by the
+         * <tt>LazyOpen</tt> property, e.g. opens the appender's file
+         * or connects to its server, and then appends events that
+         * were buffered in the meantime. It does nothing if the
+         * appender is active already or if another thread is
+         * activating it.
+         */
+        void activate();
+
+        /**
+         * Schedules activate() for execution by a pool of background
+         * threads shared by all appenders, so that appenders are
+         * activated in parallel. It does nothing unless the appender
+         * is waiting for activation. The appender must be owned by a
+         * SharedAppenderPtr. In single-threaded builds, activate() is
+         * called directly.
+         */
+        void scheduleActivation();
+
         /**
          * This method performs threshold checks and invokes filters before
          * delegating actual logging to the subclasses specific {@link
-         * #append} method.
+         * #append} method. The appender's mutex is held while
+         * <code>append()</code> runs, unless the appender has set
+         * <code>selfSynchronized</code>.
          */
         void doAppend(const log4cplus::spi::InternalLoggingEvent& event);
 
+        /**
+         * Appends <code>n</code> events starting at
+         * <code>events</code>. It performs the same checks as
+         * doAppend() on each event, but takes the appender's mutex
+         * only once and hands runs of accepted events over to
+         * appendBatch(). Appenders that have set
+         * <code>selfSynchronized</code> get each accepted event
+         * through append() instead.
+         */
+        virtual void doAppendBatch(const log4cplus::spi::InternalLoggingEvent* events,
+                                   std::size_t n);
+
         /**
          * Get the name of this appender. The name uniquely identifies the
          * appender.
@@ -181,6 +232,38 @@ namespace log4cplus {
          */
         virtual void append(const log4cplus::spi::InternalLoggingEvent& event) = 0;
 
+        /**
+         * Appends events that passed the checks of doAppendBatch(),
+         * with <code>access_mutex</code> held. Subclasses may override
+         * it to format the events into a single buffer and write it at
+         * once. The default implementation calls append() for each
+         * event.
+         */
+        virtual void appendBatch(const log4cplus::spi::InternalLoggingEvent* events,
+                                 std::size_t n);
+
+        /**
+         * Acquires resources deferred by deferActivation(). It is
+         * called by activate() without <code>access_mutex</code>
+         * held. The default implementation does nothing.
+         */
+        virtual void activateResources();
+
+        /**
+         * Handles the <tt>LazyOpen</tt> and
+         * <tt>LazyOpenBufferSize</tt> properties. If lazy opening is
+         * requested, the appender is marked as waiting for
+         * activation and <code>true</code> is returned; the caller
+         * then leaves acquisition of its resources to
+         * activateResources(). Until activation completes, up to
+         * <tt>LazyOpenBufferSize</tt> (1000 by default) events are
+         * buffered and the first of them schedules the activation.
+         */
+        bool deferActivation(const log4cplus::helpers::Properties& properties);
+
+        enum ActivationState { ACTIVE, INACTIVE, ACTIVATION_SCHEDULED,
+            ACTIVATING };
+
       // Data
         /** The layout variable does not need to be set if the appender
          *  implementation has its own layout. */
@@ -201,6 +284,23 @@ namespace log4cplus {
 
         /** Is this appender closed? */
         bool closed;
+
+        /** Guarded by <code>access_mutex</code>. */
+        ActivationState activation;
+
+        /** Events appended before activation completed. */
+        std::deque<log4cplus::spi::InternalLoggingEvent> pendingEvents;
+        std::size_t maxPendingEvents;
+        unsigned long droppedPendingEvents;
+
+        /** Set by subclasses whose append() does its own
+         *  synchronization. doAppend() then does the threshold and
+         *  filter checks without taking <code>access_mutex</code>
+         *  and events are never buffered for activation. */
+        bool selfSynchronized;
+
+    private:
+        void postActivation();
     };
 
     /** This is a pointer to an Appender. */
@@ -0,0 +1,137 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_COMPRESSED_FILE_APPENDER_HEADER_
+#define LOG4CPLUS_COMPRESSED_FILE_APPENDER_HEADER_
+
+#include <log4cplus/config.hxx>
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+#include <log4cplus/appender.h>
+#include <log4cplus/streams.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+
+namespace log4cplus {
+
+    /**
+     * Appends log events to a file in compressed form. The output is
+     * written in independently decodable frames, see {@link
+     * helpers::CompressedFrameInfo}. The resulting file can be
+     * decompressed as a whole by <tt>gzip -d</tt> or <tt>zcat</tt>,
+     * and the <tt>framereader</tt> utility can extract frames
+     * covering a given time range without decompressing the rest of
+     * the file.
+     *
+     * Events are kept in memory until the frame is complete. Events
+     * that have not been written yet are lost if the application
+     * crashes.
+     *
+     * <h3>Properties</h3>
+     * <dl>
+     * <dt><tt>File</tt></dt>
+     * <dd>This property specifies output file name.</dd>
+     *
+     * <dt><tt>Append</tt></dt>
+     * <dd>When it is set true, output file will be appended to
+     * instead of being truncated at opening.</dd>
+     *
+     * <dt><tt>FrameSize</tt></dt>
+     * <dd>Amount of uncompressed data that triggers writing of
+     * a frame. The value is in bytes, <tt>MB</tt> and <tt>KB</tt>
+     * suffixes are allowed. The default is 1 MB.</dd>
+     *
+     * <dt><tt>FrameInterval</tt></dt>
+     * <dd>When non-zero, frame is also written when the events in it
+     * span more than this many seconds. It is checked when an event
+     * is appended, there is no timer: an appender that stops
+     * receiving events keeps its last frame in memory until the next
+     * event arrives or until it is closed or reopened. The default
+     * is 0.</dd>
+     *
+     * <dt><tt>CompressionLevel</tt></dt>
+     * <dd>zlib compression level from 1 to 9. The default is 6.</dd>
+     *
+     * <dt><tt>ImmediateFlush</tt></dt>
+     * <dd>When it is set true, the output stream is flushed after
+     * each frame. The default is true.</dd>
+     * </dl>
+     */
+    class LOG4CPLUS_EXPORT CompressedFileAppender : public Appender {
+    public:
+      // Ctors
+        CompressedFileAppender(const log4cplus::tstring& filename,
+                               unsigned long frameSize = 1024 * 1024,
+                               unsigned long frameInterval = 0,
+                               bool append = false);
+        CompressedFileAppender(const log4cplus::helpers::Properties& properties);
+
+      // Dtor
+        virtual ~CompressedFileAppender();
+
+      // Methods
+        virtual void close();
+
+      //! Writes out the pending frame and reopens the file.
+        virtual void reopenFiles();
+        virtual void getFileNames(std::vector<log4cplus::tstring>& names);
+
+    protected:
+        virtual void append(const spi::InternalLoggingEvent& event);
+
+        //! Compresses and writes out the pending events.
+        void writeFrame();
+
+      // Data
+        log4cplus::tstring filename;
+        std::ofstream out;
+
+        unsigned long frameSize;
+        unsigned long frameInterval;
+        int compressionLevel;
+        bool immediateFlush;
+
+        //! Uncompressed contents of the current frame.
+        std::string frame;
+        log4cplus::helpers::Time frameFirst;
+        log4cplus::helpers::Time frameLast;
+
+    private:
+        void init(bool append);
+
+      // Disallow copying of instances of this class
+        CompressedFileAppender(const CompressedFileAppender&);
+        CompressedFileAppender& operator=(const CompressedFileAppender&);
+    };
+
+} // end namespace log4cplus
+
+#endif // defined (LOG4CPLUS_HAVE_ZLIB)
+
+#endif // LOG4CPLUS_COMPRESSED_FILE_APPENDER_HEADER_
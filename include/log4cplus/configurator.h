@@ -137,6 +137,12 @@ namespace log4cplus
          * log4cplus.appender.appenderName.layout.optionN=valueN
          * </pre>
          *
+         * Appenders that support the <tt>LazyOpen</tt> option, e.g.
+         * file and socket appenders, open their files and connections
+         * in parallel in background threads when it is set true, so
+         * that configuration does not wait for unreachable hosts.
+         * Events logged in the meantime are buffered.
+         *
          * <h3>Configuring loggers</h3>
          *
          * The syntax for configuring the root logger is:
@@ -0,0 +1,173 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_DATAGRAM_APPENDER_HEADER_
+#define LOG4CPLUS_DATAGRAM_APPENDER_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/appender.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/thread/syncprims.h>
+#include <vector>
+
+
+//! Default maximum size of datagram payload; it fits into Ethernet
+//! frame with IPv4 and UDP headers.
+#define LOG4CPLUS_DATAGRAM_MTU 1472
+
+
+namespace log4cplus {
+
+    /**
+     * Sends events to a logging server over UDP. Events are lost
+     * rather than delayed: the appender never waits for the network
+     * and events that cannot be sent are dropped, see
+     * getDroppedEvents().
+     *
+     * Each datagram carries one or more whole events, in the same
+     * size-prefixed frames as SocketAppender sends over TCP. Version
+     * 3 frames are encoded without the dictionary, so each datagram
+     * can be decoded on its own. Logging threads only serialize events
+     * into a queue of datagrams. A sender thread hands all queued
+     * datagrams to the kernel at once, with one <tt>sendmmsg()</tt>
+     * call where it is available. Datagrams that do not fit into the
+     * socket's send buffer are dropped. In single-threaded builds each
+     * event is sent right away.
+     *
+     * <h3>Properties</h3>
+     * <dl>
+     * <dt><tt>host</tt></dt>
+     * <dd>Remote host name to send events to.</dd>
+     *
+     * <dt><tt>port</tt></dt>
+     * <dd>UDP port on remote host. The default is 9998.</dd>
+     *
+     * <dt><tt>ServerName</tt></dt>
+     * <dd>Host name of event's origin prepended to each event.</dd>
+     *
+     * <dt><tt>MTU</tt></dt>
+     * <dd>Maximum size of datagram payload. Events larger than this
+     * are dropped. The default is 1472, up to 65507 can be used if the
+     * network handles IP fragmentation.</dd>
+     *
+     * <dt><tt>QueueSize</tt></dt>
+     * <dd>Number of bytes of datagrams that may wait for the sender
+     * thread. Events that do not fit are dropped. <tt>KB</tt> and
+     * <tt>MB</tt> suffixes can be used. The default is 256 KB.</dd>
+     *
+     * <dt><tt>ProtocolVersion</tt></dt>
+     * <dd>2 or 3, see SocketAppender. The default is 2.</dd>
+     * </dl>
+     */
+    class LOG4CPLUS_EXPORT DatagramAppender : public Appender {
+    public:
+      // Ctors
+        DatagramAppender(const log4cplus::tstring& host, int port,
+                         const log4cplus::tstring& serverName = tstring());
+        DatagramAppender(const log4cplus::helpers::Properties & properties);
+
+      // Dtor
+        ~DatagramAppender();
+
+      // Methods
+        virtual void close();
+
+        //! Returns number of events that were not sent.
+        unsigned long getDroppedEvents() const;
+
+    protected:
+        virtual void append(const spi::InternalLoggingEvent& event);
+
+        //! Sends datagrams in <code>sendingQueue</code> and empties
+        //! it.
+        void sendQueue();
+
+      // Data
+        helpers::DatagramSocket socket;
+        log4cplus::tstring serverName;
+        std::size_t mtu;
+        unsigned protocolVersion;
+
+        //! Serialized form of the event being appended.
+        helpers::SocketBuffer eventBuffer;
+        helpers::MessageEncoder encoder;
+        std::vector<char> eventFrames;
+
+        //! Datagrams stored back to back, with their sizes and counts
+        //! of events in them. The last datagram of
+        //! <code>pendingQueue</code> is filled by the next events.
+        //! Guarded by <code>access_mutex</code>.
+        helpers::SocketBuffer * pendingQueue;
+        std::vector<std::size_t> pendingSizes;
+        std::vector<unsigned> pendingEvents;
+
+        //! Datagrams being sent. Used by the sender thread only.
+        helpers::SocketBuffer * sendingQueue;
+        std::vector<std::size_t> sendingSizes;
+        std::vector<unsigned> sendingEvents;
+
+        unsigned long droppedEvents;
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+        class LOG4CPLUS_EXPORT SenderThread;
+        friend class SenderThread;
+
+        //! Sends queued datagrams.
+        class LOG4CPLUS_EXPORT SenderThread
+            : public thread::AbstractThread
+        {
+        public:
+            SenderThread (DatagramAppender &);
+            virtual ~SenderThread ();
+
+            virtual void run();
+
+            //! Sends the queued datagrams and stops the thread.
+            void terminate ();
+            void trigger ();
+
+        protected:
+            DatagramAppender & da;
+            thread::ManualResetEvent trigger_ev;
+            bool exit_flag;
+        };
+
+        helpers::SharedObjectPtr<SenderThread> sender;
+#endif
+
+    private:
+        void init(std::size_t queueSize);
+
+      // Disallow copying of instances of this class
+        DatagramAppender(const DatagramAppender&);
+        DatagramAppender& operator=(const DatagramAppender&);
+    };
+
+} // end namespace log4cplus
+
+#endif // LOG4CPLUS_DATAGRAM_APPENDER_HEADER_
@@ -28,7 +28,17 @@
 #include <log4cplus/fstreams.h>
 #include <log4cplus/helpers/property.h>
 #include <log4cplus/helpers/timehelper.h>
+#include <log4cplus/helpers/workqueue.h>
+#include <log4cplus/helpers/blockindex.h>
+#include <log4cplus/helpers/spillbuffer.h>
+#include <log4cplus/helpers/compress.h>
+#include <log4cplus/helpers/pagecache.h>
+#include <log4cplus/helpers/lockfile.h>
+#include <log4cplus/helpers/formatpipeline.h>
+#include <log4cplus/streams.h>
 #include <locale>
+#include <sstream>
+#include <vector>
 
 #if defined(__DECCXX)
 #   define LOG4CPLUS_OPEN_MODE_TYPE LOG4CPLUS_FSTREAM_NAMESPACE::ios::open_mode
@@ -38,6 +48,8 @@
 
 namespace log4cplus {
 
+    class SpillDrainer;
+
     /**
      * Appends log events to a file.
      * 
@@ -65,6 +77,93 @@ namespace log4cplus {
      * <dd>Non-zero value of this property sets up buffering of output
      * stream using a buffer of given size.
      * </dd>
+     *
+     * <dt><tt>PageCacheInterval</tt></dt>
+     * <dd>Non-zero value keeps the log file from filling the page
+     * cache. Each time this many bytes have been written, writeback
+     * of the new data is started and the data written before them
+     * are dropped from the page cache. <tt>KB</tt>, <tt>MB</tt> and
+     * <tt>GB</tt> suffixes can be used. Rolled over files are dropped
+     * from the page cache by the background thread; in the rolling
+     * appenders, this property implies <tt>BackgroundRollover</tt>.
+     * The default is 0, disabled.
+     * </dd>
+     *
+     * <dt><tt>SharedFile</tt></dt>
+     * <dd>When it is set true, the file can be written by several
+     * processes at once. Each event is formatted first and then
+     * written by a single <code>write()</code> to a descriptor opened
+     * with <code>O_APPEND</code>, so that records of different
+     * processes do not interleave. Records longer than 64 kB are
+     * split at line boundaries. The file is always appended to and
+     * <tt>BufferSize</tt> is ignored. Rollover in the rolling
+     * appenders is serialized through <tt>LockFile</tt>; processes
+     * that find the file already rolled over by another process just
+     * reopen it. When the rolled over files are compressed, each
+     * write also takes <tt>LockFile</tt>, so that no event is written
+     * into a file that another process is compressing. Only
+     * available on POSIX systems. The default is false.</dd>
+     *
+     * <dt><tt>LockFile</tt></dt>
+     * <dd>Advisory lock file used with <tt>SharedFile</tt>. The
+     * default is the file name with <tt>.lock</tt> suffix.</dd>
+     *
+     * <dt><tt>IndexBlockSize</tt></dt>
+     * <dd>Non-zero value makes the appender write sidecar index file
+     * with <tt>.idx</tt> suffix. Each entry of the index describes
+     * one block of about this many bytes of the log file: its offset,
+     * time of its first and last event, counts of events per level
+     * and CRC of the data. <tt>KB</tt>, <tt>MB</tt> and <tt>GB</tt>
+     * suffixes can be used. The index is renamed along with the log
+     * file at rollover. Data written before a crash but not indexed
+     * yet stays unindexed. It cannot be used with <tt>SharedFile</tt>.
+     * See {@link log4cplus::helpers::BlockIndexEntry}. The default is
+     * 0, disabled.</dd>
+     *
+     * <dt><tt>SpillBufferSize</tt></dt>
+     * <dd>Non-zero value sets up in-memory buffer of this many
+     * characters that absorbs events while the file cannot be
+     * written, e.g. when the disk is full or an NFS server does not
+     * respond. Writes are done without holding the appender's lock,
+     * so that threads logging through other loggers do not queue up
+     * behind a stalled write. Once a write fails or takes longer
+     * than <tt>SpillLatency</tt>, events are only formatted into the
+     * buffer and a background thread writes them out, reopening the
+     * file if needed. When the buffer has been drained and writes
+     * are fast again, the appender goes back to writing directly.
+     * Events that do not fit into the buffer are dropped and counted,
+     * see getDroppedEvents(). Rollover is postponed while the buffer
+     * is in use. <tt>KB</tt>, <tt>MB</tt> and <tt>GB</tt> suffixes
+     * can be used. Not available in single-threaded builds. The
+     * default is 0, disabled.</dd>
+     *
+     * <dt><tt>SpillLatency</tt></dt>
+     * <dd>Write latency in milliseconds above which the file is
+     * considered stalled. The default is 100.</dd>
+     *
+     * <dt><tt>LazyOpen</tt></dt>
+     * <dd>When it is set true, the file is not opened by the
+     * constructor but by Appender::activate(), which is scheduled by
+     * PropertyConfigurator or by the first event. Events are buffered
+     * until the file is open.</dd>
+     *
+     * <dt><tt>LazyOpenBufferSize</tt></dt>
+     * <dd>Maximum number of events buffered before the file is
+     * opened. Further events are dropped. The default is 1000.</dd>
+     *
+     * <dt><tt>FormatThreads</tt></dt>
+     * <dd>Non-zero value sets up this many threads that format events
+     * in parallel, see {@link log4cplus::helpers::FormatPipeline}.
+     * A separate thread writes the formatted events in the order in
+     * which they were appended. It helps a single appender that
+     * receives more events than one thread can format. The layout
+     * must not be changed while the appender is in use. Not available
+     * in single-threaded builds. The default is 0, disabled.</dd>
+     *
+     * <dt><tt>FormatQueueSize</tt></dt>
+     * <dd>Maximum number of events waiting to be formatted or
+     * written. When the queue is full, the appending thread writes
+     * out formatted events itself. The default is 1024.</dd>
      * </dl>
      */
     class LOG4CPLUS_EXPORT FileAppender : public Appender {
@@ -82,6 +181,11 @@ namespace log4cplus {
       // Methods
         virtual void close();
 
+      //! Reopens the file by its name. While events are being spilled
+      //! to memory, the file is reopened when spilling ends.
+        virtual void reopenFiles();
+        virtual void getFileNames(std::vector<log4cplus::tstring>& names);
+
       //! Redefine default locale for output stream. It may be a good idea to
       //! provide UTF-8 locale in case UNICODE macro is defined.
         virtual std::locale imbue(std::locale const& loc);
@@ -89,12 +193,80 @@ namespace log4cplus {
       //! \Return Locale imbued in fstream. 
         virtual std::locale getloc () const;
 
+      //! Returns number of events dropped because the spill buffer
+      //! was full; see <tt>SpillBufferSize</tt>.
+        unsigned long getDroppedEvents () const;
+
     protected:
         virtual void append(const spi::InternalLoggingEvent& event);
 
+        //! Formats the events into a single buffer that is written
+        //! and flushed at once. Falls back to append() for each event
+        //! while spilling, or when the block index or page cache
+        //! trimming, which work per event, are enabled.
+        virtual void appendBatch(const spi::InternalLoggingEvent* events,
+                                 std::size_t n);
+        virtual void activateResources();
+
         void open(LOG4CPLUS_OPEN_MODE_TYPE mode);
         bool reopen();
 
+        //! Returns current size of the output file.
+        std::streamoff getFileSize();
+
+        //! With <tt>SharedFile</tt>, checks whether the output file
+        //! has been replaced by another process and reopens it.
+        //! Returns true if the file has been reopened.
+        bool reopenIfReplaced();
+
+        //! Hands work item over to the background file worker,
+        //! creating the worker on first use.
+        void postFileWork(const log4cplus::helpers::WorkItemPtr& item);
+
+        //! Reads <tt>BackgroundRollover</tt> and compression related
+        //! properties shared by the rolling appenders.
+        void initBackgroundWork(const log4cplus::helpers::Properties& properties);
+
+        //! Renames temporary rollover files left by processes that
+        //! have exited before finishing them to temporary names of
+        //! this appender and returns the new names, oldest first.
+        //! With <tt>SharedFile</tt>, it must be called with the lock
+        //! file held; processes that still use the lock file keep
+        //! their files. Without it, any other process is taken to be
+        //! gone.
+        std::vector<log4cplus::tstring> claimAbandonedRollovers();
+
+        //! Waits until events held in the spill buffer have been
+        //! written out, or dropped if the file cannot be written, and
+        //! stops spilling. The buffer accepts events again afterwards.
+        //! It must not be called with
+        //! <code>access_mutex</code> held.
+        void finishSpill();
+
+        //! Returns true if events are written with
+        //! <code>lockFile</code> held; see <tt>SharedFile</tt>.
+        bool writesUnderLockFile() const;
+
+        //! Returns true if no other thread uses the file, so that it
+        //! can be rolled over or reopened under
+        //! <code>access_mutex</code>.
+        bool ownsFile() const;
+
+        //! Hands the event over to <code>formatPipeline</code> unless
+        //! the pipeline is committing it. Returns true if the event
+        //! has been submitted.
+        bool submitFormatted(const spi::InternalLoggingEvent& event);
+
+        //! Returns the event formatted by <code>layout</code>, or by
+        //! <code>formatPipeline</code> while it is committing it.
+        const log4cplus::tstring& formatEvent(
+            const spi::InternalLoggingEvent& event);
+
+        //! Writes out events held in <code>formatPipeline</code> and
+        //! stops its threads. It must not be called with
+        //! <code>access_mutex</code> held.
+        void stopFormatPipeline();
+
       // Data
         /**
          * Immediate flush means that the underlying writer or output stream
@@ -127,9 +299,116 @@ namespace log4cplus {
 
         log4cplus::helpers::Time reopen_time;
 
+        /**
+         * When <code>backgroundRollover</code> is set, rolled over file
+         * is only renamed to a temporary name in append() and the
+         * rest of the backup files renaming is done by background
+         * thread.
+         */
+        bool backgroundRollover;
+
+        //! Sequence number used to generate temporary rollover names.
+        unsigned long rolloverSequence;
+
+        //! Codec used to compress rolled over files. Compression
+        //! implies <code>backgroundRollover</code>.
+        log4cplus::helpers::CompressionCodec compression;
+
+        //! Nice level of the background worker thread.
+        int workerNiceLevel;
+
+        //! Background worker for file renaming. It is created lazily.
+        log4cplus::helpers::WorkQueuePtr fileWorker;
+
+        //! Drops written parts of the log file from the page cache.
+        log4cplus::helpers::PageCacheTrimmer cacheTrimmer;
+
+        //! Set when the file is shared by several processes; see
+        //! <tt>SharedFile</tt> property.
+        bool sharedFile;
+
+        //! Descriptor opened with <code>O_APPEND</code> that is used
+        //! instead of <code>out</code> when <code>sharedFile</code>
+        //! is set.
+        int sharedFd;
+
+        //! Lock serializing rollover of shared file among processes.
+        log4cplus::helpers::LockFile * lockFile;
+
+        //! Buffer for formatting of batches of events.
+        log4cplus::tstring batchBuffer;
+
+        //! Writes sidecar index of the output file; see
+        //! <tt>IndexBlockSize</tt> property.
+        log4cplus::helpers::BlockIndexWriter blockIndex;
+
+        //! Holds events while the file is stalled; see
+        //! <tt>SpillBufferSize</tt>.
+        log4cplus::helpers::SpillBuffer spill;
+
+        //! Write latency that switches the appender to spilling.
+        log4cplus::helpers::Time spillLatency;
+
+        //! Set while events go to <code>spill</code> instead of the
+        //! file. The file is then written only by the background
+        //! worker. Guarded by <code>access_mutex</code>.
+        bool spilling;
+
+        //! Background worker draining <code>spill</code>. It is
+        //! created lazily.
+        log4cplus::helpers::WorkQueuePtr spillWorker;
+
+        //! Serializes the drainer with writes into the file that are
+        //! done with <code>access_mutex</code> released when
+        //! <code>spill</code> is enabled. It is taken after
+        //! <code>access_mutex</code>.
+        log4cplus::thread::Mutex file_mutex;
+
+        //! Set while a thread writes with <code>access_mutex</code>
+        //! released. Guarded by <code>access_mutex</code>.
+        bool writing;
+
+        //! Time the write marked by <code>writing</code> has started.
+        log4cplus::helpers::Time writeStart;
+
+        //! Signalled when the write marked by <code>writing</code>
+        //! is done.
+        log4cplus::thread::ManualResetEvent writeDone;
+
+        //! Value of dropped events counter when spilling started.
+        unsigned long spillDroppedBase;
+
+        //! Set by reopenFiles() while the file is not owned by the
+        //! appender's lock; see ownsFile().
+        bool reopenPending;
+
+        //! Mode the file is opened in by activateResources().
+        LOG4CPLUS_OPEN_MODE_TYPE lazyOpenMode;
+
+        //! Formats events in parallel; see <tt>FormatThreads</tt>.
+        log4cplus::helpers::FormatPipeline * formatPipeline;
+        log4cplus::helpers::FormatPipeline::Stage * formatStage;
+
+        //! Text of the event that <code>formatPipeline</code> is
+        //! committing, null otherwise.
+        const log4cplus::tstring * committedText;
+
     private:
         void init(const log4cplus::tstring& filename,
                   LOG4CPLUS_OPEN_MODE_TYPE mode);
+        void appendShared(const log4cplus::tstring& text);
+        bool isOpen() const;
+        void reopenFile();
+        void recordWritten(const log4cplus::helpers::Time& timestamp,
+                           LogLevel ll, const log4cplus::tstring& text);
+        void spillEvent(const spi::InternalLoggingEvent& event);
+        void startSpill();
+        void drainSpill();
+        bool writeSpilled(const log4cplus::tstring& text, bool flush);
+        void appendUnlocked(const spi::InternalLoggingEvent& event);
+
+        friend class SpillDrainer;
+        friend class FormatStage;
 
       // Disallow copying of instances of this class
         FileAppender(const FileAppender&);
@@ -138,6 +417,11 @@ namespace log4cplus {
 
 
 
+    enum RollingFileNaming { INDEX_NAMING, SEQUENCE_NAMING,
+                             TIMESTAMP_NAMING };
+
+    class BackupFileSet;
+
     /**
      * RollingFileAppender extends FileAppender to backup the log
      * files when they reach a certain size.
@@ -148,21 +432,70 @@ namespace log4cplus {
      * <dl>
      * <dt><tt>MaxFileSize</tt></dt>
      * <dd>This property specifies maximal size of output file. The
-     * value is in bytes. It is possible to use <tt>MB</tt> and
-     * <tt>KB</tt> suffixes to specify the value in megabytes or
-     * kilobytes instead.</dd>
+     * value is in bytes. It is possible to use <tt>GB</tt>, <tt>MB</tt>
+     * and <tt>KB</tt> suffixes to specify the value in gigabytes,
+     * megabytes or kilobytes instead.</dd>
      *
      * <dt><tt>MaxBackupIndex</tt></dt>
      * <dd>This property limits the number of backup output
      * files; e.g. how many <tt>log.1</tt>, <tt>log.2</tt> etc. files
-     * will be kept.</dd>
+     * will be kept. With <tt>sequence</tt> and <tt>timestamp</tt>
+     * naming, value 0 means no limit.</dd>
+     *
+     * <dt><tt>BackupNaming</tt></dt>
+     * <dd>Naming of backup files. With <tt>index</tt> (the default),
+     * the newest backup is always <tt>log.1</tt> and all older backups
+     * are renamed at each rollover. With <tt>sequence</tt>, each
+     * backup gets the next sequence number, e.g.
+     * <tt>log.00000042</tt>, and with <tt>timestamp</tt> it gets the
+     * time of the rollover, e.g. <tt>log.2011-11-07-13-05-42</tt>. The
+     * latter two never rename existing backups; the oldest ones are
+     * removed according to <tt>MaxBackupIndex</tt>,
+     * <tt>MaxTotalSize</tt> and <tt>MaxBackupAge</tt>. Backups left by
+     * earlier runs are found by scanning the directory when the
+     * appender is created.</dd>
+     *
+     * <dt><tt>MaxTotalSize</tt></dt>
+     * <dd>Limit of total size of backup files with <tt>sequence</tt>
+     * and <tt>timestamp</tt> naming. Suffixes are the same as for
+     * <tt>MaxFileSize</tt>. The default is 0, no limit.</dd>
+     *
+     * <dt><tt>MaxBackupAge</tt></dt>
+     * <dd>Backup files older than this many seconds are removed at
+     * rollover, with <tt>sequence</tt> and <tt>timestamp</tt> naming.
+     * The default is 0, no limit.</dd>
+     *
+     * <dt><tt>BackgroundRollover</tt></dt>
+     * <dd>When it is set true, the output file is renamed to
+     * a temporary name at rollover and logging continues into a new
+     * file immediately. Renaming of the backup files chain is done
+     * by a background thread. Temporary files left by a process that
+     * exited before its background thread finished them are taken
+     * over at the next rollover. The default is false.</dd>
+     *
+     * <dt><tt>Compression</tt></dt>
+     * <dd>Codec used to compress rolled over files: <tt>none</tt>
+     * (the default), <tt>gzip</tt> or <tt>lz4</tt>. Availability of
+     * the codecs depends on libraries found at build time. Compressed
+     * backups get <tt>.gz</tt> or <tt>.lz4</tt> suffix, e.g.
+     * <tt>log.1.gz</tt>. Compression is done by the background
+     * thread, setting this property implies <tt>BackgroundRollover</tt>.
+     * </dd>
+     *
+     * <dt><tt>CompressionNiceLevel</tt></dt>
+     * <dd>Nice level of the background thread when compression is
+     * enabled. The default is 10.</dd>
+     *
+     * <dt><tt>MaxConcurrentCompressions</tt></dt>
+     * <dd>Process wide limit of files being compressed at the same
+     * time by all appenders. The default is 1.</dd>
      * </dl>
      */
     class LOG4CPLUS_EXPORT RollingFileAppender : public FileAppender {
     public:
       // Ctors
         RollingFileAppender(const log4cplus::tstring& filename,
-                            long maxFileSize = 10*1024*1024, // 10 MB
+                            std::streamoff maxFileSize = 10*1024*1024, // 10 MB
                             int maxBackupIndex = 1,
                             bool immediateFlush = true);
         RollingFileAppender(const log4cplus::helpers::Properties& properties);
@@ -172,14 +505,33 @@ namespace log4cplus {
 
     protected:
         virtual void append(const spi::InternalLoggingEvent& event);
+
+        //! Checks the file size once, after the whole batch.
+        virtual void appendBatch(const spi::InternalLoggingEvent* events,
+                                 std::size_t n);
         void rollover();
 
       // Data
-        long maxFileSize;
+        std::streamoff maxFileSize;
         int maxBackupIndex;
 
+        RollingFileNaming naming;
+        std::streamoff maxTotalSize;
+        long maxBackupAge;
+
+        //! Backup files tracked in <tt>sequence</tt> and
+        //! <tt>timestamp</tt> naming modes.
+        BackupFileSet * backupFiles;
+
     private:
-        void init(long maxFileSize, int maxBackupIndex);
+        void init(std::streamoff maxFileSize, int maxBackupIndex);
+        void rolloverFile();
+        void postRolloverWork(const log4cplus::tstring& pending,
+                              bool indexed);
+
+        //! Rolls over or reopens full shared file. Must be called
+        //! with the lock file held.
+        void rolloverSharedIfFull();
     };
 
 
@@ -206,6 +558,20 @@ namespace log4cplus {
      * single logging period; e.g. how many <tt>log.2009-11-07.1</tt>,
      * <tt>log.2009-11-07.2</tt> etc. files are kept.</dd>
      *
+     * <dt><tt>BackgroundRollover</tt></dt>
+     * <dd>When it is set true, the output file is renamed to
+     * a temporary name at rollover and logging continues into a new
+     * file immediately. Renaming of the backup files is done by
+     * a background thread. Temporary files left by a process that
+     * exited before its background thread finished them are taken
+     * over at the next rollover and named after the period of their
+     * last modification. The default is false.</dd>
+     *
+     * <dt><tt>Compression</tt>, <tt>CompressionNiceLevel</tt> and
+     * <tt>MaxConcurrentCompressions</tt></dt>
+     * <dd>See {@link RollingFileAppender}. Compressed backup of
+     * <tt>log.2009-11-07</tt> is <tt>log.2009-11-07.gz</tt>.</dd>
+     *
      * </dl>
      */
     class LOG4CPLUS_EXPORT DailyRollingFileAppender : public FileAppender {
@@ -225,6 +591,10 @@ namespace log4cplus {
 
     protected:
         virtual void append(const spi::InternalLoggingEvent& event);
+
+        //! Splits the batch at scheduled rollover times.
+        virtual void appendBatch(const spi::InternalLoggingEvent* events,
+                                 std::size_t n);
         void rollover();
         log4cplus::helpers::Time calculateNextRolloverTime(const log4cplus::helpers::Time& t) const;
         log4cplus::tstring getFilename(const log4cplus::helpers::Time& t) const;
@@ -237,6 +607,16 @@ namespace log4cplus {
 
     private:
         void init(DailyRollingFileSchedule schedule);
+        void rolloverFile();
+        void postRolloverWork(const log4cplus::tstring& pending,
+                              const log4cplus::tstring& target,
+                              bool indexed);
+        void scheduleNextRollover();
+
+        //! Reopens shared file rolled over by another process, or
+        //! rolls it over at time <code>t</code> when it is due. Must
+        //! be called with the lock file held.
+        void rolloverSharedIfDue(const log4cplus::helpers::Time& t);
     };
 
 } // end namespace log4cplus
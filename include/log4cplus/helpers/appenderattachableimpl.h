@@ -96,6 +96,13 @@ namespace log4cplus {
              */
             int appendLoopOnAppenders(const spi::InternalLoggingEvent& event) const;
 
+            /**
+             * Call the <code>doAppendBatch</code> method on all attached
+             * appenders.
+             */
+            int appendBatchLoopOnAppenders(const spi::InternalLoggingEvent* events,
+                                           std::size_t count) const;
+
         protected:
           // Types
             typedef std::vector<SharedAppenderPtr> ListType;
@@ -0,0 +1,184 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_BLOCKINDEX_HEADER_
+#define LOG4CPLUS_HELPERS_BLOCKINDEX_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <log4cplus/loglevel.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <fstream>
+#include <ios>
+
+
+namespace log4cplus { namespace helpers {
+
+
+//! Number of level histogram slots: TRACE, DEBUG, INFO, WARN, ERROR
+//! and FATAL. Custom levels are counted in the slot of the nearest
+//! lower standard level.
+std::size_t const BLOCK_INDEX_LEVELS = 6;
+
+//! Size of one entry in index file.
+std::size_t const BLOCK_INDEX_ENTRY_SIZE = 64;
+
+
+/**
+ * Describes one block of log file in the sidecar index. Index file
+ * is a sequence of fixed size little endian entries:
+ *
+ * <pre>
+ *  0  u32 magic "LIX1"
+ *  4  u32 block length
+ *  8  u64 block offset
+ * 16  u32 first event seconds, u32 microseconds
+ * 24  u32 last event seconds, u32 microseconds
+ * 32  u32 event counts per level [BLOCK_INDEX_LEVELS]
+ * 56  u32 CRC-32 of block data
+ * 60  u32 CRC-32 of bytes 0 - 59 of the entry
+ * </pre>
+ *
+ * Offsets refer to uncompressed data. Each block starts at or after
+ * the end of the previous one; data between them has not been
+ * indexed, e.g. because the writer has crashed.
+ */
+struct BlockIndexEntry
+{
+    std::streamoff offset;
+    unsigned long length;
+    Time first;
+    Time last;
+    unsigned long levels[BLOCK_INDEX_LEVELS];
+    unsigned long crc;
+};
+
+
+//! Returns histogram slot of the level.
+LOG4CPLUS_EXPORT std::size_t blockIndexLevelSlot (LogLevel ll);
+
+//! Updates CRC-32 (the zlib/PNG polynomial) with data. Initial
+//! value of <code>crc</code> is 0.
+LOG4CPLUS_EXPORT unsigned long computeCrc32 (unsigned long crc,
+    void const * data, std::size_t size);
+
+//! Serializes entry into BLOCK_INDEX_ENTRY_SIZE bytes.
+LOG4CPLUS_EXPORT void encodeBlockIndexEntry (unsigned char * buf,
+    BlockIndexEntry const & entry);
+
+//! Parses entry. Returns false if the entry is damaged, e.g. by
+//! a torn write.
+LOG4CPLUS_EXPORT bool decodeBlockIndexEntry (BlockIndexEntry & entry,
+    unsigned char const * buf);
+
+
+/**
+ * Writes sidecar index of a log file while the file is being
+ * written. The writer calls addEvent() with the text of each event,
+ * which updates counters and the CRC of the block, and checks
+ * isDue() now and then. When it returns true, the writer flushes its
+ * stream and calls endBlock(), which appends the entry to the index.
+ * The data file is not read.
+ */
+class LOG4CPLUS_EXPORT BlockIndexWriter
+{
+public:
+    BlockIndexWriter ();
+    ~BlockIndexWriter ();
+
+    //! Sets target block size. Zero disables indexing.
+    void setBlockSize (std::streamoff size);
+
+    bool isEnabled () const
+    {
+        return blockSize != 0;
+    }
+
+    //! Starts indexing of <code>dataFile</code>. Index is appended
+    //! to <code>dataFile + BLOCK_INDEX_SUFFIX</code>. Data already
+    //! in the file that is not covered by the index, e.g. after
+    //! a crash, is left out of the index; the first new block starts
+    //! at the end of the file.
+    void open (tstring const & dataFile);
+
+    //! Accounts event whose <code>text</code> has been written to
+    //! the data file.
+    void addEvent (Time const & ts, LogLevel ll, tstring const & text)
+    {
+        if (! events)
+            first = ts;
+        last = ts;
+        ++levels[blockIndexLevelSlot (ll)];
+        ++events;
+        addData (text);
+    }
+
+    //! Returns true if <code>pos</code> is far enough from the start
+    //! of the current block.
+    bool isDue (std::streamoff pos) const
+    {
+        return index.is_open () && pos - blockStart >= blockSize;
+    }
+
+    //! Closes the block at <code>pos</code>.
+    void endBlock (std::streamoff pos);
+
+    //! Closes the last block at the end of the data file, which
+    //! must have been flushed already, and stops indexing.
+    void close ();
+
+private:
+    void resetBlock ();
+    void addData (tstring const & text);
+
+    std::streamoff blockSize;
+    tstring dataName;
+    std::ofstream index;
+
+    std::streamoff blockStart;
+
+    //! CRC of the text of the events of the current block.
+    unsigned long crc;
+    unsigned long events;
+    Time first;
+    Time last;
+    unsigned long levels[BLOCK_INDEX_LEVELS];
+
+    // Disallow copying of instances of this class.
+    BlockIndexWriter (BlockIndexWriter const &);
+    BlockIndexWriter & operator = (BlockIndexWriter const &);
+};
+
+
+//! Suffix of sidecar index files.
+LOG4CPLUS_EXPORT extern tchar const BLOCK_INDEX_SUFFIX[];
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_BLOCKINDEX_HEADER_
@@ -0,0 +1,201 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_COMPRESS_HEADER_
+#define LOG4CPLUS_HELPERS_COMPRESS_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <string>
+
+
+namespace log4cplus { namespace helpers {
+
+
+//! Codecs usable for compression of rolled log files.
+enum CompressionCodec
+{
+    NO_COMPRESSION,
+    GZIP_COMPRESSION,
+    LZ4_COMPRESSION
+};
+
+
+//! Translates codec name ("none", "gzip" or "lz4") to
+//! CompressionCodec value. Unknown names and codecs that have not
+//! been compiled in are reported through LogLog and mapped to
+//! NO_COMPRESSION.
+LOG4CPLUS_EXPORT CompressionCodec parseCompressionCodec (
+    tstring const & name);
+
+//! Returns true if support for the codec has been compiled in.
+LOG4CPLUS_EXPORT bool isCompressionCodecAvailable (CompressionCodec codec);
+
+//! Returns file name suffix for the codec, e.g. ".gz". The suffix
+//! is empty for NO_COMPRESSION.
+LOG4CPLUS_EXPORT tstring compressedFileSuffix (CompressionCodec codec);
+
+//! Sets the process wide limit of compressFile() calls that are
+//! allowed to run at the same time. The default is 1.
+LOG4CPLUS_EXPORT void setMaxConcurrentCompressions (unsigned limit);
+
+/**
+ * Compresses file <code>src</code> into new file <code>target</code>.
+ * The source file is left untouched. When the number of
+ * compressions in progress is at the limit set by
+ * setMaxConcurrentCompressions(), the call blocks until one of them
+ * finishes.
+ *
+ * @return true on success. On failure the error is reported through
+ * LogLog and partially written <code>target</code> is removed.
+ */
+LOG4CPLUS_EXPORT bool compressFile (tstring const & src,
+    tstring const & target, CompressionCodec codec);
+
+
+/**
+ * Compressed log frame is a complete gzip member that carries an
+ * extra header field with the size of the whole member and with
+ * timestamps of the first and the last event in the frame. A file
+ * of concatenated frames is a valid gzip file and it can also be
+ * scanned frame by frame without decompression.
+ *
+ * The header of each frame is COMPRESSED_FRAME_HEADER_SIZE bytes
+ * long.
+ */
+struct CompressedFrameInfo
+{
+    //! Size of the whole frame, including the header.
+    unsigned long size;
+
+    //! Timestamp of the first event in the frame.
+    Time first;
+
+    //! Timestamp of the last event in the frame.
+    Time last;
+};
+
+
+std::size_t const COMPRESSED_FRAME_HEADER_SIZE = 36;
+
+
+//! Parses frame header. Returns false if the data do not start
+//! with a valid frame header.
+LOG4CPLUS_EXPORT bool parseCompressedFrameHeader (CompressedFrameInfo & info,
+    unsigned char const * data, std::size_t size);
+
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+//! Compresses <code>data</code> into a single frame appended to
+//! <code>out</code>.
+LOG4CPLUS_EXPORT bool encodeCompressedFrame (std::string & out,
+    std::string const & data, Time const & first, Time const & last,
+    int level);
+
+//! Decompresses frame of <code>size</code> bytes and appends the
+//! contents to <code>out</code>.
+LOG4CPLUS_EXPORT bool decodeCompressedFrame (std::string & out,
+    unsigned char const * frame, std::size_t size);
+
+#endif
+
+
+/**
+ * Raw deflate stream of one network connection. Each compress()
+ * call ends with a sync flush, so the peer can decompress all data
+ * passed in so far. Without zlib support isValid() returns false.
+ */
+class LOG4CPLUS_EXPORT StreamCompressor
+{
+public:
+    //! <code>level</code> is zlib compression level, -1 selects
+    //! zlib's default.
+    explicit StreamCompressor (int level = -1);
+    ~StreamCompressor ();
+
+    bool isValid () const { return stream != 0; }
+
+    //! Starts a new stream.
+    void reset ();
+
+    //! Returns upper bound of compress() output for
+    //! <code>size</code> bytes of input.
+    static std::size_t getBound (std::size_t size);
+
+    //! Replaces contents of <code>out</code> with compressed
+    //! <code>in</code>. Returns false on error or if <code>out</code>
+    //! is too small; the stream has to be reset then.
+    bool compress (SocketBuffer const & in, SocketBuffer & out);
+
+private:
+    void * stream;
+
+    // Disallow copying of instances of this class
+    StreamCompressor (StreamCompressor const &);
+    StreamCompressor & operator = (StreamCompressor const &);
+};
+
+
+//! Decompresses stream produced by StreamCompressor.
+class LOG4CPLUS_EXPORT StreamDecompressor
+{
+public:
+    StreamDecompressor ();
+    ~StreamDecompressor ();
+
+    bool isValid () const { return stream != 0; }
+
+    //! Starts a new stream.
+    void reset ();
+
+    /**
+     * Decompresses input at <code>data</code> into at most
+     * <code>outSize</code> bytes at <code>out</code>. Consumed input
+     * is removed by advancing <code>data</code> and decreasing
+     * <code>size</code>. Input may be left over or held in the stream
+     * when <code>out</code> is filled.
+     *
+     * @return number of bytes stored at <code>out</code> or -1 if the
+     * stream is damaged.
+     */
+    long decompress (char const * & data, std::size_t & size, char * out,
+        std::size_t outSize);
+
+private:
+    void * stream;
+
+    // Disallow copying of instances of this class
+    StreamDecompressor (StreamDecompressor const &);
+    StreamDecompressor & operator = (StreamDecompressor const &);
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_COMPRESS_HEADER_
@@ -0,0 +1,162 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_FORMATPIPELINE_HEADER_
+#define LOG4CPLUS_HELPERS_FORMATPIPELINE_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <log4cplus/thread/syncprims.h>
+#include <log4cplus/thread/threads.h>
+#include <vector>
+
+
+namespace log4cplus { namespace helpers {
+
+
+/**
+ * Formats events in parallel and commits them in the order in which
+ * they were submitted.
+ *
+ * Each submitted event is copied into a slot of a ring buffer and
+ * gets a sequence number. A pool of worker threads formats the
+ * slots concurrently. Formatted slots are committed strictly in
+ * sequence order, either by the committer thread or, when the ring
+ * is full, by the submitting thread itself.
+ *
+ * Events are submitted and committed with the owner's mutex held,
+ * so the commit step can use the owner's state as a regular append
+ * would. The workers never take the owner's mutex.
+ *
+ * In single-threaded builds, submit() formats and commits the event
+ * immediately.
+ */
+class LOG4CPLUS_EXPORT FormatPipeline
+{
+public:
+    /**
+     * Steps of the pipeline implemented by its owner.
+     */
+    class LOG4CPLUS_EXPORT Stage
+    {
+    public:
+        virtual ~Stage ();
+
+        //! Formats the event into <code>text</code>, which is kept
+        //! in the event's slot. It is called by the worker threads
+        //! concurrently, without the owner's mutex.
+        virtual void formatEvent (spi::InternalLoggingEvent const & event,
+            tstring & text) = 0;
+
+        //! Writes out the event formatted by formatEvent(). It is
+        //! called in submission order with the owner's mutex held.
+        virtual void commitEvent (spi::InternalLoggingEvent const & event,
+            tstring const & text) = 0;
+    };
+
+    FormatPipeline (Stage & stage, thread::Mutex const & ownerMutex,
+        unsigned workers, std::size_t capacity);
+    ~FormatPipeline ();
+
+    //! Enqueues copy of the event. It has to be called with the
+    //! owner's mutex held.
+    void submit (spi::InternalLoggingEvent const & event);
+
+    //! Commits all submitted events. It has to be called with the
+    //! owner's mutex held.
+    void flush ();
+
+    //! Commits all submitted events and stops the threads. It must
+    //! not be called with the owner's mutex held. Events submitted
+    //! after close() are formatted and committed immediately.
+    void close ();
+
+    //! Returns number of worker threads.
+    unsigned getWorkers () const;
+
+protected:
+    struct Slot
+    {
+        Slot ();
+
+        spi::InternalLoggingEvent event;
+        tstring text;
+        bool ready;
+    };
+
+    void commitReady ();
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    class Worker;
+    class Committer;
+    friend class Worker;
+    friend class Committer;
+
+    void start ();
+    void workerLoop ();
+    void committerLoop ();
+    bool waitForTail ();
+
+    thread::Mutex const & ownerMutex;
+
+    //! Guards the sequence numbers and the ready flags.
+    thread::Mutex slots_mutex;
+
+    //! Counts slots submitted but not yet taken by a worker.
+    thread::Semaphore work_sem;
+
+    //! Signalled when the slot at <code>tail</code> is formatted.
+    thread::ManualResetEvent tail_ev;
+
+    std::vector<thread::AbstractThreadPtr> threads;
+#endif
+
+    Stage & stage;
+    std::vector<Slot> slots;
+
+    //! Sequence number of the next submitted event.
+    std::size_t head;
+
+    //! Sequence number of the next event taken by a worker.
+    std::size_t next;
+
+    //! Sequence number of the next committed event.
+    std::size_t tail;
+
+    unsigned workers;
+    bool closed;
+
+private:
+    FormatPipeline (FormatPipeline const &);
+    FormatPipeline & operator = (FormatPipeline const &);
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_FORMATPIPELINE_HEADER_
@@ -0,0 +1,87 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_LOCKFILE_HEADER_
+#define LOG4CPLUS_HELPERS_LOCKFILE_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <log4cplus/thread/syncprims.h>
+
+
+namespace log4cplus { namespace helpers {
+
+
+/**
+ * Advisory lock file used to serialize operations on a file shared
+ * by several processes. Threads of one process are serialized by
+ * a mutex first, as the operating system locks are per process.
+ * Instances with the same name share the mutex and the open lock
+ * file, so that they exclude each other too and closing one of them
+ * does not drop the lock of another; the name has to be spelled the
+ * same way by all of them. It can be used with thread::SyncGuard.
+ *
+ * The lock file also marks processes using it, see
+ * isProcessAlive().
+ */
+class LOG4CPLUS_EXPORT LockFile
+{
+public:
+    explicit LockFile (tstring const & name);
+    ~LockFile ();
+
+    void lock () const;
+    void unlock () const;
+
+    //! Returns false if process with the given ID does not have the
+    //! lock file open, e.g. because it has exited. It returns true
+    //! for processes that cannot be told apart from another process
+    //! using the lock file and also on platforms where this cannot
+    //! be checked. This process must not be asked about.
+    bool isProcessAlive (unsigned long pid) const;
+
+    tstring const & getName () const
+    {
+        return name;
+    }
+
+    struct Shared;
+
+private:
+    tstring name;
+    Shared * shared;
+
+    // Disallow copying of instances of this class.
+    LockFile (LockFile const &);
+    LockFile & operator = (LockFile const &);
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_LOCKFILE_HEADER_
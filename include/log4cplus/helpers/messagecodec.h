@@ -0,0 +1,213 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_MESSAGECODEC_HEADER_
+#define LOG4CPLUS_HELPERS_MESSAGECODEC_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <map>
+#include <vector>
+
+
+namespace log4cplus { namespace helpers {
+
+
+class SocketBuffer;
+
+
+//! Version byte of compact protocol frames.
+unsigned char const MESSAGE_VERSION_3 = 3;
+
+//! Frame flag: the receiver starts a new dictionary.
+unsigned char const MESSAGE_FLAG_RESET = 0x01;
+
+//! Frame flag: the event continues in the next frame.
+unsigned char const MESSAGE_FLAG_MORE = 0x02;
+
+//! Frame flag: the frame continues the event of the previous frame.
+unsigned char const MESSAGE_FLAG_CONT = 0x04;
+
+//! MessageDecoder refuses events whose frames add up to more than
+//! this many bytes.
+std::size_t const MAX_DECODED_EVENT_SIZE = 16 * 1024 * 1024;
+
+//! First byte of handshake frames.
+unsigned char const MESSAGE_HANDSHAKE = 0x80;
+
+//! Handshake feature: the client's stream is compressed by
+//! StreamCompressor.
+unsigned char const HANDSHAKE_DEFLATE = 0x01;
+
+//! Size of handshake frame, including the size prefix.
+std::size_t const HANDSHAKE_FRAME_SIZE = 6;
+
+
+/**
+ * A client that wants optional protocol features sends a handshake
+ * frame as its first frame and waits for the server's reply:
+ *
+ * <pre>
+ *  u32     frame size, 2
+ *  u8      MESSAGE_HANDSHAKE
+ *  u8      features, HANDSHAKE_*
+ * </pre>
+ *
+ * The client asks for features, the reply has those that the server
+ * accepted. Servers that do not know handshakes do not reply. With
+ * HANDSHAKE_DEFLATE accepted, all data the client sends after the
+ * handshake, frames of either version, go through one
+ * StreamCompressor.
+ */
+LOG4CPLUS_EXPORT void appendHandshake (SocketBuffer & buffer,
+    unsigned char features);
+
+//! Returns true and sets <code>features</code> if the frame,
+//! without the size prefix, is a handshake.
+LOG4CPLUS_EXPORT bool parseHandshake (char const * frame, std::size_t size,
+    unsigned char & features);
+
+//! Returns server name of an event received from a peer of known
+//! identity. The identity goes first, as the server name sent by the
+//! client cannot be trusted; an empty <code>peerName</code> leaves
+//! <code>serverName</code> as it is.
+LOG4CPLUS_EXPORT tstring tagServerName (tstring const & peerName,
+    tstring const & serverName);
+
+
+/**
+ * Encodes events in version 3 of the socket protocol. Frames are
+ * size-prefixed like in version 2:
+ *
+ * <pre>
+ *  u32     frame size, network byte order
+ *  u8      version, 3
+ *  u8      flags, MESSAGE_FLAG_*
+ *  ...     event body or its part
+ * </pre>
+ *
+ * Event body:
+ *
+ * <pre>
+ *  u8      size of character, 1 or 2 as in version 2
+ *  dstr    server name
+ *  dstr    logger name
+ *  svarint log level
+ *  dstr    NDC
+ *  str     message
+ *  dstr    thread
+ *  varint  seconds
+ *  varint  nanoseconds
+ *  dstr    file
+ *  svarint line
+ * </pre>
+ *
+ * Integers are LEB128 varints, signed ones zig-zag encoded. A
+ * <tt>str</tt> is a varint length followed by the characters. A
+ * <tt>dstr</tt> starts with a varint tag: 0 is a <tt>str</tt> that
+ * is added to the dictionary under the next id, 1 is a
+ * <tt>str</tt> that is not, and <tt>n + 2</tt> refers to dictionary
+ * entry <tt>n</tt>. The dictionary lives as long as the connection,
+ * or until a frame with MESSAGE_FLAG_RESET.
+ *
+ * Bodies larger than the frame size limit are split over several
+ * frames, flagged with MESSAGE_FLAG_MORE and MESSAGE_FLAG_CONT.
+ */
+class LOG4CPLUS_EXPORT MessageEncoder
+{
+public:
+    //! Without <code>useDictionary</code> the frames do not depend on
+    //! each other. Zero <code>maxFrameSize</code> disables splitting.
+    explicit MessageEncoder (bool useDictionary = true,
+        std::size_t maxFrameSize = 0);
+
+    //! Starts new dictionary. The next frame tells the receiver to do
+    //! the same.
+    void reset ();
+
+    //! Appends size-prefixed frames of the event to
+    //! <code>frames</code>.
+    void encode (std::vector<char> & frames,
+        spi::InternalLoggingEvent const & event, tstring const & serverName);
+
+private:
+    void appendString (tstring const & str, bool shared);
+
+    std::map<tstring, unsigned long> dictionary;
+    bool useDictionary;
+    bool resetPending;
+    std::size_t maxFrameSize;
+    std::vector<char> body;
+};
+
+
+/**
+ * Decodes frames of protocol versions 2 and 3 received over one
+ * connection, in order. It keeps the dictionary and the parts of
+ * split events between calls.
+ */
+class LOG4CPLUS_EXPORT MessageDecoder
+{
+public:
+    MessageDecoder ();
+
+    //! Forgets the dictionary and incomplete event.
+    void reset ();
+
+    //! Identity of the process on the other end, e.g. of a local
+    //! socket. It is put before the server name sent with the
+    //! events, see tagServerName().
+    void setPeerName (tstring const & name);
+
+    //! Decodes frame without the size prefix. When it completes an
+    //! event, the event is appended to <code>events</code>. Returns
+    //! false if the frame is damaged or if the event it continues
+    //! grows over MAX_DECODED_EVENT_SIZE.
+    bool decode (SocketBuffer & frame,
+        std::vector<spi::InternalLoggingEvent> & events);
+
+    //! Same as above for frame in memory.
+    bool decode (char const * frame, std::size_t size,
+        std::vector<spi::InternalLoggingEvent> & events);
+
+private:
+    bool decodeFrame (unsigned char const * p, std::size_t size,
+        std::vector<spi::InternalLoggingEvent> & events);
+    bool decodeBody (std::vector<spi::InternalLoggingEvent> & events);
+
+    std::vector<tstring> dictionary;
+    std::vector<char> body;
+    tstring peerName;
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_MESSAGECODEC_HEADER_
@@ -0,0 +1,111 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_PAGECACHE_HEADER_
+#define LOG4CPLUS_HELPERS_PAGECACHE_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <ios>
+
+
+namespace log4cplus { namespace helpers {
+
+
+/**
+ * Keeps log file that is being written from filling the page
+ * cache. Every time another <code>interval</code> bytes have been
+ * written, writeback of the new region is started and the region
+ * completed at the previous step, which should already be on disk
+ * by then, is waited for and dropped from the page cache. The
+ * writer thus never waits for the region it is currently filling.
+ *
+ * The file is tracked through a separate read-only descriptor, so
+ * it works with any stream that writes into the file.
+ */
+class LOG4CPLUS_EXPORT PageCacheTrimmer
+{
+public:
+    PageCacheTrimmer ();
+    ~PageCacheTrimmer ();
+
+    //! Sets the interval in bytes. Zero disables trimming.
+    void setInterval (std::streamoff interval);
+
+    bool isEnabled () const
+    {
+        return interval != 0;
+    }
+
+    //! Starts tracking file <code>name</code>. Contents already
+    //! present in the file are left alone.
+    void open (tstring const & name);
+
+    //! Notifies that the file has been written up to
+    //! <code>pos</code>. The caller should flush its buffers first
+    //! when isDue() returns true.
+    void written (std::streamoff pos);
+
+    //! Returns true when written() at <code>pos</code> would start
+    //! writeback of another region.
+    bool isDue (std::streamoff pos) const
+    {
+        return fd != -1 && pos - started >= interval;
+    }
+
+    //! Stops tracking the file. Writeback of the rest of the file is
+    //! started but not waited for.
+    void close ();
+
+private:
+    std::streamoff interval;
+    int fd;
+
+    //! Start of the region whose writeback has been started.
+    std::streamoff done;
+
+    //! End of the region whose writeback has been started.
+    std::streamoff started;
+
+    // Disallow copying of instances of this class.
+    PageCacheTrimmer (PageCacheTrimmer const &);
+    PageCacheTrimmer & operator = (PageCacheTrimmer const &);
+};
+
+
+//! Returns true if page cache control has been compiled in.
+LOG4CPLUS_EXPORT bool isPageCacheControlAvailable ();
+
+//! Writes file <code>name</code> to disk and drops it from the page
+//! cache. It blocks until the writeback is done.
+LOG4CPLUS_EXPORT void dropFileCache (tstring const & name);
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_PAGECACHE_HEADER_
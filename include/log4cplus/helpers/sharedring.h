@@ -0,0 +1,140 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_SHAREDRING_HEADER_
+#define LOG4CPLUS_HELPERS_SHAREDRING_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <vector>
+
+
+//! Default size of shared memory ring, in bytes.
+#define LOG4CPLUS_SHARED_RING_SIZE (4 * 1024 * 1024)
+
+
+namespace log4cplus { namespace helpers {
+
+
+/**
+ * Ring buffer of records in POSIX shared memory. Any number of
+ * threads and processes write records, one reader takes them out in
+ * order.
+ *
+ * Writers reserve space without waiting for each other or for the
+ * reader. A writer first claims the header word of the record at the
+ * end of the reserved space with a compare-and-swap; the word holds
+ * the record's size and its writer, so the record is never without
+ * an owner. Then the end of the reserved space is moved past the
+ * record, by the writer or by whoever finds the claim first. The
+ * header word is marked committed once the data are written. A
+ * record does not wrap around the end of the ring; the space left at
+ * the end is taken by a padding record. Records that do not fit into
+ * the free space are dropped and counted.
+ *
+ * The reader copies committed records out and gives their space
+ * back. An uncommitted record is waited for as long as its writer
+ * has the ring open; once the writer is gone, only that record is
+ * skipped. Each SharedRing holds a lock on its own writer slot of
+ * the shared memory object, which tells whether it is still open
+ * regardless of PID namespaces. Where open file description locks
+ * are not available, writers are told by their process ids instead
+ * and all processes must share the PID namespace.
+ *
+ * The memory outlives the processes that use it, so the records a
+ * crashed application committed are still read. All processes must
+ * have the same word size. Not available on Windows.
+ */
+class LOG4CPLUS_EXPORT SharedRing
+{
+public:
+    //! Opens the shared memory object with the name, e.g.
+    //! <tt>/log4cplus</tt>. If it does not exist yet, it is created
+    //! with room for <code>size</code> bytes of records, rounded up to
+    //! power of two. An existing object keeps its size.
+    SharedRing (tstring const & name, std::size_t size);
+    ~SharedRing ();
+
+    bool isOpen () const
+    {
+        return header != 0;
+    }
+
+    //! Returns size of the largest record that can be written.
+    std::size_t getMaxRecordSize () const;
+
+    //! Writes the record. Returns false if it was dropped.
+    bool write (char const * data, std::size_t size);
+
+    //! Copies the next committed record into <code>record</code>.
+    //! Returns false if there is none. Only one reader may use the
+    //! ring.
+    bool read (std::vector<char> & record);
+
+    //! Returns number of records dropped by the writers since the
+    //! ring was created.
+    unsigned long getDropped () const;
+
+    //! Returns number of times the reader skipped records of crashed
+    //! writers.
+    unsigned long getAbandoned () const;
+
+    //! Removes the name of the shared memory object. Processes that
+    //! have it open keep using it.
+    static bool remove (tstring const & name);
+
+private:
+    struct Header;
+
+    //! Takes a free writer slot and sets <code>writer</code>.
+    void openWriterSlot ();
+
+    //! Tells whether the writer that claimed a record still has the
+    //! ring open.
+    bool isWriterAlive (unsigned id) const;
+
+    //! Marks <code>len</code> bytes of records at <code>pos</code>
+    //! free and gives them back to the writers.
+    void release (std::size_t pos, std::size_t len);
+
+    Header * header;
+    char * data;
+    std::size_t mapSize;
+    int fd;
+
+    //! Writer id stored in the records this instance claims.
+    unsigned writer;
+
+    // Disallow copying of instances of this class.
+    SharedRing (SharedRing const &);
+    SharedRing & operator = (SharedRing const &);
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_SHAREDRING_HEADER_
@@ -28,6 +28,11 @@
 #include <log4cplus/helpers/socketbuffer.h>
 
 
+//! Largest record written to a seqpacket socket. Readers receive into
+//! buffers of this size.
+#define LOG4CPLUS_SEQPACKET_RECORD_SIZE (64 * 1024)
+
+
 namespace log4cplus {
     namespace helpers {
 
@@ -40,6 +45,12 @@ namespace log4cplus {
                            message_truncated
                          };
 
+        //! Type of Unix domain socket. Records of a seqpacket socket
+        //! keep their boundaries.
+        enum LocalSocketType { local_stream,
+                               local_seqpacket
+                             };
+
         typedef std::ptrdiff_t SOCKET_TYPE;
 
         extern LOG4CPLUS_EXPORT SOCKET_TYPE const INVALID_SOCKET_VALUE;
@@ -80,12 +91,31 @@ namespace log4cplus {
           // ctor and dtor
             Socket();
             Socket(SOCKET_TYPE sock, SocketState state, int err);
-            Socket(const tstring& address, unsigned short port);
+            //! Connects to the address. Non-zero
+            //! <code>connectTimeout</code> limits the time the
+            //! connection attempt may take, in milliseconds.
+            Socket(const tstring& address, unsigned short port,
+                   unsigned long connectTimeout = 0);
+            //! Connects to the Unix domain socket at the path. Writes
+            //! to a seqpacket socket are split into records of at most
+            //! LOG4CPLUS_SEQPACKET_RECORD_SIZE bytes.
+            Socket(const tstring& path, LocalSocketType type);
             virtual ~Socket();
 
           // methods
             virtual bool read(SocketBuffer& buffer);
             virtual bool write(const SocketBuffer& buffer);
+
+            //! See helpers::setSendTimeout().
+            bool setSendTimeout(unsigned long timeout);
+
+            //! See helpers::setReceiveTimeout().
+            bool setReceiveTimeout(unsigned long timeout);
+
+        protected:
+            //! Largest amount of data written with one call, 0 for no
+            //! limit.
+            std::size_t recordSize;
         };
 
 
@@ -100,24 +130,100 @@ namespace log4cplus {
         public:
           // ctor and dtor
             ServerSocket(unsigned short port);
+            //! Listens on Unix domain socket at the path.
+            ServerSocket(const tstring& path, LocalSocketType type);
             virtual ~ServerSocket();
 
             Socket accept();
         };
 
 
+        /**
+         * UDP socket. Sending never blocks; datagrams that do not fit
+         * into the socket's send buffer are not sent.
+         */
+        class LOG4CPLUS_EXPORT DatagramSocket : public AbstractSocket {
+        public:
+          // ctor and dtor
+            DatagramSocket();
+            //! Socket that sends datagrams to the address.
+            DatagramSocket(const tstring& address, unsigned short port);
+            //! Socket that receives datagrams sent to the port.
+            explicit DatagramSocket(unsigned short port);
+            virtual ~DatagramSocket();
+
+          // methods
+            //! Sends <code>count</code> datagrams stored back to back at
+            //! <code>data</code>, datagram <code>i</code> being
+            //! <code>sizes[i]</code> bytes long. Returns number of
+            //! datagrams sent, or -1 if none could be sent.
+            long write(const char* data, const std::size_t* sizes,
+                std::size_t count);
+
+            //! Receives one datagram into the buffer. Returns false on
+            //! error.
+            bool read(SocketBuffer& buffer);
+        };
+
+
         LOG4CPLUS_EXPORT SOCKET_TYPE openSocket(unsigned short port, SocketState& state);
         LOG4CPLUS_EXPORT SOCKET_TYPE connectSocket(const log4cplus::tstring& hostn,
-                                                   unsigned short port, SocketState& state);
+                                                   unsigned short port, SocketState& state,
+                                                   unsigned long timeout = 0);
         LOG4CPLUS_EXPORT SOCKET_TYPE acceptSocket(SOCKET_TYPE sock, SocketState& state);
         LOG4CPLUS_EXPORT int closeSocket(SOCKET_TYPE sock);
 
         LOG4CPLUS_EXPORT long read(SOCKET_TYPE sock, SocketBuffer& buffer);
-        LOG4CPLUS_EXPORT long write(SOCKET_TYPE sock, const SocketBuffer& buffer);
+        //! Non-zero <code>recordSize</code> limits the amount of data
+        //! passed to one <code>send()</code> call, which is one record
+        //! of a seqpacket socket.
+        LOG4CPLUS_EXPORT long write(SOCKET_TYPE sock, const SocketBuffer& buffer,
+                                    std::size_t recordSize = 0);
+
+        //! Opens listening Unix domain socket at the path. A stale
+        //! socket left at the path, one that refuses connections, is
+        //! removed; it fails if a server still listens on it. Not
+        //! supported on Windows.
+        LOG4CPLUS_EXPORT SOCKET_TYPE openLocalSocket(
+            const log4cplus::tstring& path, LocalSocketType type,
+            SocketState& state);
+        //! Connects to Unix domain socket at the path.
+        LOG4CPLUS_EXPORT SOCKET_TYPE connectLocalSocket(
+            const log4cplus::tstring& path, LocalSocketType type,
+            SocketState& state);
+        //! Returns identity of the process on the other end of a Unix
+        //! domain socket, taken from <code>SO_PEERCRED</code>, or
+        //! empty string where it is not available.
+        LOG4CPLUS_EXPORT log4cplus::tstring getLocalPeerName(
+            SOCKET_TYPE sock);
+
+        //! Opens UDP socket bound to the port.
+        LOG4CPLUS_EXPORT SOCKET_TYPE openDatagramSocket(unsigned short port,
+            SocketState& state);
+        //! Opens non-blocking UDP socket connected to the address.
+        LOG4CPLUS_EXPORT SOCKET_TYPE connectDatagramSocket(
+            const log4cplus::tstring& hostn, unsigned short port,
+            SocketState& state);
+        //! See DatagramSocket::write(). Uses <code>sendmmsg()</code>
+        //! where available.
+        LOG4CPLUS_EXPORT long writeDatagrams(SOCKET_TYPE sock,
+            const char* data, const std::size_t* sizes, std::size_t count);
+        //! Receives one datagram. Returns its size or -1.
+        LOG4CPLUS_EXPORT long readDatagram(SOCKET_TYPE sock,
+            SocketBuffer& buffer);
 
         LOG4CPLUS_EXPORT tstring getHostname (bool fqdn);
         LOG4CPLUS_EXPORT int setTCPNoDelay (SOCKET_TYPE, bool);
 
+        //! Makes writes that cannot proceed for <code>timeout</code>
+        //! milliseconds fail.
+        LOG4CPLUS_EXPORT int setSendTimeout (SOCKET_TYPE, unsigned long timeout);
+
+        //! Makes reads that get no data for <code>timeout</code>
+        //! milliseconds fail.
+        LOG4CPLUS_EXPORT int setReceiveTimeout (SOCKET_TYPE,
+            unsigned long timeout);
+
     } // end namespace helpers
 } // end namespace log4cplus
 
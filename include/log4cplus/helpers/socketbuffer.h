@@ -45,6 +45,9 @@ namespace log4cplus {
             void setSize(std::size_t s) { size = s; }
             std::size_t getPos() const { return pos; }
 
+            //! Empties the buffer so that it can be filled again.
+            void clear() { size = 0; pos = 0; }
+
             unsigned char readByte();
             unsigned short readShort();
             unsigned int readInt();
@@ -55,6 +58,7 @@ namespace log4cplus {
             void appendInt(unsigned int val);
             void appendString(const tstring& str);
             void appendBuffer(const SocketBuffer& buffer);
+            void appendBytes(const char* data, std::size_t len);
 
         private:
           // Data
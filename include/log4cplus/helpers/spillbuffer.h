@@ -0,0 +1,126 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_SPILLBUFFER_HEADER_
+#define LOG4CPLUS_HELPERS_SPILLBUFFER_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <log4cplus/loglevel.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <log4cplus/thread/syncprims.h>
+#include <deque>
+
+
+namespace log4cplus { namespace helpers {
+
+
+//! Formatted event held by {@link SpillBuffer}.
+struct SpillRecord
+{
+    tstring text;
+    Time timestamp;
+    LogLevel ll;
+};
+
+
+/**
+ * Bounded FIFO of formatted events that absorbs writes while output
+ * of an appender is stalled. Producers push() records under the
+ * appender's lock and never block on the output; single consumer
+ * pops and writes them. When the buffer is full, records are
+ * dropped and counted.
+ */
+class LOG4CPLUS_EXPORT SpillBuffer
+{
+public:
+    SpillBuffer ();
+    ~SpillBuffer ();
+
+    //! Sets capacity in characters of formatted text. Zero disables
+    //! the buffer.
+    void setCapacity (std::size_t capacity);
+
+    bool isEnabled () const
+    {
+        return capacity != 0;
+    }
+
+    //! Appends record. Returns false if the record has been dropped
+    //! because the buffer is full or closed.
+    bool push (tstring const & text, Time const & timestamp, LogLevel ll);
+
+    //! Removes the oldest record. Returns false if the buffer is
+    //! empty.
+    bool pop (SpillRecord & record);
+
+    bool empty () const;
+
+    //! Waits at most <code>msec</code> milliseconds for a record to
+    //! be pushed or for the buffer to be closed.
+    void waitForRecords (unsigned long msec) const;
+
+    //! Waits at most <code>msec</code> milliseconds for the buffer
+    //! to be closed. Returns true if it has been closed.
+    bool waitForClose (unsigned long msec) const;
+
+    //! Rejects further records and wakes up the consumer.
+    void close ();
+
+    //! Accepts records again after close().
+    void reopen ();
+
+    bool isClosed () const;
+
+    //! Returns number of records dropped since the buffer has been
+    //! created.
+    unsigned long getDropped () const;
+
+    //! Records that could not be written out are counted as dropped.
+    void addDropped (unsigned long count);
+
+private:
+    std::size_t capacity;
+    std::size_t size;
+    unsigned long dropped;
+    bool closed;
+    std::deque<SpillRecord> records;
+
+    mutable thread::Mutex mtx;
+    thread::ManualResetEvent records_ev;
+    thread::ManualResetEvent closed_ev;
+
+    // Disallow copying of instances of this class.
+    SpillBuffer (SpillBuffer const &);
+    SpillBuffer & operator = (SpillBuffer const &);
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_SPILLBUFFER_HEADER_
@@ -0,0 +1,141 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_SPOOLFILE_HEADER_
+#define LOG4CPLUS_HELPERS_SPOOLFILE_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/tstring.h>
+#include <fstream>
+#include <ios>
+
+
+namespace log4cplus { namespace helpers {
+
+
+class SocketBuffer;
+
+
+//! Size of spool file header.
+std::size_t const SPOOL_HEADER_SIZE = 16;
+
+
+/**
+ * Append-only file of serialized events, in the same size-prefixed
+ * framing as they are sent to the server. The header records the
+ * offset of the first frame that has not been sent yet:
+ *
+ * <pre>
+ *  0  u32 magic "LSP1"
+ *  4  u32 reserved
+ *  8  u64 read offset
+ * </pre>
+ *
+ * Frames are read in order with read(), which fills a whole
+ * SocketBuffer at once. They stay in the file until commit() is
+ * called after they were sent, so they are read again after a
+ * restart. The unread part is bounded, append() evicts the oldest
+ * frames when it grows over the limit. The file is truncated when
+ * all frames were sent, and compacted when the sent part gets
+ * large.
+ *
+ * The class does no locking of its own.
+ */
+class LOG4CPLUS_EXPORT SpoolFile
+{
+public:
+    SpoolFile ();
+    ~SpoolFile ();
+
+    //! Opens existing spool or creates new one. Frames found in
+    //! existing spool are kept. Returns false if the file cannot be
+    //! used.
+    bool open (tstring const & name, std::size_t maxSize);
+    void close ();
+
+    bool isOpen () const
+    {
+        return file.is_open ();
+    }
+
+    //! Returns true if there are no frames left to read.
+    bool empty () const
+    {
+        return nextPos == endPos;
+    }
+
+    //! Returns number of frames left to read.
+    unsigned long getEvents () const
+    {
+        return events;
+    }
+
+    //! Appends <code>count</code> frames. Returns number of events
+    //! that were lost, either evicted to stay within the size limit
+    //! or not written because of an error.
+    unsigned long append (SocketBuffer const & frames, unsigned count);
+
+    //! Fills <code>buffer</code> with as many whole frames as fit.
+    //! Returns number of frames read.
+    unsigned read (SocketBuffer & buffer);
+
+    //! Marks frames returned by read() as sent.
+    void commit ();
+
+private:
+    bool reset ();
+    void writeHeader ();
+    void compact ();
+
+    //! Returns size of frame body at <code>pos</code>, or -1 when
+    //! there is no whole frame.
+    std::streamoff frameSize (std::streamoff pos);
+
+    tstring name;
+    std::fstream file;
+    std::streamoff maxSize;
+
+    //! Offset of first frame that has not been sent.
+    std::streamoff readPos;
+
+    //! Offset of first frame that has not been read.
+    std::streamoff nextPos;
+
+    std::streamoff endPos;
+    unsigned long events;
+
+    // Disallow copying of instances of this class.
+    SpoolFile (SpoolFile const &);
+    SpoolFile & operator = (SpoolFile const &);
+};
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_SPOOLFILE_HEADER_
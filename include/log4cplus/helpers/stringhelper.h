@@ -29,6 +29,7 @@
 #include <algorithm>
 #include <limits>
 #include <iterator>
+#include <ios>
 
 
 namespace log4cplus {
@@ -46,6 +47,16 @@ namespace log4cplus {
         LOG4CPLUS_EXPORT log4cplus::tstring toLower(const log4cplus::tstring& s);
 
 
+        /**
+         * Parses size in bytes with optional <tt>KB</tt>, <tt>MB</tt>
+         * or <tt>GB</tt> suffix, e.g. <tt>10MB</tt> or <tt>10 MB</tt>.
+         * The suffix is case insensitive and whitespace around the
+         * number and the suffix is ignored. The result does not
+         * overflow for sizes above 2 GB.
+         */
+        LOG4CPLUS_EXPORT std::streamoff parseFileSize(const log4cplus::tstring& s);
+
+
         /**
          * Tokenize <code>s</code> using <code>c</code> as the delimiter and
          * put the resulting tokens in <code>_result</code>.  If
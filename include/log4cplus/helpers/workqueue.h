@@ -0,0 +1,127 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/** @file */
+
+#ifndef LOG4CPLUS_HELPERS_WORKQUEUE_HEADER_
+#define LOG4CPLUS_HELPERS_WORKQUEUE_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/helpers/pointer.h>
+#include <log4cplus/thread/syncprims.h>
+#include <log4cplus/thread/threads.h>
+#include <deque>
+#include <vector>
+
+
+namespace log4cplus { namespace helpers {
+
+
+/**
+ * Unit of work executed by {@link WorkQueue}.
+ */
+class LOG4CPLUS_EXPORT WorkItem
+    : public virtual SharedObject
+{
+public:
+    WorkItem ();
+    virtual ~WorkItem ();
+
+    virtual void run () = 0;
+
+private:
+    WorkItem (WorkItem const &);
+    WorkItem & operator = (WorkItem const &);
+};
+
+
+typedef SharedObjectPtr<WorkItem> WorkItemPtr;
+
+
+/**
+ * FIFO queue of {@link WorkItem} instances serviced by a small number
+ * of background threads. The threads are started lazily, on the
+ * first call to post(). With a single thread, items are executed
+ * strictly in the order in which they were posted.
+ *
+ * In single-threaded builds, post() executes the item immediately.
+ */
+class LOG4CPLUS_EXPORT WorkQueue
+    : public virtual SharedObject
+{
+public:
+    explicit WorkQueue (unsigned threads = 1);
+    virtual ~WorkQueue ();
+
+    //! Enqueues item for execution by one of the worker threads.
+    void post (WorkItemPtr const & item);
+
+    //! Blocks until all posted items have been executed.
+    void wait () const;
+
+    //! Executes all outstanding items and stops the worker threads.
+    //! Items posted after close() are executed in the caller's thread.
+    void close ();
+
+    //! Returns number of items posted but not yet finished.
+    std::size_t pending () const;
+
+    //! Sets nice level (0 to 19) that worker threads apply to
+    //! themselves when they start. Only threads started after the
+    //! call are affected. It is a no-op on platforms without per
+    //! thread priorities.
+    void setNiceLevel (int level);
+
+protected:
+    void execute (WorkItemPtr const & item) const;
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    class Worker;
+    friend class Worker;
+
+    void workerLoop ();
+
+    thread::Mutex queue_mutex;
+    thread::ManualResetEvent work_ev;
+    thread::ManualResetEvent idle_ev;
+    std::deque<WorkItemPtr> queue;
+    std::vector<thread::AbstractThreadPtr> workers;
+    std::size_t active;
+#endif
+    unsigned maxThreads;
+    int niceLevel;
+    bool closed;
+
+private:
+    WorkQueue (WorkQueue const &);
+    WorkQueue & operator = (WorkQueue const &);
+};
+
+
+typedef SharedObjectPtr<WorkQueue> WorkQueuePtr;
+
+
+} } // namespace log4cplus { namespace helpers {
+
+
+#endif // LOG4CPLUS_HELPERS_WORKQUEUE_HEADER_
@@ -231,6 +231,24 @@ namespace log4cplus {
          */
         virtual void shutdown();
 
+        /**
+         * Returns all appenders attached to loggers of this hierarchy,
+         * including the root logger. Appenders attached to several
+         * loggers are returned only once.
+         */
+        virtual SharedAppenderPtrList getAllAppenders();
+
+        /**
+         * Makes all appenders in this hierarchy reopen their files.
+         * Use it after the files have been rotated by an external
+         * tool, e.g. logrotate, instead of letting the tool copy and
+         * truncate them.
+         *
+         * @see Appender::reopenFiles()
+         * @see ReopenWatchThread
+         */
+        virtual void reopen();
+
     private:
       // Types
         typedef std::vector<Logger> ProvisionNode;
@@ -42,7 +42,9 @@
 
 #include <log4cplus/config.hxx>
 #include <log4cplus/ndc.h>
+#include <log4cplus/streams.h>
 #include <log4cplus/thread/impl/tls.h>
+#include <sstream>
 
 
 namespace log4cplus {
@@ -62,6 +64,9 @@ struct per_thread_data
     ~per_thread_data ();
 
     DiagnosticContextStack ndc_dcs;
+
+    //! Reused by Layout::formatShared().
+    tostringstream layout_oss;
 };
 
 
@@ -49,17 +49,71 @@ namespace log4cplus {
      */
     class LOG4CPLUS_EXPORT Layout : protected :: log4cplus::helpers::LogLogUser {
     public:
-        Layout() : llmCache(getLogLevelManager()) {}
+        Layout()
+          : llmCache(getLogLevelManager()), attached(false),
+            shareFormatted(false) {}
         Layout(const log4cplus::helpers::Properties&) 
-          : llmCache(getLogLevelManager())  {}
-        virtual ~Layout() {}
+          : llmCache(getLogLevelManager()), attached(false),
+            shareFormatted(false) {}
+        virtual ~Layout();
 
         virtual void formatAndAppend(log4cplus::tostream& output, 
                                      const log4cplus::spi::InternalLoggingEvent& event) = 0;
+
+        /**
+         * Returns the event formatted by formatAndAppend(). While
+         * other attached layouts have the same format key, e.g.
+         * PatternLayouts with equal patterns attached to different
+         * appenders, the text is kept in the event and they reuse it
+         * instead of formatting the event again.
+         */
+        spi::FormattedEventPtr formatShared(
+            const log4cplus::spi::InternalLoggingEvent& event);
+
+        /**
+         * Like formatShared() but the returned text is only valid
+         * until the next call. It does not allocate shared text when
+         * no other layout has the same format key.
+         */
+        const log4cplus::tstring& formatText(
+            const log4cplus::spi::InternalLoggingEvent& event);
+
+        /**
+         * Layouts with equal format keys format every event the same
+         * way. The key is made of the dynamic type of the layout and
+         * of <code>formatKey</code> set by the subclass; it is empty
+         * until the layout is attached, or if <code>formatKey</code>
+         * is empty, which disables sharing of the text.
+         */
+        const log4cplus::tstring& getFormatKey() const { return sharedKey; }
+
+        /**
+         * Called by Appender when it takes over the layout. Derives
+         * the format key and registers it, so that formatShared()
+         * keeps the text in events only while the key is shared.
+         */
+        void attach();
+
     protected:
         LogLevelManager& llmCache;
+
+        //! Configuration that the output depends on, set by
+        //! subclasses. Empty value disables sharing of the text.
+        log4cplus::tstring formatKey;
         
     private:
+        bool attached;
+        log4cplus::tstring sharedKey;
+
+        //! Set while other attached layouts have the same
+        //! <code>sharedKey</code>.
+        bool shareFormatted;
+
+        //! Texts returned by formatText().
+        log4cplus::tstring formattedText;
+        spi::FormattedEventPtr lastFormatted;
+
+
       // Disable copy
         Layout(const Layout&);
         Layout& operator=(Layout&);
@@ -79,13 +133,16 @@ namespace log4cplus {
      */
     class LOG4CPLUS_EXPORT SimpleLayout : public Layout {
     public:
-        SimpleLayout() {}
-        SimpleLayout(const log4cplus::helpers::Properties& properties) : Layout(properties) {}
+        SimpleLayout() { init(); }
+        SimpleLayout(const log4cplus::helpers::Properties& properties)
+          : Layout(properties) { init(); }
 
         virtual void formatAndAppend(log4cplus::tostream& output, 
                                      const log4cplus::spi::InternalLoggingEvent& event);
 
     private: 
+        void init();
+
       // Disallow copying of instances of this class
         SimpleLayout(const SimpleLayout&);
         SimpleLayout& operator=(const SimpleLayout&);
@@ -142,6 +199,9 @@ namespace log4cplus {
     protected:
        log4cplus::tstring dateFormat;
        bool use_gmtime;
+
+    private:
+        void init();
      
     private: 
       // Disallow copying of instances of this class
@@ -196,6 +196,14 @@ namespace log4cplus
          */
         void callAppenders(const spi::InternalLoggingEvent& event) const;
 
+        /**
+         * Like callAppenders() for <code>count</code> events at once.
+         * Each appender in the hierarchy gets all of them with a
+         * single Appender::doAppendBatch() call.
+         */
+        void callAppendersBatch(const spi::InternalLoggingEvent* events,
+                                std::size_t count) const;
+
         /**
          * Starting from this logger, search the logger hierarchy for a
          * "set" LogLevel and return it. Otherwise, return the LogLevel of the
@@ -0,0 +1,97 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_REOPENWATCH_HEADER_
+#define LOG4CPLUS_REOPENWATCH_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/logger.h>
+
+
+namespace log4cplus {
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    class Hierarchy;
+    class ReopenWatchDogThread;
+
+
+    /**
+     * Background thread that calls {@link Hierarchy::reopen()} when
+     * log files should be reopened because they have been rotated
+     * by an external tool. It replaces <tt>copytruncate</tt> mode of
+     * logrotate, which copies whole files and loses lines written
+     * during the copy, with plain renaming.
+     *
+     * The reopen is triggered:
+     * <ul>
+     * <li>by requestReopen(), which may be called from any thread;</li>
+     * <li>by <tt>SIGHUP</tt> with <code>REOPEN_ON_SIGHUP</code>. The
+     * signal handler only writes into a pipe, the files are reopened
+     * in the watch thread. Only one instance in the process can
+     * handle the signal; the previous handler is restored when the
+     * instance is destroyed.</li>
+     * <li>with <code>REOPEN_ON_FILE_CHANGE</code>, when a file
+     * reported by {@link Appender::getFileNames()} no longer exists
+     * or is not the file that has been opened. Renames and removals
+     * are noticed immediately where inotify is available; otherwise
+     * the files are checked every <code>millis</code>
+     * milliseconds.</li>
+     * </ul>
+     *
+     * Only explicit requests are supported on Windows.
+     */
+    class LOG4CPLUS_EXPORT ReopenWatchThread {
+    public:
+        enum ReopenTriggers
+        {
+            REOPEN_ON_SIGHUP = 1,
+            REOPEN_ON_FILE_CHANGE = 2
+        };
+
+      // ctor and dtor
+        ReopenWatchThread(unsigned triggers
+                              = REOPEN_ON_SIGHUP | REOPEN_ON_FILE_CHANGE,
+                          Hierarchy& h = Logger::getDefaultHierarchy(),
+                          unsigned int millis = 1000);
+        virtual ~ReopenWatchThread();
+
+        //! Makes the watch thread reopen the files.
+        void requestReopen();
+
+    private:
+      // Disallow copying of instances of this class
+        ReopenWatchThread(const ReopenWatchThread&);
+        ReopenWatchThread& operator=(const ReopenWatchThread&);
+
+      // Data
+        ReopenWatchDogThread * watchDogThread;
+    };
+#endif
+
+} // end namespace log4cplus
+
+#endif // LOG4CPLUS_REOPENWATCH_HEADER_
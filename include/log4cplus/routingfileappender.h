@@ -0,0 +1,203 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_ROUTING_FILE_APPENDER_HEADER_
+#define LOG4CPLUS_ROUTING_FILE_APPENDER_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/appender.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/thread/syncprims.h>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+
+namespace log4cplus {
+
+    /**
+     * Routes log events to files whose names are derived from the
+     * event. Each routed file is written by its own appender,
+     * created through the appender factory from this appender's
+     * properties, so routed files honour the rolling policies of
+     * the appender type they are written by.
+     *
+     * At most <tt>MaxOpenFiles</tt> routed appenders are kept open.
+     * When a new route would exceed the limit, the least recently
+     * used route that is not being written to is closed. It is
+     * reopened in append mode the next time an event is routed to
+     * it.
+     *
+     * The cache lock is held only to look up, create or evict
+     * routes. Events are written under the routed appender's own
+     * lock, so writes to different routed files do not serialize.
+     *
+     * <h3>Properties</h3>
+     * <dl>
+     * <dt><tt>File</tt></dt>
+     * <dd>Path pattern of the routed files. It recognizes the
+     * following conversions:
+     * <dl>
+     * <dt><tt>%c</tt></dt>
+     * <dd>Logger name. <tt>%c{N}</tt> stands for its first
+     * <tt>N</tt> dot separated components. Note that unlike in
+     * PatternLayout, the components are taken from the left.</dd>
+     * <dt><tt>%x</tt></dt>
+     * <dd>Nested diagnostic context. <tt>%x{N}</tt> stands for
+     * its <tt>N</tt>-th element, counting from 1 for the
+     * outermost one.</dd>
+     * <dt><tt>%p</tt></dt>
+     * <dd>Log level.</dd>
+     * <dt><tt>%%</tt></dt>
+     * <dd>Percent sign.</dd>
+     * </dl>
+     * Characters of the expanded values other than letters, digits,
+     * <tt>-</tt>, <tt>_</tt> and <tt>.</tt> are replaced by
+     * <tt>_</tt>, and so is a leading <tt>.</tt>, so that a value
+     * cannot escape the directory given by the pattern. Empty
+     * values expand to <tt>_</tt>. Directories named by the pattern
+     * must exist.</dd>
+     *
+     * <dt><tt>RouteAppender</tt></dt>
+     * <dd>Factory name of the appender that writes the routed files,
+     * e.g. <tt>log4cplus::RollingFileAppender</tt> or
+     * <tt>log4cplus::DailyRollingFileAppender</tt>. The default is
+     * <tt>log4cplus::FileAppender</tt>.</dd>
+     *
+     * <dt><tt>MaxOpenFiles</tt></dt>
+     * <dd>Maximum number of routed appenders kept open. The default
+     * is 64. The limit is exceeded temporarily when all open routes
+     * are being written to.</dd>
+     * </dl>
+     *
+     * All other properties, including <tt>layout</tt>, are passed to
+     * the routed appenders with <tt>File</tt> set to the routed
+     * file's name and <tt>Append</tt> set true, as each routed file
+     * can be closed and reopened any number of times. Threshold and
+     * filters are applied by this appender only.
+     */
+    class LOG4CPLUS_EXPORT RoutingFileAppender : public Appender {
+    public:
+      // Ctors
+        RoutingFileAppender(const log4cplus::helpers::Properties& properties);
+
+      // Dtor
+        virtual ~RoutingFileAppender();
+
+      // Methods
+        virtual void close();
+
+      //! Reopens files of all open routes.
+        virtual void reopenFiles();
+        virtual void getFileNames(std::vector<log4cplus::tstring>& names);
+
+        //! Returns number of routes open at the moment.
+        std::size_t getOpenRoutes() const;
+
+    protected:
+        struct PathToken {
+            enum Type { LITERAL, LOGGER, NDC, LEVEL };
+
+            Type type;
+            log4cplus::tstring literal;
+
+            //! Number of logger name components or NDC element; 0
+            //! stands for all.
+            unsigned arg;
+        };
+
+        struct Route {
+            SharedAppenderPtr appender;
+            std::list<log4cplus::tstring>::iterator lru;
+
+            //! Number of threads writing to the route.
+            unsigned users;
+        };
+
+        typedef std::map<log4cplus::tstring, Route> RouteMap;
+        typedef std::vector<std::pair<log4cplus::tstring,
+            SharedAppenderPtr> > RouteList;
+
+        //! Called without <code>access_mutex</code> held, see
+        //! Appender::selfSynchronized.
+        virtual void append(const spi::InternalLoggingEvent& event);
+
+        //! Expands the path pattern for the event.
+        log4cplus::tstring expandPath(
+            const spi::InternalLoggingEvent& event) const;
+
+        //! Returns appender of the route, opening it if necessary,
+        //! and marks it as being written to.
+        SharedAppenderPtr acquireRoute(const log4cplus::tstring& path);
+        void releaseRoute(const log4cplus::tstring& path);
+
+        //! Creates appender for the route, opening its file. Called
+        //! without <code>routes_mutex</code> held by the thread that
+        //! has put the path into <code>opening</code>.
+        SharedAppenderPtr createRoute(const log4cplus::tstring& path);
+
+        //! Removes least recently used routes above the limit.
+        //! Called with <code>routes_mutex</code> held.
+        void evictRoutes(RouteList& evicted);
+
+        //! Closes evicted appenders. Must not be called with
+        //! <code>routes_mutex</code> held.
+        void closeRoutes(const RouteList& evicted);
+
+      // Data
+        std::vector<PathToken> pathPattern;
+        log4cplus::helpers::Properties routeProperties;
+        log4cplus::tstring routeAppender;
+        std::size_t maxOpenFiles;
+
+        //! Open routes.
+        RouteMap routes;
+
+        //! Paths of open routes, most recently used first.
+        std::list<log4cplus::tstring> lru;
+
+        //! Paths of evicted routes that are being closed.
+        std::set<log4cplus::tstring> closing;
+
+        //! Paths of routes whose appenders are being created.
+        std::set<log4cplus::tstring> opening;
+
+        mutable thread::Mutex routes_mutex;
+
+    private:
+        void parsePattern(const log4cplus::tstring& pattern);
+
+      // Disallow copying of instances of this class
+        RoutingFileAppender(const RoutingFileAppender&);
+        RoutingFileAppender& operator=(const RoutingFileAppender&);
+    };
+
+} // end namespace log4cplus
+
+#endif // LOG4CPLUS_ROUTING_FILE_APPENDER_HEADER_
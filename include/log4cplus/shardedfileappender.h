@@ -0,0 +1,155 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_SHARDED_FILE_APPENDER_HEADER_
+#define LOG4CPLUS_SHARDED_FILE_APPENDER_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/appender.h>
+#include <vector>
+
+
+namespace log4cplus {
+
+    enum ShardingMode { SHARD_BY_THREAD, SHARD_BY_CPU };
+
+    /**
+     * Appends log events to a set of files, one per logging thread
+     * or one per CPU. Threads do not share any lock on the logging
+     * path: each shard has its own lock, which is contended only by
+     * reopenFiles() in the per-thread mode and also when a thread
+     * migrates between CPUs in the per-CPU mode.
+     *
+     * Each record is written as
+     * <tt>sec.usec sequence length text</tt>, where the time is the
+     * event's timestamp, the sequence number counts records in the
+     * shard and the length is the length in bytes of the formatted
+     * text that follows. In <tt>UNICODE</tt> builds the text is
+     * written in the multi-byte encoding. The <tt>shardmerge</tt> utility merges the shards into
+     * a single time ordered file.
+     *
+     * <h3>Properties</h3>
+     * <dl>
+     * <dt><tt>File</tt></dt>
+     * <dd>Base name of the output files. Shards are named
+     * <tt>File.shardN</tt> in the per-thread mode, in order of first
+     * use, and <tt>File.cpuN</tt> in the per-CPU mode.</dd>
+     *
+     * <dt><tt>ShardBy</tt></dt>
+     * <dd><tt>thread</tt> (the default) or <tt>cpu</tt>. The per-CPU
+     * mode is available only where <code>sched_getcpu()</code> is;
+     * elsewhere it falls back to the per-thread mode. The shard of
+     * a thread that exits is handed to the next new thread, so there
+     * are no more shards than threads logging at once. On Windows
+     * exiting threads are not noticed and each thread gets its own
+     * shard, so the per-CPU mode suits applications that create many
+     * short-lived threads better there.</dd>
+     *
+     * <dt><tt>Append</tt></dt>
+     * <dd>When it is set true, shard files will be appended to
+     * instead of being truncated at opening. Otherwise shard files
+     * left by an earlier run are removed first.</dd>
+     *
+     * <dt><tt>ImmediateFlush</tt></dt>
+     * <dd>When it is set true, shard is flushed after each appended
+     * event. The default is true.</dd>
+     * </dl>
+     */
+    class LOG4CPLUS_EXPORT ShardedFileAppender : public Appender {
+    public:
+      // Ctors
+        ShardedFileAppender(const log4cplus::tstring& filename,
+                            ShardingMode shardBy = SHARD_BY_THREAD,
+                            bool immediateFlush = true,
+                            bool append = false);
+        ShardedFileAppender(const log4cplus::helpers::Properties& properties);
+
+      // Dtor
+        virtual ~ShardedFileAppender();
+
+      // Methods
+        virtual void close();
+
+      //! Reopens all shards.
+        virtual void reopenFiles();
+        virtual void getFileNames(std::vector<log4cplus::tstring>& names);
+
+    protected:
+        struct Shard;
+        struct ThreadKey;
+
+        //! Called without <code>access_mutex</code> held, see
+        //! Appender::selfSynchronized.
+        virtual void append(const spi::InternalLoggingEvent& event);
+
+        //! Returns shard of the calling thread or CPU.
+        Shard * getShard();
+
+        //! Creates and opens new shard. Called with
+        //! <code>access_mutex</code> held.
+        Shard * createShard(const log4cplus::tstring& suffix);
+
+        //! Hands shard of a thread that has exited over to the next
+        //! new thread.
+        void releaseShard(Shard * shard);
+
+        void writeRecord(Shard& shard, const spi::InternalLoggingEvent& event);
+
+      // Data
+        log4cplus::tstring filename;
+        ShardingMode shardBy;
+        bool immediateFlush;
+        bool appendMode;
+
+        //! All shards, for closing.
+        std::vector<Shard *> shards;
+
+        //! Shards of threads that have exited, for reuse.
+        std::vector<Shard *> idleShards;
+
+        //! Number of per-thread shards created so far, used for
+        //! their names.
+        unsigned long shardCount;
+
+        //! Thread local storage key of the calling thread's shard.
+        ThreadKey * threadKey;
+
+    private:
+        void init();
+        void removeOldShards();
+
+        //! Thread local storage cleanup function.
+        static void threadExit(void * shard);
+
+      // Disallow copying of instances of this class
+        ShardedFileAppender(const ShardedFileAppender&);
+        ShardedFileAppender& operator=(const ShardedFileAppender&);
+    };
+
+} // end namespace log4cplus
+
+#endif // LOG4CPLUS_SHARDED_FILE_APPENDER_HEADER_
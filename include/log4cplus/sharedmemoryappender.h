@@ -0,0 +1,118 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file */
+
+#ifndef LOG4CPLUS_SHARED_MEMORY_APPENDER_HEADER_
+#define LOG4CPLUS_SHARED_MEMORY_APPENDER_HEADER_
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/appender.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/sharedring.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <memory>
+#include <vector>
+
+
+namespace log4cplus {
+
+    /**
+     * Writes events into a POSIX shared memory ring for a reader
+     * process on the same host, such as <tt>loggingserver</tt> started
+     * with <tt>shm:</tt><i>name</i> address. The event is serialized
+     * and copied into space reserved with a compare-and-swap, see
+     * helpers::SharedRing, so many processes can write into one ring
+     * without waiting for each other or for the reader. Threads of
+     * one process are serialized by the appender's lock, like with
+     * other appenders, as they share the encoding buffers. When the
+     * ring is full the event is dropped, see getDroppedEvents().
+     *
+     * Each record in the ring holds one event in the same
+     * size-prefixed frames as SocketAppender sends over TCP. Version 3
+     * frames are encoded without the dictionary, so each record can
+     * be decoded on its own. The writers and the reader have to be
+     * built for the same word size.
+     *
+     * <h3>Properties</h3>
+     * <dl>
+     * <dt><tt>Name</tt></dt>
+     * <dd>Name of the shared memory object, it starts with a slash.
+     * The default is <tt>/log4cplus</tt>.</dd>
+     *
+     * <dt><tt>Size</tt></dt>
+     * <dd>Size of the ring when this appender creates it, rounded up
+     * to a power of two. <tt>KB</tt> and <tt>MB</tt> suffixes can be
+     * used. The default is 4 MB.</dd>
+     *
+     * <dt><tt>ServerName</tt></dt>
+     * <dd>Host name of event's origin prepended to each event.</dd>
+     *
+     * <dt><tt>ProtocolVersion</tt></dt>
+     * <dd>2 or 3, see SocketAppender. The default is 2.</dd>
+     * </dl>
+     */
+    class LOG4CPLUS_EXPORT SharedMemoryAppender : public Appender {
+    public:
+      // Ctors
+        SharedMemoryAppender(const log4cplus::tstring& ringName,
+                             const log4cplus::tstring& serverName = tstring());
+        SharedMemoryAppender(const log4cplus::helpers::Properties & properties);
+
+      // Dtor
+        ~SharedMemoryAppender();
+
+      // Methods
+        virtual void close();
+
+        //! Returns number of events this appender could not write.
+        unsigned long getDroppedEvents() const;
+
+    protected:
+        virtual void append(const spi::InternalLoggingEvent& event);
+
+      // Data
+        std::auto_ptr<helpers::SharedRing> ring;
+        log4cplus::tstring serverName;
+        unsigned protocolVersion;
+
+        //! Serialized form of the event being appended.
+        helpers::SocketBuffer eventBuffer;
+        helpers::SocketBuffer recordBuffer;
+        helpers::MessageEncoder encoder;
+        std::vector<char> eventFrames;
+
+        unsigned long droppedEvents;
+
+    private:
+        void init(const log4cplus::tstring& ringName, std::size_t size);
+
+      // Disallow copying of instances of this class
+        SharedMemoryAppender(const SharedMemoryAppender&);
+        SharedMemoryAppender& operator=(const SharedMemoryAppender&);
+    };
+
+} // end namespace log4cplus
+
+#endif // LOG4CPLUS_SHARED_MEMORY_APPENDER_HEADER_
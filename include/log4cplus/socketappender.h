@@ -25,7 +25,12 @@
 
 #include <log4cplus/config.hxx>
 #include <log4cplus/appender.h>
+#include <log4cplus/helpers/compress.h>
+#include <log4cplus/helpers/messagecodec.h>
 #include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/spoolfile.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/timehelper.h>
 #include <log4cplus/thread/syncprims.h>
 
 
@@ -35,6 +40,13 @@
 #  define LOG4CPLUS_MAX_MESSAGE_SIZE (2*8*1024)
 #endif
 
+//! Default size of buffer in which batches of events are sent.
+#define LOG4CPLUS_SOCKET_BATCH_SIZE (64*1024)
+
+//! Time in milliseconds to wait for the server's handshake when
+//! there is no <tt>ConnectTimeout</tt>.
+#define LOG4CPLUS_SOCKET_HANDSHAKE_TIMEOUT (5*1000)
+
 
 namespace log4cplus {
 
@@ -74,6 +86,47 @@ namespace log4cplus {
      *   <li>On the other hand, if the network link is up, but the server
      *   is down, the client will not be blocked when making log requests
      *   but the log events will be lost due to server unavailability.
+     *   See getDroppedEvents().
+     *
+     *   <li>With <tt>NonBlocking</tt> set, events are only queued by the
+     *   logging threads. A sender thread connects to the server and
+     *   writes the queued events. Events are kept in the queue while the
+     *   server is unreachable and sent once the connection is made
+     *   again. Events the server may have received only partly before
+     *   the connection broke are sent again.
+     *
+     *   <li>With <tt>SpoolFile</tt> set as well, the queue is moved to
+     *   the spool file when it overflows and while the server is
+     *   unreachable. The sender sends the spooled events first, in
+     *   order, once it connects. Events left in the spool when the
+     *   appender is closed are sent by the next appender using the
+     *   same file.
+     *
+     *   <li>Protocol version 3, see helpers::MessageEncoder, sends
+     *   integers as varints and repeated strings, like logger and
+     *   thread names, only once per connection. Messages of any size
+     *   are sent, split into several frames. loggingserver tells the
+     *   versions apart by the first byte of each frame, so clients of
+     *   both versions can use the same server. Older servers only
+     *   understand version 2.
+     *
+     *   <li>With <tt>Compression</tt> set, the appender asks the server
+     *   for a compressed stream right after connecting, see
+     *   helpers::appendHandshake(). When the server agrees, everything
+     *   sent over the connection is deflated, with a sync flush after
+     *   each batch, so the server can process each batch as it
+     *   arrives. A server that does not reply within
+     *   <tt>ConnectTimeout</tt>, or 5 seconds, is taken as one that
+     *   does not know the handshake; the appender then connects again
+     *   and sends uncompressed data for as long as it lives. Such a
+     *   server sees the handshake as one damaged event.
+     *
+     *   <li>With <tt>LocalSocket</tt> set, the appender connects to a
+     *   collector on the same host over a Unix domain socket instead
+     *   of TCP. loggingserver identifies such clients by process and
+     *   user id, see helpers::getLocalPeerName(), so
+     *   <tt>ServerName</tt> can be left out. The identity is always
+     *   put before <tt>ServerName</tt>, which cannot be trusted.
      * </ul>
      *
      * <h3>Properties</h3>
@@ -87,6 +140,98 @@ namespace log4cplus {
      * <dt><tt>ServerName</tt></dt>
      * <dd>Host name of event's origin prepended to each event.</dd>
      *
+     * <dt><tt>LocalSocket</tt></dt>
+     * <dd>Path of Unix domain socket to connect to. When it is set,
+     * <tt>host</tt> and <tt>port</tt> are not used. Not available on
+     * Windows.</dd>
+     *
+     * <dt><tt>LocalSocketType</tt></dt>
+     * <dd><tt>stream</tt> or <tt>seqpacket</tt>. Writes to a seqpacket
+     * socket are split into records of at most 64 KB. The default is
+     * <tt>stream</tt>.</dd>
+     *
+     * <dt><tt>LazyOpen</tt></dt>
+     * <dd>When it is set true, the constructor does not connect to
+     * the server. The connection is made by Appender::activate(),
+     * which is scheduled by PropertyConfigurator or by the first
+     * event, and events are buffered until then.</dd>
+     *
+     * <dt><tt>LazyOpenBufferSize</tt></dt>
+     * <dd>Maximum number of events buffered before the connection is
+     * made. Further events are dropped. The default is 1000.</dd>
+     *
+     * <dt><tt>BatchLatency</tt></dt>
+     * <dd>Non-zero value makes the appender collect events into a
+     * batch that is sent with a single write, at most this many
+     * milliseconds after its first event was appended. The events
+     * are sent in the usual framing, so any logging server can read
+     * them. The default is 0, each event is sent immediately.</dd>
+     *
+     * <dt><tt>BatchSize</tt></dt>
+     * <dd>Size of the batch buffer. A batch is sent when the next
+     * event does not fit. <tt>KB</tt> and <tt>MB</tt> suffixes can be
+     * used. The default is 64 KB.</dd>
+     *
+     * <dt><tt>BatchCount</tt></dt>
+     * <dd>Maximum number of events in a batch. The default is 0, no
+     * limit.</dd>
+     *
+     * <dt><tt>NonBlocking</tt></dt>
+     * <dd>When it is set true, the logging threads never write to the
+     * socket, see above. The sender thread sends all queued events at
+     * once, so the batch properties do not apply. Not available in
+     * single-threaded builds.</dd>
+     *
+     * <dt><tt>QueueSize</tt></dt>
+     * <dd>Number of bytes of serialized events that the
+     * <tt>NonBlocking</tt> queue holds in addition to the events being
+     * sent. Events that do not fit are dropped. <tt>KB</tt> and
+     * <tt>MB</tt> suffixes can be used. The default is 1 MB.</dd>
+     *
+     * <dt><tt>ConnectTimeout</tt></dt>
+     * <dd>Time in milliseconds a connection attempt may take. The
+     * default is 0, the system's timeout.</dd>
+     *
+     * <dt><tt>SendTimeout</tt></dt>
+     * <dd>Time in milliseconds after which a write to a server that
+     * does not read fails and the connection is made again. The
+     * default is 10000 with <tt>NonBlocking</tt> and 0, no timeout,
+     * otherwise.</dd>
+     *
+     * <dt><tt>ReconnectDelay</tt></dt>
+     * <dd>Time in milliseconds to wait after a failed connection
+     * attempt. The delay doubles with each further failure up to
+     * <tt>MaxReconnectDelay</tt>. The defaults are 1000 and 30000.</dd>
+     *
+     * <dt><tt>ProtocolVersion</tt></dt>
+     * <dd>2 or 3, see above. The default is 2.</dd>
+     *
+     * <dt><tt>SpoolFile</tt></dt>
+     * <dd>Name of the spool file, see above. Requires
+     * <tt>NonBlocking</tt>.</dd>
+     *
+     * <dt><tt>SpoolSize</tt></dt>
+     * <dd>Maximum number of bytes of unsent events in the spool file.
+     * The oldest events are dropped to make room for new ones.
+     * <tt>KB</tt> and <tt>MB</tt> suffixes can be used. The default is
+     * 64 MB.</dd>
+     *
+     * <dt><tt>Compression</tt></dt>
+     * <dd>When it is set true, the connection is compressed if the
+     * server supports it, see above. Requires zlib support.</dd>
+     *
+     * <dt><tt>CompressionLevel</tt></dt>
+     * <dd>zlib compression level, 1 to 9. The default is zlib's
+     * default, 6.</dd>
+     *
+     * <dt><tt>CompressionFlushInterval</tt></dt>
+     * <dd>Minimum time in milliseconds between two writes, and so
+     * between two sync flushes, of a compressed connection. Larger
+     * writes compress better. Without <tt>NonBlocking</tt> this is
+     * the default of <tt>BatchLatency</tt>. With <tt>NonBlocking</tt>
+     * the sender thread lets the queue fill for this long after each
+     * write. The default is 0.</dd>
+     *
      * </dl>
      */
     class LOG4CPLUS_EXPORT SocketAppender : public Appender {
@@ -102,17 +247,174 @@ namespace log4cplus {
       // Methods
         virtual void close();
 
+        //! Returns number of events dropped because the server was not
+        //! connected or the <tt>NonBlocking</tt> queue was full.
+        unsigned long getDroppedEvents() const;
+
     protected:
         void openSocket();
         void initConnector ();
         virtual void append(const spi::InternalLoggingEvent& event);
 
+        //! Sends as many events as fit into
+        //! <code>LOG4CPLUS_SOCKET_BATCH_SIZE</code> bytes at once.
+        virtual void appendBatch(const spi::InternalLoggingEvent* events,
+                                 std::size_t n);
+
+        virtual void activateResources();
+
+        //! Writes buffer to the socket, triggering reconnection when
+        //! the write fails. Returns false if the write failed.
+        bool sendBuffer(const helpers::SocketBuffer& buffer);
+
+        //! Writes buffer to the socket, compressing it if the
+        //! connection is compressed.
+        bool writeSocket(const helpers::SocketBuffer& buffer);
+
+        //! Serializes the event into <code>batchBuffer</code>, sending
+        //! the batch first when the event does not fit and afterwards
+        //! when it is complete. Called with <code>access_mutex</code>
+        //! held.
+        void bufferEvent(const spi::InternalLoggingEvent& event);
+
+        //! Sends events collected in <code>batchBuffer</code>. Called
+        //! with <code>access_mutex</code> held.
+        void flushBatch();
+
+        //! Adds the event to <code>pendingQueue</code> or drops it
+        //! when the queue is full. Called with <code>access_mutex</code>
+        //! held.
+        void queueEvent(const spi::InternalLoggingEvent& event);
+
+        //! Hands <code>pendingQueue</code> over to writeSpooled().
+        //! Returns false if there is no spool, nothing to move or the
+        //! previous queue is still being written. Called with
+        //! <code>access_mutex</code> held.
+        bool spoolQueue();
+
+        //! Writes the events handed over by spoolQueue() to the spool
+        //! file. Called without <code>access_mutex</code> held.
+        void writeSpooled();
+
+        //! Moves <code>pendingQueue</code> to the spool file. Called
+        //! without <code>access_mutex</code> held.
+        void spoolPending();
+
+        //! Encodes <code>sendingQueue</code> for the current connection
+        //! into <code>wireQueue</code>. Used by the sender thread with
+        //! protocol version 3.
+        helpers::SocketBuffer const & encodeQueue();
+
+        //! Connects to the server, applying the timeouts, and makes
+        //! the handshake. <code>compressed</code> tells whether the
+        //! server agreed to compression.
+        helpers::Socket connect(bool & compressed);
+
+        //! Asks the server for compression. Returns true if the server
+        //! agreed. The socket is replaced by a new connection if the
+        //! server did not reply.
+        bool handshake(helpers::Socket & newSocket);
+
+        //! Connects to the TCP or local address, applying the send
+        //! timeout.
+        helpers::Socket openConnection();
+
+        //! Makes <code>newSocket</code> the connection and starts its
+        //! protocol state. Called with <code>access_mutex</code> held.
+        void useSocket(const helpers::Socket & newSocket, bool compressed);
+
       // Data
         log4cplus::helpers::Socket socket;
         log4cplus::tstring host;
         int port;
         log4cplus::tstring serverName;
 
+        //! See <tt>LocalSocket</tt> and <tt>LocalSocketType</tt>
+        //! properties.
+        log4cplus::tstring localSocket;
+        helpers::LocalSocketType localSocketType;
+
+        //! Serialized form of the event being appended.
+        helpers::SocketBuffer eventBuffer;
+
+        //! See <tt>ProtocolVersion</tt> property.
+        unsigned protocolVersion;
+
+        //! Encodes events for the current connection. It is reset
+        //! whenever a new connection is made.
+        helpers::MessageEncoder encoder;
+
+        //! Version 3 frames of the event being appended.
+        std::vector<char> eventFrames;
+
+        //! The <tt>NonBlocking</tt> queue and spool hold version 3
+        //! frames that do not depend on each other. The sender thread
+        //! encodes them again for the connection.
+        helpers::MessageEncoder queueEncoder;
+        helpers::MessageDecoder queueDecoder;
+        helpers::SocketBuffer * wireQueue;
+        std::vector<char> wireFrames;
+        std::vector<spi::InternalLoggingEvent> wireEvents;
+
+        //! Frames of events waiting to be sent.
+        helpers::SocketBuffer * batchBuffer;
+        unsigned batchCount;
+        unsigned batchedEvents;
+        helpers::Time batchLatency;
+
+        //! Time when the first event of the batch was appended.
+        helpers::Time batchStart;
+
+        unsigned long connectTimeout;
+        unsigned long sendTimeout;
+        unsigned long reconnectDelay;
+        unsigned long maxReconnectDelay;
+        unsigned long droppedEvents;
+
+        //! See <tt>NonBlocking</tt> property.
+        bool nonBlocking;
+
+        //! Set while the <tt>NonBlocking</tt> queue overflows.
+        bool queueFull;
+
+        //! Events queued by the logging threads. Guarded by
+        //! <code>access_mutex</code>.
+        helpers::SocketBuffer * pendingQueue;
+        unsigned pendingEvents;
+
+        //! Events being sent by the sender thread. They are kept until
+        //! they are written successfully.
+        helpers::SocketBuffer * sendingQueue;
+        unsigned sendingEvents;
+
+        //! See <tt>SpoolFile</tt> property. Guarded by
+        //! <code>spool_mutex</code>, so that the disk does not hold
+        //! up the logging threads. It is taken before
+        //! <code>access_mutex</code>, never while holding it.
+        helpers::SpoolFile * spool;
+        thread::Mutex spool_mutex;
+
+        //! Set when <code>sendingQueue</code> was read from the spool.
+        bool sendingSpooled;
+
+        //! Events handed over by spoolQueue(). Guarded by
+        //! <code>access_mutex</code> while <code>spoolingEvents</code>
+        //! is zero, otherwise owned by writeSpooled().
+        helpers::SocketBuffer * spoolingQueue;
+        unsigned spoolingEvents;
+
+        //! See <tt>Compression</tt> property. It is cleared when the
+        //! server does not know the handshake.
+        bool compression;
+
+        //! See <tt>CompressionFlushInterval</tt> property.
+        helpers::Time compressionFlushInterval;
+
+        //! Set while the connection is compressed.
+        bool compressing;
+        helpers::StreamCompressor * compressor;
+        helpers::SocketBuffer * compressedBuffer;
+
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
         class LOG4CPLUS_EXPORT ConnectorThread;
         friend class ConnectorThread;
@@ -129,6 +431,57 @@ namespace log4cplus {
             void terminate ();
             void trigger ();
 
+        protected:
+            SocketAppender & sa;
+            thread::ManualResetEvent trigger_ev;
+            thread::ManualResetEvent exit_ev;
+            bool exit_flag;
+        };
+
+        class LOG4CPLUS_EXPORT SenderThread;
+        friend class SenderThread;
+
+        //! Connects and sends queued events in <tt>NonBlocking</tt>
+        //! mode.
+        class LOG4CPLUS_EXPORT SenderThread
+            : public thread::AbstractThread
+        {
+        public:
+            SenderThread (SocketAppender &);
+            virtual ~SenderThread ();
+
+            virtual void start();
+            virtual void run();
+
+            //! Sends the queued events if connected and stops the
+            //! thread.
+            void terminate ();
+            void trigger ();
+
+        protected:
+            SocketAppender & sa;
+            thread::ManualResetEvent trigger_ev;
+            thread::ManualResetEvent exit_ev;
+            bool started;
+            bool exit_flag;
+        };
+
+        class LOG4CPLUS_EXPORT BatchFlusher;
+        friend class BatchFlusher;
+
+        //! Sends batches that are <tt>BatchLatency</tt> old.
+        class LOG4CPLUS_EXPORT BatchFlusher
+            : public thread::AbstractThread
+        {
+        public:
+            BatchFlusher (SocketAppender &);
+            virtual ~BatchFlusher ();
+
+            virtual void run();
+
+            void terminate ();
+            void trigger ();
+
         protected:
             SocketAppender & sa;
             thread::ManualResetEvent trigger_ev;
@@ -137,9 +490,13 @@ namespace log4cplus {
 
         volatile bool connected;
         helpers::SharedObjectPtr<ConnectorThread> connector;
+        helpers::SharedObjectPtr<BatchFlusher> flusher;
+        helpers::SharedObjectPtr<SenderThread> sender;
 #endif
 
     private:
+        void initBatch (std::size_t size);
+
       // Disallow copying of instances of this class
         SocketAppender(const SocketAppender&);
         SocketAppender& operator=(const SocketAppender&);
@@ -152,6 +509,12 @@ namespace log4cplus {
 
         LOG4CPLUS_EXPORT
         log4cplus::spi::InternalLoggingEvent readFromBuffer(SocketBuffer& buffer);
+
+        //! Same as above for events from a peer of known identity,
+        //! see tagServerName().
+        LOG4CPLUS_EXPORT
+        log4cplus::spi::InternalLoggingEvent readFromBuffer(SocketBuffer& buffer,
+            const tstring& peerName);
     } // end namespace helpers
 
 } // end namespace log4cplus
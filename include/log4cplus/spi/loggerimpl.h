@@ -67,6 +67,13 @@ namespace log4cplus {
              */
             virtual void callAppenders(const InternalLoggingEvent& event);
 
+            /**
+             * Like callAppenders() for <code>n</code> events at
+             * once, see Appender::doAppendBatch().
+             */
+            virtual void callAppendersBatch(const InternalLoggingEvent* events,
+                                            std::size_t n);
+
             /**
              * Close all attached appenders implementing the AppenderAttachable
              * interface.  
@@ -27,12 +27,42 @@
 #include <log4cplus/loglevel.h>
 #include <log4cplus/ndc.h>
 #include <log4cplus/tstring.h>
+#include <log4cplus/helpers/pointer.h>
 #include <log4cplus/helpers/timehelper.h>
 #include <log4cplus/thread/threads.h>
 #include <memory>
 
 namespace log4cplus {
     namespace spi {
+        /**
+         * Text of an event formatted by a layout, see
+         * Layout::formatShared(). Instances are immutable; they are
+         * shared by the event, its copies and the appenders.
+         */
+        class LOG4CPLUS_EXPORT FormattedEvent
+            : public virtual log4cplus::helpers::SharedObject
+        {
+        public:
+            FormattedEvent(const log4cplus::tstring& key,
+                           const log4cplus::tstring& text,
+                           const helpers::SharedObjectPtr<FormattedEvent>& next);
+            virtual ~FormattedEvent();
+
+            //! Format key of the layout that produced the text.
+            const log4cplus::tstring key;
+            const log4cplus::tstring text;
+
+            //! Text of the same event formatted by another layout.
+            const helpers::SharedObjectPtr<FormattedEvent> next;
+
+        private:
+            FormattedEvent(const FormattedEvent&);
+            FormattedEvent& operator=(const FormattedEvent&);
+        };
+
+        typedef helpers::SharedObjectPtr<FormattedEvent> FormattedEventPtr;
+
+
         /**
          * The internal representation of logging events. When an affirmative
          * decision is made to log then a <code>InternalLoggingEvent</code> 
@@ -71,7 +101,8 @@ namespace log4cplus {
                 file( (  filename
                        ? LOG4CPLUS_C_STR_TO_TSTRING(filename) 
                        : log4cplus::tstring()) ),
-                line(line_)
+                line(line_),
+                formatted()
              {
              }
 
@@ -92,7 +123,8 @@ namespace log4cplus {
                 ll(ll_),
                 timestamp(time),
                 file(file_),
-                line(line_)
+                line(line_),
+                formatted()
              {
              }
 
@@ -106,7 +138,8 @@ namespace log4cplus {
                 ll(rhs.getLogLevel()),
                 timestamp(rhs.getTimestamp()),
                 file(rhs.getFile()),
-                line(rhs.getLine())
+                line(rhs.getLine()),
+                formatted(rhs.formatted)
              {
              }
 
@@ -166,6 +199,16 @@ namespace log4cplus {
 
             /** The is the line where this log statement was written */
             int getLine() const { return line; }
+
+            /** Returns text of this event formatted by a layout with
+             *  format key <code>key</code>, or null if it has not been
+             *  formatted by such layout yet. */
+            FormattedEventPtr getFormatted(const log4cplus::tstring& key) const;
+
+            /** Keeps text of this event formatted by a layout with
+             *  format key <code>key</code> for getFormatted(). */
+            FormattedEventPtr addFormatted(const log4cplus::tstring& key,
+                                           const log4cplus::tstring& text) const;
  
           // public operators
             log4cplus::spi::InternalLoggingEvent&
@@ -190,6 +233,8 @@ namespace log4cplus {
             log4cplus::helpers::Time timestamp;
             log4cplus::tstring file;
             int line;
+            /** Texts of the event formatted by layouts. */
+            mutable FormattedEventPtr formatted;
         };
 
     } // end namespace spi
@@ -0,0 +1,236 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+// Reads log file with help of its block index written by
+// FileAppender with IndexBlockSize property.
+//
+// Usage: indexreader [-l] [-c] [-e] [-f from] [-t to] file
+//
+//   -l       list blocks (offset, length, time range and counts of
+//            TRACE, DEBUG, INFO, WARN, ERROR and FATAL events)
+//            instead of printing their contents
+//   -c       verify CRC of all blocks, not only of printed ones
+//   -e       select only blocks containing ERROR or FATAL events
+//   -f from  skip blocks whose last event is older than from
+//   -t to    skip blocks whose first event is newer than to
+//
+// Times are given in seconds since the Epoch. The index is read from
+// file.idx; skipped blocks are seeked over. Damaged index entries,
+// blocks that do not match their CRC and data not covered by the
+// index, e.g. data written by a process that has crashed, are
+// reported on standard error. Data not covered by the index can only
+// be printed when no selection is made.
+
+#include <log4cplus/config.hxx>
+#include <log4cplus/helpers/blockindex.h>
+#include <log4cplus/loglevel.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+
+static
+int
+usage ()
+{
+    cerr << "Usage: indexreader [-l] [-c] [-e] [-f from] [-t to] file"
+         << endl;
+    return 1;
+}
+
+
+static
+bool
+read_block (std::vector<char> & buf, std::FILE * file,
+    BlockIndexEntry const & entry)
+{
+    buf.resize (entry.length);
+    return std::fseek (file, static_cast<long>(entry.offset), SEEK_SET) == 0
+        && (entry.length == 0
+            || std::fread (&buf[0], 1, buf.size (), file) == buf.size ());
+}
+
+
+static
+void
+unindexed (std::vector<char> & buf, std::FILE * file, std::streamoff begin,
+    std::streamoff end, bool print)
+{
+    cerr << "Unindexed data at offset " << begin << ", "
+         << end - begin << " bytes" << endl;
+
+    BlockIndexEntry gap;
+    gap.offset = begin;
+    gap.length = static_cast<unsigned long>(end - begin);
+    if (print && read_block (buf, file, gap) && ! buf.empty ())
+        cout.write (&buf[0], static_cast<std::streamsize>(buf.size ()));
+}
+
+
+int
+main (int argc, char ** argv)
+{
+    bool list = false;
+    bool check = false;
+    bool errors = false;
+    Time from (0, 0);
+    Time to (static_cast<time_t>(0x7fffffff), 0);
+    bool time_range = false;
+    char const * file_name = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp (argv[i], "-l") == 0)
+            list = true;
+        else if (std::strcmp (argv[i], "-c") == 0)
+            check = true;
+        else if (std::strcmp (argv[i], "-e") == 0)
+            errors = true;
+        else if (std::strcmp (argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            from = Time (static_cast<time_t>(std::atol (argv[++i])), 0);
+            time_range = true;
+        }
+        else if (std::strcmp (argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            to = Time (static_cast<time_t>(std::atol (argv[++i])), 999999);
+            time_range = true;
+        }
+        else if (argv[i][0] != '-' && ! file_name)
+            file_name = argv[i];
+        else
+            return usage ();
+    }
+
+    if (! file_name)
+        return usage ();
+
+    std::FILE * file = std::fopen (file_name, "rb");
+    std::string const index_name (std::string (file_name)
+        + LOG4CPLUS_TSTRING_TO_STRING (tstring (BLOCK_INDEX_SUFFIX)));
+    std::FILE * index = std::fopen (index_name.c_str (), "rb");
+    if (! file || ! index)
+    {
+        cerr << "Could not open " << (file ? index_name.c_str () : file_name)
+             << endl;
+        if (file)
+            std::fclose (file);
+        if (index)
+            std::fclose (index);
+        return 1;
+    }
+
+    bool const print_unindexed = ! list && ! errors && ! time_range;
+    std::size_t const error_slot = blockIndexLevelSlot (ERROR_LOG_LEVEL);
+    std::vector<char> buf;
+    unsigned char raw[BLOCK_INDEX_ENTRY_SIZE];
+    std::streamoff indexed_end = 0;
+    long entry_no = 0;
+    int ret = 0;
+
+    while (true)
+    {
+        std::size_t const n = std::fread (raw, 1, sizeof (raw), index);
+        if (n == 0)
+            break;
+
+        BlockIndexEntry entry;
+        if (n != sizeof (raw) || ! decodeBlockIndexEntry (entry, raw))
+        {
+            cerr << "Damaged index entry " << entry_no << endl;
+            ret = 1;
+            break;
+        }
+
+        if (entry.offset > indexed_end)
+            unindexed (buf, file, indexed_end, entry.offset,
+                print_unindexed);
+        else if (entry.offset < indexed_end)
+            cerr << "Index entry " << entry_no << " overlaps"
+                " the previous block" << endl;
+        indexed_end = entry.offset + entry.length;
+        ++entry_no;
+
+        bool wanted = ! (entry.last < from) && ! (to < entry.first);
+        if (errors)
+        {
+            unsigned long count = 0;
+            for (std::size_t i = error_slot; i != BLOCK_INDEX_LEVELS; ++i)
+                count += entry.levels[i];
+            wanted = wanted && count != 0;
+        }
+
+        if (list && wanted)
+        {
+            cout << entry.offset << '\t' << entry.length
+                 << '\t' << entry.first.sec () << '.' << entry.first.usec ()
+                 << '\t' << entry.last.sec () << '.' << entry.last.usec ();
+            for (std::size_t i = 0; i != BLOCK_INDEX_LEVELS; ++i)
+                cout << '\t' << entry.levels[i];
+            cout << endl;
+        }
+
+        if (! check && (list || ! wanted))
+            continue;
+
+        if (! read_block (buf, file, entry))
+        {
+            cerr << "Truncated block at offset " << entry.offset << endl;
+            ret = 1;
+            break;
+        }
+
+        if (computeCrc32 (0, buf.empty () ? 0 : &buf[0], buf.size ())
+            != entry.crc)
+        {
+            cerr << "CRC mismatch in block at offset " << entry.offset
+                 << endl;
+            ret = 1;
+        }
+
+        if (! list && wanted && ! buf.empty ())
+            cout.write (&buf[0], static_cast<std::streamsize>(buf.size ()));
+    }
+
+    if (std::fseek (file, 0, SEEK_END) == 0)
+    {
+        std::streamoff const size = std::ftell (file);
+        if (size > indexed_end)
+            unindexed (buf, file, indexed_end, size, print_unindexed);
+    }
+
+    std::fclose (index);
+    std::fclose (file);
+    return ret;
+}
@@ -19,17 +19,38 @@
 // limitations under the License.
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <log4cplus/config.hxx>
 #include <log4cplus/configurator.h>
 #include <log4cplus/consoleappender.h>
 #include <log4cplus/socketappender.h>
+#include <log4cplus/helpers/compress.h>
 #include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/sharedring.h>
+#include <log4cplus/helpers/sleep.h>
 #include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/helpers/workqueue.h>
 #include <log4cplus/thread/threads.h>
 #include <log4cplus/spi/loggerimpl.h>
 #include <log4cplus/spi/loggingevent.h>
 
+#if defined (__linux__)
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <map>
+#define LOGGINGSERVER_USE_EPOLL
+#endif
+
 
 using namespace std;
 using namespace log4cplus;
@@ -38,6 +59,239 @@ using namespace log4cplus::thread;
 
 
 namespace loggingserver {
+
+    //! Decodes the size-prefixed frames of a datagram or of a shared
+    //! memory record, each of which can be decoded on its own.
+    //! Returns false when the data are damaged.
+    bool decodeFrames(MessageDecoder & decoder, char const * data,
+        std::size_t size, std::vector<spi::InternalLoggingEvent> & events);
+
+    //! Warns about events lost by the writers of the ring since the
+    //! counts were last seen.
+    void reportRingLosses(SharedRing const & ring, unsigned long & dropped,
+        unsigned long & abandoned);
+
+#if defined (LOGGINGSERVER_USE_EPOLL)
+    //! Initial size of per connection read buffer. It grows to fit
+    //! the largest message received.
+    std::size_t const READ_BUFFER_SIZE = 16 * 1024;
+
+    //! Messages larger than this are considered garbage and the
+    //! connection is closed.
+    unsigned int const MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+    //! Number of reads done for one connection before the other
+    //! ready connections get their turn.
+    int const READS_PER_WAKEUP = 4;
+
+    int const MAX_EPOLL_EVENTS = 256;
+
+    //! Number of loggers remembered per connection.
+    std::size_t const LOGGER_CACHE_SIZE = 1024;
+
+    //! Number of batches a dispatcher may have queued before its
+    //! connections stop being read. They are read again once it is
+    //! down to half of that.
+    std::size_t const MAX_PENDING_BATCHES = 256;
+
+    //! Milliseconds between checks of the dispatchers of connections
+    //! that are not read.
+    int const RESUME_CHECK_INTERVAL = 1;
+
+    //! Number of datagrams received with one recvmmsg() call.
+    int const DATAGRAMS_PER_READ = 64;
+
+    //! Largest UDP payload over IPv4.
+    std::size_t const MAX_DATAGRAM_SIZE = 65507;
+
+    //! Receive buffer requested for the UDP socket, so that bursts
+    //! are not lost while the events are decoded.
+    int const DATAGRAM_RCVBUF_SIZE = 4 * 1024 * 1024;
+
+    //! Number of shared memory records decoded into one batch.
+    int const RECORDS_PER_BATCH = 256;
+
+
+    //! Opens non-blocking listening socket. Returns -1 on failure.
+    int openListenSocket(unsigned short port, bool reusePort);
+
+    //! Returns true if the port can be bound without
+    //! <code>SO_REUSEPORT</code>, i.e. no other server listens on it.
+    bool isPortFree(unsigned short port);
+
+
+    /**
+     * Events decoded from one read. Consecutive events of one logger
+     * are passed to the appenders with one
+     * Logger::callAppendersBatch() call.
+     */
+    class DispatchBatch : public WorkItem {
+    public:
+        void add(Logger const & logger, spi::InternalLoggingEvent const & event);
+        bool empty() const { return events.empty(); }
+
+        virtual void run();
+
+    private:
+        std::vector<spi::InternalLoggingEvent> events;
+
+        //! Loggers of the runs and index of the end of each run.
+        std::vector<Logger> loggers;
+        std::vector<std::size_t> ends;
+    };
+
+
+    //! Read state of one client connection. It is used by one
+    //! IoThread only.
+    struct Connection {
+        Connection(int fd_, WorkQueuePtr const & dispatcher_, bool seqpacket_)
+        : fd(fd_), seqpacket(seqpacket_), begin(0), end(0),
+          buffer(READ_BUFFER_SIZE), dispatcher(dispatcher_), decompressor(0)
+        { }
+
+        ~Connection() { delete decompressor; }
+
+        //! Returns the logger, avoiding the hierarchy lookup for
+        //! names seen before.
+        Logger const & getLogger(tstring const & name);
+
+        int fd;
+
+        //! Records of a seqpacket socket are read whole, so reads need
+        //! room for LOG4CPLUS_SEQPACKET_RECORD_SIZE bytes.
+        bool seqpacket;
+
+        //! Unparsed data is <code>buffer[begin, end)</code>.
+        std::size_t begin;
+        std::size_t end;
+        std::vector<char> buffer;
+
+        //! Events of one connection are always dispatched by the same
+        //! single-threaded queue, so their order is kept.
+        WorkQueuePtr dispatcher;
+        std::map<tstring, Logger> loggers;
+
+        //! Protocol state, see SocketAppender.
+        MessageDecoder decoder;
+
+        //! Set when the client's stream is compressed. Compressed data
+        //! are read into <code>input</code> and decompressed into
+        //! <code>buffer</code>.
+        StreamDecompressor * decompressor;
+        std::vector<char> input;
+    };
+
+
+    /**
+     * Accepts and serves a share of the client connections with its
+     * own epoll instance. Each thread has its own listening socket
+     * bound with <code>SO_REUSEPORT</code>, so the kernel spreads new
+     * connections over the threads. Threads serving a Unix domain
+     * socket share one listening socket; events of its clients are
+     * tagged with the client's process and user id, followed by the
+     * server name they come with. Sockets are non-blocking and each
+     * read takes in as many messages as fit into the connection's
+     * buffer. Decoded events are handed over to the dispatchers, so
+     * slow appenders do not hold up the network reads. A connection
+     * whose dispatcher is behind is taken out of the epoll set until
+     * it catches up; the other connections are still served.
+     */
+    class IoThread : public AbstractThread {
+    public:
+        IoThread(int listenFd,
+            std::vector<WorkQueuePtr> const & dispatchers);
+        ~IoThread();
+
+        bool isOpen() const { return epfd != -1; }
+
+        virtual void run();
+
+    private:
+        void acceptConnections();
+
+        //! Returns false when the connection is to be closed.
+        bool readMessages(Connection & conn);
+        bool decodeMessages(Connection & conn, DispatchBatch & batch);
+        bool inflateMessages(Connection & conn, DispatchBatch & batch,
+            char const * data, std::size_t size);
+        bool handshake(Connection & conn, unsigned char features);
+        void closeConnection(Connection * conn);
+        void pauseConnection(Connection * conn);
+        void resumeConnections();
+
+        int epfd;
+        int listenFd;
+        bool local;
+        bool seqpacket;
+        std::vector<WorkQueuePtr> dispatchers;
+        std::size_t nextDispatcher;
+        SocketBuffer eventBuffer;
+        std::vector<spi::InternalLoggingEvent> decodedEvents;
+
+        //! Connections not in the epoll set.
+        std::vector<Connection *> paused;
+    };
+
+
+    /**
+     * Receives events sent by DatagramAppender to the UDP port with
+     * the same number as the listening TCP port. Many datagrams are
+     * taken in with one <tt>recvmmsg()</tt> call. Each datagram is
+     * decoded on its own; damaged ones are dropped. Events of one
+     * sender always go to the same dispatcher. Datagrams of senders
+     * whose dispatcher is behind are dropped, so that the others are
+     * not held up.
+     */
+    class DatagramThread : public AbstractThread {
+    public:
+        DatagramThread(int fd,
+            std::vector<WorkQueuePtr> const & dispatchers);
+        ~DatagramThread();
+
+        virtual void run();
+
+    private:
+        void decodeDatagram(char const * data, std::size_t size,
+            DispatchBatch & batch);
+        Logger const & getLogger(tstring const & name);
+
+        int fd;
+        std::vector<WorkQueuePtr> dispatchers;
+        bool dropping;
+        std::vector<char> buffer;
+        std::map<tstring, Logger> loggers;
+        MessageDecoder decoder;
+        std::vector<spi::InternalLoggingEvent> decodedEvents;
+    };
+
+
+    /**
+     * Reads events written by SharedMemoryAppender into a shared
+     * memory ring. The ring is polled; when it is empty, or the
+     * dispatcher is behind, the thread sleeps for a millisecond.
+     * Events of all writers go to one dispatcher, so the order of
+     * each writer's events is kept.
+     */
+    class RingThread : public AbstractThread {
+    public:
+        RingThread(tstring const & name, WorkQueuePtr const & dispatcher);
+
+        bool isOpen() const { return ring.isOpen(); }
+
+        virtual void run();
+
+    private:
+        Logger const & getLogger(tstring const & name);
+
+        SharedRing ring;
+        WorkQueuePtr dispatcher;
+        std::vector<char> record;
+        std::map<tstring, Logger> loggers;
+        MessageDecoder decoder;
+        std::vector<spi::InternalLoggingEvent> decodedEvents;
+    };
+
+#else
     class ClientThread : public AbstractThread {
     public:
         ClientThread(Socket clientsock_)
@@ -55,7 +309,26 @@ namespace loggingserver {
 
     private:
         Socket clientsock;
+        MessageDecoder decoder;
+    };
+
+
+    //! Receives events sent by DatagramAppender, one datagram at a
+    //! time.
+    class DatagramThread : public AbstractThread {
+    public:
+        DatagramThread(unsigned short port)
+        : socket(port)
+        { }
+
+        bool isOpen() const { return socket.isOpen(); }
+
+        virtual void run();
+
+    private:
+        DatagramSocket socket;
     };
+#endif
 
 }
 
@@ -66,32 +339,909 @@ int
 main(int argc, char** argv)
 {
     if(argc < 3) {
-        cout << "Usage: port config_file" << endl;
+        cout << "Usage: port|path|shm:name config_file"
+            << " [io_threads [dispatch_threads]]" << endl
+            << "  path is a Unix domain socket, seqpacket:path one of"
+            << " seqpacket type" << endl
+            << "  shm:name is a shared memory ring, e.g. shm:/log4cplus"
+            << endl;
         return 1;
     }
-    int port = std::atoi(argv[1]);
+
+    // Addresses with a slash are paths of Unix domain sockets.
+    std::string address = argv[1];
+    std::string const shmPrefix = "shm:";
+    bool const shm = address.compare(0, shmPrefix.size(), shmPrefix) == 0;
+    if (shm)
+        address.erase(0, shmPrefix.size());
+    std::string const seqpacketPrefix = "seqpacket:";
+    LocalSocketType localType = local_stream;
+    if (address.compare(0, seqpacketPrefix.size(), seqpacketPrefix) == 0) {
+        localType = local_seqpacket;
+        address.erase(0, seqpacketPrefix.size());
+    }
+    bool const local = ! shm && (localType == local_seqpacket
+        || address.find('/') != std::string::npos);
+    tstring const path = LOG4CPLUS_C_STR_TO_TSTRING(address.c_str());
+    int port = local ? 0 : std::atoi(argv[1]);
     tstring configFile = LOG4CPLUS_C_STR_TO_TSTRING(argv[2]);
 
     PropertyConfigurator config(configFile);
     config.configure();
 
-    ServerSocket serverSocket(port);
-    if (!serverSocket.isOpen()) {
+#if defined (LOGGINGSERVER_USE_EPOLL)
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long ioThreads = argc > 3 ? std::atol(argv[3]) : ncpus;
+    long dispatchThreads = argc > 4 ? std::atol(argv[4]) : ncpus;
+    if (ioThreads < 1)
+        ioThreads = 1;
+    if (dispatchThreads < 1)
+        dispatchThreads = 1;
+
+    // Every client takes a descriptor.
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    std::vector<WorkQueuePtr> dispatchers;
+    for (long i = 0; i != dispatchThreads; ++i)
+        dispatchers.push_back(WorkQueuePtr(new WorkQueue(1)));
+
+    if (shm) {
+        SharedObjectPtr<loggingserver::RingThread> ringThread(
+            new loggingserver::RingThread(path, dispatchers[0]));
+        if (! ringThread->isOpen()) {
+            cout << "Could not open shared memory ring " << address << "."
+                << endl;
+            return 2;
+        }
+
+        // The reader runs forever.
+        ringThread->start();
+        ringThread->join();
+        return 0;
+    }
+
+    // Without SO_REUSEPORT all threads wait on one listening socket.
+    // Unix domain sockets always have one.
+    int sharedFd = -1;
+    if (local) {
+        SocketState localState;
+        SOCKET_TYPE localFd = openLocalSocket(path, localType, localState);
+        if (localFd == INVALID_SOCKET_VALUE) {
+            cout << "Could not open server socket " << address << "." << endl;
+            return 2;
+        }
+        sharedFd = static_cast<int>(localFd);
+        fcntl(sharedFd, F_SETFL, fcntl(sharedFd, F_GETFL) | O_NONBLOCK);
+        fcntl(sharedFd, F_SETFD, FD_CLOEXEC);
+    }
+
+    // Sockets bound with SO_REUSEPORT would share the port with
+    // another server run by the same user instead of failing.
+    if (! local
+        && ! loggingserver::isPortFree(static_cast<unsigned short>(port))) {
         cout << "Could not open server socket, maybe port "
             << port << " is already in use." << endl;
         return 2;
     }
 
+    std::vector<SharedObjectPtr<loggingserver::IoThread> > threads;
+    for (long i = 0; i != ioThreads; ++i) {
+        int listenFd = sharedFd;
+        if (listenFd == -1) {
+            listenFd = loggingserver::openListenSocket(
+                static_cast<unsigned short>(port), true);
+            if (listenFd == -1 && i == 0) {
+                listenFd = sharedFd = loggingserver::openListenSocket(
+                    static_cast<unsigned short>(port), false);
+            }
+        }
+        if (listenFd == -1) {
+            cout << "Could not open server socket, maybe port "
+                << port << " is already in use." << endl;
+            return 2;
+        }
+
+        SharedObjectPtr<loggingserver::IoThread> thr(
+            new loggingserver::IoThread(listenFd, dispatchers));
+        if (! thr->isOpen()) {
+            cout << "Could not create epoll instance." << endl;
+            return 3;
+        }
+        threads.push_back(thr);
+    }
+
+    for (std::size_t i = 0; i != threads.size(); ++i)
+        threads[i]->start();
+
+    SharedObjectPtr<loggingserver::DatagramThread> udpThread;
+    if (! local) {
+        SocketState udpState;
+        SOCKET_TYPE udpFd = openDatagramSocket(
+            static_cast<unsigned short>(port), udpState);
+        if (udpFd != INVALID_SOCKET_VALUE) {
+            udpThread = new loggingserver::DatagramThread(
+                static_cast<int>(udpFd), dispatchers);
+            udpThread->start();
+        }
+        else
+            cout << "Could not open UDP socket on port " << port << "." << endl;
+    }
+
+    // The I/O threads run forever.
+    threads[0]->join();
+
+#else
+    if (shm) {
+        SharedRing ring(path, LOG4CPLUS_SHARED_RING_SIZE);
+        if (! ring.isOpen()) {
+            cout << "Could not open shared memory ring " << address << "."
+                << endl;
+            return 2;
+        }
+
+        MessageDecoder decoder;
+        std::vector<char> record;
+        std::vector<spi::InternalLoggingEvent> events;
+        unsigned long dropped = ring.getDropped();
+        unsigned long abandoned = ring.getAbandoned();
+        while(1) {
+            loggingserver::reportRingLosses(ring, dropped, abandoned);
+            if(!ring.read(record)) {
+                sleepmillis(1);
+                continue;
+            }
+
+            events.clear();
+            if(!loggingserver::decodeFrames(decoder,
+                    record.empty() ? 0 : &record[0], record.size(), events)) {
+                getLogLog().error(
+                    LOG4CPLUS_TEXT("loggingserver- Damaged shared memory record"));
+                continue;
+            }
+            for(std::size_t i = 0; i != events.size(); ++i) {
+                Logger logger = Logger::getInstance(events[i].getLoggerName());
+                logger.callAppenders(events[i]);
+            }
+        }
+    }
+
+    // Records of seqpacket sockets are read by the epoll server only.
+    if (local && localType == local_seqpacket) {
+        cout << "seqpacket sockets are not supported." << endl;
+        return 2;
+    }
+
+    ServerSocket serverSocket(local ? ServerSocket(path, local_stream)
+        : ServerSocket(port));
+    if (!serverSocket.isOpen()) {
+        cout << "Could not open server socket, maybe "
+            << address << " is already in use." << endl;
+        return 2;
+    }
+
+    if (! local) {
+        loggingserver::DatagramThread *udpThread =
+            new loggingserver::DatagramThread(static_cast<unsigned short>(port));
+        if (udpThread->isOpen())
+            udpThread->start();
+        else
+            cout << "Could not open UDP socket on port " << port << "." << endl;
+    }
+
     while(1) {
         loggingserver::ClientThread *thr = 
             new loggingserver::ClientThread(serverSocket.accept());
         thr->start();
     }
+#endif
 
     return 0;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::decodeFrames implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+bool
+loggingserver::decodeFrames(MessageDecoder & decoder, char const * data,
+    std::size_t size, std::vector<spi::InternalLoggingEvent> & events)
+{
+    decoder.reset();
+    unsigned char const * p = reinterpret_cast<unsigned char const *>(data);
+    std::size_t left = size;
+    while (left != 0) {
+        if (left < 4)
+            return false;
+        unsigned int const msgSize = (static_cast<unsigned int>(p[0]) << 24)
+            | (p[1] << 16) | (p[2] << 8) | p[3];
+        p += 4;
+        left -= 4;
+        if (left < msgSize
+            || ! decoder.decode(reinterpret_cast<char const *>(p), msgSize,
+                events))
+            return false;
+        p += msgSize;
+        left -= msgSize;
+    }
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::reportRingLosses implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+void
+loggingserver::reportRingLosses(SharedRing const & ring,
+    unsigned long & dropped, unsigned long & abandoned)
+{
+    unsigned long const nowDropped = ring.getDropped();
+    if (nowDropped != dropped) {
+        getLogLog().warn(LOG4CPLUS_TEXT("loggingserver- ")
+            + convertIntegerToString(nowDropped - dropped)
+            + LOG4CPLUS_TEXT(" events dropped, shared memory ring is full"));
+        dropped = nowDropped;
+    }
+
+    unsigned long const nowAbandoned = ring.getAbandoned();
+    if (nowAbandoned != abandoned) {
+        getLogLog().warn(LOG4CPLUS_TEXT("loggingserver- ")
+            + convertIntegerToString(nowAbandoned - abandoned)
+            + LOG4CPLUS_TEXT(" shared memory records of crashed writers")
+            LOG4CPLUS_TEXT(" skipped"));
+        abandoned = nowAbandoned;
+    }
+}
+
+
+#if defined (LOGGINGSERVER_USE_EPOLL)
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::openListenSocket implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+int
+loggingserver::openListenSocket(unsigned short port, bool reusePort)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    int optval = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    if (reusePort) {
+#if defined (SO_REUSEPORT)
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval,
+                sizeof(optval)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+#else
+        ::close(fd);
+        return -1;
+#endif
+    }
+
+    struct sockaddr_in server;
+    std::memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = INADDR_ANY;
+    server.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&server),
+            sizeof(server)) != 0
+        || ::listen(fd, SOMAXCONN) != 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+bool
+loggingserver::isPortFree(unsigned short port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return false;
+
+    int optval = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+    struct sockaddr_in server;
+    std::memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = INADDR_ANY;
+    server.sin_port = htons(port);
+    bool const free = bind(fd, reinterpret_cast<struct sockaddr*>(&server),
+        sizeof(server)) == 0;
+    ::close(fd);
+    return free;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::DispatchBatch implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+void
+loggingserver::DispatchBatch::add(Logger const & logger,
+    spi::InternalLoggingEvent const & event)
+{
+    if (loggers.empty()
+        || loggers.back().getName() != logger.getName()) {
+        if (! loggers.empty())
+            ends.push_back(events.size());
+        loggers.push_back(logger);
+    }
+    events.push_back(event);
+}
+
+
+void
+loggingserver::DispatchBatch::run()
+{
+    ends.push_back(events.size());
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i != loggers.size(); ++i) {
+        loggers[i].callAppendersBatch(&events[begin], ends[i] - begin);
+        begin = ends[i];
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::Connection implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+Logger const &
+loggingserver::Connection::getLogger(tstring const & name)
+{
+    std::map<tstring, Logger>::iterator it = loggers.find(name);
+    if (it != loggers.end())
+        return it->second;
+
+    if (loggers.size() >= LOGGER_CACHE_SIZE)
+        loggers.clear();
+    return loggers.insert(
+        std::make_pair(name, Logger::getInstance(name))).first->second;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::IoThread implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+loggingserver::IoThread::IoThread(int listenFd_,
+    std::vector<WorkQueuePtr> const & dispatchers_)
+: epfd(epoll_create(MAX_EPOLL_EVENTS)),
+  listenFd(listenFd_),
+  local(false),
+  seqpacket(false),
+  dispatchers(dispatchers_),
+  nextDispatcher(0),
+  eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE)
+{
+    if (epfd == -1)
+        return;
+
+    fcntl(epfd, F_SETFD, FD_CLOEXEC);
+
+    struct sockaddr_storage addr;
+    socklen_t addrLen = sizeof(addr);
+    int type = SOCK_STREAM;
+    socklen_t typeLen = sizeof(type);
+    local = getsockname(listenFd, reinterpret_cast<struct sockaddr*>(&addr),
+            &addrLen) == 0
+        && addr.ss_family == AF_UNIX;
+    seqpacket = getsockopt(listenFd, SOL_SOCKET, SO_TYPE, &type, &typeLen) == 0
+        && type == SOCK_SEQPACKET;
+
+    // Listening socket is told apart by null pointer.
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev) != 0) {
+        ::close(epfd);
+        epfd = -1;
+    }
+}
+
+
+loggingserver::IoThread::~IoThread()
+{
+    if (epfd != -1)
+        ::close(epfd);
+}
+
+
+void
+loggingserver::IoThread::acceptConnections()
+{
+    while(1) {
+        int fd = accept4(listenFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR)
+                continue;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // Most likely out of descriptors; wait for some
+                // clients to go away.
+                getLogLog().error(LOG4CPLUS_TEXT("loggingserver- accept() failed"));
+                sleepmillis(100);
+            }
+            return;
+        }
+
+        Connection * conn = new Connection(fd,
+            dispatchers[nextDispatcher++ % dispatchers.size()], seqpacket);
+        if (local)
+            conn->decoder.setPeerName(getLocalPeerName(fd));
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- epoll_ctl() failed"));
+            ::close(fd);
+            delete conn;
+            continue;
+        }
+
+        cout << "Received a client connection!!!!" << endl;
+    }
+}
+
+
+void
+loggingserver::IoThread::run()
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    while(1) {
+        resumeConnections();
+        int n = epoll_wait(epfd, events, MAX_EPOLL_EVENTS,
+            paused.empty() ? -1 : RESUME_CHECK_INTERVAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- epoll_wait() failed"));
+            return;
+        }
+
+        for (int i = 0; i != n; ++i) {
+            Connection * conn = static_cast<Connection *>(events[i].data.ptr);
+            if (! conn)
+                acceptConnections();
+            else if (! readMessages(*conn))
+                closeConnection(conn);
+            else if (conn->dispatcher->pending() >= MAX_PENDING_BATCHES)
+                // Stop reading while the dispatcher is behind; TCP flow
+                // control slows the client down.
+                pauseConnection(conn);
+        }
+    }
+}
+
+
+bool
+loggingserver::IoThread::readMessages(Connection & conn)
+{
+    SharedObjectPtr<DispatchBatch> batch(new DispatchBatch);
+    bool keep = true;
+    for (int i = 0; i != READS_PER_WAKEUP; ++i) {
+        if (conn.seqpacket && ! conn.decompressor
+            && conn.buffer.size() - conn.end < LOG4CPLUS_SEQPACKET_RECORD_SIZE)
+            conn.buffer.resize(conn.end + LOG4CPLUS_SEQPACKET_RECORD_SIZE);
+
+        char * const data = conn.decompressor
+            ? &conn.input[0] : &conn.buffer[conn.end];
+        std::size_t const room = conn.decompressor
+            ? conn.input.size() : conn.buffer.size() - conn.end;
+
+        // With MSG_TRUNC recv() returns the full size of a record that
+        // did not fit.
+        ssize_t ret = ::recv(conn.fd, data, room,
+            conn.seqpacket ? MSG_TRUNC : 0);
+        if (ret == 0)
+            keep = false;
+        else if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            keep = errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        else if (static_cast<std::size_t>(ret) > room) {
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- Record too large"));
+            keep = false;
+        }
+        else {
+            if (conn.decompressor)
+                keep = inflateMessages(conn, *batch, &conn.input[0], ret);
+            else {
+                conn.end += ret;
+                keep = decodeMessages(conn, *batch);
+            }
+            if (keep)
+                continue;
+        }
+        break;
+    }
+
+    if (! batch->empty())
+        conn.dispatcher->post(WorkItemPtr(batch.get()));
+
+    return keep;
+}
+
+
+bool
+loggingserver::IoThread::decodeMessages(Connection & conn,
+    DispatchBatch & batch)
+{
+    // The framing is the same as read by Socket::read(): message size
+    // in network byte order followed by the message.
+    while (conn.end - conn.begin >= sizeof(unsigned int)) {
+        unsigned int msgSize;
+        std::memcpy(&msgSize, &conn.buffer[conn.begin], sizeof(msgSize));
+        msgSize = ntohl(msgSize);
+        if (msgSize > MAX_MESSAGE_SIZE) {
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- Message too large"));
+            return false;
+        }
+
+        std::size_t const frameSize = sizeof(unsigned int) + msgSize;
+        if (conn.end - conn.begin < frameSize) {
+            if (frameSize > conn.buffer.size())
+                conn.buffer.resize(frameSize);
+            break;
+        }
+
+        char const * msg = &conn.buffer[conn.begin + sizeof(unsigned int)];
+        unsigned char features;
+        if (parseHandshake(msg, msgSize, features)) {
+            if (! handshake(conn, features))
+                return false;
+            conn.begin += frameSize;
+
+            // Anything after the handshake is compressed.
+            if (conn.decompressor && conn.begin != conn.end) {
+                std::vector<char> rest(conn.buffer.begin() + conn.begin,
+                    conn.buffer.begin() + conn.end);
+                conn.begin = conn.end = 0;
+                return inflateMessages(conn, batch, &rest[0], rest.size());
+            }
+            continue;
+        }
+
+        bool decoded;
+        decodedEvents.clear();
+        if (msgSize <= eventBuffer.getMaxSize()) {
+            eventBuffer.clear();
+            std::memcpy(eventBuffer.getBuffer(), msg, msgSize);
+            eventBuffer.setSize(msgSize);
+            decoded = conn.decoder.decode(eventBuffer, decodedEvents);
+        }
+        else
+            decoded = conn.decoder.decode(msg, msgSize, decodedEvents);
+
+        if (! decoded) {
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- Damaged message"));
+            return false;
+        }
+
+        for (std::size_t i = 0; i != decodedEvents.size(); ++i) {
+            spi::InternalLoggingEvent const & event = decodedEvents[i];
+            batch.add(conn.getLogger(event.getLoggerName()), event);
+        }
+
+        conn.begin += frameSize;
+    }
+
+    // Move partial message to the start of the buffer.
+    if (conn.begin == conn.end)
+        conn.begin = conn.end = 0;
+    else if (conn.begin != 0) {
+        std::memmove(&conn.buffer[0], &conn.buffer[conn.begin],
+            conn.end - conn.begin);
+        conn.end -= conn.begin;
+        conn.begin = 0;
+    }
+
+    return true;
+}
+
+
+bool
+loggingserver::IoThread::inflateMessages(Connection & conn,
+    DispatchBatch & batch, char const * data, std::size_t size)
+{
+    // decodeMessages() always leaves room for more data. The
+    // decompressor can hold output back when the room runs out.
+    bool filled;
+    do {
+        std::size_t const room = conn.buffer.size() - conn.end;
+        long ret = conn.decompressor->decompress(data, size,
+            &conn.buffer[conn.end], room);
+        if (ret < 0) {
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- Damaged compressed stream"));
+            return false;
+        }
+
+        filled = static_cast<std::size_t>(ret) == room;
+        conn.end += ret;
+        if (! decodeMessages(conn, batch))
+            return false;
+    } while (size != 0 || filled);
+
+    return true;
+}
+
+
+bool
+loggingserver::IoThread::handshake(Connection & conn, unsigned char features)
+{
+    if (conn.decompressor) {
+        getLogLog().error(LOG4CPLUS_TEXT("loggingserver- Unexpected handshake"));
+        return false;
+    }
+
+    unsigned char accepted = 0;
+    if (features & HANDSHAKE_DEFLATE) {
+        conn.decompressor = new StreamDecompressor;
+        if (conn.decompressor->isValid()) {
+            accepted |= HANDSHAKE_DEFLATE;
+            conn.input.resize(conn.seqpacket
+                ? LOG4CPLUS_SEQPACKET_RECORD_SIZE : READ_BUFFER_SIZE);
+        }
+        else {
+            delete conn.decompressor;
+            conn.decompressor = 0;
+        }
+    }
+
+    // The client waits for the reply, so the socket buffer has room
+    // for it.
+    SocketBuffer reply(HANDSHAKE_FRAME_SIZE);
+    appendHandshake(reply, accepted);
+    return ::send(conn.fd, reply.getBuffer(), reply.getSize(), MSG_NOSIGNAL)
+        == static_cast<ssize_t>(reply.getSize());
+}
+
+
+void
+loggingserver::IoThread::closeConnection(Connection * conn)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, 0);
+    ::close(conn->fd);
+    delete conn;
+    cout << "Client connection closed." << endl;
+}
+
+
+void
+loggingserver::IoThread::pauseConnection(Connection * conn)
+{
+    // Removing the descriptor, rather than clearing EPOLLIN, also
+    // keeps hang-ups from being reported meanwhile.
+    if (epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, 0) == 0)
+        paused.push_back(conn);
+}
+
+
+void
+loggingserver::IoThread::resumeConnections()
+{
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i != paused.size(); ++i) {
+        Connection * conn = paused[i];
+        if (conn->dispatcher->pending() >= MAX_PENDING_BATCHES / 2) {
+            paused[kept++] = conn;
+            continue;
+        }
+
+        // Data that arrived meanwhile is reported right away.
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev) != 0) {
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- epoll_ctl() failed"));
+            closeConnection(conn);
+        }
+    }
+    paused.resize(kept);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::DatagramThread implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+loggingserver::DatagramThread::DatagramThread(int fd_,
+    std::vector<WorkQueuePtr> const & dispatchers_)
+: fd(fd_),
+  dispatchers(dispatchers_),
+  dropping(false),
+  buffer(DATAGRAMS_PER_READ * MAX_DATAGRAM_SIZE)
+{
+    int size = DATAGRAM_RCVBUF_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+
+loggingserver::DatagramThread::~DatagramThread()
+{
+    ::close(fd);
+}
+
+
+void
+loggingserver::DatagramThread::run()
+{
+    struct mmsghdr msgs[DATAGRAMS_PER_READ];
+    struct iovec iovs[DATAGRAMS_PER_READ];
+    struct sockaddr_in addrs[DATAGRAMS_PER_READ];
+    std::vector<SharedObjectPtr<DispatchBatch> > batches(dispatchers.size());
+
+    while(1) {
+        std::memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i != DATAGRAMS_PER_READ; ++i) {
+            iovs[i].iov_base = &buffer[i * MAX_DATAGRAM_SIZE];
+            iovs[i].iov_len = MAX_DATAGRAM_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        // Waits for the first datagram only, then takes whatever else
+        // is already queued.
+        int n = recvmmsg(fd, msgs, DATAGRAMS_PER_READ, MSG_WAITFORONE, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            getLogLog().error(LOG4CPLUS_TEXT("loggingserver- recvmmsg() failed"));
+            return;
+        }
+
+        bool dropped = false;
+        for (int i = 0; i != n; ++i) {
+            std::size_t const d = (addrs[i].sin_addr.s_addr
+                ^ addrs[i].sin_port) % dispatchers.size();
+            if (dispatchers[d]->pending() >= MAX_PENDING_BATCHES) {
+                dropped = true;
+                continue;
+            }
+
+            if (! batches[d])
+                batches[d] = new DispatchBatch;
+            decodeDatagram(&buffer[i * MAX_DATAGRAM_SIZE], msgs[i].msg_len,
+                *batches[d]);
+        }
+
+        for (std::size_t d = 0; d != batches.size(); ++d) {
+            if (! batches[d] || batches[d]->empty())
+                continue;
+
+            dispatchers[d]->post(WorkItemPtr(batches[d].get()));
+            batches[d] = 0;
+        }
+
+        if (dropped && ! dropping)
+            getLogLog().warn(LOG4CPLUS_TEXT("loggingserver- Dispatcher is")
+                LOG4CPLUS_TEXT(" behind, datagrams were dropped"));
+        dropping = dropped;
+    }
+}
+
+
+void
+loggingserver::DatagramThread::decodeDatagram(char const * data,
+    std::size_t size, DispatchBatch & batch)
+{
+    // Events of a damaged datagram are dropped as a whole.
+    decodedEvents.clear();
+    if (! decodeFrames(decoder, data, size, decodedEvents)) {
+        getLogLog().error(LOG4CPLUS_TEXT("loggingserver- Damaged datagram"));
+        return;
+    }
+
+    for (std::size_t i = 0; i != decodedEvents.size(); ++i) {
+        spi::InternalLoggingEvent const & event = decodedEvents[i];
+        batch.add(getLogger(event.getLoggerName()), event);
+    }
+}
+
+
+Logger const &
+loggingserver::DatagramThread::getLogger(tstring const & name)
+{
+    std::map<tstring, Logger>::iterator it = loggers.find(name);
+    if (it != loggers.end())
+        return it->second;
+
+    if (loggers.size() >= LOGGER_CACHE_SIZE)
+        loggers.clear();
+    return loggers.insert(
+        std::make_pair(name, Logger::getInstance(name))).first->second;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::RingThread implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+loggingserver::RingThread::RingThread(tstring const & name,
+    WorkQueuePtr const & dispatcher_)
+: ring(name, LOG4CPLUS_SHARED_RING_SIZE),
+  dispatcher(dispatcher_)
+{ }
+
+
+void
+loggingserver::RingThread::run()
+{
+    unsigned long dropped = ring.getDropped();
+    unsigned long abandoned = ring.getAbandoned();
+    while(1) {
+        reportRingLosses(ring, dropped, abandoned);
+
+        // Records are left in the ring while the dispatcher is behind;
+        // writers drop events once it is full.
+        SharedObjectPtr<DispatchBatch> batch(new DispatchBatch);
+        bool const behind = dispatcher->pending() >= MAX_PENDING_BATCHES;
+        for (int i = 0; ! behind && i != RECORDS_PER_BATCH
+                && ring.read(record); ++i) {
+            decodedEvents.clear();
+            if (! decodeFrames(decoder, record.empty() ? 0 : &record[0],
+                    record.size(), decodedEvents)) {
+                getLogLog().error(
+                    LOG4CPLUS_TEXT("loggingserver- Damaged shared memory record"));
+                continue;
+            }
+
+            for (std::size_t j = 0; j != decodedEvents.size(); ++j) {
+                spi::InternalLoggingEvent const & event = decodedEvents[j];
+                batch->add(getLogger(event.getLoggerName()), event);
+            }
+        }
+
+        if (batch->empty()) {
+            sleepmillis(1);
+            continue;
+        }
+
+        dispatcher->post(WorkItemPtr(batch.get()));
+    }
+}
+
+
+Logger const &
+loggingserver::RingThread::getLogger(tstring const & name)
+{
+    std::map<tstring, Logger>::iterator it = loggers.find(name);
+    if (it != loggers.end())
+        return it->second;
+
+    if (loggers.size() >= LOGGER_CACHE_SIZE)
+        loggers.clear();
+    return loggers.insert(
+        std::make_pair(name, Logger::getInstance(name))).first->second;
+}
+
+
+#else
 ////////////////////////////////////////////////////////////////////////////////
 // loggingserver::ClientThread implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -115,11 +1265,59 @@ loggingserver::ClientThread::run()
         if(!clientsock.read(buffer)) {
             return;
         }
+
+        // Compression is supported by the epoll server only.
+        unsigned char features;
+        if(parseHandshake(buffer.getBuffer(), buffer.getSize(), features)) {
+            SocketBuffer reply(HANDSHAKE_FRAME_SIZE);
+            appendHandshake(reply, 0);
+            if(!clientsock.write(reply)) {
+                return;
+            }
+            continue;
+        }
         
-        spi::InternalLoggingEvent event = readFromBuffer(buffer);
-        Logger logger = Logger::getInstance(event.getLoggerName());
-        logger.callAppenders(event);   
+        std::vector<spi::InternalLoggingEvent> events;
+        if(!decoder.decode(buffer, events)) {
+            return;
+        }
+        for(std::size_t i = 0; i != events.size(); ++i) {
+            Logger logger = Logger::getInstance(events[i].getLoggerName());
+            logger.callAppenders(events[i]);
+        }
     }
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// loggingserver::DatagramThread implementation
+////////////////////////////////////////////////////////////////////////////////
+
+
+void
+loggingserver::DatagramThread::run()
+{
+    SocketBuffer buffer(65507);
+    MessageDecoder decoder;
+    std::vector<spi::InternalLoggingEvent> events;
+    while(1) {
+        buffer.clear();
+        if(!socket.read(buffer)) {
+            return;
+        }
+
+        // Each datagram holds whole size-prefixed frames encoded
+        // without the dictionary.
+        events.clear();
+        if(!decodeFrames(decoder, buffer.getBuffer(),
+                buffer.getSize(), events)) {
+            continue;
+        }
+
+        for(std::size_t i = 0; i != events.size(); ++i) {
+            Logger logger = Logger::getInstance(events[i].getLoggerName());
+            logger.callAppenders(events[i]);
+        }
+    }
+}
+#endif
@@ -0,0 +1,241 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+// Merges shard files written by ShardedFileAppender into a single
+// time ordered stream.
+//
+// Usage: shardmerge [-k] [-o output] shard...
+//
+//   -k         keep the "sec.usec sequence length" record prefixes
+//   -o output  write into output instead of standard output
+//
+// Only one record per shard is held in memory. Records with equal
+// timestamps are ordered by the shard's position on the command line
+// and then by their sequence numbers.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+namespace
+{
+
+
+struct Record
+{
+    unsigned long sec;
+    unsigned long usec;
+    unsigned long sequence;
+    std::size_t shard;
+    std::string prefix;
+    std::string text;
+};
+
+
+//! Orders records so that std::priority_queue yields the oldest one.
+struct RecordLater
+{
+    bool
+    operator () (Record const * a, Record const * b) const
+    {
+        if (a->sec != b->sec)
+            return a->sec > b->sec;
+        else if (a->usec != b->usec)
+            return a->usec > b->usec;
+        else if (a->shard != b->shard)
+            return a->shard > b->shard;
+        else
+            return a->sequence > b->sequence;
+    }
+};
+
+
+enum ReadResult
+{
+    RECORD_READ,
+    END_OF_SHARD,
+    TRUNCATED_RECORD,
+    MALFORMED_RECORD
+};
+
+
+//! Reads next record from the shard. A shard that ends inside
+//! a record, e.g. after a crash, is reported as TRUNCATED_RECORD.
+ReadResult
+read_record (std::istream & in, Record & rec)
+{
+    if (in.peek () == std::char_traits<char>::eof ())
+        return END_OF_SHARD;
+
+    std::string sec_usec;
+    std::size_t length;
+    if (! (in >> sec_usec >> rec.sequence >> length) || in.get () != ' ')
+        return in.eof () ? TRUNCATED_RECORD : MALFORMED_RECORD;
+
+    std::string::size_type const dot = sec_usec.find ('.');
+    if (dot == std::string::npos)
+        return MALFORMED_RECORD;
+
+    rec.sec = std::strtoul (sec_usec.c_str (), 0, 10);
+    rec.usec = std::strtoul (sec_usec.c_str () + dot + 1, 0, 10);
+
+    std::ostringstream prefix;
+    prefix << sec_usec << ' ' << rec.sequence << ' ' << length << ' ';
+    rec.prefix = prefix.str ();
+
+    rec.text.resize (length);
+    if (length != 0
+        && ! in.read (&rec.text[0], static_cast<std::streamsize>(length)))
+        return TRUNCATED_RECORD;
+
+    return RECORD_READ;
+}
+
+
+//! Reads next record of the shard into <code>rec</code>. Errors are
+//! reported and set <code>ret</code> to 1. Returns false if there is
+//! no record to merge.
+bool
+next_record (std::istream & in, Record & rec, char const * name, int & ret)
+{
+    switch (read_record (in, rec))
+    {
+    case RECORD_READ:
+        return true;
+
+    case TRUNCATED_RECORD:
+        cerr << "Truncated record at the end of " << name << endl;
+        break;
+
+    case MALFORMED_RECORD:
+        cerr << "Malformed record in " << name << endl;
+        break;
+
+    case END_OF_SHARD:
+        return false;
+    }
+
+    ret = 1;
+    return false;
+}
+
+
+int
+usage ()
+{
+    cerr << "Usage: shardmerge [-k] [-o output] shard..." << endl;
+    return 1;
+}
+
+
+} // namespace
+
+
+int
+main (int argc, char ** argv)
+{
+    bool keep_prefix = false;
+    char const * output_name = 0;
+    std::vector<char const *> names;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp (argv[i], "-k") == 0)
+            keep_prefix = true;
+        else if (std::strcmp (argv[i], "-o") == 0 && i + 1 < argc)
+            output_name = argv[++i];
+        else if (argv[i][0] != '-')
+            names.push_back (argv[i]);
+        else
+            return usage ();
+    }
+
+    if (names.empty ())
+        return usage ();
+
+    std::ofstream output_file;
+    if (output_name)
+    {
+        output_file.open (output_name, std::ios::out | std::ios::binary);
+        if (! output_file)
+        {
+            cerr << "Could not open " << output_name << endl;
+            return 1;
+        }
+    }
+    std::ostream & out = output_name ? output_file : cout;
+
+    std::vector<std::ifstream *> shards (names.size ());
+    std::vector<Record> heads (names.size ());
+    std::priority_queue<Record const *, std::vector<Record const *>,
+        RecordLater> queue;
+    int ret = 0;
+
+    for (std::size_t i = 0; i != names.size (); ++i)
+    {
+        shards[i] = new std::ifstream (names[i],
+            std::ios::in | std::ios::binary);
+        if (! *shards[i])
+        {
+            cerr << "Could not open " << names[i] << endl;
+            ret = 1;
+            continue;
+        }
+
+        heads[i].shard = i;
+        if (next_record (*shards[i], heads[i], names[i], ret))
+            queue.push (&heads[i]);
+    }
+
+    while (! queue.empty ())
+    {
+        Record const * rec = queue.top ();
+        queue.pop ();
+
+        if (keep_prefix)
+            out << rec->prefix;
+        out << rec->text;
+
+        std::size_t const i = rec->shard;
+        if (next_record (*shards[i], heads[i], names[i], ret))
+            queue.push (&heads[i]);
+    }
+
+    for (std::size_t i = 0; i != shards.size (); ++i)
+        delete shards[i];
+
+    out.flush ();
+    return out ? ret : 1;
+}
@@ -23,14 +23,54 @@
 #include <log4cplus/helpers/loglog.h>
 #include <log4cplus/helpers/pointer.h>
 #include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/helpers/workqueue.h>
 #include <log4cplus/spi/factory.h>
 #include <log4cplus/spi/loggingevent.h>
+#include <cstdlib>
 
 using namespace log4cplus;
 using namespace log4cplus::helpers;
 using namespace log4cplus::spi;
 
 
+namespace
+{
+
+//! Number of threads activating lazily opened appenders.
+static unsigned const ACTIVATION_THREADS = 8;
+
+
+class ActivationWorkItem
+    : public WorkItem
+{
+public:
+    explicit ActivationWorkItem (SharedAppenderPtr const & a)
+        : appender (a)
+    { }
+
+    virtual void run ()
+    {
+        appender->activate ();
+    }
+
+private:
+    SharedAppenderPtr appender;
+};
+
+
+static
+WorkQueue &
+getActivationQueue ()
+{
+    // The queue is never destroyed, its threads may still be
+    // activating appenders when static objects are destroyed.
+    static WorkQueue * queue = new WorkQueue (ACTIVATION_THREADS);
+    return *queue;
+}
+
+} // namespace
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // log4cplus::ErrorHandler dtor
@@ -74,8 +114,13 @@ Appender::Appender()
    name( LOG4CPLUS_TEXT("") ),
    threshold(NOT_SET_LOG_LEVEL),
    errorHandler(new OnlyOnceErrorHandler()),
-   closed(false)
+   closed(false),
+   activation(ACTIVE),
+   maxPendingEvents(1000),
+   droppedPendingEvents(0),
+   selfSynchronized(false)
 {
+    layout->attach();
 }
 
 
@@ -85,8 +130,13 @@ Appender::Appender(const log4cplus::helpers::Properties properties)
    name( LOG4CPLUS_TEXT("") ),
    threshold(NOT_SET_LOG_LEVEL),
    errorHandler(new OnlyOnceErrorHandler()),
-   closed(false)
+   closed(false),
+   activation(ACTIVE),
+   maxPendingEvents(1000),
+   droppedPendingEvents(0),
+   selfSynchronized(false)
 {
+    layout->attach();
     if(properties.exists( LOG4CPLUS_TEXT("layout") )) {
         log4cplus::tstring factoryName = properties.getProperty( LOG4CPLUS_TEXT("layout") );
         LayoutFactory* factory = getLayoutFactoryRegistry().get(factoryName);
@@ -106,6 +156,7 @@ Appender::Appender(const log4cplus::helpers::Properties properties)
                                   + factoryName);
             }
             else {
+                newLayout->attach();
                 layout = newLayout;
             }
         }
@@ -186,6 +237,21 @@ Appender::destructorImpl()
 void
 Appender::doAppend(const log4cplus::spi::InternalLoggingEvent& event)
 {
+    if(selfSynchronized) {
+        if(closed) {
+            getLogLog().error(  LOG4CPLUS_TEXT("Attempted to append to closed appender named [")
+                              + name
+                              + LOG4CPLUS_TEXT("]."));
+            return;
+        }
+
+        if(isAsSevereAsThreshold(event.getLogLevel())
+           && checkFilter(filter.get(), event) != DENY) {
+            append(event);
+        }
+        return;
+    }
+
     LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( access_mutex )
         if(closed) {
             getLogLog().error(  LOG4CPLUS_TEXT("Attempted to append to closed appender named [")
@@ -202,8 +268,172 @@ Appender::doAppend(const log4cplus::spi::InternalLoggingEvent& event)
             return;
         }
 
-        append(event);
+        if(activation == ACTIVE) {
+            append(event);
+            return;
+        }
+
+        if(pendingEvents.size() < maxPendingEvents)
+            pendingEvents.push_back(event);
+        else
+            ++droppedPendingEvents;
+
+        if(activation != INACTIVE)
+            return;
+
+        activation = ACTIVATION_SCHEDULED;
     LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
+
+    postActivation();
+}
+
+
+
+void
+Appender::doAppendBatch(const log4cplus::spi::InternalLoggingEvent* events,
+    std::size_t n)
+{
+    if(selfSynchronized) {
+        for(std::size_t i = 0; i != n; ++i) {
+            doAppend(events[i]);
+        }
+        return;
+    }
+
+    {
+        thread::MutexGuard guard (access_mutex);
+        if(closed) {
+            getLogLog().error(  LOG4CPLUS_TEXT("Attempted to append to closed appender named [")
+                              + name
+                              + LOG4CPLUS_TEXT("]."));
+            return;
+        }
+
+        if(activation == ACTIVE) {
+            // Consecutive accepted events are appended together.
+            std::size_t first = 0;
+            for(std::size_t i = 0; i != n; ++i) {
+                if(isAsSevereAsThreshold(events[i].getLogLevel())
+                   && checkFilter(filter.get(), events[i]) != DENY) {
+                    continue;
+                }
+
+                if(i != first) {
+                    appendBatch(events + first, i - first);
+                }
+                first = i + 1;
+            }
+            if(n != first) {
+                appendBatch(events + first, n - first);
+            }
+            return;
+        }
+    }
+
+    // Events are buffered until the appender is activated.
+    for(std::size_t i = 0; i != n; ++i) {
+        doAppend(events[i]);
+    }
+}
+
+
+
+void
+Appender::activate()
+{
+    LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( access_mutex )
+        if(activation == ACTIVE || activation == ACTIVATING) {
+            return;
+        }
+        activation = ACTIVATING;
+    LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
+
+    getLogLog().debug(  LOG4CPLUS_TEXT("Activating appender named [")
+                      + name
+                      + LOG4CPLUS_TEXT("]."));
+    activateResources();
+
+    // append() may release the lock, e.g. while it waits for a write.
+    // Events appended meanwhile are queued behind the buffered ones
+    // and the appender becomes active only once the queue is empty.
+    LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( access_mutex )
+        while(! pendingEvents.empty()) {
+            if(! closed)
+                append(pendingEvents.front());
+            pendingEvents.pop_front();
+        }
+        activation = ACTIVE;
+        if(droppedPendingEvents != 0) {
+            getLogLog().warn(  LOG4CPLUS_TEXT("Appender [")
+                             + name
+                             + LOG4CPLUS_TEXT("] dropped ")
+                             + convertIntegerToString(droppedPendingEvents)
+                             + LOG4CPLUS_TEXT(" events before activation."));
+            droppedPendingEvents = 0;
+        }
+    LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
+}
+
+
+
+void
+Appender::scheduleActivation()
+{
+    LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( access_mutex )
+        if(activation != INACTIVE) {
+            return;
+        }
+        activation = ACTIVATION_SCHEDULED;
+    LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
+
+    postActivation();
+}
+
+
+
+void
+Appender::postActivation()
+{
+    getActivationQueue().post(
+        WorkItemPtr(new ActivationWorkItem(SharedAppenderPtr(this))));
+}
+
+
+
+void
+Appender::appendBatch(const log4cplus::spi::InternalLoggingEvent* events,
+    std::size_t n)
+{
+    for(std::size_t i = 0; i != n; ++i) {
+        append(events[i]);
+    }
+}
+
+
+
+void
+Appender::activateResources()
+{
+}
+
+
+
+bool
+Appender::deferActivation(const Properties& properties)
+{
+    tstring tmp = properties.getProperty(LOG4CPLUS_TEXT("LazyOpen"));
+    if(toLower(tmp) != LOG4CPLUS_TEXT("true")) {
+        return false;
+    }
+
+    if(properties.exists(LOG4CPLUS_TEXT("LazyOpenBufferSize"))) {
+        tmp = properties.getProperty(LOG4CPLUS_TEXT("LazyOpenBufferSize"));
+        long value = std::atol(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        maxPendingEvents = value > 0 ? static_cast<std::size_t>(value) : 0;
+    }
+
+    activation = INACTIVE;
+    return true;
 }
 
 
@@ -250,6 +480,10 @@ Appender::setErrorHandler(std::auto_ptr<ErrorHandler> eh)
 void
 Appender::setLayout(std::auto_ptr<Layout> lo)
 {
+    if(lo.get()) {
+        lo->attach();
+    }
+
     LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( access_mutex )
         this->layout = lo;
     LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
@@ -264,3 +498,15 @@ Appender::getLayout()
 }
 
 
+
+void
+Appender::reopenFiles()
+{ }
+
+
+
+void
+Appender::getFileNames(std::vector<log4cplus::tstring>&)
+{ }
+
+
@@ -171,6 +171,26 @@ AppenderAttachableImpl::appendLoopOnAppenders(const spi::InternalLoggingEvent& e
 }
 
 
+int
+AppenderAttachableImpl::appendBatchLoopOnAppenders(
+    const spi::InternalLoggingEvent* events, std::size_t count) const
+{
+    int appenders = 0;
+
+    LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( appender_list_mutex )
+        for(ListType::const_iterator it=appenderList.begin();
+            it!=appenderList.end();
+            ++it)
+        {
+            ++appenders;
+            (*it)->doAppendBatch(events, count);
+        }
+    LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
+
+    return appenders;
+}
+
+
 } // namespace helpers
 
 
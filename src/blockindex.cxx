@@ -0,0 +1,298 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/helpers/blockindex.h>
+#include <log4cplus/helpers/fileinfo.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <algorithm>
+#include <vector>
+
+
+namespace log4cplus { namespace helpers {
+
+
+tchar const BLOCK_INDEX_SUFFIX[] = LOG4CPLUS_TEXT(".idx");
+
+
+namespace
+{
+
+
+unsigned char const ENTRY_MAGIC[4] = { 'L', 'I', 'X', '1' };
+
+
+struct Crc32Table
+{
+    unsigned long values[256];
+
+    Crc32Table ()
+    {
+        for (unsigned long n = 0; n != 256; ++n)
+        {
+            unsigned long c = n;
+            for (int k = 0; k != 8; ++k)
+                c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+            values[n] = c;
+        }
+    }
+};
+
+
+Crc32Table const crc32_table;
+
+
+void
+put_u32 (unsigned char * p, unsigned long x)
+{
+    p[0] = static_cast<unsigned char>(x & 0xff);
+    p[1] = static_cast<unsigned char>((x >> 8) & 0xff);
+    p[2] = static_cast<unsigned char>((x >> 16) & 0xff);
+    p[3] = static_cast<unsigned char>((x >> 24) & 0xff);
+}
+
+
+unsigned long
+get_u32 (unsigned char const * p)
+{
+    return static_cast<unsigned long>(p[0])
+        | (static_cast<unsigned long>(p[1]) << 8)
+        | (static_cast<unsigned long>(p[2]) << 16)
+        | (static_cast<unsigned long>(p[3]) << 24);
+}
+
+
+} // namespace
+
+
+std::size_t
+blockIndexLevelSlot (LogLevel ll)
+{
+    if (ll < DEBUG_LOG_LEVEL)
+        return 0;
+    else if (ll >= FATAL_LOG_LEVEL)
+        return BLOCK_INDEX_LEVELS - 1;
+    else
+        return static_cast<std::size_t>(ll / 10000);
+}
+
+
+unsigned long
+computeCrc32 (unsigned long crc, void const * data, std::size_t size)
+{
+    unsigned char const * p = static_cast<unsigned char const *>(data);
+    crc = crc ^ 0xffffffffUL;
+    while (size--)
+        crc = crc32_table.values[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffUL;
+}
+
+
+void
+encodeBlockIndexEntry (unsigned char * buf, BlockIndexEntry const & entry)
+{
+    std::copy (ENTRY_MAGIC, ENTRY_MAGIC + 4, buf);
+    put_u32 (buf + 4, entry.length);
+    put_u32 (buf + 8, static_cast<unsigned long>(entry.offset & 0xffffffffUL));
+    put_u32 (buf + 12, static_cast<unsigned long>(
+        (entry.offset >> 16) >> 16));
+    put_u32 (buf + 16, static_cast<unsigned long>(entry.first.sec ()));
+    put_u32 (buf + 20, static_cast<unsigned long>(entry.first.usec ()));
+    put_u32 (buf + 24, static_cast<unsigned long>(entry.last.sec ()));
+    put_u32 (buf + 28, static_cast<unsigned long>(entry.last.usec ()));
+    for (std::size_t i = 0; i != BLOCK_INDEX_LEVELS; ++i)
+        put_u32 (buf + 32 + 4 * i, entry.levels[i]);
+    put_u32 (buf + 56, entry.crc);
+    put_u32 (buf + 60, computeCrc32 (0, buf, 60));
+}
+
+
+bool
+decodeBlockIndexEntry (BlockIndexEntry & entry, unsigned char const * buf)
+{
+    if (! std::equal (ENTRY_MAGIC, ENTRY_MAGIC + 4, buf)
+        || get_u32 (buf + 60) != computeCrc32 (0, buf, 60))
+        return false;
+
+    entry.length = get_u32 (buf + 4);
+    entry.offset = static_cast<std::streamoff>(get_u32 (buf + 8))
+        | ((static_cast<std::streamoff>(get_u32 (buf + 12)) << 16) << 16);
+    entry.first = Time (static_cast<time_t>(get_u32 (buf + 16)),
+        static_cast<long>(get_u32 (buf + 20)));
+    entry.last = Time (static_cast<time_t>(get_u32 (buf + 24)),
+        static_cast<long>(get_u32 (buf + 28)));
+    for (std::size_t i = 0; i != BLOCK_INDEX_LEVELS; ++i)
+        entry.levels[i] = get_u32 (buf + 32 + 4 * i);
+    entry.crc = get_u32 (buf + 56);
+    return true;
+}
+
+
+//
+//
+//
+
+BlockIndexWriter::BlockIndexWriter ()
+    : blockSize (0)
+    , blockStart (0)
+    , crc (0)
+{
+    resetBlock ();
+}
+
+
+BlockIndexWriter::~BlockIndexWriter ()
+{
+    close ();
+}
+
+
+void
+BlockIndexWriter::setBlockSize (std::streamoff size)
+{
+    blockSize = size < 0 ? 0 : size;
+}
+
+
+void
+BlockIndexWriter::resetBlock ()
+{
+    crc = 0;
+    events = 0;
+    first = last = Time ();
+    std::fill (levels, levels + BLOCK_INDEX_LEVELS, 0);
+}
+
+
+void
+BlockIndexWriter::addData (tstring const & text)
+{
+    std::string const & bytes = LOG4CPLUS_TSTRING_TO_STRING (text);
+    crc = computeCrc32 (crc, bytes.data (), bytes.size ());
+}
+
+
+void
+BlockIndexWriter::open (tstring const & dataFile)
+{
+    close ();
+    if (! blockSize)
+        return;
+
+    std::string const index_name (LOG4CPLUS_TSTRING_TO_STRING (dataFile)
+        + LOG4CPLUS_TSTRING_TO_STRING (tstring (BLOCK_INDEX_SUFFIX)));
+
+    FileInfo fi;
+    if (getFileInfo (&fi, dataFile) != 0)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("BlockIndexWriter::open()-")
+            LOG4CPLUS_TEXT (" Failed to open ") + dataFile);
+        return;
+    }
+
+    // Keep intact entries of existing index; entries torn by a crash
+    // and entries that do not fit the data are dropped. Entries may
+    // leave out data that has not been indexed before a crash.
+    std::streamoff const data_size = fi.size;
+    std::vector<unsigned char> kept;
+    blockStart = 0;
+    {
+        std::ifstream existing (index_name.c_str (),
+            std::ios::in | std::ios::binary);
+        unsigned char buf[BLOCK_INDEX_ENTRY_SIZE];
+        BlockIndexEntry entry;
+        while (existing.read (reinterpret_cast<char *>(buf), sizeof (buf))
+            && decodeBlockIndexEntry (entry, buf)
+            && entry.offset >= blockStart
+            && entry.offset + static_cast<std::streamoff>(entry.length)
+                <= data_size)
+        {
+            kept.insert (kept.end (), buf, buf + sizeof (buf));
+            blockStart = entry.offset + entry.length;
+        }
+    }
+
+    index.open (index_name.c_str (), std::ios::out | std::ios::trunc
+        | std::ios::binary);
+    if (! kept.empty ())
+        index.write (reinterpret_cast<char const *>(&kept[0]),
+            static_cast<std::streamsize>(kept.size ()));
+    if (! index)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("BlockIndexWriter::open()-")
+            LOG4CPLUS_TEXT (" Failed to open index of ") + dataFile);
+        index.close ();
+        return;
+    }
+
+    // Reading unindexed data to compute its CRC could take long, so
+    // it is left out.
+    dataName = dataFile;
+    blockStart = data_size;
+    resetBlock ();
+}
+
+
+void
+BlockIndexWriter::endBlock (std::streamoff pos)
+{
+    if (! index.is_open () || pos <= blockStart)
+        return;
+
+    BlockIndexEntry entry;
+    entry.offset = blockStart;
+    entry.length = static_cast<unsigned long>(pos - blockStart);
+    entry.first = first;
+    entry.last = last;
+    std::copy (levels, levels + BLOCK_INDEX_LEVELS, entry.levels);
+    entry.crc = crc;
+
+    unsigned char out[BLOCK_INDEX_ENTRY_SIZE];
+    encodeBlockIndexEntry (out, entry);
+    index.write (reinterpret_cast<char const *>(out), sizeof (out));
+    index.flush ();
+
+    blockStart = pos;
+    resetBlock ();
+}
+
+
+void
+BlockIndexWriter::close ()
+{
+    if (! index.is_open ())
+        return;
+
+    FileInfo fi;
+    if (getFileInfo (&fi, dataName) == 0)
+        endBlock (fi.size);
+
+    index.close ();
+    blockStart = 0;
+    resetBlock ();
+}
+
+
+} } // namespace log4cplus { namespace helpers {
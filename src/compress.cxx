@@ -0,0 +1,674 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <log4cplus/helpers/compress.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/thread/syncprims.h>
+#include <log4cplus/streams.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined (LOG4CPLUS_HAVE_LZ4)
+#include <lz4frame.h>
+#endif
+
+
+namespace log4cplus { namespace helpers {
+
+
+namespace
+{
+
+
+std::size_t const CHUNK_SIZE = 64 * 1024;
+
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+//! Limits number of compressions running at the same time.
+class CompressionGate
+{
+public:
+    CompressionGate ()
+        : max_running (1)
+        , running (0)
+        , ev (true)
+    { }
+
+    void
+    setMax (unsigned limit)
+    {
+        thread::MutexGuard guard (mtx);
+        max_running = limit == 0 ? 1 : limit;
+        ev.signal ();
+    }
+
+    void
+    lock () const
+    {
+        while (true)
+        {
+            {
+                thread::MutexGuard guard (mtx);
+                if (running < max_running)
+                {
+                    ++running;
+                    return;
+                }
+
+                ev.reset ();
+            }
+
+            ev.wait ();
+        }
+    }
+
+    void
+    unlock () const
+    {
+        thread::MutexGuard guard (mtx);
+        --running;
+        ev.signal ();
+    }
+
+private:
+    thread::Mutex mtx;
+    unsigned max_running;
+    mutable unsigned running;
+    thread::ManualResetEvent ev;
+};
+
+
+CompressionGate &
+get_gate ()
+{
+    static CompressionGate gate;
+    return gate;
+}
+
+#endif
+
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+static
+bool
+gzip_compress (std::FILE * in, tstring const & target)
+{
+    gzFile out = gzopen (LOG4CPLUS_TSTRING_TO_STRING (target).c_str (),
+        "wb6");
+    if (! out)
+        return false;
+
+    std::vector<char> buf (CHUNK_SIZE);
+    bool ok = true;
+    std::size_t n;
+    while (ok && (n = std::fread (&buf[0], 1, buf.size (), in)) != 0)
+        ok = gzwrite (out, &buf[0], static_cast<unsigned>(n))
+            == static_cast<int>(n);
+
+    ok = ok && ! std::ferror (in);
+    return (gzclose (out) == Z_OK) && ok;
+}
+
+#endif
+
+
+#if defined (LOG4CPLUS_HAVE_LZ4)
+static
+bool
+write_all (std::FILE * out, char const * data, std::size_t size)
+{
+    return std::fwrite (data, 1, size, out) == size;
+}
+
+
+static
+bool
+lz4_compress (std::FILE * in, tstring const & target)
+{
+    std::FILE * out = std::fopen (
+        LOG4CPLUS_TSTRING_TO_STRING (target).c_str (), "wb");
+    if (! out)
+        return false;
+
+    LZ4F_compressionContext_t ctx;
+    if (LZ4F_isError (LZ4F_createCompressionContext (&ctx, LZ4F_VERSION)))
+    {
+        std::fclose (out);
+        return false;
+    }
+
+    LZ4F_preferences_t prefs;
+    std::memset (&prefs, 0, sizeof (prefs));
+    prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+    std::vector<char> inbuf (CHUNK_SIZE);
+    std::vector<char> outbuf (LZ4F_compressBound (CHUNK_SIZE, &prefs)
+        + LZ4F_HEADER_SIZE_MAX);
+
+    std::size_t ret = LZ4F_compressBegin (ctx, &outbuf[0], outbuf.size (),
+        &prefs);
+    bool ok = ! LZ4F_isError (ret) && write_all (out, &outbuf[0], ret);
+
+    std::size_t n;
+    while (ok && (n = std::fread (&inbuf[0], 1, inbuf.size (), in)) != 0)
+    {
+        ret = LZ4F_compressUpdate (ctx, &outbuf[0], outbuf.size (),
+            &inbuf[0], n, 0);
+        ok = ! LZ4F_isError (ret) && write_all (out, &outbuf[0], ret);
+    }
+
+    ok = ok && ! std::ferror (in);
+    if (ok)
+    {
+        ret = LZ4F_compressEnd (ctx, &outbuf[0], outbuf.size (), 0);
+        ok = ! LZ4F_isError (ret) && write_all (out, &outbuf[0], ret);
+    }
+
+    LZ4F_freeCompressionContext (ctx);
+    return (std::fclose (out) == 0) && ok;
+}
+
+#endif
+
+
+// Gzip header with FEXTRA flag and a single "LF" subfield with
+// frame size and timestamps, see CompressedFrameInfo.
+unsigned char const GZIP_ID1 = 0x1f;
+unsigned char const GZIP_ID2 = 0x8b;
+unsigned char const GZIP_CM_DEFLATE = 8;
+unsigned char const GZIP_FLG_FEXTRA = 4;
+unsigned char const GZIP_OS_UNKNOWN = 255;
+unsigned char const FRAME_SI1 = 'L';
+unsigned char const FRAME_SI2 = 'F';
+std::size_t const FRAME_SUBFIELD_LEN = 20;
+std::size_t const FRAME_XLEN = 4 + FRAME_SUBFIELD_LEN;
+std::size_t const GZIP_TRAILER_SIZE = 8;
+
+
+static
+void
+put_u16 (unsigned char * p, unsigned long x)
+{
+    p[0] = static_cast<unsigned char>(x & 0xff);
+    p[1] = static_cast<unsigned char>((x >> 8) & 0xff);
+}
+
+
+static
+void
+put_u32 (unsigned char * p, unsigned long x)
+{
+    put_u16 (p, x & 0xffff);
+    put_u16 (p + 2, (x >> 16) & 0xffff);
+}
+
+
+static
+unsigned long
+get_u16 (unsigned char const * p)
+{
+    return p[0] | (static_cast<unsigned long>(p[1]) << 8);
+}
+
+
+static
+unsigned long
+get_u32 (unsigned char const * p)
+{
+    return get_u16 (p) | (get_u16 (p + 2) << 16);
+}
+
+
+} // namespace
+
+
+CompressionCodec
+parseCompressionCodec (tstring const & name)
+{
+    tstring const lname (toLower (name));
+    CompressionCodec codec;
+    if (lname.empty () || lname == LOG4CPLUS_TEXT ("none"))
+        return NO_COMPRESSION;
+    else if (lname == LOG4CPLUS_TEXT ("gzip")
+        || lname == LOG4CPLUS_TEXT ("gz"))
+        codec = GZIP_COMPRESSION;
+    else if (lname == LOG4CPLUS_TEXT ("lz4"))
+        codec = LZ4_COMPRESSION;
+    else
+    {
+        getLogLog ().warn (LOG4CPLUS_TEXT ("Unknown compression codec: ")
+            + name);
+        return NO_COMPRESSION;
+    }
+
+    if (! isCompressionCodecAvailable (codec))
+    {
+        getLogLog ().warn (LOG4CPLUS_TEXT ("Compression codec ") + name
+            + LOG4CPLUS_TEXT (" is not available in this build."));
+        return NO_COMPRESSION;
+    }
+
+    return codec;
+}
+
+
+bool
+isCompressionCodecAvailable (CompressionCodec codec)
+{
+    switch (codec)
+    {
+    case NO_COMPRESSION:
+        return true;
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    case GZIP_COMPRESSION:
+        return true;
+#endif
+
+#if defined (LOG4CPLUS_HAVE_LZ4)
+    case LZ4_COMPRESSION:
+        return true;
+#endif
+
+    default:
+        return false;
+    }
+}
+
+
+tstring
+compressedFileSuffix (CompressionCodec codec)
+{
+    switch (codec)
+    {
+    case GZIP_COMPRESSION:
+        return LOG4CPLUS_TEXT (".gz");
+
+    case LZ4_COMPRESSION:
+        return LOG4CPLUS_TEXT (".lz4");
+
+    default:
+        return tstring ();
+    }
+}
+
+
+void
+setMaxConcurrentCompressions (unsigned limit)
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    get_gate ().setMax (limit);
+#endif
+}
+
+
+bool
+compressFile (tstring const & src, tstring const & target,
+    CompressionCodec codec)
+{
+    if (! isCompressionCodecAvailable (codec) || codec == NO_COMPRESSION)
+        return false;
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    thread::SyncGuard<CompressionGate> guard (get_gate ());
+#endif
+
+    std::FILE * in = std::fopen (LOG4CPLUS_TSTRING_TO_STRING (src).c_str (),
+        "rb");
+    if (! in)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("compressFile()- Failed to open ")
+            + src);
+        return false;
+    }
+
+    bool ok = false;
+    switch (codec)
+    {
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    case GZIP_COMPRESSION:
+        ok = gzip_compress (in, target);
+        break;
+#endif
+
+#if defined (LOG4CPLUS_HAVE_LZ4)
+    case LZ4_COMPRESSION:
+        ok = lz4_compress (in, target);
+        break;
+#endif
+
+    default:
+        break;
+    }
+
+    std::fclose (in);
+
+    if (ok)
+        getLogLog ().debug (LOG4CPLUS_TEXT ("Compressed file ") + src
+            + LOG4CPLUS_TEXT (" to ") + target);
+    else
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("compressFile()- Failed to")
+            LOG4CPLUS_TEXT (" compress ") + src + LOG4CPLUS_TEXT (" to ")
+            + target);
+        std::remove (LOG4CPLUS_TSTRING_TO_STRING (target).c_str ());
+    }
+
+    return ok;
+}
+
+
+bool
+parseCompressedFrameHeader (CompressedFrameInfo & info,
+    unsigned char const * data, std::size_t size)
+{
+    if (size < COMPRESSED_FRAME_HEADER_SIZE
+        || data[0] != GZIP_ID1
+        || data[1] != GZIP_ID2
+        || data[2] != GZIP_CM_DEFLATE
+        || data[3] != GZIP_FLG_FEXTRA
+        || get_u16 (data + 10) != FRAME_XLEN
+        || data[12] != FRAME_SI1
+        || data[13] != FRAME_SI2
+        || get_u16 (data + 14) != FRAME_SUBFIELD_LEN)
+        return false;
+
+    info.size = get_u32 (data + 16);
+    info.first = Time (static_cast<time_t>(get_u32 (data + 20)),
+        static_cast<long>(get_u32 (data + 24)));
+    info.last = Time (static_cast<time_t>(get_u32 (data + 28)),
+        static_cast<long>(get_u32 (data + 32)));
+
+    return info.size >= COMPRESSED_FRAME_HEADER_SIZE + GZIP_TRAILER_SIZE;
+}
+
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+bool
+encodeCompressedFrame (std::string & out, std::string const & data,
+    Time const & first, Time const & last, int level)
+{
+    z_stream zs;
+    std::memset (&zs, 0, sizeof (zs));
+    // Raw deflate, the gzip header and trailer are written here.
+    if (deflateInit2 (&zs, level, Z_DEFLATED, -MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    uLong const bound = deflateBound (&zs, static_cast<uLong>(data.size ()));
+    std::vector<unsigned char> buf (COMPRESSED_FRAME_HEADER_SIZE + bound
+        + GZIP_TRAILER_SIZE);
+
+    zs.next_in = reinterpret_cast<Bytef *>(
+        const_cast<char *>(data.data ()));
+    zs.avail_in = static_cast<uInt>(data.size ());
+    zs.next_out = &buf[COMPRESSED_FRAME_HEADER_SIZE];
+    zs.avail_out = static_cast<uInt>(bound);
+    int const ret = deflate (&zs, Z_FINISH);
+    std::size_t const deflated = bound - zs.avail_out;
+    deflateEnd (&zs);
+    if (ret != Z_STREAM_END)
+        return false;
+
+    std::size_t const size = COMPRESSED_FRAME_HEADER_SIZE + deflated
+        + GZIP_TRAILER_SIZE;
+    unsigned char * p = &buf[0];
+    p[0] = GZIP_ID1;
+    p[1] = GZIP_ID2;
+    p[2] = GZIP_CM_DEFLATE;
+    p[3] = GZIP_FLG_FEXTRA;
+    put_u32 (p + 4, static_cast<unsigned long>(first.sec ()));
+    p[8] = 0;
+    p[9] = GZIP_OS_UNKNOWN;
+    put_u16 (p + 10, FRAME_XLEN);
+    p[12] = FRAME_SI1;
+    p[13] = FRAME_SI2;
+    put_u16 (p + 14, FRAME_SUBFIELD_LEN);
+    put_u32 (p + 16, static_cast<unsigned long>(size));
+    put_u32 (p + 20, static_cast<unsigned long>(first.sec ()));
+    put_u32 (p + 24, static_cast<unsigned long>(first.usec ()));
+    put_u32 (p + 28, static_cast<unsigned long>(last.sec ()));
+    put_u32 (p + 32, static_cast<unsigned long>(last.usec ()));
+
+    p += COMPRESSED_FRAME_HEADER_SIZE + deflated;
+    put_u32 (p, crc32 (crc32 (0, Z_NULL, 0),
+        reinterpret_cast<Bytef const *>(data.data ()),
+        static_cast<uInt>(data.size ())));
+    put_u32 (p + 4, static_cast<unsigned long>(data.size () & 0xffffffffUL));
+
+    out.append (reinterpret_cast<char const *>(&buf[0]), size);
+    return true;
+}
+
+
+bool
+decodeCompressedFrame (std::string & out, unsigned char const * frame,
+    std::size_t size)
+{
+    z_stream zs;
+    std::memset (&zs, 0, sizeof (zs));
+    // Let zlib parse and verify the gzip header and trailer.
+    if (inflateInit2 (&zs, 16 + MAX_WBITS) != Z_OK)
+        return false;
+
+    zs.next_in = const_cast<Bytef *>(frame);
+    zs.avail_in = static_cast<uInt>(size);
+
+    std::vector<char> buf (CHUNK_SIZE);
+    int ret;
+    do
+    {
+        zs.next_out = reinterpret_cast<Bytef *>(&buf[0]);
+        zs.avail_out = static_cast<uInt>(buf.size ());
+        ret = inflate (&zs, Z_NO_FLUSH);
+        out.append (&buf[0], buf.size () - zs.avail_out);
+    }
+    while (ret == Z_OK);
+
+    inflateEnd (&zs);
+    return ret == Z_STREAM_END;
+}
+
+#endif
+
+
+//
+// StreamCompressor
+//
+
+StreamCompressor::StreamCompressor (int level)
+    : stream (0)
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    z_stream * zs = new z_stream;
+    std::memset (zs, 0, sizeof (*zs));
+    if (deflateInit2 (zs, level, Z_DEFLATED, -MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        getLogLog ().error (
+            LOG4CPLUS_TEXT ("StreamCompressor- deflateInit2() failed"));
+        delete zs;
+        return;
+    }
+    stream = zs;
+
+#else
+    (void) level;
+
+#endif
+}
+
+
+StreamCompressor::~StreamCompressor ()
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (stream)
+    {
+        z_stream * zs = static_cast<z_stream *>(stream);
+        deflateEnd (zs);
+        delete zs;
+    }
+#endif
+}
+
+
+void
+StreamCompressor::reset ()
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (stream)
+        deflateReset (static_cast<z_stream *>(stream));
+#endif
+}
+
+
+std::size_t
+StreamCompressor::getBound (std::size_t size)
+{
+    // Stored blocks of incompressible data take 5 bytes per 16 KB
+    // block, the sync flush adds an empty stored block.
+    return size + size / 1024 + 64;
+}
+
+
+bool
+StreamCompressor::compress (SocketBuffer const & in, SocketBuffer & out)
+{
+    out.clear ();
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (! stream)
+        return false;
+
+    z_stream * zs = static_cast<z_stream *>(stream);
+    zs->next_in = reinterpret_cast<Bytef *>(
+        const_cast<char *>(in.getBuffer ()));
+    zs->avail_in = static_cast<uInt>(in.getSize ());
+    zs->next_out = reinterpret_cast<Bytef *>(out.getBuffer ());
+    zs->avail_out = static_cast<uInt>(out.getMaxSize ());
+
+    // The whole input has been flushed only if some output space
+    // is left.
+    int const ret = deflate (zs, Z_SYNC_FLUSH);
+    if ((ret != Z_OK && ret != Z_BUF_ERROR) || zs->avail_out == 0)
+        return false;
+
+    out.setSize (out.getMaxSize () - zs->avail_out);
+    return true;
+
+#else
+    (void) in;
+    return false;
+
+#endif
+}
+
+
+//
+// StreamDecompressor
+//
+
+StreamDecompressor::StreamDecompressor ()
+    : stream (0)
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    z_stream * zs = new z_stream;
+    std::memset (zs, 0, sizeof (*zs));
+    if (inflateInit2 (zs, -MAX_WBITS) != Z_OK)
+    {
+        getLogLog ().error (
+            LOG4CPLUS_TEXT ("StreamDecompressor- inflateInit2() failed"));
+        delete zs;
+        return;
+    }
+    stream = zs;
+#endif
+}
+
+
+StreamDecompressor::~StreamDecompressor ()
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (stream)
+    {
+        z_stream * zs = static_cast<z_stream *>(stream);
+        inflateEnd (zs);
+        delete zs;
+    }
+#endif
+}
+
+
+void
+StreamDecompressor::reset ()
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (stream)
+        inflateReset (static_cast<z_stream *>(stream));
+#endif
+}
+
+
+long
+StreamDecompressor::decompress (char const * & data, std::size_t & size,
+    char * out, std::size_t outSize)
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (! stream)
+        return -1;
+
+    z_stream * zs = static_cast<z_stream *>(stream);
+    zs->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    zs->avail_in = static_cast<uInt>(size);
+    zs->next_out = reinterpret_cast<Bytef *>(out);
+    zs->avail_out = static_cast<uInt>(outSize);
+
+    // The stream is never finished by the sender, Z_STREAM_END
+    // means the peer is not StreamCompressor.
+    int const ret = inflate (zs, Z_SYNC_FLUSH);
+    if (ret != Z_OK && ret != Z_BUF_ERROR)
+        return -1;
+
+    data += size - zs->avail_in;
+    size = zs->avail_in;
+    return static_cast<long>(outSize - zs->avail_out);
+
+#else
+    (void) data;
+    (void) size;
+    (void) out;
+    (void) outSize;
+    return -1;
+
+#endif
+}
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -0,0 +1,222 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <log4cplus/compressedfileappender.h>
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+
+#include <log4cplus/layout.h>
+#include <log4cplus/streams.h>
+#include <log4cplus/helpers/compress.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <cstdlib>
+
+
+namespace log4cplus
+{
+
+using helpers::Properties;
+using helpers::Time;
+
+
+CompressedFileAppender::CompressedFileAppender(const tstring& filename_,
+    unsigned long frameSize_, unsigned long frameInterval_, bool append_)
+    : filename (filename_)
+    , frameSize (frameSize_)
+    , frameInterval (frameInterval_)
+    , compressionLevel (6)
+    , immediateFlush (true)
+{
+    init (append_);
+}
+
+
+CompressedFileAppender::CompressedFileAppender(const Properties& properties)
+    : Appender(properties)
+    , frameSize (1024 * 1024)
+    , frameInterval (0)
+    , compressionLevel (6)
+    , immediateFlush (true)
+{
+    bool append_ = false;
+    filename = properties.getProperty( LOG4CPLUS_TEXT("File") );
+    if (filename.empty())
+    {
+        getErrorHandler()->error( LOG4CPLUS_TEXT("Invalid filename") );
+        return;
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("Append") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("Append") );
+        append_ = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("ImmediateFlush") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("ImmediateFlush") );
+        immediateFlush = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("FrameSize") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("FrameSize") );
+        frameSize = static_cast<unsigned long>(helpers::parseFileSize(tmp));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("FrameInterval") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("FrameInterval") );
+        frameInterval = std::strtoul(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str(), 0, 10);
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("CompressionLevel") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("CompressionLevel") );
+        compressionLevel = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+    }
+
+    init (append_);
+}
+
+
+void
+CompressedFileAppender::init(bool append_)
+{
+    if (compressionLevel < 1 || compressionLevel > 9)
+    {
+        helpers::getLogLog ().warn (
+            LOG4CPLUS_TEXT ("CompressedFileAppender: CompressionLevel")
+            LOG4CPLUS_TEXT (" out of range. Resetting to 6."));
+        compressionLevel = 6;
+    }
+
+    if (frameSize == 0)
+        frameSize = 1;
+
+    frame.reserve (frameSize);
+
+    std::ios::openmode mode = std::ios::out | std::ios::binary
+        | (append_ ? std::ios::app : std::ios::trunc);
+    out.open (LOG4CPLUS_TSTRING_TO_STRING (filename).c_str (), mode);
+    if (! out)
+        getErrorHandler ()->error (LOG4CPLUS_TEXT ("Unable to open file: ")
+            + filename);
+    else
+        helpers::getLogLog ().debug (LOG4CPLUS_TEXT ("Just opened file: ")
+            + filename);
+}
+
+
+CompressedFileAppender::~CompressedFileAppender()
+{
+    destructorImpl();
+}
+
+
+void
+CompressedFileAppender::close()
+{
+    log4cplus::thread::MutexGuard guard (access_mutex);
+
+    writeFrame ();
+    out.close ();
+    closed = true;
+}
+
+
+void
+CompressedFileAppender::reopenFiles()
+{
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    if (closed)
+        return;
+
+    writeFrame ();
+    out.close ();
+    out.clear ();
+    out.open (LOG4CPLUS_TSTRING_TO_STRING (filename).c_str (),
+        std::ios::out | std::ios::binary | std::ios::app);
+    if (! out)
+        getErrorHandler ()->error (LOG4CPLUS_TEXT ("Unable to reopen file: ")
+            + filename);
+    else
+        helpers::getLogLog ().debug (LOG4CPLUS_TEXT ("Reopened file: ")
+            + filename);
+}
+
+
+void
+CompressedFileAppender::getFileNames(std::vector<tstring>& names)
+{
+    names.push_back (filename);
+}
+
+
+// This method does not need to be locked since it is called by
+// doAppend() which performs the locking
+void
+CompressedFileAppender::append(const spi::InternalLoggingEvent& event)
+{
+    if (! out)
+    {
+        getErrorHandler ()->error (LOG4CPLUS_TEXT ("file is not open: ")
+            + filename);
+        return;
+    }
+
+
+    if (frame.empty ())
+        frameFirst = event.getTimestamp ();
+    frameLast = event.getTimestamp ();
+    frame += LOG4CPLUS_TSTRING_TO_STRING (layout->formatText (event));
+
+    if (frame.size () >= frameSize
+        || (frameInterval != 0
+            && frameLast - frameFirst >= Time (
+                static_cast<time_t>(frameInterval), 0)))
+        writeFrame ();
+}
+
+
+void
+CompressedFileAppender::writeFrame()
+{
+    if (frame.empty ())
+        return;
+
+    std::string compressed;
+    if (! helpers::encodeCompressedFrame (compressed, frame, frameFirst,
+            frameLast, compressionLevel))
+    {
+        getErrorHandler ()->error (
+            LOG4CPLUS_TEXT ("Failed to compress frame for file: ")
+            + filename);
+        frame.clear ();
+        return;
+    }
+
+    frame.clear ();
+    out.write (compressed.data (),
+        static_cast<std::streamsize>(compressed.size ()));
+    if (immediateFlush)
+        out.flush ();
+}
+
+
+} // namespace log4cplus
+
+#endif // defined (LOG4CPLUS_HAVE_ZLIB)
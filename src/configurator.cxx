@@ -24,6 +24,7 @@
 #include <log4cplus/helpers/sleep.h>
 #include <log4cplus/helpers/stringhelper.h>
 #include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/fileinfo.h>
 #include <log4cplus/thread/syncprims.h>
 #include <log4cplus/helpers/timehelper.h>
 #include <log4cplus/spi/factory.h>
@@ -92,64 +93,6 @@ namespace
     }
 
 
-    struct file_info
-    {
-        Time mtime;
-        bool is_link;
-    };
-
-
-    static
-    int
-    get_file_info (file_info * fi, tstring const & name)
-    {
-#if defined (_WIN32_WCE)
-        WIN32_FILE_ATTRIBUTE_DATA fad;
-        BOOL ret = GetFileAttributesEx (name.c_str (), GetFileExInfoStandard, &fad);
-        if (! ret)
-            return -1;
-
-        SYSTEMTIME systime;
-        ret = FileTimeToSystemTime (&fad.ftLastWriteTime, &systime);
-        if (! ret)
-            return -1;
-
-        helpers::tm tm;
-        tm.tm_isdst = 0;
-        tm.tm_yday = 0;
-        tm.tm_wday = systime.wDayOfWeek;
-        tm.tm_year = systime.wYear - 1900;
-        tm.tm_mon = systime.wMonth - 1;
-        tm.tm_mday = systime.wDay;
-        tm.tm_hour = systime.wHour;
-        tm.tm_min = systime.wMinute;
-        tm.tm_sec = systime.wSecond;
-
-        fi->mtime.setTime (&tm);
-        fi->is_link = false;
-
-#elif defined (_WIN32)
-        struct _stat fileStatus;
-        if (_tstat (name.c_str (), &fileStatus) == -1)
-            return -1;
-        
-        fi->mtime = Time (fileStatus.st_mtime);
-        fi->is_link = false;
-
-#else
-        struct stat fileStatus;
-        if (stat (LOG4CPLUS_TSTRING_TO_STRING (name).c_str (),
-                &fileStatus) == -1)
-            return -1;
-        fi->mtime = Time (fileStatus.st_mtime);
-        fi->is_link = S_ISLNK (fileStatus.st_mode);
-
-#endif
-
-        return 0;
-    }
-
-
     /**
      * Perform variable substitution in string <code>val</code> from
      * environment variables.
@@ -559,6 +502,10 @@ PropertyConfigurator::configureAppenders()
                 {
                     appender->setName(*it);
                     appenders[*it] = appender;
+
+                    // Appenders with LazyOpen connect and open their
+                    // files in parallel, in the background.
+                    appender->scheduleActivation();
                 }
             }
             catch(std::exception& e)
@@ -748,9 +695,9 @@ ConfigurationWatchDogThread::addAppender(Logger& logger,
 bool
 ConfigurationWatchDogThread::checkForFileModification(Time & mtime)
 {
-    file_info fi;
+    FileInfo fi;
 
-    if (get_file_info (&fi, propertyFilename.c_str ()) != 0)
+    if (getFileInfo (&fi, propertyFilename) != 0)
         return false;
 
     mtime = fi.mtime;
@@ -92,7 +92,7 @@ log4cplus::ConsoleAppender::append(const spi::InternalLoggingEvent& event)
     thread::MutexGuard guard (helpers::getLogLog().mutex);
 
     log4cplus::tostream& output = (logToStdErr ? tcerr : tcout);
-    layout->formatAndAppend(output, event);
+    output << layout->formatText(event);
     if(immediateFlush)
         output.flush();
 }
@@ -0,0 +1,326 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <log4cplus/datagramappender.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <algorithm>
+#include <cstdlib>
+
+
+namespace log4cplus
+{
+
+namespace
+{
+
+//! Largest UDP payload over IPv4.
+std::size_t const MAX_DATAGRAM_SIZE = 65507;
+
+int const DATAGRAM_MESSAGE_VERSION = 2;
+
+
+} // namespace
+
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+DatagramAppender::SenderThread::SenderThread (DatagramAppender & appender)
+    : da (appender)
+    , trigger_ev (false)
+    , exit_flag (false)
+{ }
+
+
+DatagramAppender::SenderThread::~SenderThread ()
+{ }
+
+
+void
+DatagramAppender::SenderThread::run ()
+{
+    while (true)
+    {
+        // Triggers that come after this are not lost.
+        trigger_ev.reset ();
+
+        bool exiting;
+        {
+            log4cplus::thread::MutexGuard guard (access_mutex);
+            exiting = exit_flag;
+        }
+
+        {
+            log4cplus::thread::MutexGuard guard (da.access_mutex);
+            std::swap (da.pendingQueue, da.sendingQueue);
+            da.pendingSizes.swap (da.sendingSizes);
+            da.pendingEvents.swap (da.sendingEvents);
+        }
+
+        if (! da.sendingSizes.empty ())
+            da.sendQueue ();
+        else if (exiting)
+            return;
+        else
+            trigger_ev.wait ();
+    }
+}
+
+
+void
+DatagramAppender::SenderThread::terminate ()
+{
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        if (exit_flag)
+            return;
+        exit_flag = true;
+        trigger_ev.signal ();
+    }
+    join ();
+}
+
+
+void
+DatagramAppender::SenderThread::trigger ()
+{
+    trigger_ev.signal ();
+}
+
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DatagramAppender ctors and dtor
+//////////////////////////////////////////////////////////////////////////////
+
+DatagramAppender::DatagramAppender(const tstring& host, int port,
+    const tstring& serverName_)
+: socket(host, static_cast<unsigned short>(port)),
+  serverName(serverName_),
+  mtu(LOG4CPLUS_DATAGRAM_MTU),
+  protocolVersion(DATAGRAM_MESSAGE_VERSION),
+  eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int)),
+  encoder(false),
+  pendingQueue(0),
+  sendingQueue(0),
+  droppedEvents(0)
+{
+    init(256 * 1024);
+}
+
+
+DatagramAppender::DatagramAppender(const helpers::Properties & properties)
+ : Appender(properties),
+   mtu(LOG4CPLUS_DATAGRAM_MTU),
+   protocolVersion(DATAGRAM_MESSAGE_VERSION),
+   eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int)),
+   encoder(false),
+   pendingQueue(0),
+   sendingQueue(0),
+   droppedEvents(0)
+{
+    tstring const host = properties.getProperty( LOG4CPLUS_TEXT("host") );
+    int port = 9998;
+    if(properties.exists( LOG4CPLUS_TEXT("port") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("port") );
+        port = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+    }
+    serverName = properties.getProperty( LOG4CPLUS_TEXT("ServerName") );
+
+    if(properties.exists( LOG4CPLUS_TEXT("MTU") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("MTU") );
+        mtu = std::strtoul(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str(), 0, 10);
+        mtu = (std::min) ((std::max) (mtu, std::size_t (64)),
+            MAX_DATAGRAM_SIZE);
+    }
+
+    if(properties.exists( LOG4CPLUS_TEXT("ProtocolVersion") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("ProtocolVersion") );
+        protocolVersion = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        if (protocolVersion != DATAGRAM_MESSAGE_VERSION
+            && protocolVersion != helpers::MESSAGE_VERSION_3)
+        {
+            getLogLog().warn(LOG4CPLUS_TEXT("DatagramAppender- Unknown")
+                LOG4CPLUS_TEXT(" \"ProtocolVersion\" ") + tmp);
+            protocolVersion = DATAGRAM_MESSAGE_VERSION;
+        }
+    }
+
+    std::size_t queueSize = 256 * 1024;
+    if(properties.exists( LOG4CPLUS_TEXT("QueueSize") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("QueueSize") );
+        queueSize = static_cast<std::size_t>(helpers::parseFileSize(tmp));
+    }
+
+    socket = helpers::DatagramSocket(host, static_cast<unsigned short>(port));
+    init(queueSize);
+}
+
+
+DatagramAppender::~DatagramAppender()
+{
+    destructorImpl();
+    delete pendingQueue;
+    delete sendingQueue;
+}
+
+
+void
+DatagramAppender::init(std::size_t queueSize)
+{
+    if (! socket.isOpen())
+        getLogLog().error(LOG4CPLUS_TEXT("DatagramAppender- Cannot open")
+            LOG4CPLUS_TEXT(" socket, events will be dropped"));
+
+    queueSize = (std::max) (queueSize, mtu);
+    pendingQueue = new helpers::SocketBuffer(queueSize);
+    sendingQueue = new helpers::SocketBuffer(queueSize);
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    sender = new SenderThread(*this);
+    sender->start();
+#endif
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DatagramAppender public methods
+//////////////////////////////////////////////////////////////////////////////
+
+void
+DatagramAppender::close()
+{
+    getLogLog().debug(LOG4CPLUS_TEXT("Entering DatagramAppender::close()..."));
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (sender.get ())
+        sender->terminate ();
+#endif
+
+    socket.close();
+    closed = true;
+}
+
+
+unsigned long
+DatagramAppender::getDroppedEvents() const
+{
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    return droppedEvents;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DatagramAppender protected methods
+//////////////////////////////////////////////////////////////////////////////
+
+void
+DatagramAppender::append(const spi::InternalLoggingEvent& event)
+{
+    std::size_t size;
+    if (protocolVersion == helpers::MESSAGE_VERSION_3)
+    {
+        eventFrames.clear();
+        encoder.encode(eventFrames, event, serverName);
+        size = eventFrames.size();
+    }
+    else
+    {
+        eventBuffer.clear();
+        helpers::convertToBuffer(eventBuffer, event, serverName);
+        size = sizeof(unsigned int) + eventBuffer.getSize();
+    }
+
+    if (size > mtu
+        || pendingQueue->getSize() + size > pendingQueue->getMaxSize())
+    {
+        ++droppedEvents;
+        return;
+    }
+
+    // Add to the last datagram if it has room, or start a new one.
+    bool const wasEmpty = pendingSizes.empty();
+    if (! wasEmpty && pendingSizes.back() + size <= mtu)
+    {
+        pendingSizes.back() += size;
+        ++pendingEvents.back();
+    }
+    else
+    {
+        pendingSizes.push_back(size);
+        pendingEvents.push_back(1);
+    }
+
+    if (protocolVersion == helpers::MESSAGE_VERSION_3)
+        pendingQueue->appendBytes(&eventFrames[0], size);
+    else
+    {
+        pendingQueue->appendInt(static_cast<unsigned>(eventBuffer.getSize()));
+        pendingQueue->appendBuffer(eventBuffer);
+    }
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (wasEmpty)
+        sender->trigger ();
+
+#else
+    std::swap (pendingQueue, sendingQueue);
+    pendingSizes.swap (sendingSizes);
+    pendingEvents.swap (sendingEvents);
+    sendQueue();
+
+#endif
+}
+
+
+void
+DatagramAppender::sendQueue()
+{
+    long const sent = socket.isOpen()
+        ? socket.write(sendingQueue->getBuffer(), &sendingSizes[0],
+            sendingSizes.size())
+        : -1;
+
+    unsigned long lost = 0;
+    for (std::size_t i = (std::max) (sent, 0l); i < sendingSizes.size(); ++i)
+        lost += sendingEvents[i];
+
+    sendingQueue->clear();
+    sendingSizes.clear();
+    sendingEvents.clear();
+
+    if (lost != 0)
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        droppedEvents += lost;
+    }
+}
+
+
+} // namespace log4cplus
@@ -20,9 +20,14 @@
 
 #include <log4cplus/spi/factory.h>
 #include <log4cplus/spi/loggerfactory.h>
+#include <log4cplus/compressedfileappender.h>
 #include <log4cplus/consoleappender.h>
+#include <log4cplus/datagramappender.h>
 #include <log4cplus/fileappender.h>
 #include <log4cplus/nullappender.h>
+#include <log4cplus/routingfileappender.h>
+#include <log4cplus/shardedfileappender.h>
+#include <log4cplus/sharedmemoryappender.h>
 #include <log4cplus/socketappender.h>
 #include <log4cplus/syslogappender.h>
 #include <log4cplus/helpers/loglog.h>
@@ -155,6 +160,13 @@ void initializeFactoryRegistry()
     REG_APPENDER (reg, RollingFileAppender);
     REG_APPENDER (reg, DailyRollingFileAppender);
     REG_APPENDER (reg, SocketAppender);
+    REG_APPENDER (reg, DatagramAppender);
+    REG_APPENDER (reg, SharedMemoryAppender);
+    REG_APPENDER (reg, ShardedFileAppender);
+    REG_APPENDER (reg, RoutingFileAppender);
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    REG_APPENDER (reg, CompressedFileAppender);
+#endif
 #if defined(_WIN32)
 #  if defined(LOG4CPLUS_HAVE_NT_EVENT_LOG)
     REG_APPENDER (reg, NTEventLogAppender);
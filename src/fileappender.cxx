@@ -21,12 +21,20 @@
 #include <log4cplus/fileappender.h>
 #include <log4cplus/layout.h>
 #include <log4cplus/streams.h>
+#include <log4cplus/helpers/blockindex.h>
+#include <log4cplus/helpers/fileinfo.h>
 #include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/pagecache.h>
+#include <log4cplus/helpers/spillbuffer.h>
 #include <log4cplus/helpers/stringhelper.h>
 #include <log4cplus/helpers/timehelper.h>
 #include <log4cplus/spi/loggingevent.h>
 #include <sstream>
+#include <iomanip>
 #include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
 #include <cstdio>
 #if defined (__BORLANDC__)
 // For _wrename() and _wremove() on Windows.
@@ -37,10 +45,17 @@
 #endif
 #include <cstdlib>
 
-#if defined (_WIN32_WCE)
+#if defined (_WIN32)
 #include <log4cplus/config/windowsh-inc.h>
 #endif
 
+#if ! defined (_WIN32)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 
 namespace log4cplus
 {
@@ -161,9 +176,30 @@ loglog_opening_result (helpers::LogLog & loglog,
 }
 
 
+//! Renames sidecar index of <code>src</code>, if it exists, to
+//! index of <code>target</code>.
 static
 void
-rolloverFiles(const tstring& filename, unsigned int maxBackupIndex)
+rename_block_index (helpers::LogLog & loglog, tstring const & src,
+    tstring const & target)
+{
+    tstring const src_index (src + helpers::BLOCK_INDEX_SUFFIX);
+    tstring const target_index (target + helpers::BLOCK_INDEX_SUFFIX);
+    long ret;
+
+#if defined (WIN32)
+    ret = file_remove (target_index);
+#endif
+
+    ret = file_rename (src_index, target_index);
+    loglog_renaming_result (loglog, src_index, target_index, ret);
+}
+
+
+static
+void
+rolloverFiles(const tstring& filename, unsigned int maxBackupIndex,
+    const tstring& suffix = tstring (), bool indexed = false)
 {
     log4cplus::helpers::SharedObjectPtr<helpers::LogLog> loglog = helpers::LogLog::getLogLog();
 
@@ -171,6 +207,10 @@ rolloverFiles(const tstring& filename, unsigned int maxBackupIndex)
     tostringstream buffer;
     buffer << filename << LOG4CPLUS_TEXT(".") << maxBackupIndex;
     long ret = file_remove (buffer.str ());
+    if (! suffix.empty ())
+        ret = file_remove (buffer.str () + suffix);
+    if (indexed)
+        ret = file_remove (buffer.str () + helpers::BLOCK_INDEX_SUFFIX);
 
     tostringstream source_oss;
     tostringstream target_oss;
@@ -195,12 +235,625 @@ rolloverFiles(const tstring& filename, unsigned int maxBackupIndex)
 
         ret = file_rename (source, target);
         loglog_renaming_result (*loglog, source, target, ret);
+
+        // Compressed backups are shifted alongside the plain ones.
+        if (! suffix.empty ())
+        {
+#if defined (WIN32)
+            ret = file_remove (target + suffix);
+#endif
+
+            ret = file_rename (source + suffix, target + suffix);
+            loglog_renaming_result (*loglog, source + suffix,
+                target + suffix, ret);
+        }
+
+        // Index keeps the uncompressed name, e.g. log.2.idx.
+        if (indexed)
+            rename_block_index (*loglog, source, target);
     }
 } // end rolloverFiles()
 
+
+static
+unsigned long
+current_process_id ()
+{
+#if defined (_WIN32)
+    return GetCurrentProcessId ();
+#else
+    return static_cast<unsigned long>(getpid ());
+#endif
 }
 
 
+//! Returns name for the file being rolled over in the background.
+//! The name carries process ID, so that processes sharing the file
+//! do not overwrite each other's pending files.
+static
+tstring
+pending_rollover_name (tstring const & filename, unsigned long seq)
+{
+    tostringstream oss;
+    oss << filename << LOG4CPLUS_TEXT(".rollover.")
+        << current_process_id () << LOG4CPLUS_TEXT(".") << seq;
+    return oss.str ();
+}
+
+
+//! Finishes rollover started by append(). It optionally compresses
+//! the rolled over file, shifts the chain of backup files and then
+//! renames the temporary file(s) into their final places, in order.
+class RolloverFilesWorkItem
+    : public helpers::WorkItem
+{
+public:
+    RolloverFilesWorkItem (tstring const & base_, int maxBackupIndex_,
+        helpers::CompressionCodec codec_)
+        : base (base_)
+        , maxBackupIndex (maxBackupIndex_)
+        , codec (codec_)
+        , suffix (helpers::compressedFileSuffix (codec_))
+        , dropCache (false)
+        , indexed (false)
+        , lockFile (0)
+    { }
+
+    void
+    addRename (tstring const & src, tstring const & target)
+    {
+        renames.push_back (std::make_pair (src, target));
+    }
+
+    //! Sets file that is compressed before any renaming is done.
+    void
+    setCompressedFile (tstring const & src)
+    {
+        compressed = src;
+    }
+
+    //! Drops the rolled over file, or its compressed version, from
+    //! the page cache before it is handed off.
+    void
+    setDropCache (bool drop)
+    {
+        dropCache = drop;
+    }
+
+    //! Renames block index files along with the backup files.
+    void
+    setIndexed (bool indexed_)
+    {
+        indexed = indexed_;
+    }
+
+    //! Sets lock file held while backup files are being renamed.
+    void
+    setLockFile (helpers::LockFile const * lock)
+    {
+        lockFile = lock;
+    }
+
+    virtual
+    void
+    run ()
+    {
+        helpers::LogLog & loglog = helpers::getLogLog ();
+
+        // Compress the file first. If it fails, the uncompressed
+        // file is renamed instead. A file taken over from another
+        // process may have been compressed already.
+        helpers::FileInfo fi;
+        if (! compressed.empty ()
+            && helpers::getFileInfo (&fi, compressed) == 0
+            && helpers::compressFile (compressed, compressed + suffix,
+                codec))
+        {
+            file_remove (compressed);
+            if (dropCache)
+                helpers::dropFileCache (compressed + suffix);
+        }
+        else if (! compressed.empty () && dropCache)
+            helpers::dropFileCache (compressed);
+
+        if (lockFile)
+            lockFile->lock ();
+
+        rolloverFiles (base, maxBackupIndex, suffix, indexed);
+
+        for (std::vector<std::pair<tstring, tstring> >::const_iterator it
+            = renames.begin (); it != renames.end (); ++it)
+        {
+            rename (loglog, it->first, it->second);
+            if (! suffix.empty ())
+                rename (loglog, it->first + suffix, it->second + suffix);
+            if (indexed)
+                rename_block_index (loglog, it->first, it->second);
+        }
+
+        if (lockFile)
+            lockFile->unlock ();
+    }
+
+private:
+    static
+    void
+    rename (helpers::LogLog & loglog, tstring const & src,
+        tstring const & target)
+    {
+        long ret;
+
+#if defined (WIN32)
+        // Try to remove the target first. It seems it is not
+        // possible to rename over existing file.
+        ret = file_remove (target);
+#endif
+
+        ret = file_rename (src, target);
+        loglog_renaming_result (loglog, src, target, ret);
+    }
+
+    tstring base;
+    int maxBackupIndex;
+    helpers::CompressionCodec codec;
+    tstring suffix;
+    tstring compressed;
+    bool dropCache;
+    bool indexed;
+    helpers::LockFile const * lockFile;
+    std::vector<std::pair<tstring, tstring> > renames;
+};
+
+
+//! Splits file name into directory and name parts.
+static
+void
+split_path (tstring & dir, tstring & name, tstring const & path)
+{
+#if defined (_WIN32)
+    tstring::size_type const pos = path.find_last_of (LOG4CPLUS_TEXT("/\\"));
+#else
+    tstring::size_type const pos = path.rfind (LOG4CPLUS_TEXT('/'));
+#endif
+    if (pos == tstring::npos)
+    {
+        dir.clear ();
+        name = path;
+    }
+    else
+    {
+        dir = path.substr (0, pos == 0 ? 1 : pos);
+        name = path.substr (pos + 1);
+    }
+}
+
+
+//! Returns true if <code>str</code> matches <code>pattern</code>
+//! where '9' in pattern matches any digit and other characters
+//! match themselves.
+static
+bool
+matches_digit_pattern (tstring const & str, tstring const & pattern)
+{
+    if (str.size () != pattern.size ())
+        return false;
+
+    for (tstring::size_type i = 0; i != str.size (); ++i)
+        if (pattern[i] == LOG4CPLUS_TEXT('9')
+            ? (str[i] < LOG4CPLUS_TEXT('0') || str[i] > LOG4CPLUS_TEXT('9'))
+            : str[i] != pattern[i])
+            return false;
+
+    return true;
+}
+
+
+static
+bool
+ends_with (tstring const & str, tstring const & suffix)
+{
+    return str.size () >= suffix.size ()
+        && str.compare (str.size () - suffix.size (), suffix.size (),
+            suffix) == 0;
+}
+
+
+//! Returns name of backup file before it has been compressed.
+static
+tstring
+strip_compressed_suffix (tstring const & name)
+{
+    helpers::CompressionCodec const codecs[] = {
+        helpers::GZIP_COMPRESSION, helpers::LZ4_COMPRESSION };
+    for (std::size_t i = 0; i != sizeof (codecs) / sizeof (codecs[0]); ++i)
+    {
+        tstring const suffix (helpers::compressedFileSuffix (codecs[i]));
+        if (! suffix.empty () && ends_with (name, suffix))
+            return name.substr (0, name.size () - suffix.size ());
+    }
+
+    return name;
+}
+
+
+tchar const SEQUENCE_PATTERN[] = LOG4CPLUS_TEXT("99999999");
+tchar const TIMESTAMP_PATTERN[] = LOG4CPLUS_TEXT("9999-99-99-99-99-99");
+tchar const TIMESTAMP_FORMAT[] = LOG4CPLUS_TEXT("%Y-%m-%d-%H-%M-%S");
+
+
+#if ! defined (_WIN32)
+//! Records up to this size are written to shared file by single
+//! write() call.
+std::size_t const MAX_ATOMIC_APPEND = 64 * 1024;
+
+
+static
+bool
+write_all (int fd, char const * data, std::size_t size)
+{
+    while (size != 0)
+    {
+        ssize_t const ret = ::write (fd, data, size);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        data += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+
+//! Writes record into file opened with O_APPEND. Records longer
+//! than MAX_ATOMIC_APPEND are split after the last complete line
+//! that fits, so that other processes can only interleave between
+//! whole lines.
+static
+bool
+write_record (int fd, std::string const & record)
+{
+    std::string::size_type pos = 0;
+    while (pos < record.size ())
+    {
+        std::string::size_type len = record.size () - pos;
+        if (len > MAX_ATOMIC_APPEND)
+        {
+            std::string::size_type const nl = record.rfind ('\n',
+                pos + MAX_ATOMIC_APPEND - 1);
+            len = nl != std::string::npos && nl >= pos
+                ? nl + 1 - pos : MAX_ATOMIC_APPEND;
+        }
+
+        if (! write_all (fd, record.data () + pos, len))
+            return false;
+
+        pos += len;
+    }
+
+    return true;
+}
+
+#endif
+
+
+} // namespace
+
+
+/**
+ * Backup files of RollingFileAppender in sequence and timestamp
+ * naming modes, oldest first. New names are generated by
+ * nextName() in the appender's thread. Backups are registered by
+ * add(), either in the appender's thread or by the background
+ * worker, never both.
+ */
+class BackupFileSet
+{
+public:
+    BackupFileSet (tstring const & filename_, RollingFileNaming naming_,
+        unsigned maxCount_, std::streamoff maxTotalSize_, long maxAge_)
+        : filename (filename_)
+        , naming (naming_)
+        , maxCount (maxCount_)
+        , maxTotalSize (maxTotalSize_)
+        , maxAge (maxAge_)
+        , totalSize (0)
+        , sequence (0)
+        , collision (0)
+    {
+        scan ();
+    }
+
+    //! Forgets all tracked backups and scans the directory again.
+    //! Used when the backups are shared with other processes.
+    void
+    rescan ()
+    {
+        thread::MutexGuard guard (mtx);
+        files.clear ();
+        totalSize = 0;
+        scan ();
+    }
+
+    //! Returns name for the next backup file.
+    tstring
+    nextName (Time const & now)
+    {
+        thread::MutexGuard guard (mtx);
+        tostringstream oss;
+        oss << filename << LOG4CPLUS_TEXT(".");
+        if (naming == SEQUENCE_NAMING)
+        {
+            oss << std::setw (8) << std::setfill (LOG4CPLUS_TEXT('0'))
+                << ++sequence;
+        }
+        else
+        {
+            tstring const stamp (now.getFormattedTime (TIMESTAMP_FORMAT));
+            oss << stamp;
+            if (stamp == lastStamp)
+                oss << LOG4CPLUS_TEXT("-") << ++collision;
+            else
+                collision = 0;
+            lastStamp = stamp;
+        }
+
+        return oss.str ();
+    }
+
+    //! Registers new backup file and removes the oldest ones that
+    //! exceed the limits.
+    void
+    add (tstring const & name)
+    {
+        thread::MutexGuard guard (mtx);
+        helpers::FileInfo fi;
+        if (helpers::getFileInfo (&fi, name) == 0)
+            push (name, fi);
+
+        enforce (Time::gettimeofday ());
+    }
+
+private:
+    struct Entry
+    {
+        tstring name;
+        std::streamoff size;
+        Time mtime;
+    };
+
+    void
+    push (tstring const & name, helpers::FileInfo const & fi)
+    {
+        Entry entry;
+        entry.name = name;
+        entry.size = fi.size;
+        entry.mtime = fi.mtime;
+        files.push_back (entry);
+        totalSize += fi.size;
+    }
+
+    void
+    enforce (Time const & now)
+    {
+        helpers::LogLog & loglog = helpers::getLogLog ();
+        while (! files.empty ()
+            && ((maxCount != 0 && files.size () > maxCount)
+                || (maxTotalSize != 0 && totalSize > maxTotalSize)
+                || (maxAge != 0
+                    && files.front ().mtime + Time (maxAge, 0) < now)))
+        {
+            Entry const & oldest = files.front ();
+            long const ret = file_remove (oldest.name);
+            if (ret == 0 || ret == LOG4CPLUS_FILE_NOT_FOUND)
+                loglog.debug (LOG4CPLUS_TEXT("Removed backup file ")
+                    + oldest.name);
+            else
+                loglog.error (LOG4CPLUS_TEXT("Failed to remove backup file ")
+                    + oldest.name);
+
+            // Block index, if any, is named after the uncompressed file.
+            file_remove (strip_compressed_suffix (oldest.name)
+                + helpers::BLOCK_INDEX_SUFFIX);
+
+            totalSize -= oldest.size;
+            files.pop_front ();
+        }
+    }
+
+    //! Finds backups left by previous runs.
+    void
+    scan ()
+    {
+        tstring dir;
+        tstring base;
+        split_path (dir, base, filename);
+        base += LOG4CPLUS_TEXT(".");
+
+        std::vector<tstring> names;
+        helpers::listDirectory (names, dir);
+
+        tstring const pattern (naming == SEQUENCE_NAMING
+            ? SEQUENCE_PATTERN : TIMESTAMP_PATTERN);
+        std::vector<tstring> found;
+        for (std::vector<tstring>::const_iterator it = names.begin ();
+             it != names.end (); ++it)
+        {
+            if (it->compare (0, base.size (), base) != 0
+                || ends_with (*it, helpers::BLOCK_INDEX_SUFFIX))
+                continue;
+
+            // Accept the pattern optionally followed by collision
+            // counter and/or compression suffix.
+            tstring const rest (it->substr (base.size ()));
+            if (rest.size () < pattern.size ()
+                || ! matches_digit_pattern (rest.substr (0, pattern.size ()),
+                    pattern)
+                || (rest.size () > pattern.size ()
+                    && rest[pattern.size ()] != LOG4CPLUS_TEXT('.')
+                    && rest[pattern.size ()] != LOG4CPLUS_TEXT('-')))
+                continue;
+
+            found.push_back (*it);
+        }
+
+        // Both naming schemes sort chronologically.
+        std::sort (found.begin (), found.end ());
+
+        tstring const prefix (dir.empty () ? tstring ()
+            : dir + LOG4CPLUS_TEXT("/"));
+        for (std::vector<tstring>::const_iterator it = found.begin ();
+             it != found.end (); ++it)
+        {
+            helpers::FileInfo fi;
+            if (helpers::getFileInfo (&fi, prefix + *it) == 0)
+                push (prefix + *it, fi);
+
+            if (naming == SEQUENCE_NAMING)
+            {
+                tstring const digits (it->substr (base.size (),
+                    pattern.size ()));
+                sequence = (std::max) (sequence, std::strtoul (
+                    LOG4CPLUS_TSTRING_TO_STRING (digits).c_str (), 0, 10));
+            }
+        }
+    }
+
+    tstring filename;
+    RollingFileNaming naming;
+    unsigned maxCount;
+    std::streamoff maxTotalSize;
+    long maxAge;
+
+    std::deque<Entry> files;
+    std::streamoff totalSize;
+
+    unsigned long sequence;
+    tstring lastStamp;
+    unsigned collision;
+
+    thread::Mutex mtx;
+};
+
+
+namespace
+{
+
+
+//! Compresses new backup file, if requested, and registers it with
+//! the BackupFileSet, which also removes the oldest backups.
+class AddBackupWorkItem
+    : public helpers::WorkItem
+{
+public:
+    AddBackupWorkItem (BackupFileSet & set_, tstring const & name_,
+        helpers::CompressionCodec codec_, bool dropCache_,
+        helpers::LockFile const * lockFile_)
+        : set (set_)
+        , name (name_)
+        , codec (codec_)
+        , dropCache (dropCache_)
+        , lockFile (lockFile_)
+    { }
+
+    virtual
+    void
+    run ()
+    {
+        tstring final_name (name);
+        if (codec != helpers::NO_COMPRESSION)
+        {
+            tstring const target (name + helpers::compressedFileSuffix (codec));
+            if (helpers::compressFile (name, target, codec))
+            {
+                file_remove (name);
+                final_name = target;
+            }
+        }
+
+        if (dropCache)
+            helpers::dropFileCache (final_name);
+
+        if (lockFile)
+            lockFile->lock ();
+
+        set.add (final_name);
+
+        if (lockFile)
+            lockFile->unlock ();
+    }
+
+private:
+    BackupFileSet & set;
+    tstring name;
+    helpers::CompressionCodec codec;
+    bool dropCache;
+    helpers::LockFile const * lockFile;
+};
+
+
+} // namespace
+
+
+//! Writes events held in the spill buffer of FileAppender.
+class SpillDrainer
+    : public helpers::WorkItem
+{
+public:
+    explicit SpillDrainer (FileAppender & appender_)
+        : appender (appender_)
+    { }
+
+    virtual
+    void
+    run ()
+    {
+        appender.drainSpill ();
+    }
+
+private:
+    FileAppender & appender;
+};
+
+
+//! Formats events for FileAppender's format pipeline and writes them
+//! out through append().
+class FormatStage
+    : public helpers::FormatPipeline::Stage
+{
+public:
+    explicit FormatStage (FileAppender & appender_)
+        : appender (appender_)
+    { }
+
+    virtual
+    void
+    formatEvent (spi::InternalLoggingEvent const & event, tstring & text)
+    {
+        text = appender.layout->formatShared (event)->text;
+    }
+
+    virtual
+    void
+    commitEvent (spi::InternalLoggingEvent const & event,
+        tstring const & text)
+    {
+        // append() writes the text instead of formatting the event.
+        appender.committedText = &text;
+        appender.append (event);
+        appender.committedText = 0;
+    }
+
+private:
+    FileAppender & appender;
+};
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // FileAppender ctors and dtor
 ///////////////////////////////////////////////////////////////////////////////
@@ -211,6 +864,22 @@ FileAppender::FileAppender(const tstring& filename_,
     , reopenDelay(1)
     , bufferSize (0)
     , buffer (0)
+    , backgroundRollover (false)
+    , rolloverSequence (0)
+    , compression (helpers::NO_COMPRESSION)
+    , workerNiceLevel (0)
+    , sharedFile (false)
+    , sharedFd (-1)
+    , lockFile (0)
+    , spillLatency (0, 100 * 1000)
+    , spilling (false)
+    , writing (false)
+    , spillDroppedBase (0)
+    , reopenPending (false)
+    , lazyOpenMode (std::ios::app)
+    , formatPipeline (0)
+    , formatStage (0)
+    , committedText (0)
 {
     init(filename_, mode);
 }
@@ -223,6 +892,22 @@ FileAppender::FileAppender(const Properties& properties,
     , reopenDelay(1)
     , bufferSize (0)
     , buffer (0)
+    , backgroundRollover (false)
+    , rolloverSequence (0)
+    , compression (helpers::NO_COMPRESSION)
+    , workerNiceLevel (0)
+    , sharedFile (false)
+    , sharedFd (-1)
+    , lockFile (0)
+    , spillLatency (0, 100 * 1000)
+    , spilling (false)
+    , writing (false)
+    , spillDroppedBase (0)
+    , reopenPending (false)
+    , lazyOpenMode (std::ios::app)
+    , formatPipeline (0)
+    , formatStage (0)
+    , committedText (0)
 {
     bool append_ = (mode == std::ios::app);
     tstring filename_ = properties.getProperty( LOG4CPLUS_TEXT("File") );
@@ -247,104 +932,724 @@ FileAppender::FileAppender(const Properties& properties,
         tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("BufferSize") );
         bufferSize = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
     }
+    if(properties.exists( LOG4CPLUS_TEXT("PageCacheInterval") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("PageCacheInterval") );
+        cacheTrimmer.setInterval (helpers::parseFileSize(tmp));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("SharedFile") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("SharedFile") );
+        sharedFile = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("IndexBlockSize") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("IndexBlockSize") );
+        blockIndex.setBlockSize (helpers::parseFileSize(tmp));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("SpillBufferSize") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("SpillBufferSize") );
+        spill.setCapacity (static_cast<std::size_t>(helpers::parseFileSize(tmp)));
+#if defined (LOG4CPLUS_SINGLE_THREADED)
+        if (spill.isEnabled ())
+        {
+            getLogLog().warn(LOG4CPLUS_TEXT("FileAppender- \"SpillBufferSize\"")
+                LOG4CPLUS_TEXT(" is not supported in single-threaded builds"));
+            spill.setCapacity (0);
+        }
+#endif
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("SpillLatency") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("SpillLatency") );
+        long ms = std::atol(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        spillLatency = Time (ms / 1000, (ms % 1000) * 1000);
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("FormatThreads") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("FormatThreads") );
+        int threads = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        tmp = properties.getProperty( LOG4CPLUS_TEXT("FormatQueueSize"),
+            LOG4CPLUS_TEXT("1024") );
+        int queueSize = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+        if (threads > 0)
+        {
+            formatStage = new FormatStage (*this);
+            formatPipeline = new helpers::FormatPipeline (*formatStage,
+                access_mutex, static_cast<unsigned>(threads),
+                static_cast<std::size_t>((std::max) (queueSize, 1)));
+        }
+#else
+        (void) queueSize;
+        if (threads > 0)
+            getLogLog().warn(LOG4CPLUS_TEXT("FileAppender- \"FormatThreads\"")
+                LOG4CPLUS_TEXT(" is not supported in single-threaded builds"));
+#endif
+    }
+    if (sharedFile && blockIndex.isEnabled ())
+    {
+        getLogLog().warn(LOG4CPLUS_TEXT("FileAppender- \"IndexBlockSize\"")
+            LOG4CPLUS_TEXT(" cannot be used with \"SharedFile\""));
+        blockIndex.setBlockSize (0);
+    }
+    if (sharedFile)
+    {
+#if defined (_WIN32)
+        getLogLog().warn(LOG4CPLUS_TEXT("FileAppender- \"SharedFile\"")
+            LOG4CPLUS_TEXT(" is not supported on this platform"));
+        sharedFile = false;
+#else
+        lockFile = new helpers::LockFile (properties.getProperty (
+            LOG4CPLUS_TEXT("LockFile"), filename_ + LOG4CPLUS_TEXT(".lock")));
+#endif
+    }
+
+    if (deferActivation(properties))
+    {
+        filename = filename_;
+        lazyOpenMode = append_ ? std::ios::app : std::ios::trunc;
+        return;
+    }
+
+    init(filename_, (append_ ? std::ios::app : std::ios::trunc));
+}
+
+
+
+void
+FileAppender::init(const tstring& filename_, 
+                   LOG4CPLUS_OPEN_MODE_TYPE mode)
+{
+    this->filename = filename_;
+    open(mode);
+
+    if (bufferSize != 0)
+    {
+        delete[] buffer;
+        buffer = new tchar[bufferSize];
+        out.rdbuf ()->pubsetbuf (buffer, bufferSize);
+    }
+
+    if(!isOpen()) {
+        getErrorHandler()->error(  LOG4CPLUS_TEXT("Unable to open file: ") 
+                                 + filename);
+        return;
+    }
+    getLogLog().debug(LOG4CPLUS_TEXT("Just opened file: ") + filename);
+}
+
+
+
+FileAppender::~FileAppender()
+{
+    destructorImpl();
+    delete formatPipeline;
+    delete formatStage;
+    delete lockFile;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FileAppender public methods
+///////////////////////////////////////////////////////////////////////////////
+
+void 
+FileAppender::close()
+{
+    // The format pipeline and the spill drainer take access_mutex
+    // to finish.
+    stopFormatPipeline();
+    finishSpill();
+
+    LOG4CPLUS_BEGIN_SYNCHRONIZE_ON_MUTEX( access_mutex )
+        // An event racing with close() may have started spilling
+        // again; the drainer gives up once the buffer is closed.
+        spill.close();
+
+        // Writers that have released access_mutex are still using
+        // the file.
+        log4cplus::thread::MutexGuard file_guard (file_mutex);
+        out.close();
+        blockIndex.close();
+        cacheTrimmer.close();
+#if ! defined (_WIN32)
+        if (sharedFd != -1)
+        {
+            ::close (sharedFd);
+            sharedFd = -1;
+        }
+#endif
+        delete[] buffer;
+        buffer = 0;
+
+        // Wait for outstanding renames.
+        if (fileWorker.get ())
+            fileWorker->close ();
+
+        closed = true;
+    LOG4CPLUS_END_SYNCHRONIZE_ON_MUTEX;
+
+    finishSpill();
+}
+
+
+std::locale
+FileAppender::imbue(std::locale const& loc)
+{
+    return out.imbue (loc);
+}
+
+
+std::locale
+FileAppender::getloc () const
+{
+    return out.getloc ();
+}
+
+
+void
+FileAppender::reopenFiles()
+{
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    if (closed || activation != ACTIVE)
+        return;
+
+    if (! ownsFile ())
+        reopenPending = true;
+    else
+        reopenFile ();
+}
+
+
+void
+FileAppender::getFileNames(std::vector<tstring>& names)
+{
+    names.push_back (filename);
+}
+
+
+unsigned long
+FileAppender::getDroppedEvents () const
+{
+    return spill.getDropped ();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FileAppender protected methods
+///////////////////////////////////////////////////////////////////////////////
+
+// This method does not need to be locked since it is called by
+// doAppend() which performs the locking
+void
+FileAppender::append(const spi::InternalLoggingEvent& event)
+{
+    if(submitFormatted(event)) {
+        return;
+    }
+
+    // Wait for a write in another thread, but not longer than
+    // spillLatency; a stalled write makes the event go to the spill
+    // buffer instead.
+    while(writing && !spilling && !closed) {
+        Time const elapsed = Time::gettimeofday() - writeStart;
+        if(elapsed > spillLatency) {
+            startSpill();
+            break;
+        }
+
+        Time const left = spillLatency - elapsed;
+        access_mutex.unlock();
+        writeDone.timed_wait(left.sec() * 1000 + left.usec() / 1000 + 1);
+        access_mutex.lock();
+    }
+
+    if(closed) {
+        return;
+    }
+    else if(spilling) {
+        spillEvent(event);
+        return;
+    }
+    else if(reopenPending) {
+        reopenFile();
+    }
+
+    if(!isOpen()) {
+        if(spill.isEnabled()) {
+            startSpill();
+            spillEvent(event);
+            return;
+        }
+        else if(!reopen()) {
+            getErrorHandler()->error(  LOG4CPLUS_TEXT("file is not open: ") 
+                                     + filename);
+            return;
+        }
+        // Resets the error handler to make it 
+        // ready to handle a future append error.
+        else
+            getErrorHandler()->reset();
+    }
+
+    if(spill.isEnabled() && !formatPipeline && !writesUnderLockFile()) {
+        appendUnlocked(event);
+        return;
+    }
+
+    Time start;
+    if(spill.isEnabled()) {
+        start = Time::gettimeofday();
+    }
+
+    const tstring& text = formatEvent(event);
+    if(sharedFile) {
+        appendShared(text);
+    }
+    else {
+        out << text;
+        if(immediateFlush) {
+            out.flush();
+        }
+    }
+
+    if(spill.isEnabled()) {
+        if(!isOpen()) {
+            // The event may have been written only partially; it is
+            // written again from the spill buffer.
+            startSpill();
+            spillEvent(event);
+            return;
+        }
+        else if(Time::gettimeofday() - start > spillLatency) {
+            startSpill();
+        }
+    }
+
+    recordWritten(event.getTimestamp(), event.getLogLevel(), text);
+}
+
+
+void
+FileAppender::appendBatch(const spi::InternalLoggingEvent* events,
+    std::size_t n)
+{
+    if(spilling || spill.isEnabled() || blockIndex.isEnabled()
+       || cacheTrimmer.isEnabled() || formatPipeline) {
+        Appender::appendBatch(events, n);
+        return;
+    }
+    else if(reopenPending) {
+        reopenFile();
+    }
+
+    if(!isOpen()) {
+        if(!reopen()) {
+            getErrorHandler()->error(  LOG4CPLUS_TEXT("file is not open: ") 
+                                     + filename);
+            return;
+        }
+        else
+            getErrorHandler()->reset();
+    }
+
+    batchBuffer.clear();
+    for(std::size_t i = 0; i != n; ++i) {
+        batchBuffer += layout->formatText(events[i]);
+    }
+
+#if ! defined (_WIN32)
+    if(sharedFile) {
+        if (! write_record (sharedFd, LOG4CPLUS_TSTRING_TO_STRING (batchBuffer)))
+        {
+            getErrorHandler()->error(LOG4CPLUS_TEXT("Failed to write to ")
+                + filename);
+            ::close (sharedFd);
+            sharedFd = -1;
+        }
+        return;
+    }
+#endif
+
+    out.write(batchBuffer.data(),
+        static_cast<std::streamsize>(batchBuffer.size()));
+    if(immediateFlush) {
+        out.flush();
+    }
+}
+
+
+// Called with access_mutex held, which is released while the event
+// is written so that other threads can spill their events when the
+// write stalls. Events formatted by formatPipeline and writes to
+// shared compressed files, which are done under lockFile, are not
+// written this way.
+void
+FileAppender::appendUnlocked(const spi::InternalLoggingEvent& event)
+{
+    spi::FormattedEventPtr const formatted = layout->formatShared(event);
+    writing = true;
+    writeStart = Time::gettimeofday();
+    writeDone.reset();
+
+    access_mutex.unlock();
+    file_mutex.lock();
+    Time const start = Time::gettimeofday();
+    bool const written = writeSpilled(formatted->text, immediateFlush);
+    if(written) {
+        recordWritten(event.getTimestamp(), event.getLogLevel(),
+            formatted->text);
+    }
+    file_mutex.unlock();
+    access_mutex.lock();
+
+    writing = false;
+    writeDone.signal();
+
+    if(closed) {
+        return;
+    }
+    else if(!written) {
+        // The event may have been written only partially; it is
+        // written again from the spill buffer.
+        if(!spilling) {
+            startSpill();
+        }
+        spillEvent(event);
+    }
+    else if(!spilling && Time::gettimeofday() - start > spillLatency) {
+        startSpill();
+    }
+}
+
+
+bool
+FileAppender::writesUnderLockFile() const
+{
+    return sharedFile && compression != helpers::NO_COMPRESSION;
+}
+
+
+bool
+FileAppender::ownsFile() const
+{
+    return !spilling && !writing;
+}
+
+
+void
+FileAppender::recordWritten(const Time& timestamp, LogLevel ll,
+    const tstring& text)
+{
+    if(blockIndex.isEnabled()) {
+        blockIndex.addEvent(timestamp, ll, text);
+        std::streamoff pos = out.tellp();
+        if(blockIndex.isDue(pos)) {
+            out.flush();
+            blockIndex.endBlock(pos);
+        }
+    }
+
+    if(cacheTrimmer.isEnabled()) {
+        std::streamoff pos = getFileSize();
+        if(cacheTrimmer.isDue(pos)) {
+            out.flush();
+            cacheTrimmer.written(pos);
+        }
+    }
+}
+
+void
+FileAppender::open(std::ios::openmode mode)
+{
+#if ! defined (_WIN32)
+    if (sharedFile)
+    {
+        if (sharedFd != -1)
+            ::close (sharedFd);
+
+        // Other processes may be writing into the file, it is never
+        // truncated.
+        sharedFd = ::open (LOG4CPLUS_TSTRING_TO_STRING (filename).c_str (),
+            O_WRONLY | O_CREAT | O_APPEND, 0666);
+    }
+    else
+#endif
+        out.open(LOG4CPLUS_FSTREAM_PREFERED_FILE_NAME(filename).c_str(), mode);
+
+    cacheTrimmer.open(filename);
+    blockIndex.open(filename);
+}
+
+
+void
+FileAppender::reopenFile()
+{
+    getLogLog().debug(LOG4CPLUS_TEXT("Reopening file ") + filename);
+    reopenPending = false;
+
+    // Closing flushes buffered data into the old file.
+    out.close();
+    out.clear();
+    open(std::ios::app);
+    if(!isOpen()) {
+        getErrorHandler()->error(LOG4CPLUS_TEXT("Unable to reopen file: ")
+            + filename);
+    }
+}
+
+
+void
+FileAppender::activateResources()
+{
+    // Opening is not expected to take long, unlike connecting, and
+    // holding the lock keeps close() and the opening apart.
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    if (! closed)
+        init(filename, lazyOpenMode);
+}
+
+
+bool
+FileAppender::isOpen() const
+{
+    return sharedFile ? sharedFd != -1 : out.good();
+}
 
-    init(filename_, (append_ ? std::ios::app : std::ios::trunc));
+
+void
+FileAppender::appendShared(const tstring& text)
+{
+#if ! defined (_WIN32)
+    if (! write_record (sharedFd, LOG4CPLUS_TSTRING_TO_STRING (text)))
+    {
+        getErrorHandler()->error(LOG4CPLUS_TEXT("Failed to write to ")
+            + filename);
+        ::close (sharedFd);
+        sharedFd = -1;
+    }
+#else
+    (void)text;
+#endif
 }
 
 
+void
+FileAppender::spillEvent(const spi::InternalLoggingEvent& event)
+{
+    spill.push(formatEvent(event), event.getTimestamp(),
+        event.getLogLevel());
+}
+
 
 void
-FileAppender::init(const tstring& filename_, 
-                   LOG4CPLUS_OPEN_MODE_TYPE mode)
+FileAppender::startSpill()
 {
-    this->filename = filename_;
-    open(mode);
+    getLogLog().warn(LOG4CPLUS_TEXT("Writes to ") + filename
+        + LOG4CPLUS_TEXT(" are stalled, spilling events to memory"));
 
-    if (bufferSize != 0)
+    spilling = true;
+    spillDroppedBase = spill.getDropped();
+    if (! spillWorker.get ())
+        spillWorker = helpers::WorkQueuePtr (new helpers::WorkQueue);
+
+    spillWorker->post (helpers::WorkItemPtr (new SpillDrainer (*this)));
+}
+
+
+bool
+FileAppender::writeSpilled(const tstring& text, bool flush)
+{
+#if ! defined (_WIN32)
+    if (sharedFile)
     {
-        delete[] buffer;
-        buffer = new tchar[bufferSize];
-        out.rdbuf ()->pubsetbuf (buffer, bufferSize);
-    }
+        if (write_record (sharedFd, LOG4CPLUS_TSTRING_TO_STRING (text)))
+            return true;
 
-    if(!out.good()) {
-        getErrorHandler()->error(  LOG4CPLUS_TEXT("Unable to open file: ") 
-                                 + filename);
-        return;
+        ::close (sharedFd);
+        sharedFd = -1;
+        return false;
     }
-    getLogLog().debug(LOG4CPLUS_TEXT("Just opened file: ") + filename);
-}
+#endif
+
+    out << text;
+    if (flush)
+        out.flush ();
 
+    return out.good ();
+}
 
 
-FileAppender::~FileAppender()
+// Runs in spillWorker. While spilling is set, the file is not touched
+// by the appender's threads, except for a write that has started
+// before; file_mutex serializes the drainer with it.
+void
+FileAppender::drainSpill()
 {
-    destructorImpl();
-}
+    helpers::SpillRecord record;
+    unsigned long const retryDelay = reopenDelay > 0
+        ? static_cast<unsigned long>(reopenDelay) * 1000 : 1000;
+    unsigned long const latencyMs = static_cast<unsigned long>(
+        spillLatency.sec () * 1000 + spillLatency.usec () / 1000);
+    bool fast = true;
+
+    while (true)
+    {
+        bool opened;
+        bool idle;
+        {
+            thread::MutexGuard file_guard (file_mutex);
+            opened = isOpen ();
+            if (opened && spill.pop (record))
+            {
+                Time const start = Time::gettimeofday ();
+                if (writeSpilled (record.text,
+                        immediateFlush || spill.empty ()))
+                {
+                    recordWritten (record.timestamp, record.ll, record.text);
+                    fast = Time::gettimeofday () - start <= spillLatency;
+                }
+                else
+                    spill.addDropped (1);
+
+                continue;
+            }
+
+            // Give writes that have just been slow a chance to recover
+            // before events go to the file directly again.
+            idle = fast || spill.isClosed ();
+            if (opened && idle)
+                out.flush ();
+        }
 
+        if (! opened)
+        {
+            if (spill.waitForClose (retryDelay))
+            {
+                // Nobody is going to wait for the file any longer.
+                unsigned long lost = 0;
+                while (spill.pop (record))
+                    ++lost;
+                spill.addDropped (lost);
+                break;
+            }
+
+            thread::MutexGuard file_guard (file_mutex);
+            out.close ();
+            out.clear ();
+            open (std::ios::app);
+            continue;
+        }
 
+        if (! idle)
+        {
+            spill.waitForRecords (latencyMs);
+            fast = true;
+            continue;
+        }
 
-///////////////////////////////////////////////////////////////////////////////
-// FileAppender public methods
-///////////////////////////////////////////////////////////////////////////////
+        thread::MutexGuard guard (access_mutex);
+        if (spill.empty ())
+        {
+            spilling = false;
+            break;
+        }
+    }
 
-void 
-FileAppender::close()
+    unsigned long const dropped = spill.getDropped () - spillDroppedBase;
+    tostringstream oss;
+    oss << LOG4CPLUS_TEXT("Writes to ") << filename
+        << (spilling ? LOG4CPLUS_TEXT(" have not recovered")
+            : LOG4CPLUS_TEXT(" have recovered"));
+    if (dropped != 0)
+        oss << LOG4CPLUS_TEXT(", ") << dropped
+            << LOG4CPLUS_TEXT(" events have been dropped");
+    getLogLog().warn(oss.str ());
+}
+
+
+void
+FileAppender::finishSpill()
 {
-    log4cplus::thread::MutexGuard guard (access_mutex);
+    if (! spill.isEnabled ())
+        return;
 
-    out.close();
-    delete[] buffer;
-    buffer = 0;
-    closed = true;
+    spill.close ();
+    if (spillWorker.get ())
+        spillWorker->wait ();
+
+    spilling = false;
+    spill.reopen ();
 }
 
 
-std::locale
-FileAppender::imbue(std::locale const& loc)
+const tstring&
+FileAppender::formatEvent(const spi::InternalLoggingEvent& event)
 {
-    return out.imbue (loc);
+    return committedText ? *committedText : layout->formatText(event);
 }
 
 
-std::locale
-FileAppender::getloc () const
+bool
+FileAppender::submitFormatted(const spi::InternalLoggingEvent& event)
 {
-    return out.getloc ();
-}
+    if(!formatPipeline || committedText) {
+        return false;
+    }
 
+    formatPipeline->submit(event);
+    return true;
+}
 
-///////////////////////////////////////////////////////////////////////////////
-// FileAppender protected methods
-///////////////////////////////////////////////////////////////////////////////
 
-// This method does not need to be locked since it is called by
-// doAppend() which performs the locking
 void
-FileAppender::append(const spi::InternalLoggingEvent& event)
+FileAppender::stopFormatPipeline()
 {
-    if(!out.good()) {
-        if(!reopen()) {
-            getErrorHandler()->error(  LOG4CPLUS_TEXT("file is not open: ") 
-                                     + filename);
-            return;
-        }
-        // Resets the error handler to make it 
-        // ready to handle a future append error.
-        else
-            getErrorHandler()->reset();
+    if(formatPipeline) {
+        formatPipeline->close();
     }
+}
 
-    layout->formatAndAppend(out, event);
-    if(immediateFlush) {
-        out.flush();
+
+std::streamoff
+FileAppender::getFileSize()
+{
+#if ! defined (_WIN32)
+    if (sharedFile)
+    {
+        struct stat st;
+        if (sharedFd == -1 || fstat (sharedFd, &st) != 0)
+            return 0;
+
+        return st.st_size;
     }
+#endif
+
+    return out.tellp();
 }
 
-void
-FileAppender::open(std::ios::openmode mode)
+
+bool
+FileAppender::reopenIfReplaced()
 {
-    out.open(LOG4CPLUS_FSTREAM_PREFERED_FILE_NAME(filename).c_str(), mode);
+#if ! defined (_WIN32)
+    if (! sharedFile)
+        return false;
+
+    struct stat ours;
+    struct stat current;
+    if (sharedFd != -1
+        && fstat (sharedFd, &ours) == 0
+        && stat (LOG4CPLUS_TSTRING_TO_STRING (filename).c_str (),
+            &current) == 0
+        && ours.st_dev == current.st_dev
+        && ours.st_ino == current.st_ino)
+        return false;
+
+    getLogLog().debug(filename
+        + LOG4CPLUS_TEXT(" has been replaced by another process, reopening"));
+    open(std::ios::app);
+    return true;
+#else
+    return false;
+#endif
 }
 
 bool
@@ -373,20 +1678,153 @@ FileAppender::reopen()
             reopen_time = log4cplus::helpers::Time ();
 
             // Succeed if no errors are found.
-            if(out.good())
+            if(isOpen())
                 return true;
         }
     }
     return false;
 }
 
+
+void
+FileAppender::postFileWork(const helpers::WorkItemPtr& item)
+{
+    if (! fileWorker.get ())
+    {
+        fileWorker = helpers::WorkQueuePtr (new helpers::WorkQueue);
+        fileWorker->setNiceLevel (workerNiceLevel);
+    }
+
+    fileWorker->post (item);
+}
+
+
+void
+FileAppender::initBackgroundWork(const Properties& properties)
+{
+    if(properties.exists( LOG4CPLUS_TEXT("BackgroundRollover") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("BackgroundRollover") );
+        backgroundRollover = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+
+    // Rolled over files are dropped from the page cache by the
+    // background thread.
+    if (cacheTrimmer.isEnabled ())
+        backgroundRollover = true;
+
+    compression = helpers::parseCompressionCodec (
+        properties.getProperty (LOG4CPLUS_TEXT("Compression")));
+    if (compression == helpers::NO_COMPRESSION)
+        return;
+
+    backgroundRollover = true;
+    workerNiceLevel = 10;
+    if(properties.exists( LOG4CPLUS_TEXT("CompressionNiceLevel") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("CompressionNiceLevel") );
+        workerNiceLevel = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+    }
+
+    if(properties.exists( LOG4CPLUS_TEXT("MaxConcurrentCompressions") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("MaxConcurrentCompressions") );
+        helpers::setMaxConcurrentCompressions (static_cast<unsigned>(
+            std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str())));
+    }
+}
+
+
+std::vector<tstring>
+FileAppender::claimAbandonedRollovers()
+{
+    std::vector<tstring> claimed;
+    if (! backgroundRollover)
+        return claimed;
+
+    tstring dir;
+    tstring base;
+    split_path (dir, base, filename);
+    base += LOG4CPLUS_TEXT(".rollover.");
+    tstring const prefix (dir.empty () ? tstring ()
+        : dir + LOG4CPLUS_TEXT("/"));
+    tstring const suffix (helpers::compressedFileSuffix (compression));
+
+    std::vector<tstring> names;
+    helpers::listDirectory (names, dir);
+
+    // Name is "<file>.rollover.<pid>.<seq>", optionally followed by
+    // the compression suffix when the compression has finished.
+    std::vector<std::pair<helpers::Time, tstring> > found;
+    for (std::vector<tstring>::const_iterator it = names.begin ();
+         it != names.end (); ++it)
+    {
+        if (it->compare (0, base.size (), base) != 0)
+            continue;
+
+        tstring ids (it->substr (base.size ()));
+        if (! suffix.empty () && ends_with (ids, suffix))
+            ids.erase (ids.size () - suffix.size ());
+
+        tstring::size_type const dot = ids.find (LOG4CPLUS_TEXT('.'));
+        if (dot == tstring::npos || dot == 0 || dot + 1 == ids.size ()
+            || ids.find_first_not_of (LOG4CPLUS_TEXT("0123456789."))
+                != tstring::npos
+            || ids.find (LOG4CPLUS_TEXT('.'), dot + 1) != tstring::npos)
+            continue;
+
+        unsigned long const pid = std::strtoul (
+            LOG4CPLUS_TSTRING_TO_STRING (ids.substr (0, dot)).c_str (), 0, 10);
+        if (pid == current_process_id ()
+            || (lockFile && lockFile->isProcessAlive (pid)))
+            continue;
+
+        tstring const pending (prefix + base + ids);
+        helpers::FileInfo fi;
+        if (helpers::getFileInfo (&fi, prefix + *it) == 0)
+            found.push_back (std::make_pair (fi.mtime, pending));
+    }
+
+    std::sort (found.begin (), found.end ());
+
+    helpers::LogLog & loglog = getLogLog();
+    for (std::size_t i = 0; i != found.size (); ++i)
+    {
+        // Both the file and its compressed version may be listed.
+        tstring const & src = found[i].second;
+        tstring const target = pending_rollover_name (filename,
+            ++rolloverSequence);
+        long ret = file_rename (src, target);
+        if (ret == 0)
+        {
+            // Compression was interrupted.
+            if (! suffix.empty ())
+                file_remove (src + suffix);
+        }
+        else if (! suffix.empty ())
+            ret = file_rename (src + suffix, target + suffix);
+
+        if (ret != 0)
+            continue;
+
+        loglog.debug (LOG4CPLUS_TEXT("Taking over abandoned rollover file ")
+            + src);
+        if (blockIndex.isEnabled ())
+            rename_block_index (loglog, src, target);
+        claimed.push_back (target);
+    }
+
+    return claimed;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // RollingFileAppender ctors and dtor
 ///////////////////////////////////////////////////////////////////////////////
 
 RollingFileAppender::RollingFileAppender(const tstring& filename_,
-    long maxFileSize_, int maxBackupIndex_, bool immediateFlush_)
+    std::streamoff maxFileSize_, int maxBackupIndex_, bool immediateFlush_)
     : FileAppender(filename_, std::ios::app, immediateFlush_)
+    , naming(INDEX_NAMING)
+    , maxTotalSize(0)
+    , maxBackupAge(0)
+    , backupFiles(0)
 {
     init(maxFileSize_, maxBackupIndex_);
 }
@@ -394,19 +1832,16 @@ RollingFileAppender::RollingFileAppender(const tstring& filename_,
 
 RollingFileAppender::RollingFileAppender(const Properties& properties)
     : FileAppender(properties, std::ios::app)
+    , naming(INDEX_NAMING)
+    , maxTotalSize(0)
+    , maxBackupAge(0)
+    , backupFiles(0)
 {
-    int maxFileSize_ = 10*1024*1024;
+    std::streamoff maxFileSize_ = 10*1024*1024;
     int maxBackupIndex_ = 1;
     if(properties.exists( LOG4CPLUS_TEXT("MaxFileSize") )) {
         tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("MaxFileSize") );
-        tmp = helpers::toUpper(tmp);
-        maxFileSize_ = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
-        if(tmp.find( LOG4CPLUS_TEXT("MB") ) == (tmp.length() - 2)) {
-            maxFileSize_ *= (1024 * 1024); // convert to megabytes
-        }
-        if(tmp.find( LOG4CPLUS_TEXT("KB") ) == (tmp.length() - 2)) {
-            maxFileSize_ *= 1024; // convert to kilobytes
-        }
+        maxFileSize_ = helpers::parseFileSize(tmp);
     }
 
     if(properties.exists( LOG4CPLUS_TEXT("MaxBackupIndex") )) {
@@ -414,12 +1849,36 @@ RollingFileAppender::RollingFileAppender(const Properties& properties)
         maxBackupIndex_ = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
     }
 
+    if(properties.exists( LOG4CPLUS_TEXT("BackupNaming") )) {
+        tstring tmp = helpers::toLower(
+            properties.getProperty(LOG4CPLUS_TEXT("BackupNaming")));
+        if(tmp == LOG4CPLUS_TEXT("sequence"))
+            naming = SEQUENCE_NAMING;
+        else if(tmp == LOG4CPLUS_TEXT("timestamp"))
+            naming = TIMESTAMP_NAMING;
+        else if(tmp != LOG4CPLUS_TEXT("index"))
+            getLogLog().warn(LOG4CPLUS_TEXT("RollingFileAppender::ctor()-")
+                LOG4CPLUS_TEXT(" \"BackupNaming\" not valid: ") + tmp);
+    }
+
+    if(properties.exists( LOG4CPLUS_TEXT("MaxTotalSize") )) {
+        tstring tmp = properties.getProperty(LOG4CPLUS_TEXT("MaxTotalSize"));
+        maxTotalSize = helpers::parseFileSize(tmp);
+    }
+
+    if(properties.exists( LOG4CPLUS_TEXT("MaxBackupAge") )) {
+        tstring tmp = properties.getProperty(LOG4CPLUS_TEXT("MaxBackupAge"));
+        maxBackupAge = std::atol(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+    }
+
+    initBackgroundWork(properties);
+
     init(maxFileSize_, maxBackupIndex_);
 }
 
 
 void
-RollingFileAppender::init(long maxFileSize_, int maxBackupIndex_)
+RollingFileAppender::init(std::streamoff maxFileSize_, int maxBackupIndex_)
 {
     if (maxFileSize_ < MINIMUM_ROLLING_LOG_SIZE)
     {
@@ -432,13 +1891,22 @@ RollingFileAppender::init(long maxFileSize_, int maxBackupIndex_)
     }
 
     this->maxFileSize = maxFileSize_;
-    this->maxBackupIndex = (std::max)(maxBackupIndex_, 1);
+    if (naming == INDEX_NAMING)
+        this->maxBackupIndex = (std::max)(maxBackupIndex_, 1);
+    else
+    {
+        this->maxBackupIndex = (std::max)(maxBackupIndex_, 0);
+        backupFiles = new BackupFileSet (filename, naming,
+            static_cast<unsigned>(this->maxBackupIndex), maxTotalSize,
+            maxBackupAge);
+    }
 }
 
 
 RollingFileAppender::~RollingFileAppender()
 {
     destructorImpl();
+    delete backupFiles;
 }
 
 
@@ -451,9 +1919,43 @@ RollingFileAppender::~RollingFileAppender()
 void
 RollingFileAppender::append(const spi::InternalLoggingEvent& event)
 {
+    if(submitFormatted(event)) {
+        return;
+    }
+
+    if(writesUnderLockFile()) {
+        thread::SyncGuard<helpers::LockFile> guard (*lockFile);
+        rolloverSharedIfFull();
+        FileAppender::append(event);
+        rolloverSharedIfFull();
+        return;
+    }
+
     FileAppender::append(event);
 
-    if(out.tellp() > maxFileSize) {
+    // Rollover waits while the spill drainer or a write done with
+    // the lock released uses the file.
+    if(ownsFile() && getFileSize() > maxFileSize) {
+        rollover();
+    }
+}
+
+
+void
+RollingFileAppender::appendBatch(const spi::InternalLoggingEvent* events,
+    std::size_t n)
+{
+    if(writesUnderLockFile()) {
+        thread::SyncGuard<helpers::LockFile> guard (*lockFile);
+        rolloverSharedIfFull();
+        FileAppender::appendBatch(events, n);
+        rolloverSharedIfFull();
+        return;
+    }
+
+    FileAppender::appendBatch(events, n);
+
+    if(ownsFile() && getFileSize() > maxFileSize) {
         rollover();
     }
 }
@@ -461,6 +1963,51 @@ RollingFileAppender::append(const spi::InternalLoggingEvent& event)
 
 void 
 RollingFileAppender::rollover()
+{
+    if (sharedFile)
+    {
+        // Serialize with other processes sharing the file. If one of
+        // them has rolled it over already, it is enough to reopen it.
+        thread::SyncGuard<helpers::LockFile> guard (*lockFile);
+        if (! reopenIfReplaced ())
+            rolloverFile ();
+    }
+    else
+        rolloverFile ();
+}
+
+
+// Rolled over files of a shared file are compressed and removed by
+// the process that rolled them over, so no process may write into
+// a file after it has been renamed. With compression the size check
+// and the write are therefore both done under the lock file. The
+// size of the old file, as seen through our descriptor, is over the
+// limit when another process has rolled it over.
+void
+RollingFileAppender::rolloverSharedIfFull()
+{
+    if(getFileSize() > maxFileSize && ! reopenIfReplaced()) {
+        rolloverFile();
+    }
+}
+
+
+void
+RollingFileAppender::postRolloverWork(const tstring& pending, bool indexed)
+{
+    helpers::SharedObjectPtr<RolloverFilesWorkItem> work (
+        new RolloverFilesWorkItem (filename, maxBackupIndex, compression));
+    work->setCompressedFile (pending);
+    work->setDropCache (cacheTrimmer.isEnabled ());
+    work->setIndexed (indexed);
+    work->setLockFile (lockFile);
+    work->addRename (pending, filename + LOG4CPLUS_TEXT(".1"));
+    postFileWork (helpers::WorkItemPtr (work.get ()));
+}
+
+
+void
+RollingFileAppender::rolloverFile()
 {
     helpers::LogLog & loglog = getLogLog();
 
@@ -468,11 +2015,51 @@ RollingFileAppender::rollover()
     out.close();
     out.clear(); // reset flags since the C++ standard specified that all the
                  // flags should remain unchanged on a close
+    blockIndex.close();
+    bool const indexed = blockIndex.isEnabled();
+
+    if (naming != INDEX_NAMING)
+    {
+        // Other processes may have added backups.
+        if (sharedFile)
+            backupFiles->rescan ();
 
+        // Backup gets a name of its own; no existing file is renamed.
+        tstring target = backupFiles->nextName (helpers::Time::gettimeofday ());
+        long ret = file_rename (filename, target);
+        loglog_renaming_result (loglog, filename, target, ret);
+        if (ret == 0 && indexed)
+            rename_block_index (loglog, filename, target);
+
+        if (ret == 0 && backgroundRollover)
+            postFileWork (helpers::WorkItemPtr (
+                new AddBackupWorkItem (*backupFiles, target, compression,
+                    cacheTrimmer.isEnabled (), lockFile)));
+        else if (ret == 0)
+            backupFiles->add (target);
+    }
     // If maxBackups <= 0, then there is no file renaming to be done.
-    if (maxBackupIndex > 0)
+    else if (maxBackupIndex > 0 && backgroundRollover)
+    {
+        // Files abandoned by other processes are older than this one.
+        std::vector<tstring> const abandoned (claimAbandonedRollovers ());
+        for (std::size_t i = 0; i != abandoned.size (); ++i)
+            postRolloverWork (abandoned[i], indexed);
+
+        // Move the file out of the way with a single rename and let
+        // the background worker shift the backup files chain.
+        tstring pending = pending_rollover_name (filename,
+            ++rolloverSequence);
+        long ret = file_rename (filename, pending);
+        loglog_renaming_result (loglog, filename, pending, ret);
+        if (indexed)
+            rename_block_index (loglog, filename, pending);
+
+        postRolloverWork (pending, indexed);
+    }
+    else if (maxBackupIndex > 0)
     {
-        rolloverFiles(filename, maxBackupIndex);
+        rolloverFiles(filename, maxBackupIndex, tstring (), indexed);
 
         // Rename fileName to fileName.1
         tstring target = filename + LOG4CPLUS_TEXT(".1");
@@ -492,10 +2079,14 @@ RollingFileAppender::rollover()
             + target);
         ret = file_rename (filename, target);
         loglog_renaming_result (loglog, filename, target, ret);
+        if (indexed)
+            rename_block_index (loglog, filename, target);
     }
     else
     {
         loglog.debug (filename + LOG4CPLUS_TEXT(" has no backups specified"));
+        if (indexed)
+            file_remove (filename + helpers::BLOCK_INDEX_SUFFIX);
     }
 
     // Open it up again in truncation mode
@@ -551,6 +2142,8 @@ DailyRollingFileAppender::DailyRollingFileAppender(
         maxBackupIndex = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
     }
 
+    initBackgroundWork(properties);
+
     init(theSchedule);
 }
 
@@ -626,7 +2219,11 @@ DailyRollingFileAppender::~DailyRollingFileAppender()
 void
 DailyRollingFileAppender::close()
 {
-    rollover();
+    stopFormatPipeline();
+    finishSpill();
+    // A lazily opened file that has never been opened is not rolled.
+    if (activation == ACTIVE)
+        rollover();
     FileAppender::close();
 }
 
@@ -641,7 +2238,20 @@ DailyRollingFileAppender::close()
 void
 DailyRollingFileAppender::append(const spi::InternalLoggingEvent& event)
 {
-    if(event.getTimestamp() >= nextRolloverTime) {
+    if(submitFormatted(event)) {
+        return;
+    }
+
+    // See RollingFileAppender::rolloverSharedIfFull().
+    if(writesUnderLockFile()) {
+        thread::SyncGuard<helpers::LockFile> guard (*lockFile);
+        rolloverSharedIfDue(event.getTimestamp());
+        FileAppender::append(event);
+        return;
+    }
+
+    // See RollingFileAppender::append().
+    if(ownsFile() && event.getTimestamp() >= nextRolloverTime) {
         rollover();
     }
 
@@ -649,20 +2259,102 @@ DailyRollingFileAppender::append(const spi::InternalLoggingEvent& event)
 }
 
 
+void
+DailyRollingFileAppender::appendBatch(const spi::InternalLoggingEvent* events,
+    std::size_t n)
+{
+    // Rollover has to happen when the events are written.
+    if(formatPipeline) {
+        Appender::appendBatch(events, n);
+        return;
+    }
+
+    bool const locked = writesUnderLockFile();
+    std::size_t first = 0;
+    while(first != n) {
+        if(locked) {
+            lockFile->lock();
+            rolloverSharedIfDue(events[first].getTimestamp());
+        }
+        else if(ownsFile() && events[first].getTimestamp() >= nextRolloverTime) {
+            rollover();
+        }
+
+        std::size_t last = first + 1;
+        while(last != n && events[last].getTimestamp() < nextRolloverTime) {
+            ++last;
+        }
+
+        FileAppender::appendBatch(events + first, last - first);
+        if(locked) {
+            lockFile->unlock();
+        }
+        first = last;
+    }
+}
+
+
 
 void
 DailyRollingFileAppender::rollover()
+{
+    if (sharedFile)
+    {
+        // Serialize with other processes sharing the file. If one of
+        // them has rolled it over already, it is enough to reopen it.
+        thread::SyncGuard<helpers::LockFile> guard (*lockFile);
+        if (reopenIfReplaced ())
+            scheduleNextRollover ();
+        else
+            rolloverFile ();
+    }
+    else
+        rolloverFile ();
+}
+
+
+// Unlike the size, time does not tell whether another process has
+// rolled the file over already, so the file is checked on every
+// call.
+void
+DailyRollingFileAppender::rolloverSharedIfDue(const helpers::Time& t)
+{
+    if(reopenIfReplaced()) {
+        scheduleNextRollover();
+    }
+    else if(t >= nextRolloverTime) {
+        rolloverFile();
+    }
+}
+
+
+// Renames <code>target</code> to its first backup and
+// <code>pending</code> to <code>target</code> in the background.
+void
+DailyRollingFileAppender::postRolloverWork(const tstring& pending,
+    const tstring& target, bool indexed)
+{
+    helpers::SharedObjectPtr<RolloverFilesWorkItem> work (
+        new RolloverFilesWorkItem (target, maxBackupIndex, compression));
+    work->setCompressedFile (pending);
+    work->setDropCache (cacheTrimmer.isEnabled ());
+    work->setIndexed (indexed);
+    work->setLockFile (lockFile);
+    work->addRename (target, target + LOG4CPLUS_TEXT(".1"));
+    work->addRename (pending, target);
+    postFileWork (helpers::WorkItemPtr (work.get ()));
+}
+
+
+void
+DailyRollingFileAppender::rolloverFile()
 {
     // Close the current file
     out.close();
     out.clear(); // reset flags since the C++ standard specified that all the
                  // flags should remain unchanged on a close
-
-    // If we've already rolled over this time period, we'll make sure that we
-    // don't overwrite any of those previous files.
-    // E.g. if "log.2009-11-07.1" already exists we rename it
-    // to "log.2009-11-07.2", etc.
-    rolloverFiles(scheduledFilename, maxBackupIndex);
+    blockIndex.close();
+    bool const indexed = blockIndex.isEnabled();
 
     // Do not overwriet the newest file either, e.g. if "log.2009-11-07"
     // already exists rename it to "log.2009-11-07.1"
@@ -673,36 +2365,83 @@ DailyRollingFileAppender::rollover()
     helpers::LogLog & loglog = getLogLog();
     long ret;
 
+    if (backgroundRollover)
+    {
+        // Files abandoned by other processes belong to the period of
+        // their last write.
+        std::vector<tstring> const abandoned (claimAbandonedRollovers ());
+        tstring const suffix (helpers::compressedFileSuffix (compression));
+        for (std::size_t i = 0; i != abandoned.size (); ++i)
+        {
+            helpers::FileInfo fi;
+            if (helpers::getFileInfo (&fi, abandoned[i]) == 0
+                || helpers::getFileInfo (&fi, abandoned[i] + suffix) == 0)
+                postRolloverWork (abandoned[i], getFilename (fi.mtime),
+                    indexed);
+        }
+
+        // Move the file out of the way with a single rename. The
+        // renames are then done in the same order by the background
+        // worker.
+        tstring pending = pending_rollover_name (filename,
+            ++rolloverSequence);
+        ret = file_rename (filename, pending);
+        loglog_renaming_result (loglog, filename, pending, ret);
+        if (indexed)
+            rename_block_index (loglog, filename, pending);
+
+        postRolloverWork (pending, scheduledFilename, indexed);
+    }
+    else
+    {
+        // If we've already rolled over this time period, we'll make sure
+        // that we don't overwrite any of those previous files.
+        // E.g. if "log.2009-11-07.1" already exists we rename it
+        // to "log.2009-11-07.2", etc.
+        rolloverFiles(scheduledFilename, maxBackupIndex, tstring (), indexed);
+
 #if defined (WIN32)
-    // Try to remove the target first. It seems it is not
-    // possible to rename over existing file, e.g. "log.2009-11-07.1".
-    ret = file_remove (backupTarget);
+        // Try to remove the target first. It seems it is not
+        // possible to rename over existing file, e.g. "log.2009-11-07.1".
+        ret = file_remove (backupTarget);
 #endif
 
-    // Rename e.g. "log.2009-11-07" to "log.2009-11-07.1".
-    ret = file_rename (scheduledFilename, backupTarget);
-    loglog_renaming_result (loglog, scheduledFilename, backupTarget, ret);
+        // Rename e.g. "log.2009-11-07" to "log.2009-11-07.1".
+        ret = file_rename (scheduledFilename, backupTarget);
+        loglog_renaming_result (loglog, scheduledFilename, backupTarget, ret);
+        if (indexed)
+            rename_block_index (loglog, scheduledFilename, backupTarget);
 
 #if defined (WIN32)
-    // Try to remove the target first. It seems it is not
-    // possible to rename over existing file, e.g. "log.2009-11-07".
-    ret = file_remove (scheduledFilename);
+        // Try to remove the target first. It seems it is not
+        // possible to rename over existing file, e.g. "log.2009-11-07".
+        ret = file_remove (scheduledFilename);
 #endif
-   
-    // Rename filename to scheduledFilename,
-    // e.g. rename "log" to "log.2009-11-07".
-    loglog.debug(
-        LOG4CPLUS_TEXT("Renaming file ")
-        + filename 
-        + LOG4CPLUS_TEXT(" to ")
-        + scheduledFilename);
-    ret = file_rename (filename, scheduledFilename);
-    loglog_renaming_result (loglog, filename, scheduledFilename, ret);
+
+        // Rename filename to scheduledFilename,
+        // e.g. rename "log" to "log.2009-11-07".
+        loglog.debug(
+            LOG4CPLUS_TEXT("Renaming file ")
+            + filename 
+            + LOG4CPLUS_TEXT(" to ")
+            + scheduledFilename);
+        ret = file_rename (filename, scheduledFilename);
+        loglog_renaming_result (loglog, filename, scheduledFilename, ret);
+        if (indexed)
+            rename_block_index (loglog, filename, scheduledFilename);
+    }
 
     // Open a new file, e.g. "log".
     open(std::ios::out | std::ios::trunc);
     loglog_opening_result (loglog, out, filename);
 
+    scheduleNextRollover ();
+}
+
+
+void
+DailyRollingFileAppender::scheduleNextRollover()
+{
     // Calculate the next rollover time
     log4cplus::helpers::Time now = Time::gettimeofday();
     if (now >= nextRolloverTime)
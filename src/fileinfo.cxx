@@ -0,0 +1,145 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <log4cplus/helpers/fileinfo.h>
+#include <log4cplus/helpers/stringhelper.h>
+
+#ifdef LOG4CPLUS_HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef LOG4CPLUS_HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#if defined (_WIN32)
+#include <log4cplus/config/windowsh-inc.h>
+#include <tchar.h>
+#else
+#include <dirent.h>
+#endif
+
+
+namespace log4cplus { namespace helpers {
+
+
+int
+getFileInfo (FileInfo * fi, tstring const & name)
+{
+#if defined (_WIN32_WCE)
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    BOOL ret = GetFileAttributesEx (name.c_str (), GetFileExInfoStandard, &fad);
+    if (! ret)
+        return -1;
+
+    SYSTEMTIME systime;
+    ret = FileTimeToSystemTime (&fad.ftLastWriteTime, &systime);
+    if (! ret)
+        return -1;
+
+    helpers::tm tm;
+    tm.tm_isdst = 0;
+    tm.tm_yday = 0;
+    tm.tm_wday = systime.wDayOfWeek;
+    tm.tm_year = systime.wYear - 1900;
+    tm.tm_mon = systime.wMonth - 1;
+    tm.tm_mday = systime.wDay;
+    tm.tm_hour = systime.wHour;
+    tm.tm_min = systime.wMinute;
+    tm.tm_sec = systime.wSecond;
+
+    fi->mtime.setTime (&tm);
+    fi->is_link = false;
+    fi->size = (static_cast<std::streamoff>(fad.nFileSizeHigh) << 32)
+        + fad.nFileSizeLow;
+
+#elif defined (_WIN32)
+    struct _stati64 fileStatus;
+    if (_tstati64 (name.c_str (), &fileStatus) == -1)
+        return -1;
+
+    fi->mtime = Time (fileStatus.st_mtime);
+    fi->is_link = false;
+    fi->size = fileStatus.st_size;
+
+#else
+    struct stat fileStatus;
+    if (stat (LOG4CPLUS_TSTRING_TO_STRING (name).c_str (),
+            &fileStatus) == -1)
+        return -1;
+    fi->mtime = Time (fileStatus.st_mtime);
+    fi->is_link = S_ISLNK (fileStatus.st_mode);
+    fi->size = fileStatus.st_size;
+
+#endif
+
+    return 0;
+}
+
+
+bool
+listDirectory (std::vector<tstring> & names, tstring const & dir)
+{
+#if defined (_WIN32)
+    tstring pattern (dir);
+    if (! pattern.empty ())
+        pattern += LOG4CPLUS_TEXT ("\\");
+    pattern += LOG4CPLUS_TEXT ("*");
+
+    WIN32_FIND_DATA data;
+    HANDLE h = FindFirstFile (pattern.c_str (), &data);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        tstring name (data.cFileName);
+        if (name != LOG4CPLUS_TEXT (".") && name != LOG4CPLUS_TEXT (".."))
+            names.push_back (name);
+    }
+    while (FindNextFile (h, &data));
+
+    FindClose (h);
+
+#else
+    DIR * d = opendir (dir.empty ()
+        ? "." : LOG4CPLUS_TSTRING_TO_STRING (dir).c_str ());
+    if (! d)
+        return false;
+
+    while (struct dirent * ent = readdir (d))
+    {
+        std::string name (ent->d_name);
+        if (name != "." && name != "..")
+            names.push_back (LOG4CPLUS_STRING_TO_TSTRING (name));
+    }
+
+    closedir (d);
+
+#endif
+
+    return true;
+}
+
+
+} } // namespace log4cplus { namespace helpers {
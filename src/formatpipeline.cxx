@@ -0,0 +1,353 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <log4cplus/helpers/formatpipeline.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/loglevel.h>
+#include <log4cplus/streams.h>
+#include <exception>
+#include <algorithm>
+
+
+namespace log4cplus { namespace helpers {
+
+
+//
+//
+//
+
+FormatPipeline::Stage::~Stage ()
+{ }
+
+
+FormatPipeline::Slot::Slot ()
+    : event (tstring (), NOT_SET_LOG_LEVEL, tstring (), 0, 0)
+    , ready (false)
+{ }
+
+
+//
+//
+//
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+class FormatPipeline::Worker
+    : public thread::AbstractThread
+{
+public:
+    explicit Worker (FormatPipeline & p)
+        : pipeline (p)
+    { }
+
+    virtual void run ()
+    {
+        pipeline.workerLoop ();
+    }
+
+protected:
+    virtual ~Worker ()
+    { }
+
+    FormatPipeline & pipeline;
+};
+
+
+class FormatPipeline::Committer
+    : public thread::AbstractThread
+{
+public:
+    explicit Committer (FormatPipeline & p)
+        : pipeline (p)
+    { }
+
+    virtual void run ()
+    {
+        pipeline.committerLoop ();
+    }
+
+protected:
+    virtual ~Committer ()
+    { }
+
+    FormatPipeline & pipeline;
+};
+
+#endif
+
+
+FormatPipeline::FormatPipeline (Stage & stage_,
+    thread::Mutex const & ownerMutex_, unsigned workers_,
+    std::size_t capacity)
+    :
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+      ownerMutex (ownerMutex_)
+    , work_sem (static_cast<unsigned>((std::max) (capacity, std::size_t (1)))
+        + (std::max) (workers_, 1u), 0)
+    , tail_ev (false)
+    ,
+#endif
+      stage (stage_)
+    , slots ((std::max) (capacity, std::size_t (1)))
+    , head (0)
+    , next (0)
+    , tail (0)
+    , workers ((std::max) (workers_, 1u))
+    , closed (false)
+{
+#if defined (LOG4CPLUS_SINGLE_THREADED)
+    (void) ownerMutex_;
+#endif
+}
+
+
+FormatPipeline::~FormatPipeline ()
+{
+    close ();
+}
+
+
+void
+FormatPipeline::submit (spi::InternalLoggingEvent const & event)
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    // The submitting thread commits events itself when the ring is
+    // full, the workers never wait for the owner's mutex.
+    while (head - tail == slots.size ())
+        if (waitForTail ())
+            commitReady ();
+
+    {
+        thread::MutexGuard guard (slots_mutex);
+        if (! closed)
+        {
+            if (threads.empty ())
+                start ();
+
+            Slot & slot = slots[head % slots.size ()];
+            slot.event = event;
+            slot.text.clear ();
+            slot.ready = false;
+            ++head;
+            work_sem.unlock ();
+            return;
+        }
+    }
+
+    // Events still held in the ring go first.
+    flush ();
+
+#endif
+
+    tstring text;
+    stage.formatEvent (event, text);
+    stage.commitEvent (event, text);
+}
+
+
+void
+FormatPipeline::flush ()
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    while (waitForTail ())
+        commitReady ();
+#endif
+}
+
+
+void
+FormatPipeline::close ()
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    std::vector<thread::AbstractThreadPtr> to_join;
+    {
+        thread::MutexGuard guard (slots_mutex);
+        if (closed)
+            return;
+
+        closed = true;
+        to_join.swap (threads);
+    }
+
+    // Worker exits when it is woken up and there is nothing left to
+    // format, the committer exits when everything is committed.
+    if (! to_join.empty ())
+        for (unsigned i = 0; i != workers; ++i)
+            work_sem.unlock ();
+    tail_ev.signal ();
+
+    for (std::vector<thread::AbstractThreadPtr>::const_iterator it
+        = to_join.begin (); it != to_join.end (); ++it)
+        (*it)->join ();
+
+#else
+    closed = true;
+
+#endif
+}
+
+
+unsigned
+FormatPipeline::getWorkers () const
+{
+    return workers;
+}
+
+
+void
+FormatPipeline::commitReady ()
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    while (true)
+    {
+        Slot * slot;
+        {
+            thread::MutexGuard guard (slots_mutex);
+            if (tail == head || ! slots[tail % slots.size ()].ready)
+                return;
+
+            slot = &slots[tail % slots.size ()];
+        }
+
+        stage.commitEvent (slot->event, slot->text);
+
+        {
+            thread::MutexGuard guard (slots_mutex);
+            slot->ready = false;
+            ++tail;
+        }
+    }
+#endif
+}
+
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+void
+FormatPipeline::start ()
+{
+    for (unsigned i = 0; i != workers; ++i)
+        threads.push_back (thread::AbstractThreadPtr (new Worker (*this)));
+    threads.push_back (thread::AbstractThreadPtr (new Committer (*this)));
+
+    for (std::vector<thread::AbstractThreadPtr>::const_iterator it
+        = threads.begin (); it != threads.end (); ++it)
+        (*it)->start ();
+}
+
+
+bool
+FormatPipeline::waitForTail ()
+{
+    while (true)
+    {
+        {
+            thread::MutexGuard guard (slots_mutex);
+            if (tail == head)
+                return false;
+            else if (slots[tail % slots.size ()].ready)
+                return true;
+
+            tail_ev.reset ();
+        }
+
+        tail_ev.wait ();
+    }
+}
+
+
+void
+FormatPipeline::workerLoop ()
+{
+    while (true)
+    {
+        work_sem.lock ();
+
+        std::size_t seq;
+        {
+            thread::MutexGuard guard (slots_mutex);
+            if (next == head)
+                return;
+
+            seq = next++;
+        }
+
+        Slot & slot = slots[seq % slots.size ()];
+        try
+        {
+            stage.formatEvent (slot.event, slot.text);
+        }
+        catch (std::exception const & e)
+        {
+            tstring err (LOG4CPLUS_TEXT ("FormatPipeline- formatting")
+                LOG4CPLUS_TEXT (" terminated with an exception: "));
+            err += LOG4CPLUS_C_STR_TO_TSTRING (e.what ());
+            getLogLog ().error (err);
+        }
+        catch (...)
+        {
+            getLogLog ().error (LOG4CPLUS_TEXT ("FormatPipeline- formatting")
+                LOG4CPLUS_TEXT (" terminated with an exception."));
+        }
+
+        bool at_tail;
+        {
+            thread::MutexGuard guard (slots_mutex);
+            slot.ready = true;
+            at_tail = (seq == tail);
+        }
+
+        if (at_tail)
+            tail_ev.signal ();
+    }
+}
+
+
+void
+FormatPipeline::committerLoop ()
+{
+    while (true)
+    {
+        tail_ev.wait ();
+
+        {
+            thread::MutexGuard owner (ownerMutex);
+            commitReady ();
+        }
+
+        thread::MutexGuard guard (slots_mutex);
+        if (tail == head)
+        {
+            if (closed)
+                return;
+
+            tail_ev.reset ();
+        }
+        else if (! slots[tail % slots.size ()].ready)
+            tail_ev.reset ();
+    }
+}
+
+#endif
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -23,6 +23,7 @@
 #include <log4cplus/spi/loggerimpl.h>
 #include <log4cplus/spi/rootlogger.h>
 #include <utility>
+#include <set>
 #include <stdexcept>
 
 using namespace log4cplus;
@@ -243,6 +244,43 @@ Hierarchy::shutdown()
 
 
 
+SharedAppenderPtrList
+Hierarchy::getAllAppenders()
+{
+    LoggerList loggers = getCurrentLoggers();
+    loggers.push_back(root);
+
+    SharedAppenderPtrList result;
+    std::set<Appender *> seen;
+    for(LoggerList::iterator it = loggers.begin(); it != loggers.end(); ++it)
+    {
+        SharedAppenderPtrList appenders = it->getAllAppenders();
+        for(SharedAppenderPtrList::iterator ait = appenders.begin();
+            ait != appenders.end(); ++ait)
+        {
+            if(seen.insert(ait->get()).second)
+                result.push_back(*ait);
+        }
+    }
+
+    return result;
+}
+
+
+
+void
+Hierarchy::reopen()
+{
+    SharedAppenderPtrList appenders = getAllAppenders();
+    for(SharedAppenderPtrList::iterator it = appenders.begin();
+        it != appenders.end(); ++it)
+    {
+        (*it)->reopenFiles();
+    }
+}
+
+
+
 //////////////////////////////////////////////////////////////////////////////
 // log4cplus::Hierarchy private methods
 //////////////////////////////////////////////////////////////////////////////
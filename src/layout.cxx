@@ -20,9 +20,14 @@
 
 #include <log4cplus/layout.h>
 #include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/internal/internal.h>
 #include <log4cplus/helpers/timehelper.h>
 #include <log4cplus/spi/loggingevent.h>
+#include <log4cplus/thread/syncprims.h>
+#include <algorithm>
 #include <iomanip>
+#include <map>
+#include <typeinfo>
 
 
 namespace log4cplus
@@ -39,10 +44,162 @@ initializeLayout ()
 }
 
 
+namespace
+{
+
+
+//! Tracks attached layouts by format key, so that the text is kept
+//! in events only while several layouts would format it the same way.
+class FormatKeyRegistry
+{
+public:
+    void
+    add (tstring const & key, bool * shared)
+    {
+        thread::MutexGuard guard (mtx);
+        std::vector<bool *> & users = keys[key];
+        users.push_back (shared);
+        update (users);
+    }
+
+    void
+    remove (tstring const & key, bool * shared)
+    {
+        thread::MutexGuard guard (mtx);
+        KeyMap::iterator it = keys.find (key);
+        if (it == keys.end ())
+            return;
+
+        std::vector<bool *> & users = it->second;
+        users.erase (std::remove (users.begin (), users.end (), shared),
+            users.end ());
+        if (users.empty ())
+            keys.erase (it);
+        else
+            update (users);
+    }
+
+private:
+    typedef std::map<tstring, std::vector<bool *> > KeyMap;
+
+    // A layout that reads a stale flag only formats the event once
+    // more, or keeps a text nobody reuses.
+    static
+    void
+    update (std::vector<bool *> const & users)
+    {
+        bool const shared = users.size () > 1;
+        for (std::vector<bool *>::const_iterator it = users.begin ();
+             it != users.end (); ++it)
+            **it = shared;
+    }
+
+    KeyMap keys;
+    thread::Mutex mtx;
+};
+
+
+// Layouts of appenders destroyed during exit outlive function-local
+// statics, the registry is never destroyed.
+FormatKeyRegistry &
+get_format_keys ()
+{
+    static FormatKeyRegistry * registry = new FormatKeyRegistry;
+    return *registry;
+}
+
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+// log4cplus::Layout dtor
+///////////////////////////////////////////////////////////////////////////////
+
+Layout::~Layout()
+{
+    if (attached)
+        get_format_keys ().remove (sharedKey, &shareFormatted);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// log4cplus::Layout public methods
+///////////////////////////////////////////////////////////////////////////////
+
+spi::FormattedEventPtr
+Layout::formatShared(const spi::InternalLoggingEvent& event)
+{
+    bool const shared = shareFormatted;
+    if (shared)
+    {
+        spi::FormattedEventPtr text = event.getFormatted (sharedKey);
+        if (text)
+            return text;
+    }
+
+    tostringstream & oss = internal::get_ptd ()->layout_oss;
+    oss.str (internal::empty_str);
+    oss.clear ();
+    formatAndAppend (oss, event);
+
+    if (shared)
+        return event.addFormatted (sharedKey, oss.str ());
+    else
+        return spi::FormattedEventPtr (new spi::FormattedEvent (
+            internal::empty_str, oss.str (), spi::FormattedEventPtr ()));
+}
+
+
+const tstring&
+Layout::formatText(const spi::InternalLoggingEvent& event)
+{
+    if (shareFormatted)
+    {
+        lastFormatted = formatShared (event);
+        return lastFormatted->text;
+    }
+
+    lastFormatted = 0;
+    tostringstream & oss = internal::get_ptd ()->layout_oss;
+    oss.str (internal::empty_str);
+    oss.clear ();
+    formatAndAppend (oss, event);
+    formattedText = oss.str ();
+    return formattedText;
+}
+
+
+void
+Layout::attach()
+{
+    // The dynamic type is known only once the layout is constructed;
+    // a subclass may format differently than its base.
+    if (attached || formatKey.empty ())
+        return;
+
+    sharedKey = LOG4CPLUS_C_STR_TO_TSTRING (typeid (*this).name ());
+    sharedKey += LOG4CPLUS_TEXT("|");
+    sharedKey += formatKey;
+    get_format_keys ().add (sharedKey, &shareFormatted);
+    attached = true;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // log4cplus::SimpleLayout public methods
 ///////////////////////////////////////////////////////////////////////////////
 
+void
+SimpleLayout::init()
+{
+    // The output depends on the type of the layout only.
+    formatKey = LOG4CPLUS_TEXT("simple");
+}
+
+
+
 void
 SimpleLayout::formatAndAppend(log4cplus::tostream& output, 
                               const log4cplus::spi::InternalLoggingEvent& event)
@@ -63,6 +220,7 @@ TTCCLayout::TTCCLayout(bool use_gmtime_)
 : dateFormat(),
   use_gmtime(use_gmtime_)
 {
+    init();
 }
 
 
@@ -77,6 +235,15 @@ TTCCLayout::TTCCLayout(const log4cplus::helpers::Properties& properties)
 
     tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("Use_gmtime") );
     use_gmtime = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    init();
+}
+
+
+void
+TTCCLayout::init()
+{
+    formatKey = use_gmtime ? LOG4CPLUS_TEXT("gmt|") : LOG4CPLUS_TEXT("local|");
+    formatKey += dateFormat;
 }
 
 
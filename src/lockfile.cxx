@@ -0,0 +1,271 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/helpers/lockfile.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <map>
+
+#if defined (_WIN32)
+#include <log4cplus/config/windowsh-inc.h>
+#else
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+
+namespace log4cplus { namespace helpers {
+
+
+//! Lock file opened by this process. The operating system locks
+//! belong to the process and on POSIX closing any descriptor of the
+//! file drops them, so the descriptor is shared by all LockFile
+//! instances with the same name.
+struct LockFile::Shared
+{
+    Shared ()
+        : refs (0)
+        , depth (0)
+#if defined (_WIN32)
+        , handle (INVALID_HANDLE_VALUE)
+#else
+        , fd (-1)
+#endif
+    { }
+
+    thread::Mutex mtx;
+    unsigned refs;
+
+    //! Number of nested lock() calls of the thread holding
+    //! <code>mtx</code>. Guarded by <code>mtx</code>.
+    unsigned depth;
+
+#if defined (_WIN32)
+    HANDLE handle;
+#else
+    int fd;
+#endif
+};
+
+
+namespace
+{
+
+
+typedef std::map<tstring, LockFile::Shared *> SharedLockFiles;
+
+
+struct LockFileRegistry
+{
+    thread::Mutex mtx;
+    SharedLockFiles files;
+};
+
+
+LockFileRegistry &
+get_registry ()
+{
+    static LockFileRegistry registry;
+    return registry;
+}
+
+
+#if ! defined (_WIN32)
+//! Byte of the lock file locked by lock(). Bytes above it mark
+//! processes using the lock file, see LockFile::isProcessAlive().
+off_t const LOCK_OFFSET = 0;
+
+
+off_t
+process_offset (unsigned long pid)
+{
+    return LOCK_OFFSET + 1 + static_cast<off_t>(pid);
+}
+
+
+int
+set_lock (int fd, int cmd, short type, off_t offset)
+{
+    struct flock fl;
+    std::memset (&fl, 0, sizeof (fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = offset;
+    fl.l_len = 1;
+
+    int ret;
+    while ((ret = fcntl (fd, cmd, &fl)) == -1 && errno == EINTR)
+        ;
+    return ret;
+}
+#endif
+
+
+void
+open_lock_file (LockFile::Shared & shared, tstring const & name)
+{
+#if defined (_WIN32)
+    shared.handle = CreateFile (name.c_str (), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (shared.handle == INVALID_HANDLE_VALUE)
+#else
+    shared.fd = ::open (LOG4CPLUS_TSTRING_TO_STRING (name).c_str (),
+        O_RDWR | O_CREAT, 0666);
+    if (shared.fd != -1)
+    {
+        // Held until the process exits or closes the lock file.
+        set_lock (shared.fd, F_SETLK, F_RDLCK,
+            process_offset (static_cast<unsigned long>(getpid ())));
+        return;
+    }
+#endif
+        getLogLog ().error (LOG4CPLUS_TEXT ("LockFile::open()- Failed to")
+            LOG4CPLUS_TEXT (" open lock file ") + name);
+}
+
+
+void
+close_lock_file (LockFile::Shared & shared)
+{
+#if defined (_WIN32)
+    if (shared.handle != INVALID_HANDLE_VALUE)
+        CloseHandle (shared.handle);
+#else
+    if (shared.fd != -1)
+        ::close (shared.fd);
+#endif
+}
+
+
+} // namespace
+
+
+LockFile::LockFile (tstring const & name_)
+    : name (name_)
+    , shared (0)
+{
+    LockFileRegistry & registry = get_registry ();
+    thread::MutexGuard guard (registry.mtx);
+    Shared * & entry = registry.files[name];
+    if (! entry)
+    {
+        entry = new Shared;
+        open_lock_file (*entry, name);
+    }
+
+    ++entry->refs;
+    shared = entry;
+}
+
+
+LockFile::~LockFile ()
+{
+    LockFileRegistry & registry = get_registry ();
+    thread::MutexGuard guard (registry.mtx);
+    if (--shared->refs != 0)
+        return;
+
+    registry.files.erase (name);
+    close_lock_file (*shared);
+    delete shared;
+}
+
+
+void
+LockFile::lock () const
+{
+    shared->mtx.lock ();
+    if (shared->depth++ != 0)
+        return;
+
+#if defined (_WIN32)
+    if (shared->handle == INVALID_HANDLE_VALUE)
+        return;
+
+    OVERLAPPED overlapped = OVERLAPPED ();
+    if (! LockFileEx (shared->handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0,
+            &overlapped))
+#else
+    if (shared->fd == -1)
+        return;
+
+    if (set_lock (shared->fd, F_SETLKW, F_WRLCK, LOCK_OFFSET) == -1)
+#endif
+        getLogLog ().error (LOG4CPLUS_TEXT ("LockFile::lock()- Failed to")
+            LOG4CPLUS_TEXT (" lock ") + name);
+}
+
+
+void
+LockFile::unlock () const
+{
+    if (--shared->depth == 0)
+    {
+#if defined (_WIN32)
+        if (shared->handle != INVALID_HANDLE_VALUE)
+        {
+            OVERLAPPED overlapped = OVERLAPPED ();
+            UnlockFileEx (shared->handle, 0, 1, 0, &overlapped);
+        }
+#else
+        if (shared->fd != -1)
+            set_lock (shared->fd, F_SETLK, F_UNLCK, LOCK_OFFSET);
+#endif
+    }
+
+    shared->mtx.unlock ();
+}
+
+
+bool
+LockFile::isProcessAlive (unsigned long pid) const
+{
+#if defined (_WIN32)
+    (void) pid;
+    return true;
+
+#else
+    if (shared->fd == -1)
+        return true;
+
+    struct flock fl;
+    std::memset (&fl, 0, sizeof (fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = process_offset (pid);
+    fl.l_len = 1;
+    if (fcntl (shared->fd, F_GETLK, &fl) == -1)
+        return true;
+
+    return fl.l_type != F_UNLCK;
+#endif
+}
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -265,6 +265,14 @@ Logger::callAppenders (const spi::InternalLoggingEvent& event) const
 }
 
 
+void
+Logger::callAppendersBatch (const spi::InternalLoggingEvent* events,
+    std::size_t count) const
+{
+    value->callAppendersBatch (events, count);
+}
+
+
 LogLevel
 Logger::getChainedLogLevel () const
 {
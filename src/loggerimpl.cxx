@@ -76,6 +76,32 @@ LoggerImpl::callAppenders(const InternalLoggingEvent& event)
 }
 
 
+void
+LoggerImpl::callAppendersBatch(const InternalLoggingEvent* events,
+    std::size_t n)
+{
+    if (n == 0)
+        return;
+
+    int writes = 0;
+    for(const LoggerImpl* c = this; c != NULL; c=c->parent.get()) {
+        writes += c->appendBatchLoopOnAppenders(events, n);
+        if(!c->additive) {
+            break;
+        }
+    }
+
+    // No appenders in hierarchy, warn user only once.
+    if(!hierarchy.emittedNoAppenderWarning && writes == 0) {
+        getLogLog().error(  LOG4CPLUS_TEXT("No appenders could be found for logger (") 
+                          + getName() 
+                          + LOG4CPLUS_TEXT(")."));
+        getLogLog().error(LOG4CPLUS_TEXT("Please initialize the log4cplus system properly."));
+        hierarchy.emittedNoAppenderWarning = true;
+    }
+}
+
+
 void 
 LoggerImpl::closeNestedAppenders()
 {
@@ -28,6 +28,25 @@ using namespace log4cplus::spi;
 #define LOG4CPLUS_DEFAULT_TYPE 1
 
 
+///////////////////////////////////////////////////////////////////////////////
+// FormattedEvent ctor and dtor
+///////////////////////////////////////////////////////////////////////////////
+
+FormattedEvent::FormattedEvent(const log4cplus::tstring& key_,
+    const log4cplus::tstring& text_, const FormattedEventPtr& next_)
+    : key(key_)
+    , text(text_)
+    , next(next_)
+{
+}
+
+
+FormattedEvent::~FormattedEvent()
+{
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // InternalLoggingEvent dtor
 ///////////////////////////////////////////////////////////////////////////////
@@ -69,6 +88,29 @@ InternalLoggingEvent::getType() const
 
 
 
+FormattedEventPtr
+InternalLoggingEvent::getFormatted(const log4cplus::tstring& key) const
+{
+    for(FormattedEvent * it = formatted.get(); it; it = it->next.get()) {
+        if(it->key == key)
+            return FormattedEventPtr(it);
+    }
+
+    return FormattedEventPtr();
+}
+
+
+
+FormattedEventPtr
+InternalLoggingEvent::addFormatted(const log4cplus::tstring& key,
+    const log4cplus::tstring& text) const
+{
+    formatted = FormattedEventPtr(new FormattedEvent(key, text, formatted));
+    return formatted;
+}
+
+
+
 std::auto_ptr<InternalLoggingEvent>
 InternalLoggingEvent::clone() const
 {
@@ -93,6 +135,7 @@ InternalLoggingEvent::operator=(const log4cplus::spi::InternalLoggingEvent& rhs)
     timestamp = rhs.timestamp;
     file = rhs.file;
     line = rhs.line;
+    formatted = rhs.formatted;
 
     return *this;
 }
@@ -0,0 +1,510 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/socketappender.h>
+#include <algorithm>
+
+
+namespace log4cplus { namespace helpers {
+
+
+namespace
+{
+
+
+//! The encoder starts new dictionary when it reaches this size.
+std::size_t const MAX_DICTIONARY_ENTRIES = 4096;
+
+//! Longer strings are never put into the dictionary.
+std::size_t const MAX_SHARED_STRING = 256;
+
+//! Number of strings one event can add to the dictionary.
+std::size_t const EVENT_SHARED_STRINGS = 5;
+
+//! Decoder refuses dictionaries larger than this.
+std::size_t const MAX_DECODER_ENTRIES = 64 * 1024;
+
+std::size_t const FRAME_HEADER_SIZE = 2;
+
+unsigned char const SIZE_OF_CHAR = sizeof (tchar) == 1 ? 1 : 2;
+
+unsigned long const TAG_DEFINE = 0;
+unsigned long const TAG_LITERAL = 1;
+unsigned long const TAG_REFERENCE = 2;
+
+
+static
+void
+put_varint (std::vector<char> & out, unsigned long val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back (static_cast<char>((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    out.push_back (static_cast<char>(val));
+}
+
+
+static
+void
+put_svarint (std::vector<char> & out, long val)
+{
+    put_varint (out, val < 0
+        ? ~(static_cast<unsigned long>(val) << 1)
+        : static_cast<unsigned long>(val) << 1);
+}
+
+
+static
+void
+put_chars (std::vector<char> & out, tstring const & str)
+{
+    put_varint (out, static_cast<unsigned long>(str.size ()));
+#ifndef UNICODE
+    out.insert (out.end (), str.begin (), str.end ());
+#else
+    for (tstring::size_type i = 0; i != str.size (); ++i)
+    {
+        unsigned short const ch = static_cast<unsigned short>(str[i]);
+        out.push_back (static_cast<char>(ch >> 8));
+        out.push_back (static_cast<char>(ch & 0xff));
+    }
+#endif
+}
+
+
+static
+void
+put_u32 (std::vector<char> & out, unsigned long val)
+{
+    out.push_back (static_cast<char>((val >> 24) & 0xff));
+    out.push_back (static_cast<char>((val >> 16) & 0xff));
+    out.push_back (static_cast<char>((val >> 8) & 0xff));
+    out.push_back (static_cast<char>(val & 0xff));
+}
+
+
+//! Bounds checked reading of event body.
+struct BodyReader
+{
+    BodyReader (std::vector<char> const & body)
+        : p (reinterpret_cast<unsigned char const *>(&body[0]))
+        , end (p + body.size ())
+        , sizeOfChar (1)
+        , ok (true)
+    { }
+
+    unsigned char
+    byte ()
+    {
+        if (p == end)
+        {
+            ok = false;
+            return 0;
+        }
+        return *p++;
+    }
+
+    unsigned long
+    varint ()
+    {
+        unsigned long val = 0;
+        for (unsigned shift = 0; shift < sizeof (unsigned long) * 8;
+             shift += 7)
+        {
+            unsigned char const b = byte ();
+            val |= static_cast<unsigned long>(b & 0x7f) << shift;
+            if (! (b & 0x80))
+                return val;
+        }
+        ok = false;
+        return 0;
+    }
+
+    long
+    svarint ()
+    {
+        unsigned long const val = varint ();
+        return val & 1
+            ? static_cast<long>(~(val >> 1))
+            : static_cast<long>(val >> 1);
+    }
+
+    tstring
+    chars ()
+    {
+        unsigned long const len = varint ();
+        if (! ok || static_cast<unsigned long>(end - p) / sizeOfChar < len)
+        {
+            ok = false;
+            return tstring ();
+        }
+
+        tstring ret;
+        if (sizeOfChar == 1)
+        {
+#ifndef UNICODE
+            ret.assign (reinterpret_cast<char const *>(p), len);
+#else
+            ret = towstring (std::string (reinterpret_cast<char const *>(p),
+                len));
+#endif
+            p += len;
+        }
+        else
+        {
+            ret.reserve (len);
+            for (unsigned long i = 0; i != len; ++i, p += 2)
+            {
+                unsigned short const ch = static_cast<unsigned short>(
+                    (p[0] << 8) | p[1]);
+#ifndef UNICODE
+                ret += static_cast<char>(ch < 256 ? ch : ' ');
+#else
+                ret += static_cast<tchar>(ch);
+#endif
+            }
+        }
+        return ret;
+    }
+
+    unsigned char const * p;
+    unsigned char const * end;
+    unsigned sizeOfChar;
+    bool ok;
+};
+
+
+} // namespace
+
+
+//
+//
+//
+
+MessageEncoder::MessageEncoder (bool useDictionary_,
+    std::size_t maxFrameSize_)
+    : useDictionary (useDictionary_)
+    , resetPending (true)
+    , maxFrameSize (maxFrameSize_)
+{ }
+
+
+void
+MessageEncoder::reset ()
+{
+    dictionary.clear ();
+    resetPending = true;
+}
+
+
+void
+MessageEncoder::appendString (tstring const & str, bool shared)
+{
+    if (! shared || ! useDictionary || str.size () > MAX_SHARED_STRING)
+    {
+        put_varint (body, TAG_LITERAL);
+        put_chars (body, str);
+        return;
+    }
+
+    std::map<tstring, unsigned long>::iterator it = dictionary.find (str);
+    if (it != dictionary.end ())
+    {
+        put_varint (body, TAG_REFERENCE + it->second);
+        return;
+    }
+
+    unsigned long const id = static_cast<unsigned long>(dictionary.size ());
+    dictionary.insert (std::make_pair (str, id));
+    put_varint (body, TAG_DEFINE);
+    put_chars (body, str);
+}
+
+
+void
+MessageEncoder::encode (std::vector<char> & frames,
+    spi::InternalLoggingEvent const & event, tstring const & serverName)
+{
+    // Start over rather than refer to stale strings forever.
+    if (dictionary.size () + EVENT_SHARED_STRINGS > MAX_DICTIONARY_ENTRIES)
+        reset ();
+
+    body.clear ();
+    body.push_back (static_cast<char>(SIZE_OF_CHAR));
+    appendString (serverName, true);
+    appendString (event.getLoggerName (), true);
+    put_svarint (body, event.getLogLevel ());
+    appendString (event.getNDC (), true);
+    put_chars (body, event.getMessage ());
+    appendString (event.getThread (), true);
+    Time const & ts = event.getTimestamp ();
+    put_varint (body, static_cast<unsigned long>(ts.sec ()));
+    put_varint (body, static_cast<unsigned long>(ts.usec ()) * 1000);
+    appendString (event.getFile (), true);
+    put_svarint (body, event.getLine ());
+
+    std::size_t const chunk = maxFrameSize != 0
+        ? maxFrameSize - sizeof (unsigned int) - FRAME_HEADER_SIZE
+        : body.size ();
+    std::size_t offset = 0;
+    do
+    {
+        std::size_t const len = (std::min) (chunk, body.size () - offset);
+        unsigned char flags = 0;
+        if (offset == 0 && resetPending)
+            flags |= MESSAGE_FLAG_RESET;
+        if (offset != 0)
+            flags |= MESSAGE_FLAG_CONT;
+        if (offset + len != body.size ())
+            flags |= MESSAGE_FLAG_MORE;
+
+        put_u32 (frames, static_cast<unsigned long>(FRAME_HEADER_SIZE + len));
+        frames.push_back (static_cast<char>(MESSAGE_VERSION_3));
+        frames.push_back (static_cast<char>(flags));
+        frames.insert (frames.end (), body.begin () + offset,
+            body.begin () + offset + len);
+        offset += len;
+    }
+    while (offset != body.size ());
+
+    resetPending = false;
+}
+
+
+//
+//
+//
+
+void
+appendHandshake (SocketBuffer & buffer, unsigned char features)
+{
+    buffer.appendInt (
+        static_cast<unsigned>(HANDSHAKE_FRAME_SIZE - sizeof (unsigned int)));
+    buffer.appendByte (MESSAGE_HANDSHAKE);
+    buffer.appendByte (features);
+}
+
+
+bool
+parseHandshake (char const * frame, std::size_t size,
+    unsigned char & features)
+{
+    if (size != HANDSHAKE_FRAME_SIZE - sizeof (unsigned int)
+        || static_cast<unsigned char>(frame[0]) != MESSAGE_HANDSHAKE)
+        return false;
+
+    features = static_cast<unsigned char>(frame[1]);
+    return true;
+}
+
+
+tstring
+tagServerName (tstring const & peerName, tstring const & serverName)
+{
+    if (peerName.empty ())
+        return serverName;
+    else if (serverName.empty ())
+        return peerName;
+    else
+        return peerName + LOG4CPLUS_TEXT (" - ") + serverName;
+}
+
+
+//
+//
+//
+
+MessageDecoder::MessageDecoder ()
+{ }
+
+
+void
+MessageDecoder::reset ()
+{
+    dictionary.clear ();
+    body.clear ();
+}
+
+
+void
+MessageDecoder::setPeerName (tstring const & name)
+{
+    peerName = name;
+}
+
+
+bool
+MessageDecoder::decode (SocketBuffer & frame,
+    std::vector<spi::InternalLoggingEvent> & events)
+{
+    if (frame.getSize () <= frame.getPos ())
+        return false;
+
+    unsigned char const * const p = reinterpret_cast<unsigned char const *>(
+        frame.getBuffer () + frame.getPos ());
+    if (p[0] != MESSAGE_VERSION_3)
+    {
+        events.push_back (readFromBuffer (frame, peerName));
+        return true;
+    }
+
+    return decodeFrame (p, frame.getSize () - frame.getPos (), events);
+}
+
+
+bool
+MessageDecoder::decode (char const * frame, std::size_t size,
+    std::vector<spi::InternalLoggingEvent> & events)
+{
+    if (size == 0)
+        return false;
+
+    unsigned char const * const p
+        = reinterpret_cast<unsigned char const *>(frame);
+    if (p[0] != MESSAGE_VERSION_3)
+    {
+        SocketBuffer buffer (size);
+        buffer.appendBytes (frame, size);
+        buffer.clear ();
+        buffer.setSize (size);
+        events.push_back (readFromBuffer (buffer, peerName));
+        return true;
+    }
+
+    return decodeFrame (p, size, events);
+}
+
+
+bool
+MessageDecoder::decodeFrame (unsigned char const * p, std::size_t size,
+    std::vector<spi::InternalLoggingEvent> & events)
+{
+    if (size < FRAME_HEADER_SIZE)
+        return false;
+
+    unsigned char const flags = p[1];
+    if (flags & MESSAGE_FLAG_RESET)
+        dictionary.clear ();
+
+    // Parts of an event that lost its beginning are skipped.
+    if (! (flags & MESSAGE_FLAG_CONT))
+        body.clear ();
+    else if (body.empty ())
+        return true;
+
+    std::size_t const part = size - FRAME_HEADER_SIZE;
+    if (body.size () + part > MAX_DECODED_EVENT_SIZE)
+    {
+        body.clear ();
+        return false;
+    }
+
+    body.insert (body.end (), p + FRAME_HEADER_SIZE, p + size);
+    if (flags & MESSAGE_FLAG_MORE)
+        return true;
+
+    bool const ret = decodeBody (events);
+    body.clear ();
+    return ret;
+}
+
+
+bool
+MessageDecoder::decodeBody (std::vector<spi::InternalLoggingEvent> & events)
+{
+    if (body.empty ())
+        return false;
+
+    BodyReader reader (body);
+    reader.sizeOfChar = reader.byte ();
+    if (reader.sizeOfChar != 1 && reader.sizeOfChar != 2)
+        return false;
+
+    // Reads dstr, see MessageEncoder.
+    tstring strings[5];
+    std::size_t const fields = sizeof (strings) / sizeof (strings[0]);
+    LogLevel ll = NOT_SET_LOG_LEVEL;
+    tstring message;
+    unsigned long sec = 0;
+    unsigned long nsec = 0;
+    int line = 0;
+    for (std::size_t i = 0; i != fields && reader.ok; ++i)
+    {
+        unsigned long const tag = reader.varint ();
+        if (tag == TAG_DEFINE)
+        {
+            strings[i] = reader.chars ();
+            if (dictionary.size () >= MAX_DECODER_ENTRIES)
+                return false;
+            dictionary.push_back (strings[i]);
+        }
+        else if (tag == TAG_LITERAL)
+            strings[i] = reader.chars ();
+        else if (tag - TAG_REFERENCE < dictionary.size ())
+            strings[i] = dictionary[tag - TAG_REFERENCE];
+        else
+            return false;
+
+        // Fixed fields follow logger name, NDC and thread.
+        if (i == 1)
+            ll = static_cast<LogLevel>(reader.svarint ());
+        else if (i == 2)
+            message = reader.chars ();
+        else if (i == 3)
+        {
+            sec = reader.varint ();
+            nsec = reader.varint ();
+        }
+        else if (i == 4)
+            line = static_cast<int>(reader.svarint ());
+    }
+
+    if (! reader.ok || reader.p != reader.end)
+        return false;
+
+    tstring const serverName = tagServerName (peerName, strings[0]);
+    tstring ndc = strings[2];
+    if (! serverName.empty ())
+    {
+        if (ndc.empty ())
+            ndc = serverName;
+        else
+            ndc = serverName + LOG4CPLUS_TEXT (" - ") + ndc;
+    }
+
+    events.push_back (spi::InternalLoggingEvent (strings[1], ll, ndc, message,
+        strings[3], Time (static_cast<time_t>(sec),
+            static_cast<long>(nsec / 1000)), strings[4], line));
+    return true;
+}
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -241,9 +241,7 @@ NTEventLogAppender::append(const InternalLoggingEvent& event)
         return;
     }
 
-    tostringstream buf;
-    layout->formatAndAppend(buf, event);
-    tstring sz = buf.str();
+    tstring sz = layout->formatText(event);
 
     // From MSDN documentation for ReportEvent():
     // Each string is limited to 31,839 characters.
@@ -0,0 +1,194 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/helpers/pagecache.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
+
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace log4cplus { namespace helpers {
+
+
+namespace
+{
+
+
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+//! Waits for writeback of the region and drops it from the page
+//! cache. Without sync_file_range() only the pages that are already
+//! clean are dropped.
+void
+drop_range (int fd, std::streamoff offset, std::streamoff len)
+{
+#if defined (LOG4CPLUS_HAVE_SYNC_FILE_RANGE)
+    sync_file_range (fd, offset, len, SYNC_FILE_RANGE_WAIT_BEFORE
+        | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+    posix_fadvise (fd, offset, len, POSIX_FADV_DONTNEED);
+}
+
+
+//! Starts writeback of the region without waiting for it.
+void
+start_writeback (int fd, std::streamoff offset, std::streamoff len)
+{
+#if defined (LOG4CPLUS_HAVE_SYNC_FILE_RANGE)
+    sync_file_range (fd, offset, len, SYNC_FILE_RANGE_WRITE);
+#else
+    (void)fd;
+    (void)offset;
+    (void)len;
+#endif
+}
+
+#endif
+
+
+} // namespace
+
+
+PageCacheTrimmer::PageCacheTrimmer ()
+    : interval (0)
+    , fd (-1)
+    , done (0)
+    , started (0)
+{ }
+
+
+PageCacheTrimmer::~PageCacheTrimmer ()
+{
+    close ();
+}
+
+
+void
+PageCacheTrimmer::setInterval (std::streamoff interval_)
+{
+    if (interval_ != 0 && ! isPageCacheControlAvailable ())
+    {
+        getLogLog ().warn (LOG4CPLUS_TEXT ("PageCacheTrimmer- page cache")
+            LOG4CPLUS_TEXT (" control is not available on this platform"));
+        interval_ = 0;
+    }
+
+    interval = interval_ < 0 ? 0 : interval_;
+}
+
+
+void
+PageCacheTrimmer::open (tstring const & name)
+{
+    close ();
+    if (! interval)
+        return;
+
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+    fd = ::open (LOG4CPLUS_TSTRING_TO_STRING (name).c_str (), O_RDONLY);
+    if (fd == -1)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("PageCacheTrimmer::open()-")
+            LOG4CPLUS_TEXT (" Failed to open ") + name);
+        return;
+    }
+
+    off_t const end = lseek (fd, 0, SEEK_END);
+    done = started = end == static_cast<off_t>(-1) ? 0 : end;
+#else
+    (void)name;
+#endif
+}
+
+
+void
+PageCacheTrimmer::written (std::streamoff pos)
+{
+    if (! isDue (pos))
+        return;
+
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+    if (started > done)
+        drop_range (fd, done, started - done);
+
+    start_writeback (fd, started, pos - started);
+    done = started;
+    started = pos;
+#endif
+}
+
+
+void
+PageCacheTrimmer::close ()
+{
+    if (fd == -1)
+        return;
+
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+    // Kick off writeback of the tail so that whoever drops the file
+    // from the cache later does not have to wait for all of it.
+    start_writeback (fd, started, 0);
+    ::close (fd);
+#endif
+    fd = -1;
+    done = started = 0;
+}
+
+
+bool
+isPageCacheControlAvailable ()
+{
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void
+dropFileCache (tstring const & name)
+{
+#if defined (LOG4CPLUS_HAVE_POSIX_FADVISE)
+    int fd = ::open (LOG4CPLUS_TSTRING_TO_STRING (name).c_str (), O_RDONLY);
+    if (fd == -1)
+        return;
+
+#if ! defined (LOG4CPLUS_HAVE_SYNC_FILE_RANGE)
+    fdatasync (fd);
+#endif
+    drop_range (fd, 0, 0);
+    ::close (fd);
+#else
+    (void)name;
+#endif
+}
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -910,6 +910,8 @@ PatternLayout::init(const log4cplus::tstring& pattern_, unsigned ndcMaxDepth)
 {
     this->pattern = pattern_;
     this->parsedPattern = PatternParser(pattern, ndcMaxDepth).parse();
+    this->formatKey = helpers::convertIntegerToString(ndcMaxDepth)
+        + LOG4CPLUS_TEXT("|") + pattern;
 
     // Let's validate that our parser didn't give us any NULLs.  If it did,
     // we will convert them to a valid PatternConverter that does nothing so
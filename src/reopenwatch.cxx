@@ -0,0 +1,425 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/reopenwatch.h>
+#include <log4cplus/hierarchy.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/thread/syncprims.h>
+#include <log4cplus/thread/threads.h>
+#include <vector>
+
+#if ! defined (_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined (LOG4CPLUS_HAVE_POLL)
+#include <poll.h>
+#endif
+#if defined (LOG4CPLUS_HAVE_INOTIFY_INIT1)
+#include <sys/inotify.h>
+#endif
+#endif
+
+
+namespace log4cplus
+{
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+
+using helpers::getLogLog;
+
+
+#if ! defined (_WIN32)
+namespace
+{
+
+
+char const REOPEN_CMD = 'r';
+char const TERMINATE_CMD = 'q';
+
+//! Write end of the command pipe of the instance handling SIGHUP.
+int volatile sighup_fd = -1;
+
+
+extern "C"
+void
+log4cplus_sighup_handler (int)
+{
+    int const saved_errno = errno;
+    int const fd = sighup_fd;
+    if (fd != -1)
+    {
+        ssize_t ret = ::write (fd, &REOPEN_CMD, 1);
+        (void)ret;
+    }
+    errno = saved_errno;
+}
+
+
+} // namespace
+#endif
+
+
+class ReopenWatchDogThread
+    : public thread::AbstractThread
+{
+public:
+    ReopenWatchDogThread (Hierarchy & h_, unsigned triggers_,
+        unsigned millis_);
+    virtual ~ReopenWatchDogThread ();
+
+    void requestReopen ();
+    void terminate ();
+
+protected:
+    virtual void run ();
+
+private:
+    struct WatchedFile
+    {
+        tstring name;
+#if ! defined (_WIN32)
+        dev_t dev;
+        ino_t ino;
+#endif
+    };
+
+    enum Command { NO_COMMAND, REOPEN_COMMAND, TERMINATE_COMMAND };
+
+    void watchFiles ();
+    bool filesChanged () const;
+    Command waitForCommand ();
+
+    Hierarchy & h;
+    unsigned triggers;
+    unsigned millis;
+    std::vector<WatchedFile> files;
+
+#if defined (_WIN32)
+    thread::ManualResetEvent reopen_ev;
+    bool volatile terminating;
+#else
+    int cmd[2];
+    int inotify_fd;
+    bool sighup;
+    struct sigaction old_action;
+#endif
+};
+
+
+ReopenWatchDogThread::ReopenWatchDogThread (Hierarchy & h_,
+    unsigned triggers_, unsigned millis_)
+    : h (h_)
+    , triggers (triggers_)
+    , millis (millis_ < 100 ? 100 : millis_)
+#if defined (_WIN32)
+    , terminating (false)
+#else
+    , inotify_fd (-1)
+    , sighup (false)
+#endif
+{
+#if ! defined (_WIN32)
+    cmd[0] = cmd[1] = -1;
+    if (::pipe (cmd) != 0)
+    {
+        getLogLog ().error (
+            LOG4CPLUS_TEXT ("ReopenWatchThread: pipe() failed"));
+        cmd[0] = cmd[1] = -1;
+        return;
+    }
+
+    // The signal handler must never block.
+    for (int i = 0; i != 2; ++i)
+        ::fcntl (cmd[i], F_SETFD, FD_CLOEXEC);
+    ::fcntl (cmd[1], F_SETFL, ::fcntl (cmd[1], F_GETFL) | O_NONBLOCK);
+
+    if ((triggers & ReopenWatchThread::REOPEN_ON_SIGHUP) != 0)
+    {
+        if (sighup_fd != -1)
+            getLogLog ().warn (LOG4CPLUS_TEXT ("ReopenWatchThread: SIGHUP")
+                LOG4CPLUS_TEXT (" is already handled by another instance"));
+        else
+        {
+            sighup_fd = cmd[1];
+
+            struct sigaction action;
+            action.sa_handler = log4cplus_sighup_handler;
+            sigemptyset (&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            if (sigaction (SIGHUP, &action, &old_action) == 0)
+                sighup = true;
+            else
+                sighup_fd = -1;
+        }
+    }
+
+#else
+    if ((triggers & ReopenWatchThread::REOPEN_ON_SIGHUP) != 0)
+        getLogLog ().warn (LOG4CPLUS_TEXT ("ReopenWatchThread: SIGHUP")
+            LOG4CPLUS_TEXT (" is not supported on this platform"));
+#endif
+
+    // Files renamed after the constructor returns are noticed.
+    watchFiles ();
+}
+
+
+ReopenWatchDogThread::~ReopenWatchDogThread ()
+{
+#if ! defined (_WIN32)
+    if (sighup)
+    {
+        sigaction (SIGHUP, &old_action, 0);
+        sighup_fd = -1;
+    }
+
+    if (inotify_fd != -1)
+        ::close (inotify_fd);
+
+    for (int i = 0; i != 2; ++i)
+        if (cmd[i] != -1)
+            ::close (cmd[i]);
+#endif
+}
+
+
+void
+ReopenWatchDogThread::requestReopen ()
+{
+#if defined (_WIN32)
+    reopen_ev.signal ();
+#else
+    if (cmd[1] != -1)
+    {
+        ssize_t ret = ::write (cmd[1], &REOPEN_CMD, 1);
+        (void)ret;
+    }
+#endif
+}
+
+
+void
+ReopenWatchDogThread::terminate ()
+{
+#if defined (_WIN32)
+    terminating = true;
+    reopen_ev.signal ();
+#else
+    if (cmd[1] != -1)
+    {
+        // The pipe might be full of reopen requests.
+        int const flags = ::fcntl (cmd[1], F_GETFL);
+        ::fcntl (cmd[1], F_SETFL, flags & ~O_NONBLOCK);
+        ssize_t ret = ::write (cmd[1], &TERMINATE_CMD, 1);
+        (void)ret;
+        ::fcntl (cmd[1], F_SETFL, flags);
+    }
+#endif
+
+    join ();
+}
+
+
+//! Remembers files of all appenders and starts watching them.
+void
+ReopenWatchDogThread::watchFiles ()
+{
+    if ((triggers & ReopenWatchThread::REOPEN_ON_FILE_CHANGE) == 0)
+        return;
+
+    std::vector<tstring> names;
+    SharedAppenderPtrList appenders = h.getAllAppenders ();
+    for (SharedAppenderPtrList::iterator it = appenders.begin ();
+         it != appenders.end (); ++it)
+        (*it)->getFileNames (names);
+
+    files.clear ();
+
+#if ! defined (_WIN32)
+#  if defined (LOG4CPLUS_HAVE_INOTIFY_INIT1)
+    // Watches stay with renamed files; it is simpler to start over.
+    if (inotify_fd != -1)
+        ::close (inotify_fd);
+    inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+#  endif
+
+    for (std::vector<tstring>::const_iterator it = names.begin ();
+         it != names.end (); ++it)
+    {
+        std::string const name (LOG4CPLUS_TSTRING_TO_STRING (*it));
+        struct stat st;
+        if (::stat (name.c_str (), &st) != 0)
+            continue;
+
+        WatchedFile file;
+        file.name = *it;
+        file.dev = st.st_dev;
+        file.ino = st.st_ino;
+        files.push_back (file);
+
+#  if defined (LOG4CPLUS_HAVE_INOTIFY_INIT1)
+        // IN_ATTRIB reports change of link count on removal.
+        if (inotify_fd != -1)
+            inotify_add_watch (inotify_fd, name.c_str (),
+                IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+#  endif
+    }
+#endif
+}
+
+
+//! Returns true if any of the watched names refers to another file
+//! or to no file at all.
+bool
+ReopenWatchDogThread::filesChanged () const
+{
+#if ! defined (_WIN32)
+    for (std::vector<WatchedFile>::const_iterator it = files.begin ();
+         it != files.end (); ++it)
+    {
+        struct stat st;
+        if (::stat (LOG4CPLUS_TSTRING_TO_STRING (it->name).c_str (), &st) != 0
+            || st.st_dev != it->dev || st.st_ino != it->ino)
+            return true;
+    }
+#endif
+
+    return false;
+}
+
+
+//! Waits for a command, inotify event or timeout.
+ReopenWatchDogThread::Command
+ReopenWatchDogThread::waitForCommand ()
+{
+#if defined (_WIN32)
+    if (! reopen_ev.timed_wait (millis))
+        return NO_COMMAND;
+
+    reopen_ev.reset ();
+    return terminating ? TERMINATE_COMMAND : REOPEN_COMMAND;
+
+#else
+    int timeout = (triggers & ReopenWatchThread::REOPEN_ON_FILE_CHANGE) != 0
+        ? static_cast<int>(millis) : -1;
+
+#  if defined (LOG4CPLUS_HAVE_POLL)
+    struct pollfd fds[2];
+    fds[0].fd = cmd[0];
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = inotify_fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    if (::poll (fds, inotify_fd != -1 ? 2 : 1, timeout) <= 0)
+        return NO_COMMAND;
+
+    if (fds[1].revents & POLLIN)
+    {
+        // Drain the events, the files are checked by filesChanged().
+        char buf[4096];
+        while (::read (inotify_fd, buf, sizeof (buf)) > 0)
+            ;
+    }
+
+    if ((fds[0].revents & (POLLIN | POLLHUP)) == 0)
+        return NO_COMMAND;
+
+#  else
+    // Without poll() the command pipe is checked periodically.
+    if (timeout < 0)
+        timeout = static_cast<int>(millis);
+    ::fcntl (cmd[0], F_SETFL, ::fcntl (cmd[0], F_GETFL) | O_NONBLOCK);
+    ::usleep (static_cast<useconds_t>(timeout) * 1000);
+
+#  endif
+
+    Command command = NO_COMMAND;
+    char buf[64];
+    ssize_t const n = ::read (cmd[0], buf, sizeof (buf));
+    for (ssize_t i = 0; i < n; ++i)
+        if (buf[i] == TERMINATE_CMD)
+            return TERMINATE_COMMAND;
+        else if (buf[i] == REOPEN_CMD)
+            command = REOPEN_COMMAND;
+
+    return command;
+#endif
+}
+
+
+void
+ReopenWatchDogThread::run ()
+{
+    while (true)
+    {
+        Command const command = waitForCommand ();
+        if (command == TERMINATE_COMMAND)
+            break;
+
+        if (command == REOPEN_COMMAND || filesChanged ())
+        {
+            getLogLog ().debug (LOG4CPLUS_TEXT ("Reopening log files"));
+            h.reopen ();
+            watchFiles ();
+        }
+    }
+}
+
+
+ReopenWatchThread::ReopenWatchThread(unsigned triggers, Hierarchy& h,
+    unsigned int millis)
+    : watchDogThread(0)
+{
+    watchDogThread = new ReopenWatchDogThread(h, triggers, millis);
+    watchDogThread->addReference ();
+    watchDogThread->start();
+}
+
+
+ReopenWatchThread::~ReopenWatchThread()
+{
+    if (watchDogThread)
+    {
+        watchDogThread->terminate();
+        watchDogThread->removeReference ();
+    }
+}
+
+
+void
+ReopenWatchThread::requestReopen()
+{
+    watchDogThread->requestReopen();
+}
+
+
+#endif // ! defined (LOG4CPLUS_SINGLE_THREADED)
+
+} // namespace log4cplus
@@ -0,0 +1,506 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include <log4cplus/routingfileappender.h>
+#include <log4cplus/loglevel.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/spi/factory.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <cstdlib>
+
+
+namespace log4cplus
+{
+
+using helpers::Properties;
+
+
+namespace
+{
+
+//! Replaces characters that could name another directory.
+static
+void
+append_sanitized (tstring & path, tstring const & value)
+{
+    if (value.empty ())
+    {
+        path += LOG4CPLUS_TEXT ('_');
+        return;
+    }
+
+    for (tstring::size_type i = 0; i != value.size (); ++i)
+    {
+        tchar const ch = value[i];
+        bool const ok = (ch >= LOG4CPLUS_TEXT ('a') && ch <= LOG4CPLUS_TEXT ('z'))
+            || (ch >= LOG4CPLUS_TEXT ('A') && ch <= LOG4CPLUS_TEXT ('Z'))
+            || (ch >= LOG4CPLUS_TEXT ('0') && ch <= LOG4CPLUS_TEXT ('9'))
+            || ch == LOG4CPLUS_TEXT ('-') || ch == LOG4CPLUS_TEXT ('_')
+            || (ch == LOG4CPLUS_TEXT ('.') && i != 0);
+        path += ok ? ch : LOG4CPLUS_TEXT ('_');
+    }
+}
+
+
+//! Returns first \p count components of \p str separated by \p sep,
+//! or the whole \p str when \p count is 0.
+static
+tstring
+leading_components (tstring const & str, tchar sep, unsigned count)
+{
+    if (count == 0)
+        return str;
+
+    tstring::size_type pos = 0;
+    for (unsigned i = 0; i != count; ++i)
+    {
+        pos = str.find (sep, pos);
+        if (pos == tstring::npos)
+            return str;
+
+        if (i + 1 != count)
+            ++pos;
+    }
+
+    return str.substr (0, pos);
+}
+
+
+//! Returns \p n-th (from 1) component of \p str separated by \p sep,
+//! or the whole \p str when \p n is 0.
+static
+tstring
+nth_component (tstring const & str, tchar sep, unsigned n)
+{
+    if (n == 0)
+        return str;
+
+    tstring::size_type start = 0;
+    for (unsigned i = 1; i != n; ++i)
+    {
+        start = str.find (sep, start);
+        if (start == tstring::npos)
+            return tstring ();
+
+        ++start;
+    }
+
+    return str.substr (start, str.find (sep, start) - start);
+}
+
+} // namespace
+
+
+RoutingFileAppender::RoutingFileAppender(const Properties& properties)
+    : Appender(properties)
+    , routeProperties (properties)
+    , routeAppender (LOG4CPLUS_TEXT ("log4cplus::FileAppender"))
+    , maxOpenFiles (64)
+{
+    // Routes are looked up under routes_mutex and routed appenders
+    // lock themselves.
+    selfSynchronized = true;
+
+    tstring pattern = properties.getProperty( LOG4CPLUS_TEXT("File") );
+    if (pattern.empty())
+    {
+        getErrorHandler()->error( LOG4CPLUS_TEXT("Invalid filename") );
+        return;
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("RouteAppender") )) {
+        routeAppender = properties.getProperty( LOG4CPLUS_TEXT("RouteAppender") );
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("MaxOpenFiles") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("MaxOpenFiles") );
+        int value = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        if (value < 1)
+            getLogLog().warn(LOG4CPLUS_TEXT("RoutingFileAppender::ctor()-")
+                LOG4CPLUS_TEXT(" \"MaxOpenFiles\" not valid: ") + tmp);
+        else
+            maxOpenFiles = static_cast<std::size_t>(value);
+    }
+
+    if (! spi::getAppenderFactoryRegistry().get(routeAppender))
+    {
+        getErrorHandler()->error(
+            LOG4CPLUS_TEXT("Cannot find AppenderFactory: ") + routeAppender);
+        return;
+    }
+
+    // Threshold and filters have been applied by the time an event
+    // reaches a routed appender.
+    routeProperties.removeProperty( LOG4CPLUS_TEXT("RouteAppender") );
+    routeProperties.removeProperty( LOG4CPLUS_TEXT("MaxOpenFiles") );
+    routeProperties.removeProperty( LOG4CPLUS_TEXT("Threshold") );
+    std::vector<tstring> keys = routeProperties.propertyNames();
+    for (std::vector<tstring>::const_iterator it = keys.begin();
+         it != keys.end(); ++it)
+        if (it->compare(0, 8, LOG4CPLUS_TEXT("filters.")) == 0)
+            routeProperties.removeProperty(*it);
+    routeProperties.setProperty( LOG4CPLUS_TEXT("Append"),
+        LOG4CPLUS_TEXT("true") );
+
+    parsePattern(pattern);
+}
+
+
+RoutingFileAppender::~RoutingFileAppender()
+{
+    destructorImpl();
+}
+
+
+void
+RoutingFileAppender::parsePattern(const tstring& pattern)
+{
+    PathToken literal;
+    literal.type = PathToken::LITERAL;
+    literal.arg = 0;
+
+    tstring::size_type i = 0;
+    while (i != pattern.size())
+    {
+        tchar const ch = pattern[i++];
+        if (ch != LOG4CPLUS_TEXT('%') || i == pattern.size())
+        {
+            literal.literal += ch;
+            continue;
+        }
+
+        PathToken token;
+        token.arg = 0;
+        switch (pattern[i++])
+        {
+        case LOG4CPLUS_TEXT('c'):
+            token.type = PathToken::LOGGER;
+            break;
+
+        case LOG4CPLUS_TEXT('x'):
+            token.type = PathToken::NDC;
+            break;
+
+        case LOG4CPLUS_TEXT('p'):
+            token.type = PathToken::LEVEL;
+            break;
+
+        case LOG4CPLUS_TEXT('%'):
+            literal.literal += LOG4CPLUS_TEXT('%');
+            continue;
+
+        default:
+            getLogLog().warn(LOG4CPLUS_TEXT("RoutingFileAppender- unknown")
+                LOG4CPLUS_TEXT(" conversion in path pattern: ") + pattern);
+            literal.literal += ch;
+            literal.literal += pattern[i - 1];
+            continue;
+        }
+
+        if (i != pattern.size() && pattern[i] == LOG4CPLUS_TEXT('{'))
+        {
+            tstring::size_type const end = pattern.find(LOG4CPLUS_TEXT('}'), i);
+            if (end != tstring::npos)
+            {
+                tstring const arg = pattern.substr(i + 1, end - i - 1);
+                int value = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(arg).c_str());
+                token.arg = value > 0 ? static_cast<unsigned>(value) : 0;
+                i = end + 1;
+            }
+        }
+
+        if (! literal.literal.empty())
+        {
+            pathPattern.push_back(literal);
+            literal.literal.clear();
+        }
+        pathPattern.push_back(token);
+    }
+
+    if (! literal.literal.empty())
+        pathPattern.push_back(literal);
+}
+
+
+tstring
+RoutingFileAppender::expandPath(const spi::InternalLoggingEvent& event) const
+{
+    tstring path;
+    for (std::vector<PathToken>::const_iterator it = pathPattern.begin();
+         it != pathPattern.end(); ++it)
+    {
+        switch (it->type)
+        {
+        case PathToken::LITERAL:
+            path += it->literal;
+            break;
+
+        case PathToken::LOGGER:
+            append_sanitized(path, leading_components(event.getLoggerName(),
+                LOG4CPLUS_TEXT('.'), it->arg));
+            break;
+
+        case PathToken::NDC:
+            append_sanitized(path, nth_component(event.getNDC(),
+                LOG4CPLUS_TEXT(' '), it->arg));
+            break;
+
+        case PathToken::LEVEL:
+            append_sanitized(path,
+                getLogLevelManager().toString(event.getLogLevel()));
+            break;
+        }
+    }
+
+    return path;
+}
+
+
+void
+RoutingFileAppender::close()
+{
+    RouteList open;
+    {
+        thread::MutexGuard guard (routes_mutex);
+        for (RouteMap::iterator it = routes.begin(); it != routes.end(); ++it)
+            open.push_back(std::make_pair(it->first, it->second.appender));
+        routes.clear();
+        lru.clear();
+        closed = true;
+    }
+
+    for (RouteList::const_iterator it = open.begin(); it != open.end(); ++it)
+        it->second->close();
+}
+
+
+void
+RoutingFileAppender::reopenFiles()
+{
+    RouteList open;
+    {
+        thread::MutexGuard guard (routes_mutex);
+        for (RouteMap::iterator it = routes.begin(); it != routes.end(); ++it)
+            open.push_back(std::make_pair(it->first, it->second.appender));
+    }
+
+    for (RouteList::const_iterator it = open.begin(); it != open.end(); ++it)
+        it->second->reopenFiles();
+}
+
+
+void
+RoutingFileAppender::getFileNames(std::vector<tstring>& names)
+{
+    RouteList open;
+    {
+        thread::MutexGuard guard (routes_mutex);
+        for (RouteMap::iterator it = routes.begin(); it != routes.end(); ++it)
+            open.push_back(std::make_pair(it->first, it->second.appender));
+    }
+
+    for (RouteList::const_iterator it = open.begin(); it != open.end(); ++it)
+        it->second->getFileNames(names);
+}
+
+
+std::size_t
+RoutingFileAppender::getOpenRoutes() const
+{
+    thread::MutexGuard guard (routes_mutex);
+    return routes.size();
+}
+
+
+void
+RoutingFileAppender::append(const spi::InternalLoggingEvent& event)
+{
+    if (pathPattern.empty())
+        return;
+
+    tstring const path = expandPath(event);
+    SharedAppenderPtr appender = acquireRoute(path);
+    if (! appender)
+        return;
+
+    appender->doAppend(event);
+    releaseRoute(path);
+}
+
+
+SharedAppenderPtr
+RoutingFileAppender::acquireRoute(const tstring& path)
+{
+    for (;;)
+    {
+        {
+            thread::MutexGuard guard (routes_mutex);
+            if (closed)
+                return SharedAppenderPtr();
+
+            RouteMap::iterator it = routes.find(path);
+            if (it != routes.end())
+            {
+                Route & route = it->second;
+                ++route.users;
+                lru.splice(lru.begin(), lru, route.lru);
+                return route.appender;
+            }
+
+            // An evicted appender of the same file has to be closed
+            // before the file is opened again, otherwise its
+            // buffered events could end up after the new ones. Only
+            // one thread opens the route.
+            if (closing.find(path) == closing.end()
+                && opening.insert(path).second)
+                break;
+        }
+
+        helpers::sleepmillis(1);
+    }
+
+    // Opening of the file can take long, other routes stay usable
+    // meanwhile.
+    SharedAppenderPtr appender = createRoute(path);
+
+    RouteList evicted;
+    bool discard = false;
+    {
+        thread::MutexGuard guard (routes_mutex);
+        opening.erase(path);
+        if (appender && closed)
+            discard = true;
+        else if (appender)
+        {
+            lru.push_front(path);
+            Route & route = routes[path];
+            route.appender = appender;
+            route.lru = lru.begin();
+            route.users = 1;
+
+            evictRoutes(evicted);
+        }
+    }
+
+    // The appender has been closed while the route was opened.
+    if (discard)
+    {
+        appender->close();
+        return SharedAppenderPtr();
+    }
+
+    closeRoutes(evicted);
+    return appender;
+}
+
+
+void
+RoutingFileAppender::releaseRoute(const tstring& path)
+{
+    thread::MutexGuard guard (routes_mutex);
+    RouteMap::iterator it = routes.find(path);
+    if (it != routes.end() && it->second.users != 0)
+        --it->second.users;
+}
+
+
+SharedAppenderPtr
+RoutingFileAppender::createRoute(const tstring& path)
+{
+    spi::AppenderFactory * factory
+        = spi::getAppenderFactoryRegistry().get(routeAppender);
+    if (! factory)
+        return SharedAppenderPtr();
+
+    Properties props (routeProperties);
+    props.setProperty(LOG4CPLUS_TEXT("File"), path);
+
+    SharedAppenderPtr appender;
+    try {
+        appender = factory->createObject(props);
+    }
+    catch(std::exception& e) {
+        getErrorHandler()->error(
+            LOG4CPLUS_TEXT("Error while creating appender for file: ")
+            + path + LOG4CPLUS_TEXT(": ")
+            + LOG4CPLUS_C_STR_TO_TSTRING(e.what()));
+        return SharedAppenderPtr();
+    }
+    if (! appender)
+    {
+        getErrorHandler()->error(
+            LOG4CPLUS_TEXT("Failed to create appender for file: ") + path);
+        return appender;
+    }
+    appender->setName(name + LOG4CPLUS_TEXT(":") + path);
+
+    getLogLog().debug(LOG4CPLUS_TEXT("RoutingFileAppender- opened route: ")
+        + path);
+    return appender;
+}
+
+
+void
+RoutingFileAppender::evictRoutes(RouteList& evicted)
+{
+    std::list<tstring>::iterator it = lru.end();
+    while (routes.size() > maxOpenFiles && it != lru.begin())
+    {
+        --it;
+        RouteMap::iterator route = routes.find(*it);
+        if (route->second.users != 0)
+            continue;
+
+        evicted.push_back(std::make_pair(*it, route->second.appender));
+        closing.insert(*it);
+        routes.erase(route);
+        it = lru.erase(it);
+    }
+}
+
+
+void
+RoutingFileAppender::closeRoutes(const RouteList& evicted)
+{
+    for (RouteList::const_iterator it = evicted.begin();
+         it != evicted.end(); ++it)
+    {
+        getLogLog().debug(LOG4CPLUS_TEXT("RoutingFileAppender- closing")
+            LOG4CPLUS_TEXT(" least recently used route: ") + it->first);
+        it->second->close();
+    }
+
+    if (evicted.empty())
+        return;
+
+    thread::MutexGuard guard (routes_mutex);
+    for (RouteList::const_iterator it = evicted.begin();
+         it != evicted.end(); ++it)
+        closing.erase(it->first);
+}
+
+
+} // namespace log4cplus
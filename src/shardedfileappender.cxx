@@ -0,0 +1,439 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/shardedfileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/streams.h>
+#include <log4cplus/helpers/fileinfo.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <log4cplus/thread/syncprims.h>
+#include <log4cplus/thread/impl/tls.h>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+#if defined (LOG4CPLUS_HAVE_SCHED_GETCPU)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+
+namespace log4cplus
+{
+
+using helpers::Properties;
+
+
+namespace
+{
+
+
+//! Per-thread shards of all appenders. The thread local storage
+//! destructor may already be running when an appender deletes its
+//! key, so threadExit() checks that the shard is still here before
+//! touching it, and appenders remove their shards before deleting
+//! them, both with the mutex held. It is taken before
+//! <code>access_mutex</code> of the appenders.
+struct LiveShards
+{
+    thread::Mutex mtx;
+    std::set<void *> shards;
+};
+
+
+LiveShards &
+get_live_shards ()
+{
+    static LiveShards live;
+    return live;
+}
+
+
+//! Returns true if <code>name</code> is <code>prefix</code> followed
+//! by a number.
+bool
+is_numbered (tstring const & name, tstring const & prefix)
+{
+    return name.size () > prefix.size ()
+        && name.compare (0, prefix.size (), prefix) == 0
+        && name.find_first_not_of (LOG4CPLUS_TEXT("0123456789"),
+            prefix.size ()) == tstring::npos;
+}
+
+
+} // namespace
+
+
+struct ShardedFileAppender::Shard
+{
+    tstring name;
+
+    //! Records are written as bytes, so that their length prefixes
+    //! count what is actually in the file.
+    std::ofstream out;
+
+    ShardedFileAppender * owner;
+
+    //! Number of records written to this shard.
+    unsigned long sequence;
+
+    //! Serializes writers of the shard with reopenFiles(), and
+    //! threads sharing the shard in per-CPU mode. It is not
+    //! contended in per-thread mode.
+    thread::Mutex mtx;
+
+    Shard ()
+        : owner (0)
+        , sequence (0)
+    { }
+};
+
+
+struct ShardedFileAppender::ThreadKey
+{
+    thread::impl::tls_key_type key;
+};
+
+
+ShardedFileAppender::ShardedFileAppender(const tstring& filename_,
+    ShardingMode shardBy_, bool immediateFlush_, bool append_)
+    : filename (filename_)
+    , shardBy (shardBy_)
+    , immediateFlush (immediateFlush_)
+    , appendMode (append_)
+    , shardCount (0)
+    , threadKey (0)
+{
+    init ();
+}
+
+
+ShardedFileAppender::ShardedFileAppender(const Properties& properties)
+    : Appender(properties)
+    , shardBy (SHARD_BY_THREAD)
+    , immediateFlush (true)
+    , appendMode (false)
+    , shardCount (0)
+    , threadKey (0)
+{
+    filename = properties.getProperty( LOG4CPLUS_TEXT("File") );
+    if (filename.empty())
+    {
+        getErrorHandler()->error( LOG4CPLUS_TEXT("Invalid filename") );
+        return;
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("ShardBy") )) {
+        tstring tmp = helpers::toLower(
+            properties.getProperty( LOG4CPLUS_TEXT("ShardBy") ));
+        if(tmp == LOG4CPLUS_TEXT("cpu"))
+            shardBy = SHARD_BY_CPU;
+        else if(tmp != LOG4CPLUS_TEXT("thread"))
+            getLogLog().warn(LOG4CPLUS_TEXT("ShardedFileAppender::ctor()-")
+                LOG4CPLUS_TEXT(" \"ShardBy\" not valid: ") + tmp);
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("Append") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("Append") );
+        appendMode = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("ImmediateFlush") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("ImmediateFlush") );
+        immediateFlush = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+
+    init ();
+}
+
+
+void
+ShardedFileAppender::init()
+{
+    // Each shard has its own lock.
+    selfSynchronized = true;
+
+    if (! appendMode)
+        removeOldShards();
+
+#if defined (LOG4CPLUS_HAVE_SCHED_GETCPU)
+    if (shardBy == SHARD_BY_CPU)
+    {
+        long cpus = sysconf (_SC_NPROCESSORS_CONF);
+        if (cpus < 1)
+            cpus = 1;
+
+        // All shards are opened up front so that getShard() can
+        // index them without locking.
+        thread::MutexGuard guard (access_mutex);
+        for (long i = 0; i != cpus; ++i)
+        {
+            tostringstream oss;
+            oss << LOG4CPLUS_TEXT(".cpu") << i;
+            createShard (oss.str ());
+        }
+        return;
+    }
+#else
+    if (shardBy == SHARD_BY_CPU)
+    {
+        getLogLog().warn(LOG4CPLUS_TEXT("ShardedFileAppender- per-CPU")
+            LOG4CPLUS_TEXT(" shards are not available on this platform"));
+        shardBy = SHARD_BY_THREAD;
+    }
+#endif
+
+    threadKey = new ThreadKey;
+    threadKey->key = thread::impl::tls_init (&ShardedFileAppender::threadExit);
+}
+
+
+ShardedFileAppender::~ShardedFileAppender()
+{
+    destructorImpl();
+
+    // Threads exiting from now on leave their shards alone, and those
+    // that are exiting already do not find them.
+    if (threadKey)
+    {
+        LiveShards & live = get_live_shards ();
+        thread::MutexGuard live_guard (live.mtx);
+        thread::impl::tls_cleanup (threadKey->key);
+        delete threadKey;
+
+        for (std::vector<Shard *>::iterator it = shards.begin ();
+             it != shards.end (); ++it)
+            live.shards.erase (*it);
+    }
+
+    thread::MutexGuard guard (access_mutex);
+    for (std::vector<Shard *>::iterator it = shards.begin ();
+         it != shards.end (); ++it)
+        delete *it;
+}
+
+
+void
+ShardedFileAppender::close()
+{
+    thread::MutexGuard guard (access_mutex);
+
+    for (std::vector<Shard *>::iterator it = shards.begin ();
+         it != shards.end (); ++it)
+    {
+        thread::MutexGuard shard_guard ((*it)->mtx);
+        (*it)->out.close ();
+    }
+
+    closed = true;
+}
+
+
+void
+ShardedFileAppender::append(const spi::InternalLoggingEvent& event)
+{
+    Shard * shard = getShard ();
+    if (! shard)
+        return;
+
+    thread::MutexGuard guard (shard->mtx);
+    writeRecord (*shard, event);
+}
+
+
+void
+ShardedFileAppender::reopenFiles()
+{
+    thread::MutexGuard guard (access_mutex);
+    if (closed)
+        return;
+
+    for (std::vector<Shard *>::iterator it = shards.begin ();
+         it != shards.end (); ++it)
+    {
+        Shard & shard = **it;
+        thread::MutexGuard shard_guard (shard.mtx);
+        shard.out.close ();
+        shard.out.clear ();
+        shard.out.open (LOG4CPLUS_TSTRING_TO_STRING (shard.name).c_str (),
+            std::ios::out | std::ios::binary | std::ios::app);
+        if (! shard.out)
+            getErrorHandler ()->error (
+                LOG4CPLUS_TEXT ("Unable to reopen file: ") + shard.name);
+    }
+}
+
+
+void
+ShardedFileAppender::getFileNames(std::vector<tstring>& names)
+{
+    thread::MutexGuard guard (access_mutex);
+    for (std::vector<Shard *>::const_iterator it = shards.begin ();
+         it != shards.end (); ++it)
+        names.push_back ((*it)->name);
+}
+
+
+ShardedFileAppender::Shard *
+ShardedFileAppender::getShard()
+{
+#if defined (LOG4CPLUS_HAVE_SCHED_GETCPU)
+    if (shardBy == SHARD_BY_CPU)
+    {
+        int cpu = sched_getcpu ();
+        if (cpu < 0)
+            cpu = 0;
+
+        return shards[static_cast<std::size_t>(cpu) % shards.size ()];
+    }
+#endif
+
+    Shard * shard = static_cast<Shard *>(
+        thread::impl::tls_get_value (threadKey->key));
+    if (! shard)
+    {
+        LiveShards & live = get_live_shards ();
+        thread::MutexGuard live_guard (live.mtx);
+        thread::MutexGuard guard (access_mutex);
+        if (! idleShards.empty ())
+        {
+            shard = idleShards.back ();
+            idleShards.pop_back ();
+        }
+        else
+        {
+            tostringstream oss;
+            oss << LOG4CPLUS_TEXT(".shard") << shardCount++;
+            shard = createShard (oss.str ());
+            live.shards.insert (shard);
+        }
+        thread::impl::tls_set_value (threadKey->key, shard);
+    }
+
+    return shard;
+}
+
+
+ShardedFileAppender::Shard *
+ShardedFileAppender::createShard(const tstring& suffix)
+{
+    std::auto_ptr<Shard> shard (new Shard);
+    shard->name = filename + suffix;
+    shard->owner = this;
+    shard->out.open (LOG4CPLUS_TSTRING_TO_STRING (shard->name).c_str (),
+        std::ios::out | std::ios::binary
+        | (appendMode ? std::ios::app : std::ios::trunc));
+    if (! shard->out)
+        getErrorHandler ()->error (LOG4CPLUS_TEXT ("Unable to open file: ")
+            + shard->name);
+    else
+        getLogLog ().debug (LOG4CPLUS_TEXT ("Just opened file: ")
+            + shard->name);
+
+    shards.push_back (shard.get ());
+    return shard.release ();
+}
+
+
+void
+ShardedFileAppender::releaseShard(Shard * shard)
+{
+    thread::MutexGuard guard (access_mutex);
+    {
+        thread::MutexGuard shard_guard (shard->mtx);
+        shard->out.flush ();
+    }
+    idleShards.push_back (shard);
+}
+
+
+void
+ShardedFileAppender::threadExit(void * shard)
+{
+    LiveShards & live = get_live_shards ();
+    thread::MutexGuard live_guard (live.mtx);
+    if (live.shards.count (shard) == 0)
+        return;
+
+    Shard * const s = static_cast<Shard *>(shard);
+    s->owner->releaseShard (s);
+}
+
+
+void
+ShardedFileAppender::removeOldShards()
+{
+#if defined (_WIN32)
+    tstring::size_type const pos = filename.find_last_of (LOG4CPLUS_TEXT("/\\"));
+#else
+    tstring::size_type const pos = filename.rfind (LOG4CPLUS_TEXT('/'));
+#endif
+    tstring const dir (pos == tstring::npos ? tstring ()
+        : filename.substr (0, pos == 0 ? 1 : pos));
+    tstring const prefix (pos == tstring::npos ? tstring ()
+        : filename.substr (0, pos + 1));
+    tstring const base (pos == tstring::npos ? filename
+        : filename.substr (pos + 1));
+
+    std::vector<tstring> names;
+    helpers::listDirectory (names, dir);
+    for (std::vector<tstring>::const_iterator it = names.begin ();
+         it != names.end (); ++it)
+    {
+        if (! is_numbered (*it, base + LOG4CPLUS_TEXT(".shard"))
+            && ! is_numbered (*it, base + LOG4CPLUS_TEXT(".cpu")))
+            continue;
+
+        tstring const path (prefix + *it);
+        if (std::remove (LOG4CPLUS_TSTRING_TO_STRING (path).c_str ()) == 0)
+            getLogLog ().debug (LOG4CPLUS_TEXT ("Removed old shard ")
+                + path);
+    }
+}
+
+
+void
+ShardedFileAppender::writeRecord(Shard& shard,
+    const spi::InternalLoggingEvent& event)
+{
+    spi::FormattedEventPtr const formatted = layout->formatShared (event);
+    std::string const & text = LOG4CPLUS_TSTRING_TO_STRING (formatted->text);
+
+    helpers::Time const & ts = event.getTimestamp ();
+    shard.out << ts.sec () << '.'
+        << std::setw (6) << std::setfill ('0') << ts.usec ()
+        << ' ' << ++shard.sequence
+        << ' ' << text.size ()
+        << ' ';
+    shard.out.write (text.data (), static_cast<std::streamsize>(text.size ()));
+
+    if (immediateFlush)
+        shard.out.flush ();
+}
+
+
+} // namespace log4cplus
@@ -0,0 +1,176 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <log4cplus/sharedmemoryappender.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <cstdlib>
+
+
+namespace log4cplus
+{
+
+namespace
+{
+
+int const SHARED_MEMORY_MESSAGE_VERSION = 2;
+
+} // namespace
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SharedMemoryAppender ctors and dtor
+//////////////////////////////////////////////////////////////////////////////
+
+SharedMemoryAppender::SharedMemoryAppender(const tstring& ringName,
+    const tstring& serverName_)
+: serverName(serverName_),
+  protocolVersion(SHARED_MEMORY_MESSAGE_VERSION),
+  eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int)),
+  recordBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE),
+  encoder(false),
+  droppedEvents(0)
+{
+    init(ringName, LOG4CPLUS_SHARED_RING_SIZE);
+}
+
+
+SharedMemoryAppender::SharedMemoryAppender(const helpers::Properties & properties)
+ : Appender(properties),
+   protocolVersion(SHARED_MEMORY_MESSAGE_VERSION),
+   eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int)),
+   recordBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE),
+   encoder(false),
+   droppedEvents(0)
+{
+    tstring ringName = LOG4CPLUS_TEXT("/log4cplus");
+    if(properties.exists( LOG4CPLUS_TEXT("Name") )) {
+        ringName = properties.getProperty( LOG4CPLUS_TEXT("Name") );
+    }
+
+    std::size_t size = LOG4CPLUS_SHARED_RING_SIZE;
+    if(properties.exists( LOG4CPLUS_TEXT("Size") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("Size") );
+        size = static_cast<std::size_t>(helpers::parseFileSize(tmp));
+    }
+
+    serverName = properties.getProperty( LOG4CPLUS_TEXT("ServerName") );
+
+    if(properties.exists( LOG4CPLUS_TEXT("ProtocolVersion") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("ProtocolVersion") );
+        protocolVersion = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        if (protocolVersion != SHARED_MEMORY_MESSAGE_VERSION
+            && protocolVersion != helpers::MESSAGE_VERSION_3)
+        {
+            getLogLog().warn(LOG4CPLUS_TEXT("SharedMemoryAppender- Unknown")
+                LOG4CPLUS_TEXT(" \"ProtocolVersion\" ") + tmp);
+            protocolVersion = SHARED_MEMORY_MESSAGE_VERSION;
+        }
+    }
+
+    init(ringName, size);
+}
+
+
+SharedMemoryAppender::~SharedMemoryAppender()
+{
+    destructorImpl();
+}
+
+
+void
+SharedMemoryAppender::init(const tstring& ringName, std::size_t size)
+{
+    ring.reset(new helpers::SharedRing(ringName, size));
+    if (! ring->isOpen())
+        getLogLog().error(LOG4CPLUS_TEXT("SharedMemoryAppender- Cannot open")
+            LOG4CPLUS_TEXT(" shared memory ring, events will be dropped"));
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SharedMemoryAppender public methods
+//////////////////////////////////////////////////////////////////////////////
+
+void
+SharedMemoryAppender::close()
+{
+    getLogLog().debug(LOG4CPLUS_TEXT("Entering SharedMemoryAppender::close()..."));
+
+    // The ring stays for the reader, only this mapping goes.
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    ring.reset();
+    closed = true;
+}
+
+
+unsigned long
+SharedMemoryAppender::getDroppedEvents() const
+{
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    return droppedEvents;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SharedMemoryAppender protected methods
+//////////////////////////////////////////////////////////////////////////////
+
+void
+SharedMemoryAppender::append(const spi::InternalLoggingEvent& event)
+{
+    if (! ring.get())
+    {
+        ++droppedEvents;
+        return;
+    }
+
+    bool written;
+    if (protocolVersion == helpers::MESSAGE_VERSION_3)
+    {
+        eventFrames.clear();
+        encoder.encode(eventFrames, event, serverName);
+        written = ring->write(&eventFrames[0], eventFrames.size());
+    }
+    else
+    {
+        eventBuffer.clear();
+        helpers::convertToBuffer(eventBuffer, event, serverName);
+        recordBuffer.clear();
+        recordBuffer.appendInt(static_cast<unsigned>(eventBuffer.getSize()));
+        recordBuffer.appendBuffer(eventBuffer);
+        written = ring->write(recordBuffer.getBuffer(), recordBuffer.getSize());
+    }
+
+    if (! written)
+        ++droppedEvents;
+}
+
+
+} // namespace log4cplus
@@ -0,0 +1,561 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/helpers/sharedring.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/sleep.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined (LOG4CPLUS_HAVE_SHM_OPEN) \
+    && defined (LOG4CPLUS_HAVE___SYNC_ADD_AND_FETCH)
+#define LOG4CPLUS_HAVE_SHARED_RING
+#include <cerrno>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+
+namespace log4cplus { namespace helpers {
+
+
+namespace
+{
+
+unsigned const RING_MAGIC = 0x4c345247; // "L4RG"
+unsigned const RING_VERSION = 2;
+
+//! Space before the records, it holds SharedRing::Header.
+std::size_t const HEADER_SPACE = 4096;
+
+std::size_t const MIN_RING_SIZE = 4096;
+std::size_t const MAX_RING_SIZE = 1024 * 1024 * 1024;
+
+//! Each record starts with 64 bit header word, which keeps the
+//! records 8 bytes aligned. Its upper half holds the size and flags,
+//! its lower half the writer id shifted left by one. Free space holds
+//! in each word its position the next time it is free with the lowest
+//! bit set, see free_word().
+std::size_t const RECORD_HEADER_SIZE = 8;
+unsigned const RECORD_COMMITTED = 0x80000000u;
+unsigned const RECORD_PADDING = 0x40000000u;
+unsigned const RECORD_SIZE_MASK = 0x3fffffffu;
+
+//! Number of writer slots. A writer id is the slot in its lowest 8
+//! bits and the slot's generation above them.
+unsigned const WRITER_SLOTS = 256;
+unsigned const WRITER_GENERATION_MASK = 0xffff;
+unsigned const NO_WRITER = 0x7fffffffu;
+
+//! Milliseconds to wait for another process to finish creating the
+//! ring.
+int const CREATE_WAIT = 1000;
+
+
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+typedef uint64_t RecordWord;
+RecordWord const RECORD_FREE = 1;
+
+
+std::size_t
+align_record (std::size_t size)
+{
+    return (size + RECORD_HEADER_SIZE - 1) & ~(RECORD_HEADER_SIZE - 1);
+}
+
+
+RecordWord volatile *
+record_word (char * record)
+{
+    return reinterpret_cast<RecordWord volatile *>(record);
+}
+
+
+//! Content of the free word at position <code>pos</code>. A writer
+//! that read the end of the reserved space before somebody else
+//! moved it cannot claim a record there, because the word no longer
+//! holds the position it expects.
+RecordWord
+free_word (std::size_t pos)
+{
+    return static_cast<RecordWord>(pos) | RECORD_FREE;
+}
+
+
+RecordWord
+claim_word (unsigned flags_size, unsigned writer)
+{
+    return static_cast<RecordWord>(flags_size) << 32
+        | static_cast<RecordWord>(writer) << 1;
+}
+
+
+unsigned
+record_flags_size (RecordWord word)
+{
+    return static_cast<unsigned>(word >> 32);
+}
+
+
+unsigned
+record_writer (RecordWord word)
+{
+    return static_cast<unsigned>(word) >> 1;
+}
+
+
+//! Returns length of the whole record claimed by the word.
+std::size_t
+record_length (RecordWord word)
+{
+    return RECORD_HEADER_SIZE
+        + align_record (record_flags_size (word) & RECORD_SIZE_MASK);
+}
+
+
+#if defined (F_OFD_SETLK)
+int
+set_slot_lock (int fd, int cmd, struct flock & fl, unsigned slot)
+{
+    std::memset (&fl, 0, sizeof (fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = static_cast<off_t>(slot);
+    fl.l_len = 1;
+
+    int ret;
+    while ((ret = fcntl (fd, cmd, &fl)) == -1 && errno == EINTR)
+        ;
+    return ret;
+}
+
+#endif
+#endif
+
+} // namespace
+
+
+//! Layout of the start of the shared memory. The counters grow
+//! without bound, position in the ring is counter modulo size. They
+//! are on separate cache lines, so the writers and the reader do not
+//! contend for them.
+struct SharedRing::Header
+{
+    unsigned volatile magic;
+    unsigned version;
+    std::size_t size;
+    char pad1[64];
+
+    //! End of reserved space, advanced by writers.
+    std::size_t volatile reserved;
+    char pad2[64];
+
+    //! Start of unread records, advanced by the reader.
+    std::size_t volatile consumed;
+    unsigned long volatile abandoned;
+    char pad3[64];
+
+    unsigned long volatile dropped;
+
+    //! Incremented each time a writer takes the slot.
+    unsigned volatile generations[WRITER_SLOTS];
+};
+
+
+SharedRing::SharedRing (tstring const & name, std::size_t size)
+    : header (0)
+    , data (0)
+    , mapSize (0)
+    , fd (-1)
+    , writer (NO_WRITER)
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    std::size_t ringSize = MIN_RING_SIZE;
+    while (ringSize < size && ringSize < MAX_RING_SIZE)
+        ringSize *= 2;
+
+    std::string const shmName = LOG4CPLUS_TSTRING_TO_STRING (name);
+    bool created = true;
+    fd = shm_open (shmName.c_str (), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd == -1 && errno == EEXIST)
+    {
+        created = false;
+        fd = shm_open (shmName.c_str (), O_RDWR, 0);
+    }
+    if (fd == -1)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SharedRing- Cannot open ")
+            + name);
+        return;
+    }
+
+    if (created)
+    {
+        mapSize = HEADER_SPACE + ringSize;
+        if (ftruncate (fd, static_cast<off_t>(mapSize)) != 0)
+            mapSize = 0;
+    }
+    else
+    {
+        // The creator may not have sized it yet.
+        struct stat st;
+        for (int i = 0; i != CREATE_WAIT; ++i)
+        {
+            if (fstat (fd, &st) == 0
+                && static_cast<std::size_t>(st.st_size) > HEADER_SPACE)
+            {
+                mapSize = static_cast<std::size_t>(st.st_size);
+                break;
+            }
+            sleepmillis (1);
+        }
+    }
+
+    void * p = mapSize != 0
+        ? mmap (0, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+    if (p == MAP_FAILED)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SharedRing- Cannot map ")
+            + name);
+        if (created)
+            shm_unlink (shmName.c_str ());
+        ::close (fd);
+        fd = -1;
+        return;
+    }
+
+    Header * h = static_cast<Header *>(p);
+    char * const records = static_cast<char *>(p) + HEADER_SPACE;
+    if (created)
+    {
+        // New memory is zeroed; the magic is written last.
+        h->version = RING_VERSION;
+        h->size = ringSize;
+        for (std::size_t pos = 0; pos != ringSize; pos += RECORD_HEADER_SIZE)
+            *record_word (records + pos) = free_word (pos);
+        __sync_synchronize ();
+        h->magic = RING_MAGIC;
+    }
+    else
+    {
+        for (int i = 0; i != CREATE_WAIT && h->magic != RING_MAGIC; ++i)
+            sleepmillis (1);
+        __sync_synchronize ();
+
+        if (h->magic != RING_MAGIC || h->version != RING_VERSION
+            || HEADER_SPACE + h->size != mapSize)
+        {
+            getLogLog ().error (name
+                + LOG4CPLUS_TEXT (" is not a log4cplus shared memory ring"));
+            munmap (p, mapSize);
+            ::close (fd);
+            fd = -1;
+            return;
+        }
+    }
+
+    header = h;
+    data = records;
+    openWriterSlot ();
+    if (writer == NO_WRITER)
+        getLogLog ().error (LOG4CPLUS_TEXT ("SharedRing- No free writer")
+            LOG4CPLUS_TEXT (" slot in ") + name);
+
+#else
+    (void)size;
+    getLogLog ().error (LOG4CPLUS_TEXT ("SharedRing- Shared memory is not")
+        LOG4CPLUS_TEXT (" supported, cannot open ") + name);
+
+#endif
+}
+
+
+SharedRing::~SharedRing ()
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    if (header)
+        munmap (header, mapSize);
+    // Closing the descriptor releases the writer slot.
+    if (fd != -1)
+        ::close (fd);
+#endif
+}
+
+
+void
+SharedRing::openWriterSlot ()
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+#if defined (F_OFD_SETLK)
+    // The lock belongs to this instance's open file description, so it
+    // is held as long as the descriptor is open, also by forked
+    // children, and other processes see it in any PID namespace.
+    struct flock fl;
+    for (unsigned slot = 0; slot != WRITER_SLOTS; ++slot)
+        if (set_slot_lock (fd, F_OFD_SETLK, fl, slot) == 0)
+        {
+            unsigned const generation = __sync_add_and_fetch (
+                &header->generations[slot], 1) & WRITER_GENERATION_MASK;
+            writer = generation << 8 | slot;
+            return;
+        }
+
+#else
+    writer = static_cast<unsigned>(getpid ());
+
+#endif
+#endif
+}
+
+
+bool
+SharedRing::isWriterAlive (unsigned id) const
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    if (id == writer)
+        return true;
+
+#if defined (F_OFD_SETLK)
+    // A slot that is locked by a writer which took it after this one
+    // has moved on to the next generation.
+    unsigned const slot = id & (WRITER_SLOTS - 1);
+    struct flock fl;
+    if (set_slot_lock (fd, F_OFD_GETLK, fl, slot) == -1)
+        return true;
+
+    return fl.l_type != F_UNLCK
+        && (header->generations[slot] & WRITER_GENERATION_MASK) == id >> 8;
+
+#else
+    // A process that exists but cannot be signalled by this one is
+    // taken as alive.
+    return kill (static_cast<pid_t>(id), 0) == 0 || errno != ESRCH;
+
+#endif
+#else
+    (void)id;
+    return true;
+
+#endif
+}
+
+
+std::size_t
+SharedRing::getMaxRecordSize () const
+{
+    // With the padding at the end of the ring a record can take twice
+    // its size; a quarter of the ring keeps room for the others.
+    if (! header)
+        return 0;
+    return (std::min) (header->size / 4, std::size_t (RECORD_SIZE_MASK))
+        - RECORD_HEADER_SIZE;
+}
+
+
+bool
+SharedRing::write (char const * src, std::size_t size)
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    if (! header)
+        return false;
+
+    if (size > getMaxRecordSize () || writer == NO_WRITER)
+    {
+        __sync_add_and_fetch (&header->dropped, 1);
+        return false;
+    }
+
+    std::size_t const ringSize = header->size;
+    std::size_t const need = RECORD_HEADER_SIZE + align_record (size);
+    std::size_t pos;
+    char * record;
+    while (true)
+    {
+        pos = header->reserved;
+        std::size_t const used = pos - header->consumed;
+
+        // The reader went past the reservation read above.
+        if (used > ringSize)
+            continue;
+
+        std::size_t const room = ringSize - (pos & (ringSize - 1));
+        std::size_t const gap = room < need ? room : 0;
+        if (used + gap + need > ringSize)
+        {
+            __sync_add_and_fetch (&header->dropped, 1);
+            return false;
+        }
+
+        // The claim succeeds only while pos is the end of the reserved
+        // space, see free_word().
+        record = data + (pos & (ringSize - 1));
+        RecordWord const claim = gap != 0
+            ? claim_word (static_cast<unsigned>(gap - RECORD_HEADER_SIZE)
+                | RECORD_PADDING | RECORD_COMMITTED, writer)
+            : claim_word (static_cast<unsigned>(size), writer);
+        RecordWord const word = __sync_val_compare_and_swap (
+            record_word (record), free_word (pos), claim);
+        bool const claimed = word == free_word (pos);
+
+        // Move the end of the reserved space past the claimed record,
+        // whoever claimed it.
+        if (claimed || ! (word & RECORD_FREE))
+            __sync_bool_compare_and_swap (&header->reserved, pos,
+                pos + record_length (claimed ? claim : word));
+
+        if (claimed && gap == 0)
+            break;
+    }
+
+    std::memcpy (record + RECORD_HEADER_SIZE, src, size);
+    __sync_synchronize ();
+    *record_word (record) = claim_word (
+        static_cast<unsigned>(size) | RECORD_COMMITTED, writer);
+    return true;
+
+#else
+    (void)src;
+    (void)size;
+    return false;
+
+#endif
+}
+
+
+bool
+SharedRing::read (std::vector<char> & record)
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    if (! header)
+        return false;
+
+    std::size_t const ringSize = header->size;
+    while (true)
+    {
+        std::size_t const pos = header->consumed;
+        std::size_t const end = header->reserved;
+        char * const rec = data + (pos & (ringSize - 1));
+        RecordWord const word = *record_word (rec);
+        if (word & RECORD_FREE)
+            return false;
+
+        // A writer died before it moved the end past its claim.
+        if (pos == end)
+        {
+            __sync_bool_compare_and_swap (&header->reserved, pos,
+                pos + record_length (word));
+            continue;
+        }
+
+        unsigned const flagsSize = record_flags_size (word);
+        if (flagsSize & RECORD_COMMITTED)
+        {
+            __sync_synchronize ();
+            bool const padding = (flagsSize & RECORD_PADDING) != 0;
+            std::size_t const size = flagsSize & RECORD_SIZE_MASK;
+            if (! padding)
+                record.assign (rec + RECORD_HEADER_SIZE,
+                    rec + RECORD_HEADER_SIZE + size);
+            release (pos, record_length (word));
+            if (padding)
+                continue;
+            return true;
+        }
+
+        // The writer is still at it, unless it is gone.
+        if (isWriterAlive (record_writer (word)))
+            return false;
+
+        getLogLog ().warn (LOG4CPLUS_TEXT ("SharedRing- Skipping record")
+            LOG4CPLUS_TEXT (" of crashed writer"));
+        release (pos, record_length (word));
+        header->abandoned = header->abandoned + 1;
+    }
+
+#else
+    (void)record;
+    return false;
+
+#endif
+}
+
+
+void
+SharedRing::release (std::size_t pos, std::size_t len)
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    std::size_t const ringSize = header->size;
+    for (std::size_t const stop = pos + len; pos != stop;
+         pos += RECORD_HEADER_SIZE)
+        *record_word (data + (pos & (ringSize - 1)))
+            = free_word (pos + ringSize);
+
+    // The free words must be in place before writers reuse the space.
+    __sync_synchronize ();
+    header->consumed = pos;
+
+#else
+    (void)pos;
+    (void)len;
+
+#endif
+}
+
+
+unsigned long
+SharedRing::getDropped () const
+{
+    return header ? header->dropped : 0;
+}
+
+
+unsigned long
+SharedRing::getAbandoned () const
+{
+    return header ? header->abandoned : 0;
+}
+
+
+bool
+SharedRing::remove (tstring const & name)
+{
+#if defined (LOG4CPLUS_HAVE_SHARED_RING)
+    return shm_unlink (LOG4CPLUS_TSTRING_TO_STRING (name).c_str ()) == 0;
+
+#else
+    (void)name;
+    return false;
+
+#endif
+}
+
+
+} } // namespace log4cplus { namespace helpers {
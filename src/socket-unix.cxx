@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <log4cplus/internal/socket.h>
 #include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
 #include <log4cplus/thread/threads.h>
 #include <log4cplus/spi/loggingevent.h>
 
@@ -55,6 +56,18 @@
 #endif
 
 #include <unistd.h>
+#include <fcntl.h>
+
+#if defined (LOG4CPLUS_HAVE_POLL)
+#include <poll.h>
+#endif
+
+#if defined (LOG4CPLUS_HAVE_SENDMMSG)
+#include <sys/uio.h>
+#endif
+
+#include <sys/stat.h>
+#include <sys/un.h>
 
 
 namespace log4cplus { namespace helpers {
@@ -159,7 +172,7 @@ openSocket(unsigned short port, SocketState& state)
     if (retval < 0)
         return INVALID_SOCKET_VALUE;
 
-    if (::listen(sock, 10))
+    if (::listen(sock, SOMAXCONN))
         return INVALID_SOCKET_VALUE;
 
     state = ok;
@@ -168,7 +181,8 @@ openSocket(unsigned short port, SocketState& state)
 
 
 SOCKET_TYPE
-connectSocket(const tstring& hostn, unsigned short port, SocketState& state)
+connectSocket(const tstring& hostn, unsigned short port, SocketState& state,
+    unsigned long timeout)
 {
     struct sockaddr_in server;
     int sock;
@@ -188,6 +202,14 @@ connectSocket(const tstring& hostn, unsigned short port, SocketState& state)
         return INVALID_SOCKET_VALUE;
     }
 
+#if defined (LOG4CPLUS_HAVE_POLL)
+    // With timeout, the socket connects in non-blocking mode and the
+    // connection is waited for with poll().
+    int const flags = timeout ? ::fcntl (sock, F_GETFL) : -1;
+    if (flags != -1)
+        ::fcntl (sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+
     socklen_t namelen = sizeof (server);
     while (
         (retval = ::connect(sock, reinterpret_cast<struct sockaddr*>(&server),
@@ -195,9 +217,41 @@ connectSocket(const tstring& hostn, unsigned short port, SocketState& state)
         == -1
         && (errno == EINTR))
         ;
+
+#if defined (LOG4CPLUS_HAVE_POLL)
+    if (flags != -1)
+    {
+        if (retval == -1 && errno == EINPROGRESS)
+        {
+            struct pollfd fds;
+            fds.fd = sock;
+            fds.events = POLLOUT;
+            fds.revents = 0;
+            while ((retval = ::poll (&fds, 1, static_cast<int>(timeout))) == -1
+                && errno == EINTR)
+                ;
+
+            int so_error = ETIMEDOUT;
+            socklen_t so_error_len = sizeof (so_error);
+            if (retval == 1)
+                ::getsockopt (sock, SOL_SOCKET, SO_ERROR, &so_error,
+                    &so_error_len);
+
+            retval = so_error == 0 ? 0 : -1;
+            if (retval == -1)
+                errno = so_error;
+        }
+
+        if (retval == 0)
+            ::fcntl (sock, F_SETFL, flags);
+    }
+#endif
+
     if (retval == INVALID_OS_SOCKET_VALUE) 
     {
+        int const eno = errno;
         ::close(sock);
+        errno = eno;
         return INVALID_SOCKET_VALUE;
     }
 
@@ -301,15 +355,333 @@ read(SOCKET_TYPE sock, SocketBuffer& buffer)
 
 
 long
-write(SOCKET_TYPE sock, const SocketBuffer& buffer)
+write(SOCKET_TYPE sock, const SocketBuffer& buffer, std::size_t recordSize)
+{
+#if defined(MSG_NOSIGNAL)
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    // Blocking send() can still write only a part of the buffer, e.g.
+    // when it is interrupted or the send timeout expires.
+    std::size_t written = 0;
+    while (written < buffer.getSize())
+    {
+        std::size_t size = buffer.getSize() - written;
+        if (recordSize != 0 && size > recordSize)
+            size = recordSize;
+
+        long res = ::send( to_os_socket (sock), buffer.getBuffer() + written,
+            size, flags );
+        if (res == -1 && errno == EINTR)
+            continue;
+        else if (res <= 0)
+            return res;
+
+        written += res;
+    }
+
+    return static_cast<long>(written);
+}
+
+
+namespace
+{
+
+//! Fills in the address of the Unix domain socket at the path.
+static
+bool
+make_local_address (tstring const & path, struct sockaddr_un * addr)
+{
+    std::string const name = LOG4CPLUS_TSTRING_TO_STRING (path);
+    if (name.empty () || name.size () >= sizeof (addr->sun_path))
+        return false;
+
+    std::memset (addr, 0, sizeof (*addr));
+    addr->sun_family = AF_UNIX;
+    std::memcpy (addr->sun_path, name.c_str (), name.size ());
+    return true;
+}
+
+
+static
+int
+local_socket_type (LocalSocketType type)
+{
+    return type == local_seqpacket ? SOCK_SEQPACKET : SOCK_STREAM;
+}
+
+
+//! Tells whether the socket at the address was left behind by a
+//! server that is gone, i.e. connections to it are refused.
+static
+bool
+is_stale_local_socket (struct sockaddr_un const & addr, int type)
+{
+    int sock = ::socket(AF_UNIX, type, 0);
+    if (sock < 0)
+        return false;
+
+    int retval;
+    while ((retval = ::connect(sock,
+                reinterpret_cast<struct sockaddr const *>(&addr),
+                sizeof(addr)))
+        == -1
+        && errno == EINTR)
+        ;
+
+    int const eno = errno;
+    ::close(sock);
+    return retval == -1 && eno == ECONNREFUSED;
+}
+
+} // namespace
+
+
+SOCKET_TYPE
+openLocalSocket(const tstring& path, LocalSocketType type, SocketState& state)
+{
+    struct sockaddr_un server;
+    if (! make_local_address (path, &server))
+    {
+        state = bad_address;
+        return INVALID_SOCKET_VALUE;
+    }
+
+    int sock = ::socket(AF_UNIX, local_socket_type (type), 0);
+    if(sock < 0) {
+        return INVALID_SOCKET_VALUE;
+    }
+
+    // Socket of a server that did not exit cleanly stays behind and
+    // makes bind() fail. It is removed only if nobody listens on it
+    // any more; other files and sockets in use are left alone.
+    struct stat st;
+    if (::lstat (server.sun_path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+        if (! is_stale_local_socket (server, local_socket_type (type)))
+        {
+            ::close(sock);
+            set_last_socket_error (EADDRINUSE);
+            return INVALID_SOCKET_VALUE;
+        }
+        ::unlink (server.sun_path);
+    }
+
+    if (bind(sock, reinterpret_cast<struct sockaddr*>(&server),
+            sizeof(server)) < 0
+        || ::listen(sock, SOMAXCONN) < 0)
+    {
+        int const eno = errno;
+        ::close(sock);
+        set_last_socket_error (eno);
+        return INVALID_SOCKET_VALUE;
+    }
+
+    state = ok;
+    return to_log4cplus_socket (sock);
+}
+
+
+SOCKET_TYPE
+connectLocalSocket(const tstring& path, LocalSocketType type,
+    SocketState& state)
+{
+    struct sockaddr_un server;
+    if (! make_local_address (path, &server))
+    {
+        state = bad_address;
+        return INVALID_SOCKET_VALUE;
+    }
+
+    int sock = ::socket(AF_UNIX, local_socket_type (type), 0);
+    if(sock < 0) {
+        return INVALID_SOCKET_VALUE;
+    }
+
+    int retval;
+    while ((retval = ::connect(sock,
+                reinterpret_cast<struct sockaddr*>(&server), sizeof(server)))
+        == -1
+        && errno == EINTR)
+        ;
+
+    if (retval == -1)
+    {
+        int const eno = errno;
+        ::close(sock);
+        set_last_socket_error (eno);
+        state = connection_failed;
+        return INVALID_SOCKET_VALUE;
+    }
+
+    state = ok;
+    return to_log4cplus_socket (sock);
+}
+
+
+tstring
+getLocalPeerName(SOCKET_TYPE sock)
+{
+#if defined (SO_PEERCRED)
+    struct ucred cred;
+    socklen_t len = sizeof (cred);
+    if (::getsockopt (to_os_socket (sock), SOL_SOCKET, SO_PEERCRED, &cred,
+            &len) == 0)
+        return LOG4CPLUS_TEXT ("pid ") + convertIntegerToString (cred.pid)
+            + LOG4CPLUS_TEXT (" uid ") + convertIntegerToString (cred.uid);
+
+#endif
+    return tstring ();
+}
+
+
+SOCKET_TYPE
+openDatagramSocket(unsigned short port, SocketState& state)
+{
+    int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0) {
+        return INVALID_SOCKET_VALUE;
+    }
+
+    struct sockaddr_in server;
+    std::memset (&server, 0, sizeof (server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = INADDR_ANY;
+    server.sin_port = htons(port);
+
+    int optval = 1;
+    socklen_t optlen = sizeof (optval);
+    setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, &optval, optlen );
+
+    if (bind(sock, reinterpret_cast<struct sockaddr*>(&server),
+            sizeof(server)) < 0)
+    {
+        int const eno = errno;
+        ::close(sock);
+        set_last_socket_error (eno);
+        return INVALID_SOCKET_VALUE;
+    }
+
+    state = ok;
+    return to_log4cplus_socket (sock);
+}
+
+
+SOCKET_TYPE
+connectDatagramSocket(const tstring& hostn, unsigned short port,
+    SocketState& state)
+{
+    struct sockaddr_in server;
+    std::memset (&server, 0, sizeof (server));
+    if (get_host_by_name (LOG4CPLUS_TSTRING_TO_STRING(hostn).c_str(),
+            0, &server) != 0)
+    {
+        state = bad_address;
+        return INVALID_SOCKET_VALUE;
+    }
+
+    server.sin_port = htons(port);
+    server.sin_family = AF_INET;
+
+    int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0) {
+        return INVALID_SOCKET_VALUE;
+    }
+
+    // Sends that would block fail instead.
+    int const flags = ::fcntl (sock, F_GETFL);
+    if (flags == -1
+        || ::fcntl (sock, F_SETFL, flags | O_NONBLOCK) == -1
+        || ::connect(sock, reinterpret_cast<struct sockaddr*>(&server),
+            sizeof (server)) == -1)
+    {
+        int const eno = errno;
+        ::close(sock);
+        set_last_socket_error (eno);
+        return INVALID_SOCKET_VALUE;
+    }
+
+    state = ok;
+    return to_log4cplus_socket (sock);
+}
+
+
+long
+writeDatagrams(SOCKET_TYPE sock, const char* data, const std::size_t* sizes,
+    std::size_t count)
 {
 #if defined(MSG_NOSIGNAL)
     int flags = MSG_NOSIGNAL;
 #else
     int flags = 0;
 #endif
-    return ::send( to_os_socket (sock), buffer.getBuffer(), buffer.getSize(),
-        flags );
+    std::size_t sent = 0;
+
+#if defined (LOG4CPLUS_HAVE_SENDMMSG)
+    std::vector<struct iovec> iov (count);
+    std::vector<struct mmsghdr> msgs (count);
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        iov[i].iov_base = const_cast<char *>(data);
+        iov[i].iov_len = sizes[i];
+        data += sizes[i];
+
+        std::memset (&msgs[i], 0, sizeof (msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (sent < count)
+    {
+        // Number of messages per call is limited by the kernel.
+        int const ret = ::sendmmsg (to_os_socket (sock), &msgs[sent],
+            static_cast<unsigned>((std::min) (count - sent, std::size_t (1024))),
+            flags);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        else if (ret <= 0)
+            break;
+
+        sent += ret;
+    }
+
+#else
+    while (sent < count)
+    {
+        long const ret = ::send (to_os_socket (sock), data, sizes[sent],
+            flags);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        else if (ret == -1)
+            break;
+
+        data += sizes[sent];
+        ++sent;
+    }
+
+#endif
+
+    if (sent == 0 && count != 0)
+    {
+        set_last_socket_error (errno);
+        return -1;
+    }
+
+    return static_cast<long>(sent);
+}
+
+
+long
+readDatagram(SOCKET_TYPE sock, SocketBuffer& buffer)
+{
+    long res;
+    while ((res = ::recv(to_os_socket (sock), buffer.getBuffer(),
+                buffer.getMaxSize(), 0)) == -1
+        && errno == EINTR)
+        ;
+
+    return res;
 }
 
 
@@ -377,6 +749,50 @@ setTCPNoDelay (SOCKET_TYPE sock, bool val)
 }
 
 
+int
+setSendTimeout (SOCKET_TYPE sock, unsigned long timeout)
+{
+#if defined (SO_SNDTIMEO)
+    struct timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout % 1000) * 1000);
+
+    int result;
+    if ((result = setsockopt(to_os_socket (sock), SOL_SOCKET, SO_SNDTIMEO,
+                &tv, sizeof(tv))) != 0)
+        set_last_socket_error (errno);
+
+    return result;
+
+#else
+    return 0;
+
+#endif
+}
+
+
+int
+setReceiveTimeout (SOCKET_TYPE sock, unsigned long timeout)
+{
+#if defined (SO_RCVTIMEO)
+    struct timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout % 1000) * 1000);
+
+    int result;
+    if ((result = setsockopt(to_os_socket (sock), SOL_SOCKET, SO_RCVTIMEO,
+                &tv, sizeof(tv))) != 0)
+        set_last_socket_error (errno);
+
+    return result;
+
+#else
+    return 0;
+
+#endif
+}
+
+
 } } // namespace log4cplus
 
 #endif // LOG4CPLUS_USE_BSD_SOCKETS
@@ -170,7 +170,7 @@ openSocket(unsigned short port, SocketState& state)
         != 0)
         goto error;
 
-    if (::listen(sock, 10) != 0)
+    if (::listen(sock, SOMAXCONN) != 0)
         goto error;
 
     state = ok;
@@ -188,7 +188,8 @@ error:
 
 
 SOCKET_TYPE
-connectSocket(const tstring& hostn, unsigned short port, SocketState& state)
+connectSocket(const tstring& hostn, unsigned short port, SocketState& state,
+    unsigned long timeout)
 {
     struct hostent * hp;
     struct sockaddr_in insock;
@@ -221,9 +222,38 @@ connectSocket(const tstring& hostn, unsigned short port, SocketState& state)
     insock.sin_port = htons(port);
     insock.sin_family = AF_INET;
 
+    if (timeout)
+    {
+        // Connects in non-blocking mode and waits for the connection
+        // with select().
+        u_long nonblocking = 1;
+        ioctlsocket (sock, FIONBIO, &nonblocking);
+    }
+
     while(   (retval = ::connect(sock, (struct sockaddr*)&insock, sizeof(insock))) == -1
           && (WSAGetLastError() == WSAEINTR))
         ;
+
+    if (timeout)
+    {
+        if (retval == SOCKET_ERROR && WSAGetLastError () == WSAEWOULDBLOCK)
+        {
+            fd_set writefds, exceptfds;
+            FD_ZERO (&writefds);
+            FD_SET (sock, &writefds);
+            FD_ZERO (&exceptfds);
+            FD_SET (sock, &exceptfds);
+            struct timeval tv;
+            tv.tv_sec = static_cast<long>(timeout / 1000);
+            tv.tv_usec = static_cast<long>((timeout % 1000) * 1000);
+            retval = ::select (0, 0, &writefds, &exceptfds, &tv) == 1
+                && FD_ISSET (sock, &writefds) ? 0 : SOCKET_ERROR;
+        }
+
+        u_long nonblocking = 0;
+        ioctlsocket (sock, FIONBIO, &nonblocking);
+    }
+
     if (retval == SOCKET_ERROR)
         goto error;
 
@@ -290,8 +320,11 @@ read(SOCKET_TYPE sock, SocketBuffer& buffer)
 
 
 long
-write(SOCKET_TYPE sock, const SocketBuffer& buffer)
+write(SOCKET_TYPE sock, const SocketBuffer& buffer, std::size_t recordSize)
 {
+    // Local sockets are not supported, so the stream can be written
+    // at once.
+    (void)recordSize;
     long ret = ::send (to_os_socket (sock), buffer.getBuffer(),
         static_cast<int>(buffer.getSize()), 0);
     if (ret == SOCKET_ERROR)
@@ -300,6 +333,153 @@ write(SOCKET_TYPE sock, const SocketBuffer& buffer)
 }
 
 
+SOCKET_TYPE
+openLocalSocket(const tstring&, LocalSocketType, SocketState& state)
+{
+    state = not_opened;
+    set_last_socket_error (WSAEAFNOSUPPORT);
+    return INVALID_SOCKET_VALUE;
+}
+
+
+SOCKET_TYPE
+connectLocalSocket(const tstring&, LocalSocketType, SocketState& state)
+{
+    state = not_opened;
+    set_last_socket_error (WSAEAFNOSUPPORT);
+    return INVALID_SOCKET_VALUE;
+}
+
+
+tstring
+getLocalPeerName(SOCKET_TYPE)
+{
+    return tstring ();
+}
+
+
+SOCKET_TYPE
+openDatagramSocket(unsigned short port, SocketState& state)
+{
+    struct sockaddr_in server;
+
+    init_winsock ();
+
+    SOCKET sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_OS_SOCKET_VALUE)
+        goto error;
+
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = htonl(INADDR_ANY);
+    server.sin_port = htons(port);
+
+    if (bind(sock, reinterpret_cast<struct sockaddr*>(&server), sizeof(server))
+        != 0)
+        goto error;
+
+    state = ok;
+    return to_log4cplus_socket (sock);
+
+error:
+    int eno = WSAGetLastError ();
+
+    if (sock != INVALID_OS_SOCKET_VALUE)
+        ::closesocket (sock);
+
+    set_last_socket_error (eno);
+    return INVALID_SOCKET_VALUE;
+}
+
+
+SOCKET_TYPE
+connectDatagramSocket(const tstring& hostn, unsigned short port,
+    SocketState& state)
+{
+    struct hostent * hp;
+    struct sockaddr_in insock;
+    u_long nonblocking = 1;
+
+    init_winsock ();
+
+    SOCKET sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_OS_SOCKET_VALUE)
+        goto error;
+
+    hp = ::gethostbyname( LOG4CPLUS_TSTRING_TO_STRING(hostn).c_str() );
+    if (hp == 0 || hp->h_addrtype != AF_INET)
+    {
+        insock.sin_family = AF_INET;
+        INT insock_size = sizeof (insock);
+        INT ret = WSAStringToAddress (const_cast<LPTSTR>(hostn.c_str ()),
+            AF_INET, 0, reinterpret_cast<struct sockaddr *>(&insock),
+            &insock_size);
+        if (ret == SOCKET_ERROR || insock_size != sizeof (insock)) 
+        {
+            state = bad_address;
+            goto error;
+        }
+    }
+    else
+        std::memcpy (&insock.sin_addr, hp->h_addr_list[0],
+            sizeof (insock.sin_addr));
+
+    insock.sin_port = htons(port);
+    insock.sin_family = AF_INET;
+
+    // Sends that would block fail instead.
+    if (ioctlsocket (sock, FIONBIO, &nonblocking) == SOCKET_ERROR
+        || ::connect(sock, reinterpret_cast<struct sockaddr*>(&insock),
+            sizeof(insock)) == SOCKET_ERROR)
+        goto error;
+
+    state = ok;
+    return to_log4cplus_socket (sock);
+
+error:
+    int eno = WSAGetLastError ();
+
+    if (sock != INVALID_OS_SOCKET_VALUE)
+        ::closesocket (sock);
+
+    set_last_socket_error (eno);
+    return INVALID_SOCKET_VALUE;
+}
+
+
+long
+writeDatagrams(SOCKET_TYPE sock, const char* data, const std::size_t* sizes,
+    std::size_t count)
+{
+    std::size_t sent = 0;
+    for (; sent < count; ++sent)
+    {
+        if (::send (to_os_socket (sock), data, static_cast<int>(sizes[sent]),
+                0) == SOCKET_ERROR)
+            break;
+        data += sizes[sent];
+    }
+
+    if (sent == 0 && count != 0)
+    {
+        set_last_socket_error (WSAGetLastError ());
+        return -1;
+    }
+
+    return static_cast<long>(sent);
+}
+
+
+long
+readDatagram(SOCKET_TYPE sock, SocketBuffer& buffer)
+{
+    long ret = ::recv (to_os_socket (sock), buffer.getBuffer(),
+        static_cast<int>(buffer.getMaxSize()), 0);
+    if (ret == SOCKET_ERROR)
+        set_last_socket_error (WSAGetLastError ());
+    return ret;
+}
+
+
 tstring
 getHostname (bool fqdn)
 {
@@ -349,6 +529,38 @@ setTCPNoDelay (SOCKET_TYPE sock, bool val)
 }
 
 
+int
+setSendTimeout (SOCKET_TYPE sock, unsigned long timeout)
+{
+    int result;
+    DWORD value = static_cast<DWORD>(timeout);
+    if ((result = setsockopt(to_os_socket (sock), SOL_SOCKET, SO_SNDTIMEO,
+            reinterpret_cast<char*>(&value), sizeof(value))) != 0)
+    {
+        int eno = WSAGetLastError ();
+        set_last_socket_error (eno);
+    }
+
+    return result;
+}
+
+
+int
+setReceiveTimeout (SOCKET_TYPE sock, unsigned long timeout)
+{
+    int result;
+    DWORD value = static_cast<DWORD>(timeout);
+    if ((result = setsockopt(to_os_socket (sock), SOL_SOCKET, SO_RCVTIMEO,
+            reinterpret_cast<char*>(&value), sizeof(value))) != 0)
+    {
+        int eno = WSAGetLastError ();
+        set_last_socket_error (eno);
+    }
+
+    return result;
+}
+
+
 } } // namespace log4cplus { namespace helpers {
 
 #endif // LOG4CPLUS_USE_WINSOCK
@@ -125,14 +125,17 @@ AbstractSocket::copy(const AbstractSocket& r)
 //////////////////////////////////////////////////////////////////////////////
 
 Socket::Socket()
-    : AbstractSocket()
+    : AbstractSocket(),
+      recordSize(0)
 { }
 
 
-Socket::Socket(const tstring& address, unsigned short port)
-    : AbstractSocket()
+Socket::Socket(const tstring& address, unsigned short port,
+    unsigned long connectTimeout)
+    : AbstractSocket(),
+      recordSize(0)
 {
-    sock = connectSocket(address, port, state);
+    sock = connectSocket(address, port, state, connectTimeout);
     if (sock == INVALID_SOCKET_VALUE)
         goto error;
 
@@ -146,8 +149,19 @@ error:
 }
 
 
+Socket::Socket(const tstring& path, LocalSocketType type)
+    : AbstractSocket(),
+      recordSize(type == local_seqpacket ? LOG4CPLUS_SEQPACKET_RECORD_SIZE : 0)
+{
+    sock = connectLocalSocket(path, type, state);
+    if (sock == INVALID_SOCKET_VALUE)
+        err = get_last_socket_error ();
+}
+
+
 Socket::Socket(SOCKET_TYPE sock_, SocketState state_, int err_)
-    : AbstractSocket(sock_, state_, err_)
+    : AbstractSocket(sock_, state_, err_),
+      recordSize(0)
 { }
 
 
@@ -179,7 +193,7 @@ Socket::read(SocketBuffer& buffer)
 bool
 Socket::write(const SocketBuffer& buffer)
 {
-    long retval = helpers::write(sock, buffer);
+    long retval = helpers::write(sock, buffer, recordSize);
     if(retval <= 0) {
         close();
     }
@@ -188,6 +202,78 @@ Socket::write(const SocketBuffer& buffer)
 }
 
 
+bool
+Socket::setSendTimeout(unsigned long timeout)
+{
+    return helpers::setSendTimeout(sock, timeout) == 0;
+}
+
+
+bool
+Socket::setReceiveTimeout(unsigned long timeout)
+{
+    return helpers::setReceiveTimeout(sock, timeout) == 0;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DatagramSocket ctors and dtor
+//////////////////////////////////////////////////////////////////////////////
+
+DatagramSocket::DatagramSocket()
+    : AbstractSocket()
+{ }
+
+
+DatagramSocket::DatagramSocket(const tstring& address, unsigned short port)
+    : AbstractSocket()
+{
+    sock = connectDatagramSocket(address, port, state);
+    if (sock == INVALID_SOCKET_VALUE)
+        err = get_last_socket_error ();
+}
+
+
+DatagramSocket::DatagramSocket(unsigned short port)
+    : AbstractSocket()
+{
+    sock = openDatagramSocket(port, state);
+    if (sock == INVALID_SOCKET_VALUE)
+        err = get_last_socket_error ();
+}
+
+
+DatagramSocket::~DatagramSocket()
+{ }
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DatagramSocket methods
+//////////////////////////////////////////////////////////////////////////////
+
+long
+DatagramSocket::write(const char* data, const std::size_t* sizes,
+    std::size_t count)
+{
+    // Errors like ICMP port unreachable do not make the socket
+    // unusable, it is not closed.
+    return helpers::writeDatagrams(sock, data, sizes, count);
+}
+
+
+bool
+DatagramSocket::read(SocketBuffer& buffer)
+{
+    long retval = helpers::readDatagram(sock, buffer);
+    if (retval >= 0)
+        buffer.setSize(retval);
+
+    return (retval >= 0);
+}
+
+
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -203,6 +289,15 @@ ServerSocket::ServerSocket(unsigned short port)
 }
 
 
+ServerSocket::ServerSocket(const tstring& path, LocalSocketType type)
+{
+    sock = openLocalSocket(path, type, state);
+    if(sock == INVALID_SOCKET_VALUE) {
+        err = get_last_socket_error ();
+    }
+}
+
+
 
 ServerSocket::~ServerSocket()
 {
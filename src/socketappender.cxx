@@ -19,11 +19,13 @@
 // limitations under the License.
 
 #include <cstdlib>
+#include <algorithm>
 #include <log4cplus/socketappender.h>
 #include <log4cplus/layout.h>
 #include <log4cplus/helpers/loglog.h>
 #include <log4cplus/spi/loggingevent.h>
 #include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/stringhelper.h>
 
 
 int const LOG4CPLUS_MESSAGE_VERSION = 2;
@@ -32,10 +34,42 @@ int const LOG4CPLUS_MESSAGE_VERSION = 2;
 namespace log4cplus
 {
 
+namespace
+{
+
+
+static
+unsigned long
+parse_millis (helpers::Properties const & properties, tchar const * name,
+    unsigned long defaultValue)
+{
+    if (! properties.exists (name))
+        return defaultValue;
+
+    tstring const tmp = properties.getProperty (name);
+    return std::strtoul(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str(), 0, 10);
+}
+
+//! Returns size of frame at <code>p</code> without the size prefix.
+static
+std::size_t
+get_frame_size (char const * p)
+{
+    unsigned char const * const q = reinterpret_cast<unsigned char const *>(p);
+    return (static_cast<std::size_t>(q[0]) << 24)
+        | (static_cast<std::size_t>(q[1]) << 16)
+        | (static_cast<std::size_t>(q[2]) << 8)
+        | static_cast<std::size_t>(q[3]);
+}
+
+} // namespace
+
+
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
 SocketAppender::ConnectorThread::ConnectorThread (
     SocketAppender & socket_appender)
     : sa (socket_appender)
+    , exit_ev (false)
     , exit_flag (false)
 { }
 
@@ -47,6 +81,7 @@ SocketAppender::ConnectorThread::~ConnectorThread ()
 void
 SocketAppender::ConnectorThread::run ()
 {
+    unsigned long delay = sa.reconnectDelay;
     while (true)
     {
         trigger_ev.timed_wait (30 * 1000);
@@ -74,26 +109,31 @@ SocketAppender::ConnectorThread::run ()
 
         // The socket is not open, try to reconnect.
 
-        helpers::Socket socket (sa.host, sa.port);
+        bool compressed;
+        helpers::Socket socket (sa.connect (compressed));
         if (! socket.isOpen ())
         {
             helpers::getLogLog().error(
                 LOG4CPLUS_TEXT("SocketAppender::ConnectorThread::run()")
                 LOG4CPLUS_TEXT("- Cannot connect to server"));
 
-            // Sleep for a short while after unsuccessful connection attempt
-            // so that we do not try to reconnect after each logging attempt
-            // which could be many times per second.
-            helpers::sleep (5);
+            // Wait after unsuccessful connection attempt so that we do
+            // not try to reconnect after each logging attempt which
+            // could be many times per second. The wait grows while
+            // the server stays unreachable.
+            if (exit_ev.timed_wait (delay))
+                return;
+            delay = (std::min) (delay * 2, sa.maxReconnectDelay);
 
             continue;
         }
 
         // Connection was successful, move the socket into SocketAppender.
+        delay = sa.reconnectDelay;
 
         {
             log4cplus::thread::MutexGuard guard (sa.access_mutex);
-            sa.socket = socket;
+            sa.useSocket (socket, compressed);
             sa.connected = true;
         }
     }
@@ -103,12 +143,18 @@ SocketAppender::ConnectorThread::run ()
 void
 SocketAppender::ConnectorThread::terminate ()
 {
+    // Both close() and the destructor terminate the thread; it can
+    // be joined only once.
+    bool join_thread;
     {
         log4cplus::thread::MutexGuard guard (access_mutex);
+        join_thread = ! exit_flag;
         exit_flag = true;
         trigger_ev.signal ();
+        exit_ev.signal ();
     }
-    join ();
+    if (join_thread)
+        join ();
 }
 
 
@@ -118,6 +164,312 @@ SocketAppender::ConnectorThread::trigger ()
     trigger_ev.signal ();
 }
 
+
+SocketAppender::SenderThread::SenderThread (SocketAppender & socket_appender)
+    : sa (socket_appender)
+    , trigger_ev (false)
+    , exit_ev (false)
+    , started (false)
+    , exit_flag (false)
+{ }
+
+
+SocketAppender::SenderThread::~SenderThread ()
+{ }
+
+
+void
+SocketAppender::SenderThread::start ()
+{
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        if (started || exit_flag)
+            return;
+        started = true;
+    }
+    thread::AbstractThread::start ();
+}
+
+
+void
+SocketAppender::SenderThread::run ()
+{
+    unsigned long delay = sa.reconnectDelay;
+    bool reported = false;
+    helpers::Time lastWrite;
+    while (true)
+    {
+        bool exiting;
+        {
+            log4cplus::thread::MutexGuard guard (access_mutex);
+            exiting = exit_flag;
+        }
+
+        // Only this thread uses the socket.
+
+        if (! sa.socket.isOpen ())
+        {
+            if (exiting)
+                break;
+
+            bool compressed;
+            helpers::Socket socket (sa.connect (compressed));
+            if (! socket.isOpen ())
+            {
+                if (! reported)
+                    helpers::getLogLog().error(
+                        LOG4CPLUS_TEXT("SocketAppender::SenderThread::run()")
+                        LOG4CPLUS_TEXT("- Cannot connect to server"));
+                reported = true;
+
+                // Keep the queue free for new events.
+                if (sa.spool)
+                    sa.spoolPending ();
+
+                if (! exit_ev.timed_wait (delay))
+                    delay = (std::min) (delay * 2, sa.maxReconnectDelay);
+                continue;
+            }
+
+            delay = sa.reconnectDelay;
+            reported = false;
+
+            log4cplus::thread::MutexGuard guard (sa.access_mutex);
+            sa.useSocket (socket, compressed);
+            sa.connected = true;
+        }
+
+        // Let the queue fill, larger writes compress better. Spooled
+        // events are sent without delay.
+        if (sa.sendingEvents == 0 && ! exiting && sa.compressing
+            && ! sa.sendingSpooled
+            && sa.compressionFlushInterval != helpers::Time ())
+        {
+            helpers::Time const due = lastWrite + sa.compressionFlushInterval;
+            helpers::Time const now = helpers::Time::gettimeofday ();
+            if (now < due)
+            {
+                helpers::Time const wait = due - now;
+                exit_ev.timed_wait (wait.sec () * 1000 + wait.usec () / 1000
+                    + 1);
+                continue;
+            }
+        }
+
+        // Take over the events queued by the logging threads. Events
+        // that have not been sent yet are sent again first. Spooled
+        // events are older than the queued ones and go before them.
+
+        if (sa.sendingEvents == 0)
+        {
+            // The spool file is read without access_mutex, so that
+            // the logging threads are not held up by the disk.
+            bool spooled = false;
+            if (sa.spool)
+            {
+                sa.writeSpooled ();
+
+                log4cplus::thread::MutexGuard guard (sa.spool_mutex);
+                spooled = ! sa.spool->empty ();
+                if (spooled && ! exiting)
+                {
+                    sa.sendingEvents = sa.spool->read (*sa.sendingQueue);
+                    sa.sendingSpooled = true;
+                }
+            }
+
+            if (spooled && exiting)
+                // The rest is sent by the next appender.
+                break;
+            else if (spooled)
+            {
+                if (sa.sendingEvents == 0)
+                    continue;
+            }
+            else
+            {
+                log4cplus::thread::MutexGuard guard (sa.access_mutex);
+                if (sa.spoolingEvents != 0)
+                    // A logging thread is spooling older events, they
+                    // have to be read back first.
+                    continue;
+                else if (sa.pendingEvents != 0)
+                {
+                    std::swap (sa.pendingQueue, sa.sendingQueue);
+                    std::swap (sa.pendingEvents, sa.sendingEvents);
+                    sa.sendingSpooled = false;
+                    if (sa.queueFull)
+                    {
+                        helpers::getLogLog().warn(
+                            LOG4CPLUS_TEXT("SocketAppender::SenderThread::run()")
+                            LOG4CPLUS_TEXT("- Queue was full, events were dropped"));
+                        sa.queueFull = false;
+                    }
+                }
+                else if (exiting)
+                    break;
+                else
+                    trigger_ev.reset ();
+            }
+        }
+
+        if (sa.sendingEvents == 0)
+        {
+            trigger_ev.wait ();
+            continue;
+        }
+
+        // Version 3 frames are encoded for this connection each time,
+        // as the dictionary starts anew with a new connection.
+        if (! sa.writeSocket (sa.protocolVersion == helpers::MESSAGE_VERSION_3
+                ? sa.encodeQueue () : *sa.sendingQueue))
+        {
+            helpers::getLogLog().error(
+                LOG4CPLUS_TEXT("SocketAppender::SenderThread::run()")
+                LOG4CPLUS_TEXT("- Connection lost, events will be sent again"));
+
+            log4cplus::thread::MutexGuard guard (sa.access_mutex);
+            sa.connected = false;
+            continue;
+        }
+
+        lastWrite = helpers::Time::gettimeofday ();
+        if (sa.sendingSpooled)
+        {
+            log4cplus::thread::MutexGuard guard (sa.spool_mutex);
+            sa.spool->commit ();
+        }
+
+        sa.sendingQueue->clear ();
+        sa.sendingEvents = 0;
+    }
+
+    // Events that could not be sent before close() are spooled if
+    // possible. Spooled events being sent are still in the spool.
+
+    if (sa.spool)
+    {
+        unsigned long dropped = 0;
+        if (sa.sendingEvents != 0 && ! sa.sendingSpooled)
+        {
+            log4cplus::thread::MutexGuard guard (sa.spool_mutex);
+            dropped = sa.spool->append (*sa.sendingQueue, sa.sendingEvents);
+        }
+        sa.sendingQueue->clear ();
+        sa.sendingEvents = 0;
+        {
+            log4cplus::thread::MutexGuard guard (sa.access_mutex);
+            sa.droppedEvents += dropped;
+        }
+        sa.spoolPending ();
+    }
+
+    // Otherwise they are lost.
+
+    log4cplus::thread::MutexGuard guard (sa.access_mutex);
+
+    if (sa.sendingEvents + sa.pendingEvents != 0)
+    {
+        helpers::getLogLog().warn(
+            LOG4CPLUS_TEXT("SocketAppender::SenderThread::run()")
+            LOG4CPLUS_TEXT("- Server is not connected, queued events were dropped"));
+        sa.droppedEvents += sa.sendingEvents + sa.pendingEvents;
+        sa.sendingQueue->clear ();
+        sa.sendingEvents = 0;
+        sa.pendingQueue->clear ();
+        sa.pendingEvents = 0;
+    }
+}
+
+
+void
+SocketAppender::SenderThread::terminate ()
+{
+    bool join_thread;
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        join_thread = started && ! exit_flag;
+        exit_flag = true;
+        trigger_ev.signal ();
+        exit_ev.signal ();
+    }
+    if (join_thread)
+        join ();
+}
+
+
+void
+SocketAppender::SenderThread::trigger ()
+{
+    trigger_ev.signal ();
+}
+
+
+SocketAppender::BatchFlusher::BatchFlusher (SocketAppender & socket_appender)
+    : sa (socket_appender)
+    , exit_flag (false)
+{ }
+
+
+SocketAppender::BatchFlusher::~BatchFlusher ()
+{ }
+
+
+void
+SocketAppender::BatchFlusher::run ()
+{
+    while (true)
+    {
+        trigger_ev.wait ();
+
+        {
+            log4cplus::thread::MutexGuard guard (access_mutex);
+            if (exit_flag)
+                return;
+        }
+
+        helpers::Time wait;
+        {
+            log4cplus::thread::MutexGuard guard (sa.access_mutex);
+            if (sa.batchedEvents != 0)
+            {
+                helpers::Time const due = sa.batchStart + sa.batchLatency;
+                helpers::Time const now = helpers::Time::gettimeofday ();
+                if (now < due)
+                    wait = due - now;
+                else
+                    sa.flushBatch ();
+            }
+
+            // The next batch triggers us again.
+            if (sa.batchedEvents == 0)
+                trigger_ev.reset ();
+        }
+
+        if (wait != helpers::Time ())
+            helpers::sleepmillis (wait.sec () * 1000 + wait.usec () / 1000 + 1);
+    }
+}
+
+
+void
+SocketAppender::BatchFlusher::terminate ()
+{
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        exit_flag = true;
+        trigger_ev.signal ();
+    }
+    join ();
+}
+
+
+void
+SocketAppender::BatchFlusher::trigger ()
+{
+    trigger_ev.signal ();
+}
+
 #endif
 
 
@@ -129,8 +481,37 @@ SocketAppender::SocketAppender(const tstring& host_, int port_,
     const tstring& serverName_)
 : host(host_),
   port(port_),
-  serverName(serverName_)
+  serverName(serverName_),
+  localSocketType(helpers::local_stream),
+  eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int)),
+  protocolVersion(LOG4CPLUS_MESSAGE_VERSION),
+  encoder(true, LOG4CPLUS_MAX_MESSAGE_SIZE),
+  queueEncoder(false),
+  wireQueue(0),
+  batchBuffer(0),
+  batchCount(0),
+  batchedEvents(0),
+  connectTimeout(0),
+  sendTimeout(0),
+  reconnectDelay(1000),
+  maxReconnectDelay(30 * 1000),
+  droppedEvents(0),
+  nonBlocking(false),
+  queueFull(false),
+  pendingQueue(0),
+  pendingEvents(0),
+  sendingQueue(0),
+  sendingEvents(0),
+  spool(0),
+  sendingSpooled(false),
+  spoolingQueue(0),
+  spoolingEvents(0),
+  compression(false),
+  compressing(false),
+  compressor(0),
+  compressedBuffer(0)
 {
+    initBatch (LOG4CPLUS_SOCKET_BATCH_SIZE);
     openSocket();
     initConnector ();
 }
@@ -139,7 +520,35 @@ SocketAppender::SocketAppender(const tstring& host_, int port_,
 
 SocketAppender::SocketAppender(const helpers::Properties & properties)
  : Appender(properties),
-   port(9998)
+   port(9998),
+   localSocketType(helpers::local_stream),
+   eventBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int)),
+   protocolVersion(LOG4CPLUS_MESSAGE_VERSION),
+   encoder(true, LOG4CPLUS_MAX_MESSAGE_SIZE),
+   queueEncoder(false),
+   wireQueue(0),
+   batchBuffer(0),
+   batchCount(0),
+   batchedEvents(0),
+   connectTimeout(0),
+   sendTimeout(0),
+   reconnectDelay(1000),
+   maxReconnectDelay(30 * 1000),
+   droppedEvents(0),
+   nonBlocking(false),
+   queueFull(false),
+   pendingQueue(0),
+   pendingEvents(0),
+   sendingQueue(0),
+   sendingEvents(0),
+   spool(0),
+   sendingSpooled(false),
+   spoolingQueue(0),
+   spoolingEvents(0),
+   compression(false),
+   compressing(false),
+   compressor(0),
+   compressedBuffer(0)
 {
     host = properties.getProperty( LOG4CPLUS_TEXT("host") );
     if(properties.exists( LOG4CPLUS_TEXT("port") )) {
@@ -148,7 +557,154 @@ SocketAppender::SocketAppender(const helpers::Properties & properties)
     }
     serverName = properties.getProperty( LOG4CPLUS_TEXT("ServerName") );
 
-    openSocket();
+    localSocket = properties.getProperty( LOG4CPLUS_TEXT("LocalSocket") );
+    if(properties.exists( LOG4CPLUS_TEXT("LocalSocketType") )) {
+        tstring tmp = helpers::toLower(
+            properties.getProperty( LOG4CPLUS_TEXT("LocalSocketType") ));
+        if (tmp == LOG4CPLUS_TEXT("seqpacket"))
+            localSocketType = helpers::local_seqpacket;
+        else if (tmp != LOG4CPLUS_TEXT("stream"))
+            getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender- Unknown")
+                LOG4CPLUS_TEXT(" \"LocalSocketType\" ") + tmp);
+    }
+
+    if(properties.exists( LOG4CPLUS_TEXT("ProtocolVersion") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("ProtocolVersion") );
+        protocolVersion = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        if (protocolVersion != LOG4CPLUS_MESSAGE_VERSION
+            && protocolVersion != helpers::MESSAGE_VERSION_3)
+        {
+            getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender- Unknown")
+                LOG4CPLUS_TEXT(" \"ProtocolVersion\" ") + tmp);
+            protocolVersion = LOG4CPLUS_MESSAGE_VERSION;
+        }
+    }
+
+    std::size_t batchSize = LOG4CPLUS_SOCKET_BATCH_SIZE;
+    if(properties.exists( LOG4CPLUS_TEXT("BatchSize") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("BatchSize") );
+        batchSize = static_cast<std::size_t>(helpers::parseFileSize(tmp));
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("BatchCount") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("BatchCount") );
+        batchCount = std::strtoul(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str(), 0, 10);
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("BatchLatency") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("BatchLatency") );
+        long ms = std::atol(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        if (ms > 0)
+            batchLatency = helpers::Time (ms / 1000, (ms % 1000) * 1000);
+    }
+    if(properties.exists( LOG4CPLUS_TEXT("NonBlocking") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("NonBlocking") );
+        nonBlocking = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+#if defined (LOG4CPLUS_SINGLE_THREADED)
+        if (nonBlocking)
+        {
+            getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender- \"NonBlocking\"")
+                LOG4CPLUS_TEXT(" is not supported in single-threaded builds"));
+            nonBlocking = false;
+        }
+#endif
+    }
+    connectTimeout = parse_millis (properties,
+        LOG4CPLUS_TEXT("ConnectTimeout"), connectTimeout);
+    sendTimeout = parse_millis (properties, LOG4CPLUS_TEXT("SendTimeout"),
+        nonBlocking ? 10 * 1000 : 0);
+    reconnectDelay = (std::max) (parse_millis (properties,
+        LOG4CPLUS_TEXT("ReconnectDelay"), reconnectDelay), 1ul);
+    maxReconnectDelay = (std::max) (parse_millis (properties,
+        LOG4CPLUS_TEXT("MaxReconnectDelay"), maxReconnectDelay),
+        reconnectDelay);
+
+    if (nonBlocking)
+    {
+        std::size_t queueSize = 1024 * 1024;
+        if(properties.exists( LOG4CPLUS_TEXT("QueueSize") )) {
+            tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("QueueSize") );
+            queueSize = static_cast<std::size_t>(helpers::parseFileSize(tmp));
+        }
+        queueSize = (std::max) (queueSize,
+            std::size_t (LOG4CPLUS_MAX_MESSAGE_SIZE));
+        pendingQueue = new helpers::SocketBuffer (queueSize);
+        sendingQueue = new helpers::SocketBuffer (queueSize);
+
+        // Splitting into frames and the dictionary definitions make
+        // the wire form slightly larger in the worst case.
+        if (protocolVersion == helpers::MESSAGE_VERSION_3)
+            wireQueue = new helpers::SocketBuffer (queueSize + queueSize / 8
+                + LOG4CPLUS_MAX_MESSAGE_SIZE);
+    }
+
+    tstring const spoolFile = properties.getProperty( LOG4CPLUS_TEXT("SpoolFile") );
+    if (! spoolFile.empty() && ! nonBlocking)
+    {
+        getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender- \"SpoolFile\"")
+            LOG4CPLUS_TEXT(" requires \"NonBlocking\""));
+    }
+    else if (! spoolFile.empty())
+    {
+        std::size_t spoolSize = 64 * 1024 * 1024;
+        if(properties.exists( LOG4CPLUS_TEXT("SpoolSize") )) {
+            tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("SpoolSize") );
+            spoolSize = static_cast<std::size_t>(helpers::parseFileSize(tmp));
+        }
+        spool = new helpers::SpoolFile;
+        if (! spool->open (spoolFile, spoolSize))
+        {
+            delete spool;
+            spool = 0;
+        }
+        else
+            spoolingQueue = new helpers::SocketBuffer (
+                pendingQueue->getMaxSize ());
+    }
+
+    if(properties.exists( LOG4CPLUS_TEXT("Compression") )) {
+        tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("Compression") );
+        compression = (helpers::toLower(tmp) == LOG4CPLUS_TEXT("true"));
+    }
+    if (compression)
+    {
+        int level = -1;
+        if(properties.exists( LOG4CPLUS_TEXT("CompressionLevel") )) {
+            tstring tmp = properties.getProperty( LOG4CPLUS_TEXT("CompressionLevel") );
+            level = std::atoi(LOG4CPLUS_TSTRING_TO_STRING(tmp).c_str());
+        }
+        compressor = new helpers::StreamCompressor (level);
+        if (! compressor->isValid())
+        {
+            getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender- \"Compression\"")
+                LOG4CPLUS_TEXT(" is not available"));
+            delete compressor;
+            compressor = 0;
+            compression = false;
+        }
+
+        unsigned long const ms = parse_millis (properties,
+            LOG4CPLUS_TEXT("CompressionFlushInterval"), 0);
+        compressionFlushInterval = helpers::Time (ms / 1000, (ms % 1000) * 1000);
+        if (batchLatency == helpers::Time () && ! nonBlocking)
+            batchLatency = compressionFlushInterval;
+    }
+
+    initBatch (batchSize);
+
+    // Largest write is a batch or the whole queue.
+    if (compression)
+    {
+        std::size_t maxWrite = batchBuffer->getMaxSize();
+        if (wireQueue)
+            maxWrite = (std::max) (maxWrite, wireQueue->getMaxSize());
+        else if (sendingQueue)
+            maxWrite = (std::max) (maxWrite, sendingQueue->getMaxSize());
+        compressedBuffer = new helpers::SocketBuffer (
+            helpers::StreamCompressor::getBound (maxWrite));
+    }
+
+    // The sender thread connects in non-blocking mode.
+    if (! deferActivation(properties) && ! nonBlocking)
+        openSocket();
     initConnector ();
 }
 
@@ -157,10 +713,19 @@ SocketAppender::SocketAppender(const helpers::Properties & properties)
 SocketAppender::~SocketAppender()
 {
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
-    connector->terminate ();
+    if (connector.get ())
+        connector->terminate ();
 #endif
 
     destructorImpl();
+    delete batchBuffer;
+    delete pendingQueue;
+    delete sendingQueue;
+    delete spoolingQueue;
+    delete wireQueue;
+    delete spool;
+    delete compressor;
+    delete compressedBuffer;
 }
 
 
@@ -175,14 +740,39 @@ SocketAppender::close()
     getLogLog().debug(LOG4CPLUS_TEXT("Entering SocketAppender::close()..."));
 
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
-    connector->terminate ();
+    if (flusher.get ())
+        flusher->terminate ();
+    if (sender.get ())
+        sender->terminate ();
+    if (connector.get ())
+        connector->terminate ();
 #endif
 
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        if (socket.isOpen())
+            flushBatch();
+    }
+
+    if (spool)
+    {
+        log4cplus::thread::MutexGuard guard (spool_mutex);
+        spool->close();
+    }
+
     socket.close();
     closed = true;
 }
 
 
+unsigned long
+SocketAppender::getDroppedEvents() const
+{
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    return droppedEvents;
+}
+
+
 
 //////////////////////////////////////////////////////////////////////////////
 // SocketAppender protected methods
@@ -192,15 +782,130 @@ void
 SocketAppender::openSocket()
 {
     if(!socket.isOpen()) {
-        socket = helpers::Socket(host, port);
+        bool compressed;
+        helpers::Socket newSocket(connect(compressed));
+        useSocket(newSocket, compressed);
     }
 }
 
 
+helpers::Socket
+SocketAppender::connect(bool & compressed)
+{
+    helpers::Socket newSocket(openConnection());
+    compressed = newSocket.isOpen() && compression && handshake(newSocket);
+    return newSocket;
+}
+
+
+bool
+SocketAppender::handshake(helpers::Socket & newSocket)
+{
+    helpers::SocketBuffer request(helpers::HANDSHAKE_FRAME_SIZE);
+    helpers::appendHandshake(request, helpers::HANDSHAKE_DEFLATE);
+    if (! newSocket.write(request))
+        return false;
+
+    // Socket::read() closes the socket when the timeout expires.
+    helpers::SocketBuffer reply(helpers::HANDSHAKE_FRAME_SIZE);
+    newSocket.setReceiveTimeout(connectTimeout != 0 ? connectTimeout
+        : LOG4CPLUS_SOCKET_HANDSHAKE_TIMEOUT);
+    unsigned char features = 0;
+    if (newSocket.read(reply)
+        && reply.readInt() == reply.getSize() - sizeof(unsigned int)
+        && helpers::parseHandshake(reply.getBuffer() + sizeof(unsigned int),
+            reply.getSize() - sizeof(unsigned int), features))
+    {
+        if (! (features & helpers::HANDSHAKE_DEFLATE))
+            getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender::handshake()")
+                LOG4CPLUS_TEXT("- Server does not support compression"));
+        return (features & helpers::HANDSHAKE_DEFLATE) != 0;
+    }
+
+    getLogLog().warn(LOG4CPLUS_TEXT("SocketAppender::handshake()")
+        LOG4CPLUS_TEXT("- Server did not answer the handshake,")
+        LOG4CPLUS_TEXT(" compression is disabled"));
+    compression = false;
+
+    newSocket.close();
+    newSocket = openConnection();
+    return false;
+}
+
+
+helpers::Socket
+SocketAppender::openConnection()
+{
+    helpers::Socket newSocket;
+    if (localSocket.empty())
+        newSocket = helpers::Socket(host, static_cast<unsigned short>(port),
+            connectTimeout);
+    else
+        newSocket = helpers::Socket(localSocket, localSocketType);
+
+    if (newSocket.isOpen() && sendTimeout != 0)
+        newSocket.setSendTimeout(sendTimeout);
+    return newSocket;
+}
+
+
+void
+SocketAppender::useSocket(const helpers::Socket & newSocket, bool compressed)
+{
+    socket = newSocket;
+    encoder.reset();
+    compressing = compressed;
+    if (compressing)
+        compressor->reset();
+}
+
+
+void
+SocketAppender::activateResources()
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (nonBlocking)
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        if (! closed)
+            sender->start ();
+        return;
+    }
+#endif
+
+    // Connecting can take long, the lock is taken only to hand the
+    // connected socket over.
+    bool compressed;
+    helpers::Socket newSocket(connect(compressed));
+
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    if (closed)
+        return;
+
+    if (! socket.isOpen())
+        useSocket(newSocket, compressed);
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    connected = socket.isOpen();
+    if (! connected)
+        connector->trigger ();
+#endif
+}
+
+
 void
 SocketAppender::initConnector ()
 {
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (nonBlocking)
+    {
+        connected = false;
+        sender = new SenderThread (*this);
+        if (activation == ACTIVE)
+            sender->start ();
+        return;
+    }
+
     connected = true;
     connector = new ConnectorThread (*this);
     connector->start ();
@@ -208,12 +913,35 @@ SocketAppender::initConnector ()
 }
 
 
+void
+SocketAppender::initBatch (std::size_t size)
+{
+    // Any single event has to fit into the batch.
+    batchBuffer = new helpers::SocketBuffer (
+        (std::max) (size, std::size_t (LOG4CPLUS_MAX_MESSAGE_SIZE)));
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (batchLatency != helpers::Time () && ! nonBlocking)
+    {
+        flusher = new BatchFlusher (*this);
+        flusher->start ();
+    }
+#endif
+}
+
+
 void
 SocketAppender::append(const spi::InternalLoggingEvent& event)
 {
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
-    if (! connected)
+    if (nonBlocking)
+    {
+        queueEvent(event);
+        return;
+    }
+    else if (! connected)
     {
+        ++droppedEvents;
         connector->trigger ();
         return;
     }
@@ -223,20 +951,287 @@ SocketAppender::append(const spi::InternalLoggingEvent& event)
         openSocket();
         if(!socket.isOpen()) {
             getLogLog().error(LOG4CPLUS_TEXT("SocketAppender::append()- Cannot connect to server"));
+            ++droppedEvents;
             return;
         }
     }
 
 #endif
 
-    helpers::SocketBuffer buffer(LOG4CPLUS_MAX_MESSAGE_SIZE - sizeof(unsigned int));
-    convertToBuffer (buffer, event, serverName);
-    helpers::SocketBuffer msgBuffer(LOG4CPLUS_MAX_MESSAGE_SIZE);
+    bufferEvent(event);
+    if (batchLatency == helpers::Time ())
+        flushBatch();
+}
+
+
+void
+SocketAppender::appendBatch(const spi::InternalLoggingEvent* events,
+    std::size_t n)
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (nonBlocking)
+    {
+        for (std::size_t i = 0; i != n; ++i)
+            queueEvent(events[i]);
+        return;
+    }
+    else if (! connected)
+    {
+        droppedEvents += static_cast<unsigned long>(n);
+        connector->trigger ();
+        return;
+    }
+
+#else
+    if(!socket.isOpen()) {
+        openSocket();
+        if(!socket.isOpen()) {
+            getLogLog().error(LOG4CPLUS_TEXT("SocketAppender::appendBatch()- Cannot connect to server"));
+            droppedEvents += static_cast<unsigned long>(n);
+            return;
+        }
+    }
+
+#endif
+
+    for (std::size_t i = 0; i != n; ++i)
+        bufferEvent(events[i]);
+
+    if (batchLatency == helpers::Time ())
+        flushBatch();
+}
+
+
+void
+SocketAppender::bufferEvent(const spi::InternalLoggingEvent& event)
+{
+    if (protocolVersion == helpers::MESSAGE_VERSION_3)
+    {
+        eventFrames.clear();
+        encoder.encode(eventFrames, event, serverName);
+
+        // Each frame fits into empty batch.
+        for (std::size_t pos = 0; pos != eventFrames.size(); )
+        {
+            std::size_t const len = sizeof(unsigned int)
+                + get_frame_size(&eventFrames[pos]);
+            if (batchBuffer->getSize() + len > batchBuffer->getMaxSize())
+                flushBatch();
+            batchBuffer->appendBytes(&eventFrames[pos], len);
+            pos += len;
+        }
+    }
+    else
+    {
+        eventBuffer.clear();
+        convertToBuffer (eventBuffer, event, serverName);
+
+        if (batchBuffer->getSize() + sizeof(unsigned int) + eventBuffer.getSize()
+            > batchBuffer->getMaxSize())
+            flushBatch();
+
+        batchBuffer->appendInt(static_cast<unsigned>(eventBuffer.getSize()));
+        batchBuffer->appendBuffer(eventBuffer);
+    }
+
+    if (batchedEvents++ == 0 && batchLatency != helpers::Time ())
+    {
+        batchStart = helpers::Time::gettimeofday();
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+        flusher->trigger ();
+#endif
+    }
+
+    if (batchCount != 0 && batchedEvents >= batchCount)
+        flushBatch();
+#if defined (LOG4CPLUS_SINGLE_THREADED)
+    // There is no flusher thread, the latency is checked here.
+    else if (batchLatency != helpers::Time ()
+        && helpers::Time::gettimeofday() - batchStart >= batchLatency)
+        flushBatch();
+#endif
+}
+
+
+void
+SocketAppender::flushBatch()
+{
+    // Frames of a split event can be there before it is counted.
+    if (batchBuffer->getSize() == 0)
+        return;
+
+    if (! sendBuffer(*batchBuffer))
+        droppedEvents += batchedEvents;
+    batchBuffer->clear();
+    batchedEvents = 0;
+}
+
+
+void
+SocketAppender::queueEvent(const spi::InternalLoggingEvent& event)
+{
+    std::size_t size;
+    if (protocolVersion == helpers::MESSAGE_VERSION_3)
+    {
+        // The server name is added by the sender.
+        eventFrames.clear();
+        queueEncoder.encode(eventFrames, event, tstring());
+        size = eventFrames.size();
+    }
+    else
+    {
+        eventBuffer.clear();
+        convertToBuffer (eventBuffer, event, serverName);
+        size = sizeof(unsigned int) + eventBuffer.getSize();
+    }
+
+    // The full queue is written to the spool without access_mutex
+    // held, the other logging threads keep queueing meanwhile.
+    while (spool && size <= pendingQueue->getMaxSize()
+        && pendingQueue->getSize() + size > pendingQueue->getMaxSize())
+    {
+        access_mutex.unlock();
+        spoolPending();
+        access_mutex.lock();
+    }
+
+    if (pendingQueue->getSize() + size > pendingQueue->getMaxSize())
+    {
+        ++droppedEvents;
+        queueFull = true;
+        return;
+    }
+
+    if (protocolVersion == helpers::MESSAGE_VERSION_3)
+        pendingQueue->appendBytes(&eventFrames[0], size);
+    else
+    {
+        pendingQueue->appendInt(static_cast<unsigned>(eventBuffer.getSize()));
+        pendingQueue->appendBuffer(eventBuffer);
+    }
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (pendingEvents++ == 0)
+        sender->trigger ();
+#endif
+}
+
+
+helpers::SocketBuffer const &
+SocketAppender::encodeQueue()
+{
+    wireQueue->clear();
+    queueDecoder.reset();
+
+    char const * const frames = sendingQueue->getBuffer();
+    for (std::size_t pos = 0; pos + sizeof(unsigned int)
+        <= sendingQueue->getSize(); )
+    {
+        std::size_t const len = get_frame_size(frames + pos);
+        pos += sizeof(unsigned int);
+
+        wireEvents.clear();
+        if (! queueDecoder.decode(frames + pos, len, wireEvents))
+            getLogLog().error(LOG4CPLUS_TEXT("SocketAppender::encodeQueue()")
+                LOG4CPLUS_TEXT("- Damaged frame in queue"));
+        pos += len;
+
+        for (std::size_t i = 0; i != wireEvents.size(); ++i)
+        {
+            wireFrames.clear();
+            encoder.encode(wireFrames, wireEvents[i], serverName);
+            wireQueue->appendBytes(&wireFrames[0], wireFrames.size());
+        }
+    }
+
+    return *wireQueue;
+}
+
+
+bool
+SocketAppender::spoolQueue()
+{
+    if (! spool || pendingEvents == 0 || spoolingEvents != 0)
+        return false;
+
+    std::swap(pendingQueue, spoolingQueue);
+    std::swap(pendingEvents, spoolingEvents);
+    return true;
+}
 
-    msgBuffer.appendInt(static_cast<unsigned>(buffer.getSize()));
-    msgBuffer.appendBuffer(buffer);
 
-    bool ret = socket.write(msgBuffer);
+void
+SocketAppender::writeSpooled()
+{
+    log4cplus::thread::MutexGuard spoolGuard (spool_mutex);
+
+    unsigned events;
+    {
+        log4cplus::thread::MutexGuard guard (access_mutex);
+        events = spoolingEvents;
+    }
+    if (events == 0)
+        return;
+
+    // Nobody else touches spoolingQueue until spoolingEvents is reset.
+    unsigned long const dropped = spool->append(*spoolingQueue, events);
+    spoolingQueue->clear();
+
+    log4cplus::thread::MutexGuard guard (access_mutex);
+    droppedEvents += dropped;
+    spoolingEvents = 0;
+}
+
+
+void
+SocketAppender::spoolPending()
+{
+    while (true)
+    {
+        // Events handed over before are older than the pending ones,
+        // possibly by another thread meanwhile.
+        writeSpooled();
+
+        bool moved;
+        {
+            log4cplus::thread::MutexGuard guard (access_mutex);
+            if (pendingEvents == 0)
+                return;
+            moved = spoolQueue();
+        }
+        if (moved)
+        {
+            writeSpooled();
+            return;
+        }
+    }
+}
+
+
+bool
+SocketAppender::writeSocket(const helpers::SocketBuffer& buffer)
+{
+    if (! compressing)
+        return socket.write(buffer);
+
+    // A failed stream cannot be continued, it starts anew with the
+    // next connection.
+    if (! compressor->compress(buffer, *compressedBuffer))
+    {
+        getLogLog().error(LOG4CPLUS_TEXT("SocketAppender::writeSocket()")
+            LOG4CPLUS_TEXT("- Compression failed"));
+        socket.close();
+        return false;
+    }
+
+    return socket.write(*compressedBuffer);
+}
+
+
+bool
+SocketAppender::sendBuffer(const helpers::SocketBuffer& buffer)
+{
+    bool ret = writeSocket(buffer);
     if (! ret)
     {
 #if ! defined (LOG4CPLUS_SINGLE_THREADED)
@@ -244,6 +1239,7 @@ SocketAppender::append(const spi::InternalLoggingEvent& event)
         connector->trigger ();
 #endif
     }
+    return ret;
 }
 
 
@@ -281,6 +1277,13 @@ convertToBuffer(SocketBuffer & buffer,
 
 spi::InternalLoggingEvent
 readFromBuffer(SocketBuffer& buffer)
+{
+    return readFromBuffer(buffer, tstring());
+}
+
+
+spi::InternalLoggingEvent
+readFromBuffer(SocketBuffer& buffer, const tstring& peerName)
 {
     unsigned char msgVersion = buffer.readByte();
     if(msgVersion != LOG4CPLUS_MESSAGE_VERSION) {
@@ -291,7 +1294,8 @@ readFromBuffer(SocketBuffer& buffer)
 
     unsigned char sizeOfChar = buffer.readByte();
 
-    tstring serverName = buffer.readString(sizeOfChar);
+    tstring const serverName = tagServerName(peerName,
+        buffer.readString(sizeOfChar));
     tstring loggerName = buffer.readString(sizeOfChar);
     LogLevel ll = buffer.readInt();
     tstring ndc = buffer.readString(sizeOfChar);
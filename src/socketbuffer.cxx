@@ -272,4 +272,19 @@ SocketBuffer::appendBuffer(const SocketBuffer& buf)
 }
 
 
+
+void
+SocketBuffer::appendBytes(const char* data, std::size_t len)
+{
+    if((pos + len) > maxsize) {
+        getLogLog().error(LOG4CPLUS_TEXT("SocketBuffer::appendBytes()- Attempt to write beyond end of buffer"));
+        return;
+    }
+
+    std::memcpy(&buffer[pos], data, len);
+    pos += len;
+    size = pos;
+}
+
+
 } } // namespace log4cplus { namespace helpers {
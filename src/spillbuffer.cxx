@@ -0,0 +1,157 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <log4cplus/helpers/spillbuffer.h>
+
+
+namespace log4cplus { namespace helpers {
+
+
+SpillBuffer::SpillBuffer ()
+    : capacity (0)
+    , size (0)
+    , dropped (0)
+    , closed (false)
+{ }
+
+
+SpillBuffer::~SpillBuffer ()
+{ }
+
+
+void
+SpillBuffer::setCapacity (std::size_t capacity_)
+{
+    capacity = capacity_;
+}
+
+
+bool
+SpillBuffer::push (tstring const & text, Time const & timestamp, LogLevel ll)
+{
+    thread::MutexGuard guard (mtx);
+    if (closed || size + text.size () > capacity)
+    {
+        ++dropped;
+        return false;
+    }
+
+    records.push_back (SpillRecord ());
+    SpillRecord & record = records.back ();
+    record.text = text;
+    record.timestamp = timestamp;
+    record.ll = ll;
+    size += text.size ();
+    records_ev.signal ();
+    return true;
+}
+
+
+bool
+SpillBuffer::pop (SpillRecord & record)
+{
+    thread::MutexGuard guard (mtx);
+    if (records.empty ())
+    {
+        records_ev.reset ();
+        return false;
+    }
+
+    SpillRecord & front = records.front ();
+    record.text.swap (front.text);
+    record.timestamp = front.timestamp;
+    record.ll = front.ll;
+    size -= record.text.size ();
+    records.pop_front ();
+    return true;
+}
+
+
+bool
+SpillBuffer::empty () const
+{
+    thread::MutexGuard guard (mtx);
+    return records.empty ();
+}
+
+
+void
+SpillBuffer::waitForRecords (unsigned long msec) const
+{
+    records_ev.timed_wait (msec);
+}
+
+
+bool
+SpillBuffer::waitForClose (unsigned long msec) const
+{
+    return closed_ev.timed_wait (msec);
+}
+
+
+void
+SpillBuffer::close ()
+{
+    thread::MutexGuard guard (mtx);
+    closed = true;
+    closed_ev.signal ();
+    records_ev.signal ();
+}
+
+
+void
+SpillBuffer::reopen ()
+{
+    thread::MutexGuard guard (mtx);
+    closed = false;
+    closed_ev.reset ();
+}
+
+
+bool
+SpillBuffer::isClosed () const
+{
+    thread::MutexGuard guard (mtx);
+    return closed;
+}
+
+
+unsigned long
+SpillBuffer::getDropped () const
+{
+    thread::MutexGuard guard (mtx);
+    return dropped;
+}
+
+
+void
+SpillBuffer::addDropped (unsigned long count)
+{
+    thread::MutexGuard guard (mtx);
+    dropped += count;
+}
+
+
+} } // namespace log4cplus { namespace helpers {
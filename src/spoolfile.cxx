@@ -0,0 +1,431 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include <log4cplus/helpers/spoolfile.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+
+namespace log4cplus { namespace helpers {
+
+
+namespace
+{
+
+
+unsigned char const SPOOL_MAGIC[4] = { 'L', 'S', 'P', '1' };
+
+std::size_t const COPY_CHUNK = 64 * 1024;
+
+
+static
+void
+put_u32 (unsigned char * p, unsigned long x)
+{
+    p[0] = static_cast<unsigned char>(x & 0xff);
+    p[1] = static_cast<unsigned char>((x >> 8) & 0xff);
+    p[2] = static_cast<unsigned char>((x >> 16) & 0xff);
+    p[3] = static_cast<unsigned char>((x >> 24) & 0xff);
+}
+
+
+static
+unsigned long
+get_u32 (unsigned char const * p)
+{
+    return static_cast<unsigned long>(p[0])
+        | (static_cast<unsigned long>(p[1]) << 8)
+        | (static_cast<unsigned long>(p[2]) << 16)
+        | (static_cast<unsigned long>(p[3]) << 24);
+}
+
+
+//! Frame sizes are in network byte order, see SocketBuffer::appendInt().
+static
+unsigned long
+get_frame_size (unsigned char const * p)
+{
+    return (static_cast<unsigned long>(p[0]) << 24)
+        | (static_cast<unsigned long>(p[1]) << 16)
+        | (static_cast<unsigned long>(p[2]) << 8)
+        | static_cast<unsigned long>(p[3]);
+}
+
+
+} // namespace
+
+
+//
+//
+//
+
+SpoolFile::SpoolFile ()
+    : maxSize (0)
+    , readPos (SPOOL_HEADER_SIZE)
+    , nextPos (SPOOL_HEADER_SIZE)
+    , endPos (SPOOL_HEADER_SIZE)
+    , events (0)
+{ }
+
+
+SpoolFile::~SpoolFile ()
+{
+    close ();
+}
+
+
+bool
+SpoolFile::open (tstring const & name_, std::size_t maxSize_)
+{
+    close ();
+    name = name_;
+    maxSize = static_cast<std::streamoff>(maxSize_);
+
+    std::string const file_name (LOG4CPLUS_TSTRING_TO_STRING (name));
+    file.open (file_name.c_str (), std::ios::in | std::ios::out
+        | std::ios::binary);
+    if (! file.is_open ())
+    {
+        file.clear ();
+        return reset ();
+    }
+
+    unsigned char header[SPOOL_HEADER_SIZE];
+    file.seekg (0, std::ios::end);
+    endPos = file.tellg ();
+    file.seekg (0);
+    if (endPos < static_cast<std::streamoff>(SPOOL_HEADER_SIZE)
+        || ! file.read (reinterpret_cast<char *>(header), sizeof (header))
+        || ! std::equal (SPOOL_MAGIC, SPOOL_MAGIC + 4, header))
+    {
+        getLogLog ().warn (LOG4CPLUS_TEXT ("SpoolFile::open()- ") + name
+            + LOG4CPLUS_TEXT (" is not a spool file, starting new one"));
+        file.close ();
+        file.clear ();
+        return reset ();
+    }
+
+    readPos = static_cast<std::streamoff>(get_u32 (header + 8))
+        | ((static_cast<std::streamoff>(get_u32 (header + 12)) << 16) << 16);
+    if (readPos < static_cast<std::streamoff>(SPOOL_HEADER_SIZE)
+        || readPos > endPos)
+        readPos = endPos;
+
+    // Count the frames left over. A frame torn by a crash ends the
+    // spool, it is cut off by compact().
+    nextPos = readPos;
+    std::streamoff pos = readPos;
+    std::streamoff size;
+    while ((size = frameSize (pos)) >= 0)
+    {
+        pos += sizeof (unsigned int) + size;
+        ++events;
+    }
+
+    if (pos != endPos)
+    {
+        getLogLog ().warn (LOG4CPLUS_TEXT ("SpoolFile::open()- Dropping")
+            LOG4CPLUS_TEXT (" torn frame at the end of ") + name);
+        endPos = pos;
+        if (readPos != endPos)
+            compact ();
+    }
+
+    if (readPos == endPos)
+        return reset ();
+
+    if (! file.is_open ())
+        return false;
+
+    if (events != 0)
+        getLogLog ().debug (LOG4CPLUS_TEXT ("SpoolFile::open()- ")
+            + convertIntegerToString (events)
+            + LOG4CPLUS_TEXT (" events left in ") + name);
+    return true;
+}
+
+
+void
+SpoolFile::close ()
+{
+    if (file.is_open ())
+        file.close ();
+    file.clear ();
+    readPos = nextPos = endPos = SPOOL_HEADER_SIZE;
+    events = 0;
+}
+
+
+bool
+SpoolFile::reset ()
+{
+    if (file.is_open ())
+        file.close ();
+    file.clear ();
+    file.open (LOG4CPLUS_TSTRING_TO_STRING (name).c_str (),
+        std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+
+    readPos = nextPos = endPos = SPOOL_HEADER_SIZE;
+    events = 0;
+    writeHeader ();
+    if (! file)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::reset()- Failed")
+            LOG4CPLUS_TEXT (" to open ") + name);
+        file.close ();
+        file.clear ();
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+SpoolFile::writeHeader ()
+{
+    unsigned char header[SPOOL_HEADER_SIZE];
+    std::copy (SPOOL_MAGIC, SPOOL_MAGIC + 4, header);
+    put_u32 (header + 4, 0);
+    put_u32 (header + 8, static_cast<unsigned long>(readPos & 0xffffffffUL));
+    put_u32 (header + 12, static_cast<unsigned long>((readPos >> 16) >> 16));
+
+    file.clear ();
+    file.seekp (0);
+    file.write (reinterpret_cast<char const *>(header), sizeof (header));
+    file.flush ();
+}
+
+
+std::streamoff
+SpoolFile::frameSize (std::streamoff pos)
+{
+    if (endPos - pos < static_cast<std::streamoff>(sizeof (unsigned int)))
+        return -1;
+
+    unsigned char buf[sizeof (unsigned int)];
+    file.clear ();
+    file.seekg (pos);
+    if (! file.read (reinterpret_cast<char *>(buf), sizeof (buf)))
+        return -1;
+
+    std::streamoff const size = get_frame_size (buf);
+    if (endPos - pos - static_cast<std::streamoff>(sizeof (buf)) < size)
+        return -1;
+
+    return size;
+}
+
+
+unsigned long
+SpoolFile::append (SocketBuffer const & frames, unsigned count)
+{
+    if (! file.is_open ())
+        return count;
+
+    file.clear ();
+    file.seekp (endPos);
+    file.write (frames.getBuffer (),
+        static_cast<std::streamsize>(frames.getSize ()));
+    file.flush ();
+    if (! file)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::append()- Failed")
+            LOG4CPLUS_TEXT (" to write ") + name);
+        // Whatever part got written is overwritten by the next append.
+        return count;
+    }
+
+    endPos += static_cast<std::streamoff>(frames.getSize ());
+    events += count;
+
+    // Evict the oldest frames that have not been read yet. Frames
+    // being sent are left alone, commit() skips the evicted ones.
+    unsigned long evicted = 0;
+    bool const in_flight = readPos != nextPos;
+    while (endPos - nextPos > maxSize)
+    {
+        std::streamoff const size = frameSize (nextPos);
+        if (size < 0)
+            break;
+
+        nextPos += sizeof (unsigned int) + size;
+        --events;
+        ++evicted;
+    }
+
+    if (evicted != 0 && ! in_flight)
+    {
+        readPos = nextPos;
+        writeHeader ();
+    }
+
+    // Sent frames are not reclaimed until the spool is drained
+    // completely; rewrite the file when they take too much space.
+    if (! in_flight && readPos - static_cast<std::streamoff>(SPOOL_HEADER_SIZE)
+        > (std::max) (maxSize, endPos - readPos))
+        compact ();
+
+    return evicted;
+}
+
+
+unsigned
+SpoolFile::read (SocketBuffer & buffer)
+{
+    buffer.clear ();
+    std::streamoff const avail = endPos - nextPos;
+    if (! file.is_open () || avail == 0)
+        return 0;
+
+    std::size_t const n = static_cast<std::size_t>((std::min) (avail,
+        static_cast<std::streamoff>(buffer.getMaxSize ())));
+    file.clear ();
+    file.seekg (nextPos);
+    if (! file.read (buffer.getBuffer (), static_cast<std::streamsize>(n)))
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::read()- Failed")
+            LOG4CPLUS_TEXT (" to read ") + name);
+        return 0;
+    }
+
+    // Take whole frames only.
+    unsigned char const * const p
+        = reinterpret_cast<unsigned char const *>(buffer.getBuffer ());
+    std::size_t used = 0;
+    unsigned count = 0;
+    while (n - used >= sizeof (unsigned int))
+    {
+        std::size_t const size = get_frame_size (p + used);
+        if (n - used - sizeof (unsigned int) < size)
+            break;
+
+        used += sizeof (unsigned int) + size;
+        ++count;
+    }
+
+    if (count == 0)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::read()- Frame")
+            LOG4CPLUS_TEXT (" larger than buffer, dropping rest of ") + name);
+        nextPos = endPos;
+        events = 0;
+        return 0;
+    }
+
+    buffer.setSize (used);
+    nextPos += static_cast<std::streamoff>(used);
+    events -= count;
+    return count;
+}
+
+
+void
+SpoolFile::commit ()
+{
+    if (! file.is_open () || readPos == nextPos)
+        return;
+
+    readPos = nextPos;
+    if (readPos == endPos)
+        reset ();
+    else
+        writeHeader ();
+}
+
+
+void
+SpoolFile::compact ()
+{
+    std::string const file_name (LOG4CPLUS_TSTRING_TO_STRING (name));
+    std::string const tmp_name (file_name + ".tmp");
+    std::streamoff const shift = readPos
+        - static_cast<std::streamoff>(SPOOL_HEADER_SIZE);
+    {
+        std::ofstream tmp (tmp_name.c_str (), std::ios::out
+            | std::ios::trunc | std::ios::binary);
+        std::vector<char> buf (COPY_CHUNK);
+        tmp.write (&buf[0], SPOOL_HEADER_SIZE);
+        file.clear ();
+        file.seekg (readPos);
+        std::streamoff remaining = endPos - readPos;
+        while (remaining > 0 && tmp)
+        {
+            std::streamsize const n = static_cast<std::streamsize>(
+                (std::min) (static_cast<std::streamoff>(buf.size ()),
+                    remaining));
+            if (! file.read (&buf[0], n))
+                break;
+
+            tmp.write (&buf[0], n);
+            remaining -= n;
+        }
+
+        tmp.close ();
+        if (remaining != 0 || ! tmp)
+        {
+            getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::compact()-")
+                LOG4CPLUS_TEXT (" Failed to copy ") + name);
+            std::remove (tmp_name.c_str ());
+            return;
+        }
+    }
+
+    file.close ();
+    file.clear ();
+#if defined (WIN32)
+    // rename() does not replace existing file on Windows. Elsewhere
+    // it does so atomically and the spool file is never missing.
+    std::remove (file_name.c_str ());
+#endif
+    if (std::rename (tmp_name.c_str (), file_name.c_str ()) != 0)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::compact()- Failed")
+            LOG4CPLUS_TEXT (" to rename ") + LOG4CPLUS_C_STR_TO_TSTRING (tmp_name));
+        return;
+    }
+
+    file.open (file_name.c_str (), std::ios::in | std::ios::out
+        | std::ios::binary);
+    readPos -= shift;
+    nextPos -= shift;
+    endPos -= shift;
+    writeHeader ();
+    if (! file)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("SpoolFile::compact()- Failed")
+            LOG4CPLUS_TEXT (" to open ") + name);
+        file.close ();
+        file.clear ();
+    }
+}
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -405,3 +405,38 @@ log4cplus::helpers::toLower(const log4cplus::tstring& s)
                    string_append_iterator<tstring>(ret), tolower_func ());
     return ret;
 }
+
+
+std::streamoff
+log4cplus::helpers::parseFileSize(const log4cplus::tstring& s)
+{
+    tstring const tmp (toUpper (s));
+    tstring::size_type i = 0;
+    tstring::size_type end = tmp.size ();
+    while (i < end && (tmp[i] == LOG4CPLUS_TEXT(' ')
+            || tmp[i] == LOG4CPLUS_TEXT('\t')))
+        ++i;
+    while (end > i && (tmp[end - 1] == LOG4CPLUS_TEXT(' ')
+            || tmp[end - 1] == LOG4CPLUS_TEXT('\t')))
+        --end;
+
+    std::streamoff value = 0;
+    for (; i < end
+            && tmp[i] >= LOG4CPLUS_TEXT('0') && tmp[i] <= LOG4CPLUS_TEXT('9');
+         ++i)
+        value = value * 10 + (tmp[i] - LOG4CPLUS_TEXT('0'));
+
+    while (i < end && (tmp[i] == LOG4CPLUS_TEXT(' ')
+            || tmp[i] == LOG4CPLUS_TEXT('\t')))
+        ++i;
+
+    tstring const unit (tmp, i, end - i);
+    if (unit == LOG4CPLUS_TEXT("KB"))
+        value *= 1024;
+    else if (unit == LOG4CPLUS_TEXT("MB"))
+        value *= 1024 * 1024;
+    else if (unit == LOG4CPLUS_TEXT("GB"))
+        value *= 1024 * 1024 * 1024;
+
+    return value;
+}
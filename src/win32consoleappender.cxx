@@ -88,9 +88,7 @@ Win32ConsoleAppender::append (spi::InternalLoggingEvent const & event)
         return;
     }
 
-    tostringstream oss;
-    layout->formatAndAppend (oss, event);
-    tstring str = oss.str ();
+    tstring const & str = layout->formatText (event);
     size_t const str_len = str.size ();
     tchar const * s = str.c_str ();
     DWORD mode;
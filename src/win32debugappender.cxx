@@ -78,10 +78,7 @@ log4cplus::Win32DebugAppender::close()
 void
 log4cplus::Win32DebugAppender::append(const spi::InternalLoggingEvent& event)
 {
-    tostringstream buf;
-    layout->formatAndAppend(buf, event);
-    tstring sz = buf.str();
-    const tchar * s = sz.c_str();
+    const tchar * s = layout->formatText(event).c_str();
     ::OutputDebugString(s);
 }
 
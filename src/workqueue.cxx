@@ -0,0 +1,297 @@
+//   Copyright (C) 2011, Vaclav Haisman. All rights reserved.
+//
+//   Redistribution and use in source and binary forms, with or without modifica-
+//   tion, are permitted provided that the following conditions are met:
+//
+//   1. Redistributions of  source code must  retain the above copyright  notice,
+//      this list of conditions and the following disclaimer.
+//
+//   2. Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED WARRANTIES,
+//   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//   FITNESS  FOR A PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN NO  EVENT SHALL  THE
+//   APACHE SOFTWARE  FOUNDATION  OR ITS CONTRIBUTORS  BE LIABLE FOR  ANY DIRECT,
+//   INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL  DAMAGES (INCLU-
+//   DING, BUT NOT LIMITED TO, PROCUREMENT  OF SUBSTITUTE GOODS OR SERVICES; LOSS
+//   OF USE, DATA, OR  PROFITS; OR BUSINESS  INTERRUPTION)  HOWEVER CAUSED AND ON
+//   ANY  THEORY OF LIABILITY,  WHETHER  IN CONTRACT,  STRICT LIABILITY,  OR TORT
+//   (INCLUDING  NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT OF THE  USE OF
+//   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <log4cplus/helpers/workqueue.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/streams.h>
+#include <exception>
+#include <algorithm>
+
+#if defined (__linux__)
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined (_WIN32)
+#include <log4cplus/config/windowsh-inc.h>
+#endif
+
+
+namespace log4cplus { namespace helpers {
+
+
+namespace
+{
+
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+static
+void
+set_current_thread_nice_level (int level)
+{
+    if (level <= 0)
+        return;
+
+#if defined (__linux__)
+    // Linux keeps nice level per thread, addressed by its TID.
+    if (setpriority (PRIO_PROCESS, static_cast<id_t>(syscall (SYS_gettid)),
+            level) != 0)
+        getLogLog ().warn (
+            LOG4CPLUS_TEXT ("WorkQueue: Failed to set thread nice level."));
+
+#elif defined (_WIN32)
+    SetThreadPriority (GetCurrentThread (),
+        level >= 10 ? THREAD_PRIORITY_LOWEST : THREAD_PRIORITY_BELOW_NORMAL);
+
+#endif
+}
+
+#endif
+
+
+} // namespace
+
+
+//
+//
+//
+
+WorkItem::WorkItem ()
+{ }
+
+
+WorkItem::~WorkItem ()
+{ }
+
+
+//
+//
+//
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+class WorkQueue::Worker
+    : public thread::AbstractThread
+{
+public:
+    Worker (WorkQueue & q)
+        : wq (q)
+        , niceLevel (q.niceLevel)
+    { }
+
+    virtual void run ()
+    {
+        set_current_thread_nice_level (niceLevel);
+        wq.workerLoop ();
+    }
+
+protected:
+    virtual ~Worker ()
+    { }
+
+    WorkQueue & wq;
+    int niceLevel;
+};
+
+#endif
+
+
+WorkQueue::WorkQueue (unsigned threads)
+    :
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+      work_ev (false)
+    , idle_ev (true)
+    , active (0)
+    ,
+#endif
+      maxThreads ((std::max) (threads, 1u))
+    , niceLevel (0)
+    , closed (false)
+{ }
+
+
+WorkQueue::~WorkQueue ()
+{
+    close ();
+}
+
+
+void
+WorkQueue::post (WorkItemPtr const & item)
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    {
+        thread::MutexGuard guard (queue_mutex);
+        if (! closed)
+        {
+            queue.push_back (item);
+            idle_ev.reset ();
+            work_ev.signal ();
+
+            // Start another worker if all the existing ones are busy.
+            if (workers.size () < maxThreads
+                && workers.size () < active + queue.size ())
+            {
+                thread::AbstractThreadPtr worker (new Worker (*this));
+                workers.push_back (worker);
+                worker->start ();
+            }
+
+            return;
+        }
+    }
+
+#endif
+
+    execute (item);
+}
+
+
+void
+WorkQueue::wait () const
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    idle_ev.wait ();
+#endif
+}
+
+
+void
+WorkQueue::close ()
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    std::vector<thread::AbstractThreadPtr> to_join;
+    {
+        thread::MutexGuard guard (queue_mutex);
+        if (closed)
+            return;
+
+        closed = true;
+        work_ev.signal ();
+        to_join.swap (workers);
+    }
+
+    for (std::vector<thread::AbstractThreadPtr>::const_iterator it
+        = to_join.begin (); it != to_join.end (); ++it)
+        (*it)->join ();
+
+    // There might be no worker thread at all when close() is called
+    // before the first post().
+    idle_ev.signal ();
+
+#else
+    closed = true;
+
+#endif
+}
+
+
+std::size_t
+WorkQueue::pending () const
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    thread::MutexGuard guard (queue_mutex);
+    return queue.size () + active;
+
+#else
+    return 0;
+
+#endif
+}
+
+
+void
+WorkQueue::setNiceLevel (int level)
+{
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    thread::MutexGuard guard (queue_mutex);
+#endif
+    niceLevel = level;
+}
+
+
+void
+WorkQueue::execute (WorkItemPtr const & item) const
+{
+    try
+    {
+        item->run ();
+    }
+    catch (std::exception const & e)
+    {
+        tstring err (LOG4CPLUS_TEXT ("WorkQueue::execute()- work item")
+            LOG4CPLUS_TEXT (" terminated with an exception: "));
+        err += LOG4CPLUS_C_STR_TO_TSTRING (e.what ());
+        getLogLog ().error (err);
+    }
+    catch (...)
+    {
+        getLogLog ().error (LOG4CPLUS_TEXT ("WorkQueue::execute()- work item")
+            LOG4CPLUS_TEXT (" terminated with an exception."));
+    }
+}
+
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+void
+WorkQueue::workerLoop ()
+{
+    while (true)
+    {
+        WorkItemPtr item;
+
+        {
+            thread::MutexGuard guard (queue_mutex);
+            if (! queue.empty ())
+            {
+                item = queue.front ();
+                queue.pop_front ();
+                ++active;
+            }
+            else if (closed)
+                return;
+            else
+                work_ev.reset ();
+        }
+
+        if (! item.get ())
+        {
+            work_ev.wait ();
+            continue;
+        }
+
+        execute (item);
+        item = WorkItemPtr ();
+
+        {
+            thread::MutexGuard guard (queue_mutex);
+            --active;
+            if (queue.empty () && active == 0)
+                idle_ev.signal ();
+        }
+    }
+}
+
+#endif
+
+
+} } // namespace log4cplus { namespace helpers {
@@ -0,0 +1,106 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/fileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/loglevel.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const int EVENT_COUNT = 20000;
+const std::size_t BATCH_SIZE = 256;
+
+
+static
+std::string
+read_file (std::string const & name)
+{
+    std::ifstream in (name.c_str ());
+    std::ostringstream oss;
+    oss << in.rdbuf ();
+    return oss.str ();
+}
+
+
+static
+SharedAppenderPtr
+make_appender (Appender * appender, tchar const * name)
+{
+    SharedAppenderPtr append (appender);
+    append->setName (name);
+    append->setLayout (std::auto_ptr<Layout> (
+        new PatternLayout (LOG4CPLUS_TEXT ("%-5p %c - %m%n"))));
+    append->setThreshold (INFO_LOG_LEVEL);
+    return append;
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    std::vector<spi::InternalLoggingEvent> events;
+    events.reserve (EVENT_COUNT);
+    for (int i = 0; i < EVENT_COUNT; ++i)
+        events.push_back (spi::InternalLoggingEvent (
+            LOG4CPLUS_TEXT ("test.batch"),
+            i % 3 == 0 ? DEBUG_LOG_LEVEL : INFO_LOG_LEVEL,
+            LOG4CPLUS_TEXT ("event ") + convertIntegerToString (i),
+            __FILE__, __LINE__));
+
+    SharedAppenderPtr single (make_appender (
+        new FileAppender (LOG4CPLUS_TEXT ("Single.log")),
+        LOG4CPLUS_TEXT ("Single")));
+    SharedAppenderPtr batch (make_appender (
+        new FileAppender (LOG4CPLUS_TEXT ("Batch.log")),
+        LOG4CPLUS_TEXT ("Batch")));
+    SharedAppenderPtr rolling (make_appender (
+        new RollingFileAppender (LOG4CPLUS_TEXT ("Rolling.log"),
+            200 * 1024, 5),
+        LOG4CPLUS_TEXT ("Rolling")));
+
+    for (std::size_t i = 0; i != events.size (); ++i)
+        single->doAppend (events[i]);
+
+    for (std::size_t i = 0; i < events.size (); i += BATCH_SIZE)
+    {
+        std::size_t const count = std::min (BATCH_SIZE, events.size () - i);
+        batch->doAppendBatch (&events[i], count);
+        rolling->doAppendBatch (&events[i], count);
+    }
+
+    single->close ();
+    batch->close ();
+    rolling->close ();
+
+    int failures = 0;
+    std::string const expected (read_file ("Single.log"));
+    if (expected.empty () || expected != read_file ("Batch.log"))
+    {
+        std::cout << "batched output differs" << std::endl;
+        ++failures;
+    }
+
+    if (expected.find ("DEBUG") != std::string::npos)
+    {
+        std::cout << "threshold not applied" << std::endl;
+        ++failures;
+    }
+
+    if (read_file ("Rolling.log.1").empty ())
+    {
+        std::cout << "rolling appender did not roll over" << std::endl;
+        ++failures;
+    }
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/compressedfileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/ndc.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/compress.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+
+using namespace log4cplus;
+
+const int LOOP_COUNT = 20000;
+
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+//! Records are stamped ten per second from this time on.
+const time_t BASE_TIME = 1000000000;
+
+
+static
+helpers::Time
+record_time (int record)
+{
+    return helpers::Time (BASE_TIME + record / 10, (record % 10) * 100000);
+}
+
+
+//! Appends record numbers found in <code>text</code> to
+//! <code>records</code>. Returns the number of broken lines.
+static
+int
+parse_records (std::vector<int> & records, std::string const & text)
+{
+    int broken = 0;
+    std::istringstream iss (text);
+    std::string line;
+    while (std::getline (iss, line))
+    {
+        int record;
+        if (std::sscanf (line.c_str (), "record %d", &record) == 1)
+            records.push_back (record);
+        else
+            ++broken;
+    }
+
+    return broken;
+}
+
+
+//! Decodes frames whose time span overlaps [from, to], or all frames
+//! when <code>from</code> is greater than <code>to</code>, and checks
+//! that the timestamps in frame headers match the records inside.
+//! Returns the number of frames in the file, or -1 on error.
+static
+int
+read_frames (std::vector<int> & records, std::string const & data,
+    helpers::Time const & from, helpers::Time const & to, int & decoded)
+{
+    bool const all = to < from;
+    unsigned char const * p
+        = reinterpret_cast<unsigned char const *>(data.data ());
+    std::size_t left = data.size ();
+    int frames = 0;
+    decoded = 0;
+    while (left != 0)
+    {
+        helpers::CompressedFrameInfo info;
+        if (! helpers::parseCompressedFrameHeader (info, p, left)
+            || info.size > left)
+        {
+            std::cout << "Bad frame header at offset "
+                << data.size () - left << std::endl;
+            return -1;
+        }
+
+        ++frames;
+        if (all || (info.last >= from && info.first <= to))
+        {
+            std::string text;
+            std::vector<int> frameRecords;
+            if (! helpers::decodeCompressedFrame (text, p, info.size)
+                || parse_records (frameRecords, text) != 0
+                || frameRecords.empty ()
+                || record_time (frameRecords.front ()) != info.first
+                || record_time (frameRecords.back ()) != info.last)
+            {
+                std::cout << "Bad frame " << frames << std::endl;
+                return -1;
+            }
+
+            ++decoded;
+            records.insert (records.end (), frameRecords.begin (),
+                frameRecords.end ());
+        }
+
+        p += info.size;
+        left -= info.size;
+    }
+
+    return frames;
+}
+
+
+static
+bool
+is_sequence (std::vector<int> const & records, int first, int last)
+{
+    if (records.empty () || records.front () > first
+        || records.back () < last)
+        return false;
+
+    for (std::size_t i = 1; i < records.size (); ++i)
+        if (records[i] != records[i - 1] + 1)
+            return false;
+
+    return true;
+}
+#endif
+
+
+int
+main()
+{
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    std::remove ("Test.log.gz");
+
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+    SharedAppenderPtr append_1(
+        new CompressedFileAppender(LOG4CPLUS_TEXT("Test.log.gz"), 64*1024));
+    append_1->setName(LOG4CPLUS_TEXT("First"));
+    append_1->setLayout( std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))) );
+
+    // Events carry made up timestamps, so that time ranges of the
+    // frames are known.
+    for(int i=0; i<LOOP_COUNT; ++i) {
+        tostringstream message;
+        message << LOG4CPLUS_TEXT("record ") << i
+                << LOG4CPLUS_TEXT(" of the compressed file appender test");
+        spi::InternalLoggingEvent event(LOG4CPLUS_TEXT("test.subtest"),
+            DEBUG_LOG_LEVEL, LOG4CPLUS_TEXT("loop"), message.str(),
+            LOG4CPLUS_TEXT("main"), record_time(i), tstring(), 0);
+        append_1->doAppend(event);
+    }
+    append_1->close();
+
+    std::ifstream file ("Test.log.gz", std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf ();
+    std::string const data (contents.str ());
+
+    // Whole file.
+    std::vector<int> records;
+    int decoded = 0;
+    int const frames = read_frames (records, data, helpers::Time (1, 0),
+        helpers::Time (0, 0), decoded);
+    std::cout << "Frames: " << frames << ", records: " << records.size ()
+        << std::endl;
+    if (frames < 2 || static_cast<int>(records.size ()) != LOOP_COUNT
+        || ! is_sequence (records, 0, LOOP_COUNT - 1))
+        return 1;
+
+    // Time range of records 5000 to 5999.
+    records.clear ();
+    read_frames (records, data, record_time (5000), record_time (5999),
+        decoded);
+    std::cout << "Range: decoded " << decoded << " frames, "
+        << records.size () << " records" << std::endl;
+    if (decoded == 0 || decoded >= frames
+        || ! is_sequence (records, 5000, 5999))
+        return 1;
+
+#else
+    std::cout << "log4cplus has been built without zlib." << std::endl;
+
+#endif
+
+    return 0;
+}
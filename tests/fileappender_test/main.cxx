@@ -3,16 +3,780 @@
 #include <log4cplus/layout.h>
 #include <log4cplus/ndc.h>
 #include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/helpers/pagecache.h>
+#include <log4cplus/helpers/blockindex.h>
+#include <log4cplus/helpers/fileinfo.h>
+#include <log4cplus/helpers/sleep.h>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <cstdio>
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined (__linux__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 using namespace log4cplus;
 
 const int LOOP_COUNT = 20000;
+const int MAX_BACKUP_INDEX = 5;
+
+
+static
+std::string
+backup_name (std::string const & base, int i, char const * suffix = "")
+{
+    std::ostringstream name;
+    name << base;
+    if (i != 0)
+        name << "." << i << suffix;
+
+    return name.str ();
+}
+
+
+static
+void
+remove_files (std::string const & base, char const * suffix = "")
+{
+    for (int i = 0; i <= MAX_BACKUP_INDEX; ++i)
+        std::remove (backup_name (base, i, suffix).c_str ());
+}
+
+
+//! Appends loop numbers of the records in <code>text</code> to
+//! <code>records</code>. Returns the number of lines that are not
+//! complete records.
+static
+int
+parse_records (std::vector<int> & records, std::istream & text)
+{
+    int broken = 0;
+    std::string line;
+    while (std::getline (text, line))
+    {
+        std::string::size_type const pos = line.find ("Entering loop #");
+        int record;
+        if (pos != std::string::npos
+            && line.find (" DEBUG test.subtest <loop> - ") != std::string::npos
+            && std::sscanf (line.c_str () + pos, "Entering loop #%d",
+                &record) == 1)
+            records.push_back (record);
+        else
+            ++broken;
+    }
+
+    return broken;
+}
+
+
+//! Reads the whole file, decompressing it if <code>compressed</code>
+//! is true. Returns false if the file cannot be read.
+static
+bool
+read_file (std::string & contents, std::string const & name,
+    bool compressed)
+{
+    contents.clear ();
+    if (! compressed)
+    {
+        std::ifstream file (name.c_str (), std::ios::binary);
+        if (! file)
+            return false;
+
+        std::ostringstream oss;
+        oss << file.rdbuf ();
+        contents = oss.str ();
+        return true;
+    }
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    gzFile file = gzopen (name.c_str (), "rb");
+    if (! file)
+        return false;
+
+    char buf[16384];
+    int ret;
+    while ((ret = gzread (file, buf, sizeof (buf))) > 0)
+        contents.append (buf, ret);
+
+    gzclose (file);
+    return ret == 0;
+#else
+    return false;
+#endif
+}
+
+
+//! Checks that the backups, oldest first, followed by the current
+//! file hold the last records of the loop without gaps and that no
+//! backup is larger than <code>maxSize</code> plus one record. With
+//! <code>compressed</code> the backups must have been replaced by
+//! their gzip compressed versions.
+static
+bool
+check_rolled_files (std::string const & base, std::streamoff maxSize,
+    bool compressed = false)
+{
+    std::vector<int> records;
+    int broken = 0;
+    int files = 0;
+    for (int i = MAX_BACKUP_INDEX; i >= 0; --i)
+    {
+        std::string const name (backup_name (base, i,
+            compressed ? ".gz" : ""));
+        std::string contents;
+        if (! read_file (contents, name, compressed && i != 0))
+            continue;
+
+        if (compressed && i != 0
+            && std::ifstream (backup_name (base, i).c_str ()))
+        {
+            std::cout << name << " left behind its uncompressed source"
+                << std::endl;
+            return false;
+        }
+
+        ++files;
+        std::istringstream text (contents);
+        broken += parse_records (records, text);
+        if (i != 0 && static_cast<std::streamoff>(contents.size ())
+            > maxSize + 200)
+        {
+            std::cout << name << " is too large: " << contents.size ()
+                << std::endl;
+            return false;
+        }
+    }
+
+    bool ok = files == MAX_BACKUP_INDEX + 1 && broken == 0
+        && ! records.empty () && records.back () == LOOP_COUNT - 1;
+    for (std::size_t i = 1; ok && i < records.size (); ++i)
+        ok = records[i] == records[i - 1] + 1;
+
+    std::cout << base << ": " << files << " files, " << records.size ()
+        << " records, broken lines: " << broken << std::endl;
+    return ok;
+}
+
+
+//! Checks parsing of size properties like MaxFileSize.
+static
+bool
+check_file_sizes ()
+{
+    struct Case
+    {
+        tchar const * text;
+        std::streamoff size;
+    };
+    static Case const cases[] = {
+        { LOG4CPLUS_TEXT("204800"), 204800 },
+        { LOG4CPLUS_TEXT(" 204800 "), 204800 },
+        { LOG4CPLUS_TEXT("16KB"), 16 * 1024 },
+        { LOG4CPLUS_TEXT("16kb"), 16 * 1024 },
+        { LOG4CPLUS_TEXT("10MB"), 10 * 1024 * 1024 },
+        { LOG4CPLUS_TEXT("10 MB"), 10 * 1024 * 1024 },
+        { LOG4CPLUS_TEXT("10\tMB "), 10 * 1024 * 1024 },
+        { LOG4CPLUS_TEXT("3GB"), static_cast<std::streamoff>(3) << 30 }
+    };
+
+    bool ok = true;
+    for (std::size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); ++i)
+    {
+        std::streamoff const size = helpers::parseFileSize (cases[i].text);
+        if (size != cases[i].size)
+        {
+            tcout << LOG4CPLUS_TEXT("\"") << cases[i].text
+                  << LOG4CPLUS_TEXT("\" parsed as ") << size << std::endl;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+static
+std::streamoff
+file_size (char const * name)
+{
+    std::ifstream file (name, std::ios::binary | std::ios::ate);
+    return file ? static_cast<std::streamoff>(file.tellg ()) : -1;
+}
+
+
+#if defined (__linux__)
+//! Returns the number of pages of the first <code>size</code> bytes
+//! of the file that are in the page cache, or -1 on error. The
+//! number of pages in the range is stored in <code>pages</code>.
+static
+long
+resident_pages (char const * name, std::streamoff size, long & pages)
+{
+    long const pageSize = sysconf (_SC_PAGESIZE);
+    pages = static_cast<long>((size + pageSize - 1) / pageSize);
+    int const fd = open (name, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    void * addr = mmap (0, size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED)
+        return -1;
+
+    std::vector<unsigned char> vec (pages);
+    long resident = -1;
+    if (mincore (addr, size, &vec[0]) == 0)
+    {
+        resident = 0;
+        for (long i = 0; i < pages; ++i)
+            resident += vec[i] & 1;
+    }
+
+    munmap (addr, size);
+    return resident;
+}
+#endif
+
+
+//! Checks that with PageCacheInterval set the appender writes its
+//! output out every interval and drops the regions written before
+//! the last two intervals from the page cache, while an otherwise
+//! identical appender without it leaves the file cached.
+static
+bool
+check_page_cache_trimming ()
+{
+    if (! helpers::isPageCacheControlAvailable ())
+    {
+        std::cout << "Page cache control is not available." << std::endl;
+        return true;
+    }
+
+    std::streamoff const interval = 64 * 1024;
+    int const recordSize = 100;
+    int const records = 4000;
+
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestCache.log"));
+    props.setProperty(LOG4CPLUS_TEXT("ImmediateFlush"), LOG4CPLUS_TEXT("false"));
+    props.setProperty(LOG4CPLUS_TEXT("PageCacheInterval"), LOG4CPLUS_TEXT("64KB"));
+    SharedAppenderPtr trimmed(new FileAppender(props));
+    trimmed->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestNoCache.log"));
+    props.removeProperty(LOG4CPLUS_TEXT("PageCacheInterval"));
+    SharedAppenderPtr cached(new FileAppender(props));
+    cached->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+
+    Logger cache = Logger::getInstance(LOG4CPLUS_TEXT("cache"));
+    cache.setAdditivity(false);
+    cache.addAppender(trimmed);
+    cache.addAppender(cached);
+
+    tstring const padding (recordSize - 1 - 12, LOG4CPLUS_TEXT('.'));
+    for (int i = 0; i < records; ++i)
+    {
+        tostringstream message;
+        message << std::setw (12) << i << padding;
+        LOG4CPLUS_INFO(cache, message.str ());
+    }
+
+    std::streamoff const total
+        = static_cast<std::streamoff>(records) * recordSize;
+    std::streamoff const onDisk = file_size ("TestCache.log");
+    bool ok = onDisk >= total - interval - recordSize;
+
+#if defined (__linux__)
+    // Regions older than the last two intervals have been waited for
+    // and dropped.
+    long pages = 0;
+    long const trimmedResident = resident_pages ("TestCache.log",
+        total - 2 * interval - recordSize, pages);
+    long const cachedResident = resident_pages ("TestNoCache.log",
+        total - 2 * interval - recordSize, pages);
+    std::cout << "Resident pages of " << pages << " with PageCacheInterval: "
+        << trimmedResident << ", without: " << cachedResident << std::endl;
+    ok = ok && trimmedResident >= 0 && trimmedResident <= pages / 4
+        && cachedResident > pages / 2;
+#endif
+
+    std::cout << "Written " << total << " bytes, " << onDisk
+        << " bytes on disk before close" << std::endl;
+
+    cache.removeAllAppenders();
+    trimmed->close();
+    cached->close();
+
+    // Trimming must not lose or add anything.
+    return ok && file_size ("TestCache.log") == total
+        && file_size ("TestNoCache.log") == total;
+}
+
+
+//! Size of the records written by log_records(), newline included.
+const int RECORD_SIZE = 1000;
+
+//! Number of records of RECORD_SIZE in a rolled file: the file is
+//! rolled over after the record that takes it over 200 KB.
+const int RECORDS_PER_FILE = 200 * 1024 / RECORD_SIZE + 1;
+
+
+//! Logs records numbered <code>from</code> to <code>to - 1</code>.
+static
+void
+log_records (Logger const & logger, int from, int to)
+{
+    tstring const padding (RECORD_SIZE - 1 - 12, LOG4CPLUS_TEXT('.'));
+    for (int i = from; i < to; ++i)
+    {
+        tostringstream message;
+        message << std::setw (12) << i << padding;
+        LOG4CPLUS_INFO(logger, message.str ());
+    }
+}
+
+
+static
+SharedAppenderPtr
+add_naming_appender (Logger & logger, helpers::Properties const & props)
+{
+    SharedAppenderPtr appender(new RollingFileAppender(props));
+    appender->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+    logger.setAdditivity(false);
+    logger.addAppender(appender);
+    return appender;
+}
+
+
+//! Returns number of the first record in the file or -1 if it does
+//! not exist.
+static
+int
+first_record (std::string const & name)
+{
+    std::ifstream file (name.c_str ());
+    int record = -1;
+    if (! (file >> record))
+        return -1;
+
+    return record;
+}
+
+
+static
+bool
+file_exists (std::string const & name)
+{
+    return !! std::ifstream (name.c_str ());
+}
+
+
+static
+std::string
+sequence_name (std::string const & base, int i)
+{
+    std::ostringstream name;
+    name << base << "." << std::setw (8) << std::setfill ('0') << i;
+    return name.str ();
+}
+
+
+//! Returns sorted names of the files in the current directory that
+//! start with <code>prefix</code>.
+static
+std::vector<std::string>
+list_files (std::string const & prefix)
+{
+    std::vector<tstring> names;
+    helpers::listDirectory (names, tstring ());
+
+    std::vector<std::string> found;
+    for (std::size_t i = 0; i != names.size (); ++i)
+    {
+        std::string const name (LOG4CPLUS_TSTRING_TO_STRING (names[i]));
+        if (name.compare (0, prefix.size (), prefix) == 0)
+            found.push_back (name);
+    }
+
+    std::sort (found.begin (), found.end ());
+    return found;
+}
+
+
+static
+void
+remove_listed_files (std::string const & prefix)
+{
+    std::vector<std::string> const names (list_files (prefix));
+    for (std::size_t i = 0; i != names.size (); ++i)
+        std::remove (names[i].c_str ());
+}
+
+
+//! Checks that with BackupNaming=sequence backups get increasing
+//! numbers continuing after backups found on disk, are never
+//! renamed, and the oldest ones are removed by MaxBackupIndex.
+static
+bool
+check_sequence_naming ()
+{
+    remove_listed_files ("TestSeq.log");
+    std::string const base ("TestSeq.log");
+    std::ofstream (sequence_name (base, 7).c_str ()) << "left behind\n";
+
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestSeq.log"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxFileSize"), LOG4CPLUS_TEXT("200KB"));
+    props.setProperty(LOG4CPLUS_TEXT("BackupNaming"), LOG4CPLUS_TEXT("sequence"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupIndex"), LOG4CPLUS_TEXT("3"));
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("naming.sequence"));
+    SharedAppenderPtr appender = add_naming_appender (logger, props);
+
+    // One rollover. The backup found on disk is kept.
+    log_records (logger, 0, RECORDS_PER_FILE + 10);
+    bool ok = file_exists (sequence_name (base, 7))
+        && first_record (sequence_name (base, 8)) == 0
+        && ! file_exists (sequence_name (base, 9));
+
+    // Two more rollovers. The first backup keeps its name and the
+    // oldest one, over the limit of 3, is removed.
+    log_records (logger, RECORDS_PER_FILE + 10, 3 * RECORDS_PER_FILE + 10);
+    ok = ok && ! file_exists (sequence_name (base, 7))
+        && first_record (sequence_name (base, 8)) == 0
+        && first_record (sequence_name (base, 9)) == RECORDS_PER_FILE
+        && first_record (sequence_name (base, 10)) == 2 * RECORDS_PER_FILE
+        && ! file_exists (sequence_name (base, 11));
+
+    log_records (logger, 3 * RECORDS_PER_FILE + 10, 4 * RECORDS_PER_FILE + 10);
+    ok = ok && ! file_exists (sequence_name (base, 8))
+        && first_record (sequence_name (base, 9)) == RECORDS_PER_FILE
+        && first_record (sequence_name (base, 11)) == 3 * RECORDS_PER_FILE
+        && first_record (base) == 4 * RECORDS_PER_FILE;
+
+    logger.removeAllAppenders();
+    appender->close();
+
+    std::cout << "Sequence naming: " << list_files (base).size ()
+        << " files" << std::endl;
+    return ok && list_files (base).size () == 4;
+}
+
+
+//! Checks that MaxTotalSize removes the oldest backups once their
+//! total size is over the limit.
+static
+bool
+check_total_size_limit ()
+{
+    remove_listed_files ("TestTotal.log");
+    std::string const base ("TestTotal.log");
+
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestTotal.log"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxFileSize"), LOG4CPLUS_TEXT("200KB"));
+    props.setProperty(LOG4CPLUS_TEXT("BackupNaming"), LOG4CPLUS_TEXT("sequence"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupIndex"), LOG4CPLUS_TEXT("0"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxTotalSize"), LOG4CPLUS_TEXT("500KB"));
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("naming.total"));
+    SharedAppenderPtr appender = add_naming_appender (logger, props);
+
+    // Four backups of 205000 bytes, only two fit into 500 KB.
+    log_records (logger, 0, 4 * RECORDS_PER_FILE + 10);
+    logger.removeAllAppenders();
+    appender->close();
+
+    std::streamoff total = 0;
+    for (int i = 1; i <= 4; ++i)
+        if (file_exists (sequence_name (base, i)))
+            total += file_size (sequence_name (base, i).c_str ());
+
+    std::cout << "Total size of backups: " << total << std::endl;
+    return ! file_exists (sequence_name (base, 1))
+        && ! file_exists (sequence_name (base, 2))
+        && first_record (sequence_name (base, 3)) == 2 * RECORDS_PER_FILE
+        && first_record (sequence_name (base, 4)) == 3 * RECORDS_PER_FILE
+        && total <= 500 * 1024;
+}
+
+
+//! Checks that BackupNaming=timestamp names backups after the time
+//! of the rollover and that MaxBackupAge removes old backups,
+//! including those found on disk.
+static
+bool
+check_timestamp_naming ()
+{
+    remove_listed_files ("TestTs.log");
+    std::string const base ("TestTs.log");
+    std::string const leftover (base + ".2000-01-01-00-00-00");
+    std::ofstream (leftover.c_str ()) << "left behind\n";
+
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestTs.log"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxFileSize"), LOG4CPLUS_TEXT("200KB"));
+    props.setProperty(LOG4CPLUS_TEXT("BackupNaming"), LOG4CPLUS_TEXT("timestamp"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupIndex"), LOG4CPLUS_TEXT("0"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupAge"), LOG4CPLUS_TEXT("1"));
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("naming.timestamp"));
+    SharedAppenderPtr appender = add_naming_appender (logger, props);
+
+    tstring const stamp (helpers::Time::gettimeofday ().getFormattedTime (
+        LOG4CPLUS_TEXT("%Y-%m-%d")));
+    std::string const prefix (base + "."
+        + LOG4CPLUS_TSTRING_TO_STRING (stamp) + "-");
+
+    log_records (logger, 0, RECORDS_PER_FILE + 10);
+    std::vector<std::string> first (list_files (prefix));
+    bool ok = first.size () == 1 && first_record (first[0]) == 0
+        && first[0].size () == leftover.size ()
+        && file_exists (leftover);
+
+    // After more than MaxBackupAge both the first backup and the one
+    // found on disk are removed at the next rollover.
+    helpers::sleep (2);
+    log_records (logger, RECORDS_PER_FILE + 10, 2 * RECORDS_PER_FILE + 10);
+    std::vector<std::string> second (list_files (prefix));
+    ok = ok && second.size () == 1 && second[0] != first[0]
+        && first_record (second[0]) == RECORDS_PER_FILE
+        && ! file_exists (leftover);
+
+    logger.removeAllAppenders();
+    appender->close();
+
+    std::cout << "Timestamp naming: "
+        << (second.empty () ? std::string () : second[0]) << std::endl;
+    return ok;
+}
+
+
+//! Reads entries of the index of <code>name</code>. Returns false if
+//! an entry is damaged.
+static
+bool
+read_block_index (std::vector<helpers::BlockIndexEntry> & entries,
+    std::string const & name)
+{
+    entries.clear ();
+    std::string contents;
+    if (! read_file (contents, name + ".idx", false)
+        || contents.size () % helpers::BLOCK_INDEX_ENTRY_SIZE != 0)
+        return false;
+
+    for (std::size_t i = 0; i != contents.size ();
+        i += helpers::BLOCK_INDEX_ENTRY_SIZE)
+    {
+        helpers::BlockIndexEntry entry;
+        if (! helpers::decodeBlockIndexEntry (entry,
+                reinterpret_cast<unsigned char const *>(&contents[i])))
+            return false;
+
+        entries.push_back (entry);
+    }
+
+    return true;
+}
+
+
+static
+bool
+block_crc_matches (std::string const & data,
+    helpers::BlockIndexEntry const & entry)
+{
+    return helpers::computeCrc32 (0, data.data () + entry.offset,
+        entry.length) == entry.crc;
+}
+
+
+//! Checks that blocks <code>first</code> to <code>last - 1</code> of
+//! the index follow each other from <code>offset</code> to the end
+//! of <code>data</code>, match their CRC, times and counts of
+//! <code>infos</code> INFO and <code>errors</code> ERROR events.
+static
+bool
+check_blocks (std::vector<helpers::BlockIndexEntry> const & entries,
+    std::size_t first, std::size_t last, std::string const & data,
+    std::streamoff offset,
+    helpers::Time const & from, helpers::Time const & to,
+    unsigned long infos, unsigned long errors)
+{
+    std::size_t const info_slot = helpers::blockIndexLevelSlot (
+        INFO_LOG_LEVEL);
+    std::size_t const error_slot = helpers::blockIndexLevelSlot (
+        ERROR_LOG_LEVEL);
+    unsigned long counts[helpers::BLOCK_INDEX_LEVELS] = { 0 };
+    bool ok = last > first + 1 && last <= entries.size ();
+    for (std::size_t i = first; ok && i != last; ++i)
+    {
+        helpers::BlockIndexEntry const & entry = entries[i];
+        ok = entry.offset == offset
+            && entry.offset + static_cast<std::streamoff>(entry.length)
+                <= static_cast<std::streamoff>(data.size ())
+            && block_crc_matches (data, entry)
+            && ! (entry.first < from) && ! (entry.last < entry.first)
+            && ! (to < entry.last);
+        for (std::size_t j = 0; j != helpers::BLOCK_INDEX_LEVELS; ++j)
+            counts[j] += entry.levels[j];
+        offset += entry.length;
+    }
+
+    if (! ok)
+        std::cout << "Index blocks do not match the data" << std::endl;
+
+    return ok && offset == static_cast<std::streamoff>(data.size ())
+        && counts[info_slot] == infos && counts[error_slot] == errors
+        && counts[info_slot] + counts[error_slot] == infos + errors;
+}
+
+
+static
+SharedAppenderPtr
+add_indexed_appender (Logger & logger)
+{
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestIdx.log"));
+    props.setProperty(LOG4CPLUS_TEXT("Append"), LOG4CPLUS_TEXT("true"));
+    props.setProperty(LOG4CPLUS_TEXT("IndexBlockSize"), LOG4CPLUS_TEXT("16KB"));
+    SharedAppenderPtr appender(new FileAppender(props));
+    appender->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+    logger.setAdditivity(false);
+    logger.addAppender(appender);
+    return appender;
+}
+
+
+//! Logs records numbered <code>from</code> to <code>to - 1</code>,
+//! every tenth as ERROR, the others as INFO.
+static
+void
+log_indexed_records (Logger const & logger, int from, int to)
+{
+    tstring const padding (RECORD_SIZE - 1 - 12, LOG4CPLUS_TEXT('.'));
+    for (int i = from; i < to; ++i)
+    {
+        tostringstream message;
+        message << std::setw (12) << i << padding;
+        if (i % 10 == 0)
+            LOG4CPLUS_ERROR(logger, message.str ());
+        else
+            LOG4CPLUS_INFO(logger, message.str ());
+    }
+}
+
+
+//! Checks that IndexBlockSize indexes the whole file in blocks that
+//! match their CRC, times and level counts, that a torn index entry
+//! and data left unindexed by a crash are skipped when the file is
+//! reopened, and that a damaged block is detected by its CRC.
+static
+bool
+check_block_index ()
+{
+    std::remove ("TestIdx.log");
+    std::remove ("TestIdx.log.idx");
+
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("index"));
+    helpers::Time const start = helpers::Time::gettimeofday ();
+    SharedAppenderPtr appender = add_indexed_appender (logger);
+    log_indexed_records (logger, 0, 100);
+    logger.removeAllAppenders();
+    appender->close();
+    helpers::Time const middle = helpers::Time::gettimeofday ();
+
+    std::vector<helpers::BlockIndexEntry> entries;
+    std::string data;
+    bool ok = read_block_index (entries, "TestIdx.log")
+        && read_file (data, "TestIdx.log", false)
+        && data.size () == 100 * RECORD_SIZE
+        && check_blocks (entries, 0, entries.size (), data, 0, start,
+            middle, 90, 10);
+    if (! ok)
+    {
+        std::cout << "Block index is wrong" << std::endl;
+        return false;
+    }
+
+    // Simulate a crash that has left unindexed data behind and torn
+    // the last index entry.
+    std::size_t const indexed = entries.size ();
+    std::string const unindexed ("unindexed\n");
+    {
+        std::ofstream file ("TestIdx.log", std::ios::app | std::ios::binary);
+        file << unindexed;
+        std::ofstream index ("TestIdx.log.idx",
+            std::ios::app | std::ios::binary);
+        index << std::string (helpers::BLOCK_INDEX_ENTRY_SIZE / 2, 'x');
+    }
+
+    appender = add_indexed_appender (logger);
+    log_indexed_records (logger, 100, 150);
+    logger.removeAllAppenders();
+    appender->close();
+    helpers::Time const end = helpers::Time::gettimeofday ();
+
+    ok = read_block_index (entries, "TestIdx.log")
+        && read_file (data, "TestIdx.log", false)
+        && entries.size () > indexed
+        && check_blocks (entries, 0, indexed,
+            data.substr (0, 100 * RECORD_SIZE), 0, start, middle, 90, 10)
+        && check_blocks (entries, indexed, entries.size (), data,
+            100 * RECORD_SIZE + unindexed.size (), middle, end, 45, 5);
+    if (! ok)
+    {
+        std::cout << "Block index is wrong after reopening" << std::endl;
+        return false;
+    }
+
+    // Damage the second block.
+    std::streamoff const damaged = entries[1].offset + entries[1].length / 2;
+    {
+        std::fstream file ("TestIdx.log",
+            std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp (damaged);
+        file.put ('!');
+    }
+
+    ok = read_file (data, "TestIdx.log", false)
+        && block_crc_matches (data, entries[0])
+        && ! block_crc_matches (data, entries[1])
+        && block_crc_matches (data, entries[2]);
+    if (! ok)
+        std::cout << "Damaged block is not detected" << std::endl;
+
+    return ok;
+}
 
 
 int
 main()
 {
+    if (! check_file_sizes () || ! check_page_cache_trimming ()
+        || ! check_sequence_naming () || ! check_total_size_limit ()
+        || ! check_timestamp_naming () || ! check_block_index ())
+        return 1;
+
+    remove_files ("Test.log");
+    remove_files ("TestBg.log");
+    remove_files ("TestGz.log", ".gz");
+
     helpers::LogLog::getLogLog()->setInternalDebugging(true);
     SharedAppenderPtr append_1(
         new RollingFileAppender(LOG4CPLUS_TEXT("Test.log"), 5*1024, 5));
@@ -20,6 +784,24 @@ main()
     append_1->setLayout( std::auto_ptr<Layout>(new TTCCLayout()) );
     Logger::getRoot().addAppender(append_1);
 
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestBg.log"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxFileSize"), LOG4CPLUS_TEXT("204800"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupIndex"), LOG4CPLUS_TEXT("5"));
+    props.setProperty(LOG4CPLUS_TEXT("BackgroundRollover"), LOG4CPLUS_TEXT("true"));
+    props.setProperty(LOG4CPLUS_TEXT("IndexBlockSize"), LOG4CPLUS_TEXT("16KB"));
+    SharedAppenderPtr append_2(new RollingFileAppender(props));
+    append_2->setName(LOG4CPLUS_TEXT("Second"));
+    append_2->setLayout( std::auto_ptr<Layout>(new TTCCLayout()) );
+    Logger::getRoot().addAppender(append_2);
+
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("TestGz.log"));
+    props.setProperty(LOG4CPLUS_TEXT("Compression"), LOG4CPLUS_TEXT("gzip"));
+    SharedAppenderPtr append_3(new RollingFileAppender(props));
+    append_3->setName(LOG4CPLUS_TEXT("Third"));
+    append_3->setLayout( std::auto_ptr<Layout>(new TTCCLayout()) );
+    Logger::getRoot().addAppender(append_3);
+
     Logger root = Logger::getRoot();
     Logger test = Logger::getInstance(LOG4CPLUS_TEXT("test"));
     Logger subTest = Logger::getInstance(LOG4CPLUS_TEXT("test.subtest"));
@@ -29,6 +811,18 @@ main()
         LOG4CPLUS_DEBUG(subTest, "Entering loop #" << i);
     }
 
+    // Closing waits for the background renames to finish.
+    Logger::getRoot().removeAllAppenders();
+    append_1->close();
+    append_2->close();
+    append_3->close();
+
+    // 5 KB is below the minimum size, which is used instead.
+    bool ok = check_rolled_files ("Test.log", 200*1024);
+    ok = check_rolled_files ("TestBg.log", 204800) && ok;
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    ok = check_rolled_files ("TestGz.log", 204800, true) && ok;
+#endif
 
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,151 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/fileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/helpers/loglog.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+using namespace log4cplus;
+
+const int LOOP_COUNT = 1000;
+
+
+//! PatternLayout that counts events it has formatted.
+class CountingLayout : public PatternLayout
+{
+public:
+    explicit CountingLayout(const tstring& pattern_)
+        : PatternLayout(pattern_)
+    { }
+
+    virtual void formatAndAppend(tostream& output,
+        const spi::InternalLoggingEvent& event)
+    {
+        ++count;
+        PatternLayout::formatAndAppend(output, event);
+    }
+
+    static int count;
+};
+
+int CountingLayout::count = 0;
+
+
+//! PatternLayout that marks its output. It must not reuse texts of
+//! layouts of other types with the same pattern.
+class MarkingLayout : public PatternLayout
+{
+public:
+    explicit MarkingLayout(const tstring& pattern_)
+        : PatternLayout(pattern_)
+    { }
+
+    virtual void formatAndAppend(tostream& output,
+        const spi::InternalLoggingEvent& event)
+    {
+        output << LOG4CPLUS_TEXT("* ");
+        PatternLayout::formatAndAppend(output, event);
+    }
+};
+
+
+static
+std::string
+read_file (std::string const & name)
+{
+    std::ifstream in (name.c_str ());
+    std::ostringstream oss;
+    oss << in.rdbuf ();
+    return oss.str ();
+}
+
+
+static
+void
+add_appender (Logger & logger, tchar const * file, Layout * layout)
+{
+    SharedAppenderPtr append(new FileAppender(file));
+    append->setName(file);
+    append->setLayout(std::auto_ptr<Layout>(layout));
+    logger.addAppender(append);
+}
+
+
+//! The text is kept in the event only while another attached layout
+//! has the same format key.
+static
+bool
+check_unshared_key ()
+{
+    spi::InternalLoggingEvent event (LOG4CPLUS_TEXT("test.format"),
+        INFO_LOG_LEVEL, LOG4CPLUS_TEXT("text"), __FILE__, __LINE__);
+    PatternLayout layout (LOG4CPLUS_TEXT("%p %m%n"));
+    layout.attach ();
+    if (layout.formatText (event) != LOG4CPLUS_TEXT("INFO text\n")
+        || layout.formatShared (event)->text != LOG4CPLUS_TEXT("INFO text\n")
+        || event.getFormatted (layout.getFormatKey ()))
+        return false;
+
+    PatternLayout other (LOG4CPLUS_TEXT("%p %m%n"));
+    other.attach ();
+    layout.formatShared (event);
+    return event.getFormatted (layout.getFormatKey ())
+        && other.formatText (event) == LOG4CPLUS_TEXT("INFO text\n");
+}
+
+
+int
+main()
+{
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("test.format"));
+    tchar const * const pattern = LOG4CPLUS_TEXT("%d{%H:%M:%S.%q} [%t] %-5p %c - %m%n");
+    add_appender (logger, LOG4CPLUS_TEXT("Format1.log"),
+        new CountingLayout (pattern));
+    add_appender (logger, LOG4CPLUS_TEXT("Format2.log"),
+        new CountingLayout (pattern));
+    add_appender (logger, LOG4CPLUS_TEXT("Format3.log"),
+        new CountingLayout (pattern));
+    add_appender (logger, LOG4CPLUS_TEXT("Format4.log"),
+        new CountingLayout (LOG4CPLUS_TEXT("%m%n")));
+    add_appender (logger, LOG4CPLUS_TEXT("Format5.log"),
+        new MarkingLayout (pattern));
+
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO(logger, "event " << i);
+
+    logger.removeAllAppenders();
+
+    int failures = 0;
+    std::cout << "formatted " << CountingLayout::count << " times for "
+        << LOOP_COUNT << " events and 4 appenders" << std::endl;
+    if (CountingLayout::count != 2 * LOOP_COUNT)
+        ++failures;
+
+    std::string const first (read_file ("Format1.log"));
+    if (first.empty ()
+        || first != read_file ("Format2.log")
+        || first != read_file ("Format3.log"))
+        ++failures;
+
+    if (read_file ("Format4.log").find ("event 999\n") == std::string::npos)
+        ++failures;
+
+    if (read_file ("Format5.log").compare (0, 2, "* ") != 0
+        || first.compare (0, 2, "* ") == 0)
+        ++failures;
+
+    if (! check_unshared_key ())
+    {
+        std::cout << "text of unshared format key has been cached"
+            << std::endl;
+        ++failures;
+    }
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/fileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <log4cplus/thread/threads.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const int THREAD_COUNT = 4;
+const int LOOP_COUNT = 20000;
+
+
+class LogThread
+    : public thread::AbstractThread
+{
+public:
+    LogThread (Logger const & l, int i)
+        : logger (l)
+        , id (i)
+    { }
+
+    virtual void run ()
+    {
+        for (int i = 0; i < LOOP_COUNT; ++i)
+            LOG4CPLUS_INFO (logger, "T" << id << " " << i);
+    }
+
+private:
+    Logger logger;
+    int id;
+};
+
+
+//! PatternLayout that counts events it has formatted. The pipeline
+//! calls it from several threads.
+class CountingLayout
+    : public PatternLayout
+{
+public:
+    explicit CountingLayout (tstring const & pattern_)
+        : PatternLayout (pattern_)
+    { }
+
+    virtual void formatAndAppend (tostream & output,
+        spi::InternalLoggingEvent const & event)
+    {
+        {
+            thread::MutexGuard guard (mtx);
+            ++count;
+        }
+        PatternLayout::formatAndAppend (output, event);
+    }
+
+    static int count;
+    static thread::Mutex mtx;
+};
+
+int CountingLayout::count = 0;
+thread::Mutex CountingLayout::mtx;
+
+
+//! Checks that events of each thread are complete and in order.
+static
+int
+check_file (std::string const & name)
+{
+    std::ifstream in (name.c_str ());
+    std::vector<int> next (THREAD_COUNT, 0);
+    std::string line;
+    while (std::getline (in, line))
+    {
+        std::istringstream iss (line);
+        char t;
+        int id = -1, seq = -1;
+        iss >> t >> id >> seq;
+        if (id < 0 || id >= THREAD_COUNT || seq != next[id])
+        {
+            std::cout << "unexpected line: " << line << std::endl;
+            return 1;
+        }
+
+        ++next[id];
+    }
+
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        if (next[i] != LOOP_COUNT)
+        {
+            std::cout << "thread " << i << " has " << next[i]
+                << " events" << std::endl;
+            return 1;
+        }
+
+    return 0;
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("File"), LOG4CPLUS_TEXT ("Pipeline.log"));
+    props.setProperty (LOG4CPLUS_TEXT ("ImmediateFlush"), LOG4CPLUS_TEXT ("false"));
+    props.setProperty (LOG4CPLUS_TEXT ("FormatThreads"), LOG4CPLUS_TEXT ("4"));
+    props.setProperty (LOG4CPLUS_TEXT ("FormatQueueSize"), LOG4CPLUS_TEXT ("64"));
+
+    SharedAppenderPtr append (new FileAppender (props));
+    append->setName (LOG4CPLUS_TEXT ("Pipeline"));
+    append->setLayout (std::auto_ptr<Layout> (
+        new CountingLayout (LOG4CPLUS_TEXT ("%m%n"))));
+
+    Logger logger = Logger::getInstance (LOG4CPLUS_TEXT ("test.pipeline"));
+    logger.addAppender (append);
+
+    Time const start = Time::gettimeofday ();
+    std::vector<thread::AbstractThreadPtr> threads;
+    for (int i = 0; i < THREAD_COUNT; ++i)
+    {
+        threads.push_back (thread::AbstractThreadPtr (new LogThread (logger, i)));
+        threads.back ()->start ();
+    }
+
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        threads[i]->join ();
+
+    // close() writes out events still held by the pipeline.
+    append->close ();
+    Time const elapsed = Time::gettimeofday () - start;
+    std::cout << THREAD_COUNT * LOOP_COUNT << " events in "
+        << elapsed.sec () * 1000 + elapsed.usec () / 1000 << " ms"
+        << std::endl;
+
+    logger.removeAllAppenders ();
+
+    int failures = check_file ("Pipeline.log");
+
+    // The text formatted by the workers is written, events are not
+    // formatted again when they are committed.
+    std::cout << "formatted " << CountingLayout::count << " times"
+        << std::endl;
+    if (CountingLayout::count != THREAD_COUNT * LOOP_COUNT)
+        failures = 1;
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures;
+}
@@ -0,0 +1,241 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/configurator.h>
+#include <log4cplus/appender.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace log4cplus;
+
+const int APPENDER_COUNT = 20;
+const int LOOP_COUNT = 100;
+const int ORDER_BURST_COUNT = 50;
+const int ORDER_LOOP_COUNT = 200;
+
+
+//! Returns number of lines of file, or -1 if they are out of order.
+static
+int
+count_lines (std::string const & name)
+{
+    std::ifstream in (name.c_str ());
+    std::string line;
+    int lines = 0;
+    while (std::getline (in, line))
+    {
+        std::ostringstream expected;
+        expected << "event " << lines;
+        if (line != expected.str ())
+            return -1;
+
+        ++lines;
+    }
+
+    return lines;
+}
+
+
+//! Waits until file <code>name</code> has <code>count</code> lines
+//! in order.
+static
+bool
+wait_for_lines (std::string const & name, int count)
+{
+    int lines = 0;
+    for (int tries = 0; tries < 50; ++tries)
+    {
+        lines = count_lines (name);
+        if (lines == count)
+            return true;
+        helpers::sleepmillis (100);
+    }
+
+    std::cout << name << ": " << lines << " lines" << std::endl;
+    return false;
+}
+
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+//! Releases its lock for a while in append(), like FileAppender
+//! with <tt>SpillBufferSize</tt> does while it writes.
+class YieldingAppender : public Appender {
+public:
+    explicit YieldingAppender(helpers::Properties const & props)
+        : Appender(props)
+    {
+        deferActivation(props);
+    }
+
+    ~YieldingAppender()
+    {
+        destructorImpl();
+    }
+
+    virtual void close()
+    {
+        closed = true;
+    }
+
+    //! Returns true once <code>expectedCount</code> events have been
+    //! appended in order.
+    bool hasInOrder(std::size_t expectedCount)
+    {
+        thread::MutexGuard guard (access_mutex);
+        if (messages.size () != expectedCount)
+            return false;
+
+        for (std::size_t i = 0; i != messages.size (); ++i)
+        {
+            tostringstream expected;
+            expected << LOG4CPLUS_TEXT("event ") << i;
+            if (messages[i] != expected.str ())
+                return false;
+        }
+
+        return true;
+    }
+
+protected:
+    //! Takes a while, like opening a file on a slow disk.
+    virtual void activateResources()
+    {
+        helpers::sleepmillis(100);
+    }
+
+    virtual void append(spi::InternalLoggingEvent const & event)
+    {
+        messages.push_back(event.getMessage());
+        access_mutex.unlock();
+        helpers::sleepmillis(1);
+        access_mutex.lock();
+    }
+
+private:
+    std::vector<tstring> messages;
+};
+
+
+//! Events logged while the buffered ones are being appended must
+//! not overtake them.
+static
+bool
+check_order ()
+{
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("LazyOpen"), LOG4CPLUS_TEXT("true"));
+    SharedAppenderPtr appender(new YieldingAppender(props));
+
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("order"));
+    logger.setAdditivity(false);
+    logger.addAppender(appender);
+
+    // The burst is buffered until the appender is activated and it is
+    // still being appended while the rest is logged.
+    int i = 0;
+    for (; i < ORDER_BURST_COUNT; ++i)
+        LOG4CPLUS_INFO(logger, "event " << i);
+    for (; i < ORDER_LOOP_COUNT; ++i)
+    {
+        LOG4CPLUS_INFO(logger, "event " << i);
+        helpers::sleepmillis (1);
+    }
+
+    YieldingAppender & yielding
+        = static_cast<YieldingAppender &>(*appender);
+    bool ok = false;
+    for (int tries = 0; tries < 50 && ! ok; ++tries)
+    {
+        ok = yielding.hasInOrder (ORDER_LOOP_COUNT);
+        if (! ok)
+            helpers::sleepmillis (100);
+    }
+
+    logger.removeAllAppenders();
+    if (! ok)
+        std::cout << "Events appended during activation are out of order"
+            << std::endl;
+
+    return ok;
+}
+#endif
+
+
+int
+main()
+{
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+
+    helpers::Properties props;
+    tostringstream root;
+    root << LOG4CPLUS_TEXT("INFO, S");
+    for (int i = 0; i < APPENDER_COUNT; ++i)
+    {
+        tostringstream prefix;
+        prefix << LOG4CPLUS_TEXT("log4cplus.appender.A") << i;
+        tostringstream file;
+        file << LOG4CPLUS_TEXT("Lazy-") << i << LOG4CPLUS_TEXT(".log");
+        props.setProperty(prefix.str (),
+            LOG4CPLUS_TEXT("log4cplus::FileAppender"));
+        props.setProperty(prefix.str () + LOG4CPLUS_TEXT(".File"), file.str ());
+        props.setProperty(prefix.str () + LOG4CPLUS_TEXT(".LazyOpen"),
+            LOG4CPLUS_TEXT("true"));
+        props.setProperty(prefix.str () + LOG4CPLUS_TEXT(".layout"),
+            LOG4CPLUS_TEXT("log4cplus::PatternLayout"));
+        props.setProperty(prefix.str ()
+            + LOG4CPLUS_TEXT(".layout.ConversionPattern"),
+            LOG4CPLUS_TEXT("%m%n"));
+        root << LOG4CPLUS_TEXT(", A") << i;
+    }
+
+    // Connecting to an unroutable address blocks until timeout.
+    props.setProperty(LOG4CPLUS_TEXT("log4cplus.appender.S"),
+        LOG4CPLUS_TEXT("log4cplus::SocketAppender"));
+    props.setProperty(LOG4CPLUS_TEXT("log4cplus.appender.S.host"),
+        LOG4CPLUS_TEXT("10.255.255.1"));
+    props.setProperty(LOG4CPLUS_TEXT("log4cplus.appender.S.port"),
+        LOG4CPLUS_TEXT("9998"));
+    props.setProperty(LOG4CPLUS_TEXT("log4cplus.appender.S.LazyOpen"),
+        LOG4CPLUS_TEXT("true"));
+    props.setProperty(LOG4CPLUS_TEXT("log4cplus.rootLogger"), root.str ());
+
+    helpers::Time const start = helpers::Time::gettimeofday ();
+    PropertyConfigurator configurator(props);
+    configurator.configure();
+
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("test.lazy"));
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO(logger, "event " << i);
+
+    helpers::Time const elapsed = helpers::Time::gettimeofday () - start;
+    std::cout << "configured and logged in "
+        << elapsed.sec () * 1000 + elapsed.usec () / 1000 << " ms"
+        << std::endl;
+
+    // Wait for the files to be opened and the buffered events written.
+    int failures = 0;
+    for (int i = 0; i < APPENDER_COUNT; ++i)
+    {
+        std::ostringstream name;
+        name << "Lazy-" << i << ".log";
+        if (! wait_for_lines (name.str (), LOOP_COUNT))
+            ++failures;
+    }
+
+    if (elapsed.sec () >= 2)
+        ++failures;
+
+#if ! defined (LOG4CPLUS_SINGLE_THREADED)
+    if (! check_order ())
+        ++failures;
+#endif
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
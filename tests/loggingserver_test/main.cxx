@@ -0,0 +1,291 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/thread/threads.h>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const unsigned short PORT = 19370;
+char const CONFIG_FILE[] = "loggingserver_test.properties";
+char const FIFO_FILE[] = "loggingserver_test.fifo";
+char const LOG_FILE[] = "loggingserver_test.log";
+const int FAST_COUNT = 100;
+
+
+//! Events of the "slow" logger are written by the server to a pipe
+//! that is not read until the end, so its dispatcher falls behind.
+//! Events of the "fast" logger go to a plain file.
+static
+void
+write_config ()
+{
+    std::ofstream config (CONFIG_FILE);
+    config
+        << "log4cplus.logger.slow=INFO, SLOW\n"
+        << "log4cplus.additivity.slow=false\n"
+        << "log4cplus.logger.fast=INFO, FAST\n"
+        << "log4cplus.additivity.fast=false\n"
+        << "log4cplus.appender.SLOW=log4cplus::FileAppender\n"
+        << "log4cplus.appender.SLOW.File=" << FIFO_FILE << "\n"
+        << "log4cplus.appender.SLOW.layout=log4cplus::PatternLayout\n"
+        << "log4cplus.appender.SLOW.layout.ConversionPattern=%m%n\n"
+        << "log4cplus.appender.FAST=log4cplus::FileAppender\n"
+        << "log4cplus.appender.FAST.File=" << LOG_FILE << "\n"
+        << "log4cplus.appender.FAST.layout=log4cplus::PatternLayout\n"
+        << "log4cplus.appender.FAST.layout.ConversionPattern=%m%n\n";
+}
+
+
+//! Starts the server with one I/O thread, so that both clients are
+//! served by the same epoll loop, and two dispatchers.
+static
+pid_t
+start_server ()
+{
+    std::string const port = convertIntegerToString (PORT);
+    pid_t pid = fork ();
+    if (pid == 0)
+    {
+        execl (LOGGINGSERVER_PATH, LOGGINGSERVER_PATH, port.c_str (),
+            CONFIG_FILE, "1", "2", static_cast<char *>(0));
+        _exit (127);
+    }
+    return pid;
+}
+
+
+static
+bool
+wait_for_server ()
+{
+    for (int i = 0; i < 500; ++i)
+    {
+        Socket probe (LOG4CPLUS_TEXT ("localhost"), PORT);
+        if (probe.isOpen ())
+            return true;
+        sleepmillis (10);
+    }
+    return false;
+}
+
+
+static
+void
+log_event (SharedAppenderPtr const & appender, tchar const * logger, int i)
+{
+    appender->doAppend (spi::InternalLoggingEvent (logger, INFO_LOG_LEVEL,
+        LOG4CPLUS_TEXT ("event ") + convertIntegerToString (i),
+        __FILE__, __LINE__));
+}
+
+
+//! Logs to the "slow" logger until stopped. Once the server stops
+//! reading the connection, doAppend() blocks in the socket write.
+class FloodThread
+    : public thread::AbstractThread
+{
+public:
+    FloodThread ()
+        : appender (new SocketAppender (LOG4CPLUS_TEXT ("localhost"), PORT))
+        , sent (0)
+        , stop (false)
+    { }
+
+    virtual void run ()
+    {
+        for (int i = 0; ! isStopped (); ++i)
+        {
+            log_event (appender, LOG4CPLUS_TEXT ("slow"), i);
+            thread::MutexGuard guard (mtx);
+            ++sent;
+        }
+    }
+
+    int getSent () const
+    {
+        thread::MutexGuard guard (mtx);
+        return sent;
+    }
+
+    bool isStopped () const
+    {
+        thread::MutexGuard guard (mtx);
+        return stop;
+    }
+
+    void setStopped ()
+    {
+        thread::MutexGuard guard (mtx);
+        stop = true;
+    }
+
+    SharedAppenderPtr appender;
+    thread::Mutex mtx;
+    int sent;
+    bool stop;
+};
+
+
+static
+int
+count_lines (char const * name)
+{
+    std::ifstream file (name);
+    std::string line;
+    int lines = 0;
+    while (std::getline (file, line))
+        ++lines;
+    return lines;
+}
+
+
+//! Reads what the server wrote to the pipe and checks the order of
+//! the events.
+class PipeReader
+{
+public:
+    explicit PipeReader (int fd_)
+        : fd (fd_)
+        , lines (0)
+        , failures (0)
+    { }
+
+    bool read ()
+    {
+        char buffer[4096];
+        ssize_t ret = ::read (fd, buffer, sizeof (buffer));
+        if (ret <= 0)
+            return false;
+
+        for (ssize_t i = 0; i != ret; ++i)
+        {
+            if (buffer[i] != '\n')
+            {
+                line += buffer[i];
+                continue;
+            }
+
+            if (line != "event " + convertIntegerToString (lines))
+                ++failures;
+            ++lines;
+            line.clear ();
+        }
+        return true;
+    }
+
+    int fd;
+    std::string line;
+    int lines;
+    int failures;
+};
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+    int failures = 0;
+
+    write_config ();
+    std::remove (FIFO_FILE);
+    std::remove (LOG_FILE);
+
+    // The read end is opened first, so that the server does not block
+    // opening the pipe.
+    if (mkfifo (FIFO_FILE, 0600) != 0)
+    {
+        std::cout << "mkfifo() failed" << std::endl;
+        return 1;
+    }
+    int const fifo = open (FIFO_FILE, O_RDONLY | O_NONBLOCK);
+
+    pid_t const server = start_server ();
+    if (server == -1 || ! wait_for_server ())
+    {
+        std::cout << "server did not start" << std::endl;
+        if (server > 0)
+        {
+            kill (server, SIGKILL);
+            waitpid (server, 0, 0);
+        }
+        return 1;
+    }
+
+    // Flood the server until the client blocks, which happens once the
+    // server stops reading its connection.
+    SharedObjectPtr<FloodThread> flood (new FloodThread);
+    flood->start ();
+    int sent = -1;
+    for (int i = 0; i < 100 && sent != flood->getSent (); ++i)
+    {
+        sent = flood->getSent ();
+        sleepmillis (200);
+    }
+    std::cout << "flood blocked after " << sent << " events" << std::endl;
+
+    // The other connection of the same I/O thread is still served.
+    {
+        SharedAppenderPtr fast (new SocketAppender (
+            LOG4CPLUS_TEXT ("localhost"), PORT));
+        for (int i = 0; i < FAST_COUNT; ++i)
+            log_event (fast, LOG4CPLUS_TEXT ("fast"), i);
+
+        int lines = 0;
+        for (int i = 0; i < 500 && lines != FAST_COUNT; ++i)
+        {
+            sleepmillis (10);
+            lines = count_lines (LOG_FILE);
+        }
+        fast->close ();
+        std::cout << "fast connection: " << lines << " events" << std::endl;
+        if (lines != FAST_COUNT)
+            ++failures;
+    }
+
+    // Once the pipe is read, the flooding connection is read again and
+    // all of its events arrive in order.
+    flood->setStopped ();
+    PipeReader reader (fifo);
+    for (int waits = 0; waits < 3000; )
+    {
+        if (reader.read ())
+            continue;
+        else if (! flood->isRunning ()
+            && reader.lines == flood->getSent ())
+            break;
+        sleepmillis (10);
+        ++waits;
+    }
+    std::cout << "slow connection: " << reader.lines << " of "
+        << flood->getSent () << " events" << std::endl;
+    if (flood->isRunning () || reader.lines != flood->getSent ()
+        || reader.failures != 0)
+        ++failures;
+
+    // A client still blocked gets an error once the server is gone.
+    kill (server, SIGKILL);
+    waitpid (server, 0, 0);
+    flood->join ();
+    flood->appender->close ();
+    close (fifo);
+    std::remove (FIFO_FILE);
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+#include <log4cplus/socketappender.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <iostream>
+#include <vector>
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const int LOOP_COUNT = 1000;
+const std::size_t FRAME_PART_SIZE = 1024 * 1024;
+
+
+static
+spi::InternalLoggingEvent
+make_event (int i, tstring const & message)
+{
+    return spi::InternalLoggingEvent (
+        LOG4CPLUS_TEXT ("test.protocol.") + convertIntegerToString (i % 4),
+        i % 2 ? INFO_LOG_LEVEL : WARN_LOG_LEVEL,
+        LOG4CPLUS_TEXT ("ndc"), message,
+        LOG4CPLUS_TEXT ("thread ") + convertIntegerToString (i % 3),
+        Time (1300000000 + i, 1000 * i), LOG4CPLUS_TEXT ("main.cxx"), i);
+}
+
+
+//! Feeds size-prefixed frames to the decoder.
+static
+bool
+decode_frames (MessageDecoder & decoder, std::vector<char> const & frames,
+    std::vector<spi::InternalLoggingEvent> & events,
+    std::size_t & frameCount)
+{
+    std::size_t pos = 0;
+    while (pos < frames.size ())
+    {
+        SocketBuffer size (sizeof (unsigned int));
+        size.appendBytes (&frames[pos], sizeof (unsigned int));
+        size.clear ();
+        size.setSize (sizeof (unsigned int));
+        std::size_t const len = size.readInt ();
+        pos += sizeof (unsigned int);
+
+        if (len + sizeof (unsigned int) > LOG4CPLUS_MAX_MESSAGE_SIZE
+            || ! decoder.decode (&frames[pos], len, events))
+            return false;
+
+        pos += len;
+        ++frameCount;
+    }
+    return true;
+}
+
+
+static
+bool
+same_event (spi::InternalLoggingEvent const & a,
+    spi::InternalLoggingEvent const & b, tstring const & serverName)
+{
+    return a.getLoggerName () == b.getLoggerName ()
+        && a.getLogLevel () == b.getLogLevel ()
+        && serverName + LOG4CPLUS_TEXT (" - ") + a.getNDC () == b.getNDC ()
+        && a.getMessage () == b.getMessage ()
+        && a.getThread () == b.getThread ()
+        && a.getTimestamp () == b.getTimestamp ()
+        && a.getFile () == b.getFile ()
+        && a.getLine () == b.getLine ();
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+    int failures = 0;
+    tstring const serverName (LOG4CPLUS_TEXT ("host"));
+
+    // Round trip, compared with version 2 size.
+    MessageEncoder encoder (true, LOG4CPLUS_MAX_MESSAGE_SIZE);
+    MessageDecoder decoder;
+    std::vector<char> frames;
+    std::vector<spi::InternalLoggingEvent> sent;
+    std::size_t v2Size = 0;
+    for (int i = 0; i < LOOP_COUNT; ++i)
+    {
+        sent.push_back (make_event (i, LOG4CPLUS_TEXT ("event ")
+            + convertIntegerToString (i)));
+        encoder.encode (frames, sent.back (), serverName);
+
+        SocketBuffer buffer (LOG4CPLUS_MAX_MESSAGE_SIZE);
+        convertToBuffer (buffer, sent.back (), serverName);
+        v2Size += sizeof (unsigned int) + buffer.getSize ();
+    }
+
+    // A message larger than one frame is split.
+    sent.push_back (make_event (LOOP_COUNT,
+        tstring (10 * LOG4CPLUS_MAX_MESSAGE_SIZE, LOG4CPLUS_TEXT ('x'))));
+    encoder.encode (frames, sent.back (), serverName);
+
+    std::vector<spi::InternalLoggingEvent> received;
+    std::size_t frameCount = 0;
+    if (! decode_frames (decoder, frames, received, frameCount)
+        || received.size () != sent.size ())
+    {
+        std::cout << "decoded " << received.size () << " events" << std::endl;
+        ++failures;
+    }
+    for (std::size_t i = 0; i != received.size () && i != sent.size (); ++i)
+        if (! same_event (sent[i], received[i], serverName))
+        {
+            std::cout << "event " << i << " differs" << std::endl;
+            ++failures;
+            break;
+        }
+    if (frameCount <= sent.size ())
+    {
+        std::cout << "large message was not split" << std::endl;
+        ++failures;
+    }
+
+    std::size_t const v3Size = frames.size ()
+        - (frameCount - LOOP_COUNT) * (sizeof (unsigned int) + 2)
+        - 10 * LOG4CPLUS_MAX_MESSAGE_SIZE;
+    std::cout << "version 2: " << v2Size << " bytes, version 3: about "
+        << v3Size << " bytes" << std::endl;
+    if (v3Size * 2 > v2Size)
+        ++failures;
+
+    // After reset, a new decoder can pick up the stream.
+    encoder.reset ();
+    frames.clear ();
+    encoder.encode (frames, sent[1], serverName);
+    encoder.encode (frames, sent[2], serverName);
+    MessageDecoder fresh;
+    received.clear ();
+    if (! decode_frames (fresh, frames, received, frameCount)
+        || received.size () != 2 || ! same_event (sent[2], received[1], serverName))
+    {
+        std::cout << "reset failed" << std::endl;
+        ++failures;
+    }
+
+    // Version 2 messages are still understood.
+    SocketBuffer v2 (LOG4CPLUS_MAX_MESSAGE_SIZE);
+    convertToBuffer (v2, sent[3], serverName);
+    v2.clear ();
+    v2.setSize (v2.getMaxSize ());
+    received.clear ();
+    if (! fresh.decode (v2, received) || received.size () != 1
+        || ! same_event (sent[3], received[0], serverName))
+    {
+        std::cout << "version 2 decoding failed" << std::endl;
+        ++failures;
+    }
+
+    // Continuation frames cannot grow an event without limit. The
+    // decoder refuses it and goes on with the next event.
+    std::vector<char> part (FRAME_PART_SIZE);
+    part[0] = static_cast<char>(MESSAGE_VERSION_3);
+    part[1] = static_cast<char>(MESSAGE_FLAG_MORE);
+    received.clear ();
+    std::size_t parts = 0;
+    while (fresh.decode (&part[0], part.size (), received)
+        && parts * FRAME_PART_SIZE <= MAX_DECODED_EVENT_SIZE)
+    {
+        part[1] = static_cast<char>(MESSAGE_FLAG_MORE | MESSAGE_FLAG_CONT);
+        ++parts;
+    }
+    frames.clear ();
+    encoder.encode (frames, sent[4], serverName);
+    if (parts * FRAME_PART_SIZE > MAX_DECODED_EVENT_SIZE
+        || ! received.empty ()
+        || ! decode_frames (fresh, frames, received, frameCount)
+        || received.size () != 1
+        || ! same_event (sent[4], received[0], serverName))
+    {
+        std::cout << "oversized event was not refused" << std::endl;
+        ++failures;
+    }
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/fileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/reopenwatch.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/sleep.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+
+#if ! defined (_WIN32)
+#include <csignal>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+
+using namespace log4cplus;
+
+const int LOOP_COUNT = 1000;
+
+
+static
+int
+count_lines (char const * name)
+{
+    std::ifstream file (name);
+    std::string line;
+    int lines = 0;
+    while (std::getline (file, line))
+        ++lines;
+
+    return lines;
+}
+
+
+//! Waits for the appender to recreate its file.
+static
+bool
+wait_for_file (char const * name)
+{
+    for (int i = 0; i != 300; ++i)
+    {
+        if (std::ifstream (name))
+            return true;
+
+        helpers::sleepmillis (10);
+    }
+
+    return false;
+}
+
+
+static
+void
+log_records (Logger & logger, int first)
+{
+    for (int i = first; i != first + LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO(logger, "record " << i);
+}
+
+
+int
+main()
+{
+#if ! defined (_WIN32)
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+    std::remove ("Reopen.log");
+    std::remove ("Reopen.log.1");
+    std::remove ("Reopen.log.2");
+
+    SharedAppenderPtr append(new FileAppender(LOG4CPLUS_TEXT("Reopen.log")));
+    append->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+    Logger root = Logger::getRoot();
+    root.addAppender(append);
+
+    int ret = 0;
+    {
+        // Rotation noticed by watching the file.
+        ReopenWatchThread watch (ReopenWatchThread::REOPEN_ON_FILE_CHANGE);
+        log_records (root, 0);
+        std::rename ("Reopen.log", "Reopen.log.1");
+        if (! wait_for_file ("Reopen.log"))
+        {
+            std::cerr << "File has not been reopened after rename"
+                << std::endl;
+            ret = 1;
+        }
+    }
+
+    {
+        // Rotation announced by SIGHUP.
+        ReopenWatchThread watch (ReopenWatchThread::REOPEN_ON_SIGHUP);
+        log_records (root, LOOP_COUNT);
+        std::rename ("Reopen.log", "Reopen.log.2");
+        kill (getpid (), SIGHUP);
+        if (! wait_for_file ("Reopen.log"))
+        {
+            std::cerr << "File has not been reopened after SIGHUP"
+                << std::endl;
+            ret = 1;
+        }
+    }
+
+    log_records (root, 2 * LOOP_COUNT);
+    root.removeAllAppenders ();
+
+    int const lines[] = { count_lines ("Reopen.log.1"),
+        count_lines ("Reopen.log.2"), count_lines ("Reopen.log") };
+    std::cout << "Lines: " << lines[0] << " " << lines[1] << " " << lines[2]
+        << std::endl;
+    if (lines[0] + lines[1] + lines[2] != 3 * LOOP_COUNT
+        || lines[2] != LOOP_COUNT)
+        ret = 1;
+
+    return ret;
+#else
+    return 0;
+#endif
+}
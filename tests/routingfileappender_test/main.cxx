@@ -0,0 +1,133 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/routingfileappender.h>
+#include <log4cplus/ndc.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+using namespace log4cplus;
+
+const int TENANT_COUNT = 5;
+const int LOOP_COUNT = 20000;
+
+
+const int MAX_BACKUP_INDEX = 5;
+
+
+//! Returns name of routed file or of its backup.
+static
+std::string
+backup_name (std::string const & name, int i)
+{
+    std::ostringstream oss;
+    oss << name;
+    if (i != 0)
+        oss << '.' << i;
+
+    return oss.str ();
+}
+
+
+//! Returns name of file of the tenant's route.
+static
+std::string
+tenant_file (int tenant)
+{
+    std::ostringstream name;
+    name << "Route-tenant" << tenant << "-test.route.log";
+    return name.str ();
+}
+
+
+//! Counts lines in routed file and its backups.
+static
+int
+count_lines (std::string const & name)
+{
+    int lines = 0;
+    for (int i = 0; i <= MAX_BACKUP_INDEX; ++i)
+    {
+        std::ifstream in (backup_name (name, i).c_str ());
+        std::string line;
+        while (std::getline (in, line))
+            ++lines;
+    }
+
+    return lines;
+}
+
+
+//! Removes routed file and its backups left by previous runs.
+static
+void
+remove_files (std::string const & name)
+{
+    for (int i = 0; i <= MAX_BACKUP_INDEX; ++i)
+        std::remove (backup_name (name, i).c_str ());
+}
+
+
+int
+main()
+{
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+
+    for (int t = 0; t < TENANT_COUNT; ++t)
+        remove_files (tenant_file (t));
+    remove_files ("Route-_._escape-test.route.log");
+
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("Route-%x{1}-%c{2}.log"));
+    props.setProperty(LOG4CPLUS_TEXT("RouteAppender"),
+        LOG4CPLUS_TEXT("log4cplus::RollingFileAppender"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxOpenFiles"), LOG4CPLUS_TEXT("2"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxFileSize"), LOG4CPLUS_TEXT("204800"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupIndex"), LOG4CPLUS_TEXT("5"));
+    props.setProperty(LOG4CPLUS_TEXT("layout"), LOG4CPLUS_TEXT("log4cplus::PatternLayout"));
+    props.setProperty(LOG4CPLUS_TEXT("layout.ConversionPattern"), LOG4CPLUS_TEXT("%m%n"));
+    SharedAppenderPtr append(new RoutingFileAppender(props));
+    append->setName(LOG4CPLUS_TEXT("Routing"));
+    Logger::getRoot().addAppender(append);
+
+    Logger logger = Logger::getInstance(LOG4CPLUS_TEXT("test.route.sub"));
+    std::string const padding (100, 'x');
+    for (int i = 0; i < LOOP_COUNT; ++i)
+    {
+        tostringstream tenant;
+        tenant << LOG4CPLUS_TEXT("tenant") << i % TENANT_COUNT;
+        NDCContextCreator ctx (tenant.str ());
+        NDCContextCreator inner (LOG4CPLUS_TEXT("request"));
+        LOG4CPLUS_INFO(logger, "record " << i << ' ' << padding.c_str ());
+    }
+
+    {
+        NDCContextCreator ctx (LOG4CPLUS_TEXT("../escape"));
+        LOG4CPLUS_INFO(logger, "sanitized");
+    }
+
+    std::cout << "open routes: "
+        << static_cast<RoutingFileAppender&>(*append).getOpenRoutes ()
+        << std::endl;
+    append->close ();
+
+    int failures = 0;
+    for (int t = 0; t < TENANT_COUNT; ++t)
+    {
+        std::string const name = tenant_file (t);
+        int const lines = count_lines (name);
+        std::cout << name << ": " << lines << " lines" << std::endl;
+        if (lines != LOOP_COUNT / TENANT_COUNT)
+            ++failures;
+    }
+
+    if (count_lines ("Route-_._escape-test.route.log") != 1)
+        ++failures;
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/shardedfileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/thread/threads.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+using namespace log4cplus;
+
+const int THREAD_COUNT = 4;
+const int LOOP_COUNT = 10000;
+
+
+//! Number of threads that have finished logging.
+thread::Mutex logged_mtx;
+int logged = 0;
+
+
+class LoggingThread : public thread::AbstractThread {
+public:
+    explicit LoggingThread(int n, int count_ = LOOP_COUNT)
+        : number(n)
+        , records(count_)
+        , logger(Logger::getInstance(LOG4CPLUS_TEXT("test.shard")))
+    { }
+
+    virtual void run()
+    {
+        for (int i = 0; i < records; ++i)
+            LOG4CPLUS_INFO(logger, "thread " << number << " record " << i);
+
+        thread::MutexGuard guard (logged_mtx);
+        ++logged;
+    }
+
+private:
+    int number;
+    int records;
+    Logger logger;
+};
+
+
+//! Counts records in shard, checking the record framing.
+static
+int
+count_records (std::string const & name)
+{
+    std::ifstream in (name.c_str (), std::ios::in | std::ios::binary);
+    int records = 0;
+    std::string stamp;
+    unsigned long sequence;
+    std::size_t length;
+    while (in >> stamp >> sequence >> length && in.get () == ' ')
+    {
+        std::string text (length, ' ');
+        if (! in.read (&text[0], length)
+            || sequence != static_cast<unsigned long>(records) + 1)
+            return -1;
+
+        ++records;
+    }
+
+    return records;
+}
+
+
+int
+main()
+{
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+
+    // Shard of an earlier run with more threads.
+    std::ofstream ("Sharded.log.shard9") << "old\n";
+
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_TEXT("Sharded.log"));
+    props.setProperty(LOG4CPLUS_TEXT("ImmediateFlush"), LOG4CPLUS_TEXT("false"));
+    SharedAppenderPtr append(new ShardedFileAppender(props));
+    append->setName(LOG4CPLUS_TEXT("Sharded"));
+    append->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%D{%H:%M:%S.%q} [%t] %m%n"))));
+    Logger::getRoot().addAppender(append);
+
+    if (std::ifstream ("Sharded.log.shard9"))
+    {
+        std::cout << "Old shard has not been removed" << std::endl;
+        return 1;
+    }
+
+    // The second round of threads gets the shards of the first round,
+    // whose threads have exited.
+    for (int round = 0; round < 2; ++round)
+    {
+        std::vector<thread::AbstractThreadPtr> threads;
+        for (int i = 0; i < THREAD_COUNT; ++i)
+        {
+            thread::AbstractThreadPtr t (new LoggingThread (i));
+            t->start ();
+            threads.push_back (t);
+        }
+
+        for (int i = 0; i < THREAD_COUNT; ++i)
+            threads[i]->join ();
+
+#if defined (LOG4CPLUS_USE_PTHREADS)
+        std::vector<tstring> open;
+        append->getFileNames (open);
+        std::cout << "Shards after round " << round << ": "
+            << open.size () << std::endl;
+        if (open.size () != THREAD_COUNT)
+            return 1;
+#endif
+    }
+
+    append->close ();
+    Logger::getRoot().removeAllAppenders();
+
+#if defined (LOG4CPLUS_USE_PTHREADS)
+    int const shards = THREAD_COUNT;
+#else
+    int const shards = 2 * THREAD_COUNT;
+#endif
+    int total = 0;
+    for (int i = 0; i < shards; ++i)
+    {
+        std::ostringstream name;
+        name << "Sharded.log.shard" << i;
+        int records = count_records (name.str ());
+        std::cout << name.str () << ": " << records << " records" << std::endl;
+        if (records < 0)
+            return 1;
+
+        total += records;
+    }
+
+    if (total != 2 * THREAD_COUNT * LOOP_COUNT)
+        return 1;
+
+    // Appenders destroyed while their threads exit.
+    for (int round = 0; round < 20; ++round)
+    {
+        {
+            thread::MutexGuard guard (logged_mtx);
+            logged = 0;
+        }
+
+        SharedAppenderPtr appender(new ShardedFileAppender(props));
+        appender->setLayout(std::auto_ptr<Layout>(
+            new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+        Logger::getRoot().addAppender(appender);
+
+        std::vector<thread::AbstractThreadPtr> threads;
+        for (int i = 0; i < THREAD_COUNT; ++i)
+        {
+            thread::AbstractThreadPtr t (new LoggingThread (i, 10));
+            t->start ();
+            threads.push_back (t);
+        }
+
+        for (bool done = false; ! done; )
+        {
+            thread::MutexGuard guard (logged_mtx);
+            done = logged == THREAD_COUNT;
+        }
+
+        Logger::getRoot().removeAllAppenders();
+        appender = SharedAppenderPtr ();
+        for (int i = 0; i < THREAD_COUNT; ++i)
+            threads[i]->join ();
+    }
+
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/fileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/lockfile.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/thread/threads.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if ! defined (_WIN32)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+using namespace log4cplus;
+
+const int PROCESS_COUNT = 4;
+const int LOOP_COUNT = 5000;
+const int MAX_BACKUP_INDEX = 20;
+const int ABANDONED_COUNT = 100;
+
+
+//! Suffix of backups rolled over in the background; they are
+//! compressed when zlib is available.
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+char const BACKGROUND_SUFFIX[] = ".gz";
+#else
+char const BACKGROUND_SUFFIX[] = "";
+#endif
+
+
+static
+std::string
+log_name (char const * base, int i, char const * suffix)
+{
+    std::ostringstream name;
+    name << base;
+    if (i != 0)
+        name << "." << i << suffix;
+
+    return name.str ();
+}
+
+
+static
+void
+remove_files (char const * base, char const * suffix)
+{
+    for (int i = 0; i <= MAX_BACKUP_INDEX; ++i)
+        std::remove (log_name (base, i, suffix).c_str ());
+}
+
+
+//! Logs the records through a shared file appender. With
+//! <code>background</code> the rollover is finished, and the backups
+//! compressed, by the background worker of each process.
+static
+void
+log_records (int process, char const * base, bool background)
+{
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), LOG4CPLUS_C_STR_TO_TSTRING(base));
+    props.setProperty(LOG4CPLUS_TEXT("SharedFile"), LOG4CPLUS_TEXT("true"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxFileSize"), LOG4CPLUS_TEXT("200KB"));
+    props.setProperty(LOG4CPLUS_TEXT("MaxBackupIndex"), LOG4CPLUS_TEXT("20"));
+    if (background)
+    {
+        props.setProperty(LOG4CPLUS_TEXT("BackgroundRollover"),
+            LOG4CPLUS_TEXT("true"));
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+        props.setProperty(LOG4CPLUS_TEXT("Compression"),
+            LOG4CPLUS_TEXT("gzip"));
+#endif
+    }
+    SharedAppenderPtr append(new RollingFileAppender(props));
+    append->setName(LOG4CPLUS_TEXT("Shared"));
+    append->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+    Logger::getRoot().addAppender(append);
+
+    Logger test = Logger::getInstance(LOG4CPLUS_TEXT("test"));
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_WARN(test, "process " << process << " record " << i
+            << " padding padding padding padding padding padding padding");
+
+    Logger::getRoot().removeAllAppenders();
+}
+
+
+//! Reads the whole file, decompressing backups with non-empty
+//! <code>suffix</code>.
+static
+std::string
+read_file (std::string const & name, char const * suffix)
+{
+    std::string contents;
+#if defined (LOG4CPLUS_HAVE_ZLIB)
+    if (*suffix)
+    {
+        gzFile file = gzopen (name.c_str (), "rb");
+        if (! file)
+            return contents;
+
+        char buf[16384];
+        int ret;
+        while ((ret = gzread (file, buf, sizeof (buf))) > 0)
+            contents.append (buf, ret);
+
+        gzclose (file);
+        return contents;
+    }
+#endif
+
+    std::ifstream file (name.c_str (), std::ios::binary);
+    std::ostringstream oss;
+    oss << file.rdbuf ();
+    return oss.str ();
+}
+
+
+//! Checks that every line in the log files is a complete record.
+static
+int
+count_records (char const * base, char const * suffix, int & broken)
+{
+    int records = 0;
+    broken = 0;
+    for (int i = 0; i <= MAX_BACKUP_INDEX; ++i)
+    {
+        std::istringstream file (read_file (log_name (base, i, suffix),
+            i != 0 ? suffix : ""));
+        std::string line;
+        while (std::getline (file, line))
+        {
+            int process, record;
+            if (std::sscanf (line.c_str (), "process %d record %d", &process,
+                    &record) == 2
+                && line.size () > 60
+                && line.compare (line.size () - 7, 7, "padding") == 0)
+                ++records;
+            else
+                ++broken;
+        }
+    }
+
+    return records;
+}
+
+
+#if ! defined (_WIN32)
+//! Runs PROCESS_COUNT processes logging into the same file and
+//! checks that all their records ended up in the file or its
+//! backups.
+static
+bool
+run_processes (char const * base, char const * suffix, bool background)
+{
+    remove_files (base, suffix);
+
+    for (int i = 0; i < PROCESS_COUNT; ++i)
+    {
+        pid_t pid = fork ();
+        if (pid == 0)
+        {
+            log_records (i, base, background);
+            _exit (0);
+        }
+        else if (pid == -1)
+        {
+            std::perror ("fork");
+            return false;
+        }
+    }
+
+    for (int i = 0; i < PROCESS_COUNT; ++i)
+        wait (0);
+
+    int broken = 0;
+    int records = count_records (base, suffix, broken);
+    std::cout << base << ": records: " << records << ", broken lines: "
+        << broken << std::endl;
+
+    return records == PROCESS_COUNT * LOOP_COUNT && broken == 0;
+}
+
+
+static
+std::string
+pending_name (char const * base, pid_t pid)
+{
+    std::ostringstream name;
+    name << base << ".rollover." << pid << ".1";
+    return name.str ();
+}
+
+
+static
+void
+write_abandoned_file (std::string const & name)
+{
+    std::ofstream file (name.c_str ());
+    for (int i = 0; i < ABANDONED_COUNT; ++i)
+        file << "process " << PROCESS_COUNT << " record " << i
+            << " padding padding padding padding padding padding padding\n";
+}
+
+
+//! Checks that a file left pending by a process that has exited is
+//! taken over at rollover, while one of a process that still uses
+//! the lock file is left alone.
+static
+bool
+check_abandoned_rollover ()
+{
+    char const base[] = "SharedLeft.log";
+    remove_files (base, BACKGROUND_SUFFIX);
+
+    pid_t const gone = fork ();
+    if (gone == 0)
+        _exit (0);
+    waitpid (gone, 0, 0);
+
+    int ready[2];
+    int done[2];
+    if (gone == -1 || pipe (ready) != 0 || pipe (done) != 0)
+    {
+        std::perror ("fork/pipe");
+        return false;
+    }
+
+    pid_t const alive = fork ();
+    if (alive == 0)
+    {
+        close (done[1]);
+        helpers::LockFile lock (LOG4CPLUS_TEXT ("SharedLeft.log.lock"));
+        char c = 0;
+        if (write (ready[1], &c, 1) == 1)
+            while (read (done[0], &c, 1) == -1 && errno == EINTR)
+                ;
+        _exit (0);
+    }
+    close (done[0]);
+    char c;
+    if (alive == -1 || read (ready[0], &c, 1) != 1)
+    {
+        std::perror ("fork/read");
+        return false;
+    }
+
+    std::string const goneFile (pending_name (base, gone));
+    std::string const aliveFile (pending_name (base, alive));
+    write_abandoned_file (goneFile);
+    write_abandoned_file (aliveFile);
+
+    log_records (0, base, true);
+
+    close (done[1]);
+    waitpid (alive, 0, 0);
+    close (ready[0]);
+    close (ready[1]);
+
+    int broken = 0;
+    int records = count_records (base, BACKGROUND_SUFFIX, broken);
+    bool const aliveLeft = !! std::ifstream (aliveFile.c_str ());
+    std::cout << base << ": records: " << records << ", broken lines: "
+        << broken << ", file of running process kept: " << aliveLeft
+        << std::endl;
+    std::remove (aliveFile.c_str ());
+
+    return records == LOOP_COUNT + ABANDONED_COUNT && broken == 0
+        && aliveLeft && ! std::ifstream (goneFile.c_str ());
+}
+
+
+class LockingThread
+    : public thread::AbstractThread
+{
+public:
+    explicit LockingThread (tstring const & name)
+        : lockFile (name)
+        , locked (false)
+    { }
+
+    virtual void run ()
+    {
+        lockFile.lock ();
+        {
+            thread::MutexGuard guard (mtx);
+            locked = true;
+        }
+        lockFile.unlock ();
+    }
+
+    bool isLocked () const
+    {
+        thread::MutexGuard guard (mtx);
+        return locked;
+    }
+
+    helpers::LockFile lockFile;
+    thread::Mutex mtx;
+    bool locked;
+};
+
+
+//! Returns true if another process sees the lock of the lock file
+//! taken.
+static
+bool
+is_locked_for_others (char const * name)
+{
+    pid_t const pid = fork ();
+    if (pid == 0)
+    {
+        struct flock fl;
+        std::memset (&fl, 0, sizeof (fl));
+        fl.l_type = F_WRLCK;
+        fl.l_whence = SEEK_SET;
+        fl.l_len = 1;
+        int const fd = open (name, O_RDWR);
+        _exit (fd != -1 && fcntl (fd, F_GETLK, &fl) == 0
+            && fl.l_type == F_WRLCK ? 0 : 1);
+    }
+
+    int status = 1;
+    return pid != -1 && waitpid (pid, &status, 0) == pid
+        && WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+
+//! Checks that LockFile instances with the same name exclude each
+//! other within a process and that destroying one of them does not
+//! release the lock held through another.
+static
+bool
+check_lock_file_in_process ()
+{
+    tstring const name (LOG4CPLUS_TEXT ("SharedLock.lock"));
+    helpers::LockFile lock (name);
+    lock.lock ();
+    {
+        helpers::LockFile other (name);
+    }
+    bool ok = is_locked_for_others ("SharedLock.lock");
+
+    helpers::SharedObjectPtr<LockingThread> thread (new LockingThread (name));
+    thread->start ();
+    helpers::sleepmillis (200);
+    ok = ok && ! thread->isLocked ();
+
+    lock.unlock ();
+    thread->join ();
+    ok = ok && thread->isLocked () && ! is_locked_for_others ("SharedLock.lock");
+
+    std::cout << "Lock file instances in one process exclude each other: "
+        << ok << std::endl;
+    return ok;
+}
+#endif
+
+
+int
+main()
+{
+#if defined (_WIN32)
+    std::cout << "Shared file is not supported on this platform." << std::endl;
+    return 0;
+#else
+    bool ok = run_processes ("Shared.log", "", false);
+
+    // Processes finishing rollovers in the background must not
+    // overwrite each other's pending files.
+    ok = run_processes ("SharedBg.log", BACKGROUND_SUFFIX, true) && ok;
+
+    ok = check_abandoned_rollover () && ok;
+    ok = check_lock_file_in_process () && ok;
+
+    return ok ? 0 : 1;
+#endif
+}
@@ -0,0 +1,349 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/sharedmemoryappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/sharedring.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <log4cplus/thread/threads.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+tchar const RING_NAME[] = LOG4CPLUS_TEXT ("/log4cplus-sharedmemory-test");
+tchar const APPENDER_RING_NAME[]
+    = LOG4CPLUS_TEXT ("/log4cplus-sharedmemory-appender-test");
+tchar const CRASH_RING_NAME[]
+    = LOG4CPLUS_TEXT ("/log4cplus-sharedmemory-crash-test");
+const int WRITER_COUNT = 4;
+const int RECORD_COUNT = 50000;
+const int LOOP_COUNT = 2000;
+
+
+//! Writes numbered records of varying length straight into the ring.
+//! When the ring is full the record is written again.
+class Writer
+    : public thread::AbstractThread
+{
+public:
+    Writer (int id_)
+        : retries (0)
+        , id (id_)
+        , ring (RING_NAME, 64 * 1024)
+    { }
+
+    virtual void run ()
+    {
+        char record[200];
+        for (int i = 0; i != RECORD_COUNT; ++i)
+        {
+            int const len = std::sprintf (record, "%d %d ", id, i);
+            std::memset (record + len, 'x', i % 100);
+            while (! ring.write (record, len + i % 100))
+            {
+                ++retries;
+                thread::yield ();
+            }
+        }
+    }
+
+    unsigned long retries;
+
+private:
+    int id;
+    SharedRing ring;
+};
+
+
+//! Checks that the records of each writer come whole and in order and
+//! that each failed write is counted.
+static
+int
+testRing ()
+{
+    SharedRing::remove (RING_NAME);
+    SharedRing ring (RING_NAME, 64 * 1024);
+    if (! ring.isOpen ())
+    {
+        std::cout << "cannot open shared memory ring" << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+
+    // Too large for the ring.
+    std::vector<char> large (ring.getMaxRecordSize () + 1);
+    if (ring.write (&large[0], large.size ()) || ring.getDropped () != 1)
+        ++failures;
+
+    std::vector<SharedObjectPtr<Writer> > writers;
+    for (int i = 0; i != WRITER_COUNT; ++i)
+    {
+        writers.push_back (SharedObjectPtr<Writer> (new Writer (i)));
+        writers.back ()->start ();
+    }
+
+    std::vector<int> last (WRITER_COUNT, -1);
+    std::vector<char> record;
+    long received = 0;
+    bool running = true;
+    while (true)
+    {
+        if (! ring.read (record))
+        {
+            if (! running)
+                break;
+
+            running = false;
+            for (int i = 0; i != WRITER_COUNT; ++i)
+                running = running || writers[i]->isRunning ();
+            continue;
+        }
+
+        ++received;
+        record.push_back ('\0');
+        int id = -1;
+        int seq = -1;
+        int len = 0;
+        if (std::sscanf (&record[0], "%d %d %n", &id, &seq, &len) != 2
+            || id < 0 || id >= WRITER_COUNT || seq != last[id] + 1
+            || record.size () - 1 != static_cast<std::size_t>(len + seq % 100)
+            || std::strspn (&record[len], "x")
+                != static_cast<std::size_t>(seq % 100))
+        {
+            ++failures;
+            continue;
+        }
+        last[id] = seq;
+    }
+
+    unsigned long retries = 0;
+    for (int i = 0; i != WRITER_COUNT; ++i)
+    {
+        writers[i]->join ();
+        retries += writers[i]->retries;
+    }
+
+    std::cout << "ring: " << received << " records received, "
+        << retries << " writes retried" << std::endl;
+    if (received != static_cast<long>(WRITER_COUNT) * RECORD_COUNT)
+        ++failures;
+    if (ring.getDropped () != 1 + retries)
+        ++failures;
+    if (ring.getAbandoned () != 0)
+        ++failures;
+
+    SharedRing::remove (RING_NAME);
+    return failures;
+}
+
+
+static
+void
+exit_on_fault (int)
+{
+    _exit (1);
+}
+
+
+static
+void
+stop_on_fault (int)
+{
+    for (;;)
+        raise (SIGSTOP);
+}
+
+
+//! Starts a process that writes one record and then faults while
+//! copying the next one, after the ring claimed it. It either exits
+//! or stays stopped with the record uncommitted.
+static
+pid_t
+startFaultingWriter (bool stop)
+{
+    pid_t const pid = fork ();
+    if (pid != 0)
+        return pid;
+
+    signal (SIGSEGV, stop ? stop_on_fault : exit_on_fault);
+    SharedRing ring (CRASH_RING_NAME, 64 * 1024);
+    ring.write ("before", 6);
+
+    // The source runs into a page that cannot be read.
+    long const page = sysconf (_SC_PAGESIZE);
+    char * const p = static_cast<char *>(mmap (0, 2 * page,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    mprotect (p + page, page, PROT_NONE);
+    ring.write (p + page - 16, 1024);
+    _exit (0);
+}
+
+
+static
+bool
+readRecord (SharedRing & ring, char const * expected)
+{
+    std::vector<char> record;
+    return ring.read (record)
+        && std::string (record.begin (), record.end ()) == expected;
+}
+
+
+//! Checks that an uncommitted record is waited for as long as its
+//! writer lives and that only that record is skipped right after it
+//! is gone, while the records committed after it are kept.
+static
+int
+testCrashedWriter ()
+{
+    SharedRing::remove (CRASH_RING_NAME);
+    SharedRing ring (CRASH_RING_NAME, 64 * 1024);
+    int failures = 0;
+
+    // A writer that is alive, though stuck, is not given up on.
+    pid_t pid = startFaultingWriter (true);
+    int status = 0;
+    waitpid (pid, &status, WUNTRACED);
+    ring.write ("after", 5);
+    ring.write ("after 2", 7);
+
+    if (! WIFSTOPPED (status) || ! readRecord (ring, "before"))
+        ++failures;
+    std::vector<char> record;
+    Time const start = Time::gettimeofday ();
+    while (Time::gettimeofday () - start < Time (1))
+    {
+        if (ring.read (record))
+        {
+            std::cout << "record of live writer was skipped" << std::endl;
+            ++failures;
+            break;
+        }
+        sleepmillis (10);
+    }
+    if (ring.getAbandoned () != 0)
+        ++failures;
+
+    // Once it is gone, its record is skipped without waiting.
+    kill (pid, SIGKILL);
+    waitpid (pid, &status, 0);
+    if (! readRecord (ring, "after") || ! readRecord (ring, "after 2")
+        || ring.getAbandoned () != 1)
+        ++failures;
+
+    // Same for a writer that exited.
+    pid = startFaultingWriter (false);
+    waitpid (pid, &status, 0);
+    ring.write ("after", 5);
+    if (! WIFEXITED (status) || ! readRecord (ring, "before")
+        || ! readRecord (ring, "after") || ring.getAbandoned () != 2)
+        ++failures;
+
+    // The ring is empty and can be filled again.
+    std::vector<char> fill (ring.getMaxRecordSize ());
+    for (int i = 0; i != 16; ++i)
+        if (! ring.write (&fill[0], fill.size ())
+            || ! ring.read (record) || record.size () != fill.size ())
+            ++failures;
+    if (ring.read (record))
+        ++failures;
+
+    std::cout << "crash: " << ring.getAbandoned () << " records abandoned"
+        << std::endl;
+    SharedRing::remove (CRASH_RING_NAME);
+    return failures;
+}
+
+
+//! Decodes the records SharedMemoryAppender wrote and checks the order
+//! of events.
+static
+int
+testAppender (tchar const * version)
+{
+    SharedRing::remove (APPENDER_RING_NAME);
+
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("Name"), APPENDER_RING_NAME);
+    props.setProperty (LOG4CPLUS_TEXT ("Size"), LOG4CPLUS_TEXT ("1MB"));
+    props.setProperty (LOG4CPLUS_TEXT ("ProtocolVersion"), version);
+    SharedMemoryAppender * appender = new SharedMemoryAppender (props);
+    SharedAppenderPtr append (appender);
+
+    Logger logger = Logger::getInstance (LOG4CPLUS_TEXT ("test.sharedmemory"));
+    logger.addAppender (append);
+
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO (logger, "event " << i);
+
+    logger.removeAllAppenders ();
+
+    int failures = 0;
+    SharedRing ring (APPENDER_RING_NAME, 0);
+    MessageDecoder decoder;
+    std::vector<char> record;
+    std::vector<spi::InternalLoggingEvent> events;
+    while (ring.read (record))
+    {
+        // Each record holds one size-prefixed event.
+        SocketBuffer sizeBuffer (sizeof (unsigned int));
+        sizeBuffer.appendBytes (&record[0], sizeof (unsigned int));
+        sizeBuffer.clear ();
+        sizeBuffer.setSize (sizeof (unsigned int));
+        std::size_t const len = sizeBuffer.readInt ();
+
+        decoder.reset ();
+        if (record.size () != sizeof (unsigned int) + len
+            || ! decoder.decode (&record[sizeof (unsigned int)], len, events))
+            ++failures;
+    }
+
+    for (std::size_t i = 0; i != events.size (); ++i)
+        if (events[i].getMessage ()
+            != LOG4CPLUS_TEXT ("event ") + convertIntegerToString (i))
+            ++failures;
+
+    std::cout << "protocol " << LOG4CPLUS_TSTRING_TO_STRING (version)
+        << ": " << events.size () << " events, "
+        << appender->getDroppedEvents () << " dropped" << std::endl;
+    if (events.size () != static_cast<std::size_t>(LOOP_COUNT))
+        ++failures;
+    if (appender->getDroppedEvents () != 0)
+        ++failures;
+
+    append->close ();
+    SharedRing::remove (APPENDER_RING_NAME);
+    return failures;
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    int failures = 0;
+    failures += testRing ();
+    failures += testCrashedWriter ();
+    failures += testAppender (LOG4CPLUS_TEXT ("2"));
+    failures += testAppender (LOG4CPLUS_TEXT ("3"));
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
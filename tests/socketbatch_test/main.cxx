@@ -0,0 +1,64 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <iostream>
+
+#include "../socketreceiver.h"
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const unsigned short PORT = 19341;
+const int LOOP_COUNT = 20000;
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    SharedObjectPtr<StreamReceiver> receiver (new StreamReceiver (PORT));
+    receiver->start ();
+
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("host"), LOG4CPLUS_TEXT ("localhost"));
+    props.setProperty (LOG4CPLUS_TEXT ("port"), convertIntegerToString (PORT));
+    props.setProperty (LOG4CPLUS_TEXT ("BatchLatency"), LOG4CPLUS_TEXT ("5"));
+    props.setProperty (LOG4CPLUS_TEXT ("BatchSize"), LOG4CPLUS_TEXT ("32KB"));
+
+    SharedAppenderPtr append (new SocketAppender (props));
+    append->setName (LOG4CPLUS_TEXT ("Batch"));
+
+    Logger logger = Logger::getInstance (LOG4CPLUS_TEXT ("test.socketbatch"));
+    logger.addAppender (append);
+
+    Time const start = Time::gettimeofday ();
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO (logger, "event " << i);
+    Time const elapsed = Time::gettimeofday () - start;
+    std::cout << LOOP_COUNT << " events appended in "
+        << elapsed.sec () * 1000 + elapsed.usec () / 1000 << " ms"
+        << std::endl;
+
+    // The last partial batch is sent by the flusher thread.
+    int failures = 0;
+    if (receiver->waitFor (LOOP_COUNT) != LOOP_COUNT)
+    {
+        std::cout << "received only " << receiver->getReceived ()
+            << " events before close" << std::endl;
+        ++failures;
+    }
+
+    logger.removeAllAppenders ();
+    append->close ();
+    receiver->join ();
+
+    failures += receiver->getFailures ();
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
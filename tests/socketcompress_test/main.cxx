@@ -0,0 +1,218 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/compress.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/thread/threads.h>
+#include <iostream>
+#include <vector>
+
+#include "../socketreceiver.h"
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const unsigned short PORT = 19347;
+const unsigned short OLD_SERVER_PORT = 19348;
+const int LOOP_COUNT = 20000;
+
+
+//! Accepts compression and decompresses the stream byte by byte, as
+//! Socket::read() reads whole buffers only.
+class CompressingReceiver
+    : public EventReceiver
+{
+public:
+    CompressingReceiver ()
+        : server (PORT)
+        , compressedBytes (0)
+        , plainBytes (0)
+    { }
+
+    virtual void run ()
+    {
+        Socket client = server.accept ();
+
+        SocketBuffer request (HANDSHAKE_FRAME_SIZE);
+        unsigned char features = 0;
+        if (! client.read (request)
+            || request.readInt () != HANDSHAKE_FRAME_SIZE - sizeof (unsigned int)
+            || ! parseHandshake (request.getBuffer () + sizeof (unsigned int),
+                2, features)
+            || ! (features & HANDSHAKE_DEFLATE))
+        {
+            std::cout << "no handshake" << std::endl;
+            fail ();
+            return;
+        }
+
+        SocketBuffer reply (HANDSHAKE_FRAME_SIZE);
+        appendHandshake (reply, HANDSHAKE_DEFLATE);
+        client.write (reply);
+
+        StreamDecompressor decompressor;
+        MessageDecoder decoder;
+        std::vector<char> pending;
+        std::vector<char> out (64 * 1024);
+        SocketBuffer byte (1);
+        while (client.read (byte))
+        {
+            ++compressedBytes;
+            char const * data = byte.getBuffer ();
+            std::size_t size = 1;
+            long n;
+            do
+            {
+                n = decompressor.decompress (data, size, &out[0], out.size ());
+                if (n < 0)
+                {
+                    std::cout << "damaged stream" << std::endl;
+                    fail ();
+                    return;
+                }
+                pending.insert (pending.end (), out.begin (), out.begin () + n);
+            }
+            while (static_cast<std::size_t>(n) == out.size ());
+
+            std::size_t const before = pending.size ();
+            decodeFrames (decoder, pending);
+            plainBytes += before - pending.size ();
+        }
+    }
+
+    ServerSocket server;
+    std::size_t compressedBytes;
+    std::size_t plainBytes;
+};
+
+
+//! Server that does not know the handshake.
+class OldReceiver
+    : public EventReceiver
+{
+public:
+    OldReceiver ()
+        : server (OLD_SERVER_PORT)
+        , connections (0)
+    { }
+
+    virtual void run ()
+    {
+        // The appender connects again after the handshake times out.
+        for (; connections != 2; ++connections)
+        {
+            Socket client = server.accept ();
+            while (client.isOpen ())
+            {
+                SocketBuffer msgSizeBuffer (sizeof (unsigned int));
+                if (! client.read (msgSizeBuffer))
+                    break;
+
+                SocketBuffer buffer (msgSizeBuffer.readInt ());
+                if (! client.read (buffer))
+                    break;
+
+                unsigned char features;
+                if (parseHandshake (buffer.getBuffer (), buffer.getSize (),
+                        features))
+                    continue;
+
+                check (readFromBuffer (buffer));
+            }
+        }
+    }
+
+    ServerSocket server;
+    int connections;
+};
+
+
+static
+SharedAppenderPtr
+make_appender (unsigned short port, bool nonBlocking)
+{
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("host"), LOG4CPLUS_TEXT ("localhost"));
+    props.setProperty (LOG4CPLUS_TEXT ("port"), convertIntegerToString (port));
+    props.setProperty (LOG4CPLUS_TEXT ("Compression"), LOG4CPLUS_TEXT ("true"));
+    props.setProperty (LOG4CPLUS_TEXT ("CompressionFlushInterval"),
+        LOG4CPLUS_TEXT ("5"));
+    props.setProperty (LOG4CPLUS_TEXT ("ConnectTimeout"), LOG4CPLUS_TEXT ("200"));
+    if (nonBlocking)
+    {
+        props.setProperty (LOG4CPLUS_TEXT ("NonBlocking"), LOG4CPLUS_TEXT ("true"));
+        props.setProperty (LOG4CPLUS_TEXT ("ProtocolVersion"), LOG4CPLUS_TEXT ("3"));
+        props.setProperty (LOG4CPLUS_TEXT ("QueueSize"), LOG4CPLUS_TEXT ("4MB"));
+    }
+    return SharedAppenderPtr (new SocketAppender (props));
+}
+
+
+static
+int
+run (EventReceiver & receiver, SharedAppenderPtr append, tchar const * name)
+{
+    Logger logger = Logger::getInstance (name);
+    logger.addAppender (append);
+
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO (logger, "event " << i);
+
+    receiver.waitFor (LOOP_COUNT);
+    logger.removeAllAppenders ();
+    append->close ();
+    receiver.join ();
+
+    int failures = receiver.getFailures ();
+    if (receiver.getReceived () != LOOP_COUNT)
+    {
+        std::cout << "received " << receiver.getReceived () << " of "
+            << LOOP_COUNT << " events" << std::endl;
+        ++failures;
+    }
+    return failures;
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    int failures = 0;
+    if (! StreamCompressor ().isValid ())
+    {
+        std::cout << "compression not available, skipped" << std::endl;
+        return 0;
+    }
+
+    // Compressed version 3 stream from the non-blocking queue.
+    {
+        SharedObjectPtr<CompressingReceiver> receiver (new CompressingReceiver);
+        receiver->start ();
+        failures += run (*receiver, make_appender (PORT, true),
+            LOG4CPLUS_TEXT ("test.socketcompress"));
+
+        std::cout << "compressed " << receiver->plainBytes << " bytes to "
+            << receiver->compressedBytes << std::endl;
+        if (receiver->compressedBytes * 3 > receiver->plainBytes)
+            ++failures;
+    }
+
+    // Server without handshake support gets uncompressed stream.
+    {
+        SharedObjectPtr<OldReceiver> receiver (new OldReceiver);
+        receiver->start ();
+        failures += run (*receiver, make_appender (OLD_SERVER_PORT, false),
+            LOG4CPLUS_TEXT ("test.socketcompress.old"));
+    }
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/datagramappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <iostream>
+#include <vector>
+
+#include "../socketreceiver.h"
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const unsigned short PORT = 19349;
+const int LOOP_COUNT = 2000;
+
+
+//! Decodes each datagram on its own and checks the order of events.
+//! An empty datagram stops it.
+class Receiver
+    : public EventReceiver
+{
+public:
+    Receiver ()
+        : socket (PORT)
+        , datagrams (0)
+        , largest (0)
+    { }
+
+    virtual void run ()
+    {
+        SocketBuffer buffer (65507);
+        MessageDecoder decoder;
+        std::vector<char> pending;
+        while (true)
+        {
+            buffer.clear ();
+            if (! socket.read (buffer) || buffer.getSize () == 0)
+                return;
+
+            ++datagrams;
+            if (buffer.getSize () > largest)
+                largest = buffer.getSize ();
+            decoder.reset ();
+            pending.assign (buffer.getBuffer (),
+                buffer.getBuffer () + buffer.getSize ());
+            decodeFrames (decoder, pending);
+            if (! pending.empty ())
+            {
+                std::cout << "damaged datagram" << std::endl;
+                fail ();
+            }
+        }
+    }
+
+    DatagramSocket socket;
+    int datagrams;
+    std::size_t largest;
+};
+
+
+static
+int
+run (tchar const * version, std::size_t mtu, bool oversized)
+{
+    SharedObjectPtr<Receiver> receiver (new Receiver);
+    if (! receiver->socket.isOpen ())
+    {
+        std::cout << "cannot open UDP socket" << std::endl;
+        return 1;
+    }
+    receiver->start ();
+
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("host"), LOG4CPLUS_TEXT ("localhost"));
+    props.setProperty (LOG4CPLUS_TEXT ("port"), convertIntegerToString (PORT));
+    props.setProperty (LOG4CPLUS_TEXT ("ProtocolVersion"), version);
+    props.setProperty (LOG4CPLUS_TEXT ("MTU"), convertIntegerToString (mtu));
+    DatagramAppender * appender = new DatagramAppender (props);
+    SharedAppenderPtr append (appender);
+
+    Logger logger = Logger::getInstance (LOG4CPLUS_TEXT ("test.datagram"));
+    logger.addAppender (append);
+
+    // Paced, so that the receiver's socket buffer does not overflow.
+    for (int i = 0; i < LOOP_COUNT; ++i)
+    {
+        LOG4CPLUS_INFO (logger, "event " << i);
+        if (oversized && i == LOOP_COUNT / 2)
+            LOG4CPLUS_INFO (logger, tstring (2000, LOG4CPLUS_TEXT ('x')));
+        if (i % 50 == 0)
+            sleepmillis (1);
+    }
+
+    receiver->waitFor (LOOP_COUNT);
+    logger.removeAllAppenders ();
+    append->close ();
+
+    // Stop the receiver.
+    DatagramSocket stop (LOG4CPLUS_TEXT ("localhost"), PORT);
+    std::size_t const zero = 0;
+    stop.write ("", &zero, 1);
+    receiver->join ();
+
+    int failures = receiver->getFailures ();
+    std::cout << "protocol " << LOG4CPLUS_TSTRING_TO_STRING (version)
+        << ": " << receiver->getReceived () << " events in "
+        << receiver->datagrams << " datagrams of up to "
+        << receiver->largest << " bytes, "
+        << appender->getDroppedEvents () << " dropped" << std::endl;
+    if (receiver->getReceived () != LOOP_COUNT)
+        ++failures;
+    if (receiver->largest > mtu)
+        ++failures;
+    if (appender->getDroppedEvents () != (oversized ? 1u : 0u))
+        ++failures;
+    return failures;
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    int failures = 0;
+    failures += run (LOG4CPLUS_TEXT ("2"), 1472, false);
+
+    // Event larger than the MTU is dropped, the others still arrive.
+    failures += run (LOG4CPLUS_TEXT ("3"), 512, true);
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <iostream>
+#include <vector>
+
+#include "../socketreceiver.h"
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+tchar const SOCKET_PATH[] = LOG4CPLUS_TEXT ("socketlocal_test.sock");
+const int LOOP_COUNT = 20000;
+
+
+//! Reads the connection in records, decodes the frames and checks the
+//! order of events and that they are tagged with the peer's identity,
+//! followed by the server name the client claims.
+class Receiver
+    : public EventReceiver
+{
+public:
+    Receiver (LocalSocketType type, tstring const & serverName_)
+        : serverName (serverName_)
+        , largest (0)
+    {
+        SocketState state;
+        server = openLocalSocket (SOCKET_PATH, type, state);
+    }
+
+    ~Receiver ()
+    {
+        if (server != INVALID_SOCKET_VALUE)
+            closeSocket (server);
+    }
+
+    virtual void run ()
+    {
+        SocketState state;
+        SOCKET_TYPE client = acceptSocket (server, state);
+        if (client == INVALID_SOCKET_VALUE)
+        {
+            fail ();
+            return;
+        }
+
+        peerName = getLocalPeerName (client);
+        MessageDecoder decoder;
+        decoder.setPeerName (peerName);
+
+        // Twice the record size, so that larger records show.
+        SocketBuffer record (2 * LOG4CPLUS_SEQPACKET_RECORD_SIZE);
+        std::vector<char> pending;
+        long n;
+        while ((n = readDatagram (client, record)) > 0)
+        {
+            if (static_cast<std::size_t>(n) > largest)
+                largest = n;
+            pending.insert (pending.end (), record.getBuffer (),
+                record.getBuffer () + n);
+            decodeFrames (decoder, pending);
+        }
+        closeSocket (client);
+    }
+
+    SOCKET_TYPE server;
+    tstring serverName;
+    tstring peerName;
+    std::size_t largest;
+
+protected:
+    virtual bool isExpected (spi::InternalLoggingEvent const & event,
+        int number) const
+    {
+        tstring expected = peerName;
+        if (! serverName.empty ())
+            expected += LOG4CPLUS_TEXT (" - ") + serverName;
+
+        return EventReceiver::isExpected (event, number)
+            && event.getNDC () == expected;
+    }
+};
+
+
+static
+int
+run (tchar const * type, bool nonBlocking, tchar const * serverName)
+{
+    LocalSocketType const localType
+        = tstring (type) == LOG4CPLUS_TEXT ("seqpacket")
+        ? local_seqpacket : local_stream;
+    SharedObjectPtr<Receiver> receiver (new Receiver (localType, serverName));
+    if (receiver->server == INVALID_SOCKET_VALUE)
+    {
+        std::cout << "cannot open local socket" << std::endl;
+        return 1;
+    }
+    receiver->start ();
+
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("LocalSocket"), SOCKET_PATH);
+    props.setProperty (LOG4CPLUS_TEXT ("LocalSocketType"), type);
+    props.setProperty (LOG4CPLUS_TEXT ("ServerName"), serverName);
+    if (nonBlocking)
+    {
+        props.setProperty (LOG4CPLUS_TEXT ("NonBlocking"), LOG4CPLUS_TEXT ("true"));
+        props.setProperty (LOG4CPLUS_TEXT ("ProtocolVersion"), LOG4CPLUS_TEXT ("3"));
+        props.setProperty (LOG4CPLUS_TEXT ("QueueSize"), LOG4CPLUS_TEXT ("4MB"));
+    }
+    SharedAppenderPtr append (new SocketAppender (props));
+
+    Logger logger = Logger::getInstance (LOG4CPLUS_TEXT ("test.socketlocal"));
+    logger.addAppender (append);
+
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO (logger, "event " << i);
+
+    receiver->waitFor (LOOP_COUNT);
+    logger.removeAllAppenders ();
+    append->close ();
+    receiver->join ();
+
+    int failures = receiver->getFailures ();
+    std::cout << LOG4CPLUS_TSTRING_TO_STRING (type) << ": "
+        << receiver->getReceived () << " events from \""
+        << LOG4CPLUS_TSTRING_TO_STRING (receiver->peerName)
+        << "\", largest read " << receiver->largest << " bytes" << std::endl;
+    if (receiver->getReceived () != LOOP_COUNT)
+        ++failures;
+    if (localType == local_seqpacket
+        && receiver->largest > LOG4CPLUS_SEQPACKET_RECORD_SIZE)
+        ++failures;
+#if defined (__linux__)
+    if (receiver->peerName.empty ())
+        ++failures;
+#endif
+    return failures;
+}
+
+
+//! A socket that is listened on is not taken over; one left behind by
+//! a closed server is replaced.
+static
+int
+check_socket_in_use ()
+{
+    int failures = 0;
+    SocketState state;
+    SOCKET_TYPE first = openLocalSocket (SOCKET_PATH, local_stream, state);
+    SOCKET_TYPE second = openLocalSocket (SOCKET_PATH, local_stream, state);
+    if (first == INVALID_SOCKET_VALUE || second != INVALID_SOCKET_VALUE)
+    {
+        std::cout << "socket in use was taken over" << std::endl;
+        ++failures;
+    }
+    if (second != INVALID_SOCKET_VALUE)
+        closeSocket (second);
+    if (first != INVALID_SOCKET_VALUE)
+        closeSocket (first);
+
+    SOCKET_TYPE third = openLocalSocket (SOCKET_PATH, local_stream, state);
+    if (third == INVALID_SOCKET_VALUE)
+    {
+        std::cout << "stale socket was not replaced" << std::endl;
+        ++failures;
+    }
+    else
+        closeSocket (third);
+    return failures;
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+
+    int failures = 0;
+    // No ServerName; the receiver knows the peer.
+    failures += run (LOG4CPLUS_TEXT ("stream"), false, LOG4CPLUS_TEXT (""));
+
+    // Large writes of the non-blocking queue are split into records.
+    failures += run (LOG4CPLUS_TEXT ("seqpacket"), true, LOG4CPLUS_TEXT (""));
+
+    // ServerName does not hide the peer's identity.
+    failures += run (LOG4CPLUS_TEXT ("stream"), false,
+        LOG4CPLUS_TEXT ("spoofed"));
+    failures += run (LOG4CPLUS_TEXT ("seqpacket"), true,
+        LOG4CPLUS_TEXT ("spoofed"));
+
+    failures += check_socket_in_use ();
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <iostream>
+
+#include "../socketreceiver.h"
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const unsigned short PORT = 19342;
+const unsigned short UNUSED_PORT = 19343;
+const int LOOP_COUNT = 1000;
+
+
+static
+SharedAppenderPtr
+make_appender (unsigned short port, tchar const * queueSize)
+{
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("host"), LOG4CPLUS_TEXT ("localhost"));
+    props.setProperty (LOG4CPLUS_TEXT ("port"), convertIntegerToString (port));
+    props.setProperty (LOG4CPLUS_TEXT ("NonBlocking"), LOG4CPLUS_TEXT ("true"));
+    props.setProperty (LOG4CPLUS_TEXT ("QueueSize"), queueSize);
+    props.setProperty (LOG4CPLUS_TEXT ("ConnectTimeout"), LOG4CPLUS_TEXT ("500"));
+    props.setProperty (LOG4CPLUS_TEXT ("ReconnectDelay"), LOG4CPLUS_TEXT ("20"));
+    props.setProperty (LOG4CPLUS_TEXT ("MaxReconnectDelay"), LOG4CPLUS_TEXT ("100"));
+    return SharedAppenderPtr (new SocketAppender (props));
+}
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+    int failures = 0;
+
+    // Events appended before the server is up are sent once the
+    // sender connects.
+    SharedAppenderPtr queued (make_appender (PORT, LOG4CPLUS_TEXT ("1MB")));
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        queued->doAppend (spi::InternalLoggingEvent (
+            LOG4CPLUS_TEXT ("test.socketqueue"), INFO_LOG_LEVEL,
+            LOG4CPLUS_TEXT ("event ") + convertIntegerToString (i),
+            __FILE__, __LINE__));
+
+    sleepmillis (200);
+    SharedObjectPtr<StreamReceiver> receiver (new StreamReceiver (PORT));
+    receiver->start ();
+
+    int const received = receiver->waitFor (LOOP_COUNT);
+    SocketAppender & sa = static_cast<SocketAppender &>(*queued);
+    if (received != LOOP_COUNT || sa.getDroppedEvents () != 0)
+    {
+        std::cout << "received " << received
+            << " events, dropped " << sa.getDroppedEvents () << std::endl;
+        ++failures;
+    }
+
+    queued->close ();
+    receiver->join ();
+    failures += receiver->getFailures ();
+
+    // Events that do not fit into the queue, or are still queued when
+    // the appender is closed, are counted as dropped.
+    SharedAppenderPtr overflow (make_appender (UNUSED_PORT,
+        LOG4CPLUS_TEXT ("16KB")));
+    for (int i = 0; i < LOOP_COUNT; ++i)
+        overflow->doAppend (spi::InternalLoggingEvent (
+            LOG4CPLUS_TEXT ("test.socketqueue"), INFO_LOG_LEVEL,
+            LOG4CPLUS_TEXT ("event ") + convertIntegerToString (i),
+            __FILE__, __LINE__));
+
+    SocketAppender & osa = static_cast<SocketAppender &>(*overflow);
+    unsigned long const dropped = osa.getDroppedEvents ();
+    overflow->close ();
+    std::cout << "dropped " << dropped << " events while queueing, "
+        << osa.getDroppedEvents () << " in total" << std::endl;
+    if (dropped == 0 || osa.getDroppedEvents () != LOOP_COUNT)
+        ++failures;
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
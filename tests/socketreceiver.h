@@ -0,0 +1,149 @@
+// Receivers shared by the socket tests. The tests log events with
+// messages "event 0", "event 1", ... and the receivers check that
+// they arrive complete and in order.
+
+#ifndef LOG4CPLUS_TESTS_SOCKETRECEIVER_H
+#define LOG4CPLUS_TESTS_SOCKETRECEIVER_H
+
+#include <log4cplus/socketappender.h>
+#include <log4cplus/helpers/messagecodec.h>
+#include <log4cplus/helpers/sleep.h>
+#include <log4cplus/helpers/socket.h>
+#include <log4cplus/helpers/socketbuffer.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/spi/loggingevent.h>
+#include <log4cplus/thread/syncprims.h>
+#include <log4cplus/thread/threads.h>
+#include <vector>
+
+
+//! Counts received events and checks their order, starting at event
+//! <code>first</code>, unless it is negative. Subclasses read the
+//! events in run() and pass them to check().
+class EventReceiver
+    : public log4cplus::thread::AbstractThread
+{
+public:
+    explicit EventReceiver (int first_ = 0)
+        : first (first_)
+        , received (0)
+        , failures (0)
+    { }
+
+    int getReceived () const
+    {
+        log4cplus::thread::MutexGuard guard (mtx);
+        return received;
+    }
+
+    int getFailures () const
+    {
+        log4cplus::thread::MutexGuard guard (mtx);
+        return failures;
+    }
+
+    //! Waits up to 5 seconds for <code>expected</code> events.
+    //! Returns the number of events received.
+    int waitFor (int expected) const
+    {
+        for (int i = 0; i < 500 && getReceived () != expected; ++i)
+            log4cplus::helpers::sleepmillis (10);
+        return getReceived ();
+    }
+
+protected:
+    void check (log4cplus::spi::InternalLoggingEvent const & event)
+    {
+        log4cplus::thread::MutexGuard guard (mtx);
+        if (first >= 0 && ! isExpected (event, first + received))
+            ++failures;
+
+        ++received;
+    }
+
+    void fail ()
+    {
+        log4cplus::thread::MutexGuard guard (mtx);
+        ++failures;
+    }
+
+    //! Returns true if <code>event</code> is event number
+    //! <code>number</code>.
+    virtual bool isExpected (log4cplus::spi::InternalLoggingEvent const & event,
+        int number) const
+    {
+        return event.getMessage () == LOG4CPLUS_TEXT ("event ")
+            + log4cplus::helpers::convertIntegerToString (number);
+    }
+
+    //! Decodes complete size-prefixed frames at the beginning of
+    //! <code>pending</code>, checks their events and removes them.
+    void decodeFrames (log4cplus::helpers::MessageDecoder & decoder,
+        std::vector<char> & pending)
+    {
+        std::vector<log4cplus::spi::InternalLoggingEvent> events;
+        std::size_t pos = 0;
+        while (pending.size () - pos >= sizeof (unsigned int))
+        {
+            log4cplus::helpers::SocketBuffer sizeBuffer (sizeof (unsigned int));
+            sizeBuffer.appendBytes (&pending[pos], sizeof (unsigned int));
+            sizeBuffer.clear ();
+            sizeBuffer.setSize (sizeof (unsigned int));
+            std::size_t const len = sizeBuffer.readInt ();
+            if (pending.size () - pos - sizeof (unsigned int) < len)
+                break;
+
+            events.clear ();
+            if (! decoder.decode (&pending[pos + sizeof (unsigned int)],
+                    len, events))
+                fail ();
+            for (std::size_t i = 0; i != events.size (); ++i)
+                check (events[i]);
+            pos += sizeof (unsigned int) + len;
+        }
+        pending.erase (pending.begin (), pending.begin () + pos);
+    }
+
+private:
+    mutable log4cplus::thread::Mutex mtx;
+    int first;
+    int received;
+    int failures;
+};
+
+
+//! Reads version 2 messages from one TCP connection like
+//! loggingserver does.
+class StreamReceiver
+    : public EventReceiver
+{
+public:
+    explicit StreamReceiver (unsigned short port, int first_ = 0)
+        : EventReceiver (first_)
+        , server (port)
+    { }
+
+    virtual void run ()
+    {
+        log4cplus::helpers::Socket client = server.accept ();
+        while (client.isOpen ())
+        {
+            log4cplus::helpers::SocketBuffer msgSizeBuffer (
+                sizeof (unsigned int));
+            if (! client.read (msgSizeBuffer))
+                return;
+
+            log4cplus::helpers::SocketBuffer buffer (
+                msgSizeBuffer.readInt ());
+            if (! client.read (buffer))
+                return;
+
+            check (log4cplus::helpers::readFromBuffer (buffer));
+        }
+    }
+
+    log4cplus::helpers::ServerSocket server;
+};
+
+
+#endif // LOG4CPLUS_TESTS_SOCKETRECEIVER_H
@@ -0,0 +1,191 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/socketappender.h>
+#include <log4cplus/loggingmacros.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/stringhelper.h>
+#include <log4cplus/thread/threads.h>
+#include <iostream>
+#include <vector>
+
+#include "../socketreceiver.h"
+
+
+using namespace log4cplus;
+using namespace log4cplus::helpers;
+
+const unsigned short PORT = 19344;
+const unsigned short UNUSED_PORT = 19345;
+const unsigned short EVICT_PORT = 19346;
+const unsigned short THREADS_PORT = 19347;
+const int LOOP_COUNT = 1000;
+const int THREAD_COUNT = 4;
+
+
+static
+SharedAppenderPtr
+make_appender (unsigned short port, tchar const * spoolSize)
+{
+    Properties props;
+    props.setProperty (LOG4CPLUS_TEXT ("host"), LOG4CPLUS_TEXT ("localhost"));
+    props.setProperty (LOG4CPLUS_TEXT ("port"), convertIntegerToString (port));
+    props.setProperty (LOG4CPLUS_TEXT ("NonBlocking"), LOG4CPLUS_TEXT ("true"));
+    props.setProperty (LOG4CPLUS_TEXT ("QueueSize"), LOG4CPLUS_TEXT ("16KB"));
+    props.setProperty (LOG4CPLUS_TEXT ("SpoolFile"),
+        LOG4CPLUS_TEXT ("socketspool.dat"));
+    props.setProperty (LOG4CPLUS_TEXT ("SpoolSize"), spoolSize);
+    props.setProperty (LOG4CPLUS_TEXT ("ConnectTimeout"), LOG4CPLUS_TEXT ("500"));
+    props.setProperty (LOG4CPLUS_TEXT ("ReconnectDelay"), LOG4CPLUS_TEXT ("20"));
+    props.setProperty (LOG4CPLUS_TEXT ("MaxReconnectDelay"), LOG4CPLUS_TEXT ("100"));
+    return SharedAppenderPtr (new SocketAppender (props));
+}
+
+
+static
+void
+log_events (SharedAppenderPtr const & appender, int first, int count)
+{
+    for (int i = first; i < first + count; ++i)
+        appender->doAppend (spi::InternalLoggingEvent (
+            LOG4CPLUS_TEXT ("test.socketspool"), INFO_LOG_LEVEL,
+            LOG4CPLUS_TEXT ("event ") + convertIntegerToString (i),
+            __FILE__, __LINE__));
+}
+
+
+class LoggingThread
+    : public thread::AbstractThread
+{
+public:
+    LoggingThread (SharedAppenderPtr const & appender_, int first_)
+        : appender (appender_)
+        , first (first_)
+    { }
+
+    virtual void run ()
+    {
+        log_events (appender, first, LOOP_COUNT);
+    }
+
+    SharedAppenderPtr appender;
+    int first;
+};
+
+
+int
+main()
+{
+    LogLog::getLogLog()->setInternalDebugging(true);
+    int failures = 0;
+    std::remove ("socketspool.dat");
+
+    // Events that do not fit into the queue while the server is
+    // unreachable, or are queued when the appender is closed, are
+    // kept in the spool file.
+    {
+        SharedAppenderPtr spooling (make_appender (UNUSED_PORT,
+            LOG4CPLUS_TEXT ("1MB")));
+        log_events (spooling, 0, LOOP_COUNT);
+        spooling->close ();
+
+        SocketAppender & sa = static_cast<SocketAppender &>(*spooling);
+        if (sa.getDroppedEvents () != 0)
+        {
+            std::cout << "dropped " << sa.getDroppedEvents ()
+                << " events while spooling" << std::endl;
+            ++failures;
+        }
+    }
+
+    // The next appender sends the spooled events first, then its own.
+    {
+        SharedObjectPtr<StreamReceiver> receiver (
+            new StreamReceiver (PORT, 0));
+        receiver->start ();
+
+        SharedAppenderPtr draining (make_appender (PORT,
+            LOG4CPLUS_TEXT ("1MB")));
+        log_events (draining, LOOP_COUNT, LOOP_COUNT / 2);
+
+        int const received = receiver->waitFor (LOOP_COUNT * 3 / 2);
+        draining->close ();
+        receiver->join ();
+        std::cout << "received " << received << " events" << std::endl;
+        if (received != LOOP_COUNT * 3 / 2 || receiver->getFailures () != 0)
+            ++failures;
+    }
+
+    // The oldest events are evicted when the spool is full.
+    unsigned long evicted = 0;
+    {
+        SharedAppenderPtr spooling (make_appender (UNUSED_PORT,
+            LOG4CPLUS_TEXT ("16KB")));
+        log_events (spooling, 0, LOOP_COUNT);
+        spooling->close ();
+
+        evicted = static_cast<SocketAppender &>(*spooling).getDroppedEvents ();
+        std::cout << "evicted " << evicted << " events" << std::endl;
+        if (evicted == 0 || evicted >= LOOP_COUNT)
+            ++failures;
+    }
+
+    {
+        int const first = static_cast<int>(evicted);
+        SharedObjectPtr<StreamReceiver> receiver (
+            new StreamReceiver (EVICT_PORT, first));
+        receiver->start ();
+
+        SharedAppenderPtr draining (make_appender (EVICT_PORT,
+            LOG4CPLUS_TEXT ("16KB")));
+        int const received = receiver->waitFor (LOOP_COUNT - first);
+        draining->close ();
+        receiver->join ();
+        std::cout << "received " << received << " events" << std::endl;
+        if (received != LOOP_COUNT - first || receiver->getFailures () != 0)
+            ++failures;
+    }
+
+    // Logging threads that overflow the queue concurrently write it
+    // to the spool one after another, nothing is lost.
+    std::remove ("socketspool.dat");
+    {
+        SharedAppenderPtr spooling (make_appender (UNUSED_PORT,
+            LOG4CPLUS_TEXT ("1MB")));
+        std::vector<SharedObjectPtr<LoggingThread> > threads;
+        for (int i = 0; i < THREAD_COUNT; ++i)
+        {
+            threads.push_back (SharedObjectPtr<LoggingThread> (
+                new LoggingThread (spooling, i * LOOP_COUNT)));
+            threads.back ()->start ();
+        }
+        for (int i = 0; i < THREAD_COUNT; ++i)
+            threads[i]->join ();
+        spooling->close ();
+
+        SocketAppender & sa = static_cast<SocketAppender &>(*spooling);
+        if (sa.getDroppedEvents () != 0)
+        {
+            std::cout << "dropped " << sa.getDroppedEvents ()
+                << " events while spooling from threads" << std::endl;
+            ++failures;
+        }
+    }
+
+    {
+        SharedObjectPtr<StreamReceiver> receiver (
+            new StreamReceiver (THREADS_PORT, -1));
+        receiver->start ();
+
+        SharedAppenderPtr draining (make_appender (THREADS_PORT,
+            LOG4CPLUS_TEXT ("1MB")));
+        int const received = receiver->waitFor (THREAD_COUNT * LOOP_COUNT);
+        draining->close ();
+        receiver->join ();
+        std::cout << "received " << received << " events" << std::endl;
+        if (received != THREAD_COUNT * LOOP_COUNT)
+            ++failures;
+    }
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+#include <log4cplus/logger.h>
+#include <log4cplus/fileappender.h>
+#include <log4cplus/layout.h>
+#include <log4cplus/helpers/loglog.h>
+#include <log4cplus/helpers/property.h>
+#include <log4cplus/helpers/timehelper.h>
+#include <log4cplus/helpers/spillbuffer.h>
+#include <log4cplus/thread/threads.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#if ! defined (_WIN32)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+using namespace log4cplus;
+using helpers::Time;
+
+const int LOOP_COUNT = 20000;
+const int FULL_LOOP_COUNT = 1000;
+const int THREAD_COUNT = 4;
+const int THREAD_LOOP_COUNT = 5000;
+
+
+//! Logs records through its own logger and counts those that have
+//! taken longer than half of the reader's stall. Threads logging
+//! through one logger would wait for each other in the logger.
+class LoggingThread : public thread::AbstractThread {
+public:
+    LoggingThread(int n, Logger const & l)
+        : number(n)
+        , slow(0)
+        , logger(l)
+    { }
+
+    virtual void run()
+    {
+        Time const limit (0, 500 * 1000);
+        for (int i = 0; i < THREAD_LOOP_COUNT; ++i)
+        {
+            Time const start = Time::gettimeofday ();
+            LOG4CPLUS_INFO(logger, "thread " << number << " record " << i);
+            if (Time::gettimeofday () - start > limit)
+                ++slow;
+        }
+    }
+
+    int getSlow () const
+    {
+        return slow;
+    }
+
+private:
+    int number;
+    int slow;
+    Logger logger;
+};
+
+
+//! Reads records from the FIFO, stalling the writer for a second
+//! first. Exits with 0 if all records have arrived in order.
+static
+int
+read_fifo ()
+{
+    std::ifstream fifo ("Spill.fifo");
+    sleep (1);
+
+    int expected = 0;
+    std::string line;
+    while (std::getline (fifo, line))
+    {
+        int record;
+        if (std::sscanf (line.c_str (), "record %d", &record) != 1
+            || record != expected)
+            return 1;
+
+        ++expected;
+    }
+
+    return expected == LOOP_COUNT ? 0 : 1;
+}
+
+
+//! Like read_fifo() but for records logged by LoggingThread. Records
+//! of each thread have to arrive in order.
+static
+int
+read_threads_fifo ()
+{
+    std::ifstream fifo ("Spill.fifo");
+    sleep (1);
+
+    std::vector<int> expected (THREAD_COUNT, 0);
+    std::string line;
+    while (std::getline (fifo, line))
+    {
+        int number, record;
+        if (std::sscanf (line.c_str (), "thread %d record %d", &number,
+                &record) != 2
+            || number < 0 || number >= THREAD_COUNT
+            || record != expected[number])
+            return 1;
+
+        ++expected[number];
+    }
+
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        if (expected[i] != THREAD_LOOP_COUNT)
+            return 1;
+
+    return 0;
+}
+
+
+//! Records are accepted again after the buffer has been closed and
+//! reopened.
+static
+bool
+check_spill_reopen ()
+{
+    helpers::SpillBuffer buffer;
+    buffer.setCapacity (1024);
+    buffer.close ();
+    if (buffer.push (LOG4CPLUS_TEXT("x"), Time (), INFO_LOG_LEVEL)
+        || ! buffer.waitForClose (0))
+        return false;
+
+    buffer.reopen ();
+    helpers::SpillRecord record;
+    return ! buffer.isClosed ()
+        && ! buffer.waitForClose (0)
+        && buffer.push (LOG4CPLUS_TEXT("x"), Time (), INFO_LOG_LEVEL)
+        && buffer.pop (record)
+        && buffer.getDropped () == 1;
+}
+
+
+static
+SharedAppenderPtr
+make_appender (tchar const * file, tchar const * spill_size)
+{
+    helpers::Properties props;
+    props.setProperty(LOG4CPLUS_TEXT("File"), file);
+    props.setProperty(LOG4CPLUS_TEXT("SpillBufferSize"), spill_size);
+    props.setProperty(LOG4CPLUS_TEXT("SpillLatency"), LOG4CPLUS_TEXT("50"));
+    SharedAppenderPtr append(new FileAppender(props, std::ios::app));
+    append->setLayout(std::auto_ptr<Layout>(
+        new PatternLayout(LOG4CPLUS_TEXT("%m%n"))));
+    return append;
+}
+
+
+int
+main()
+{
+#if ! defined (_WIN32)
+    helpers::LogLog::getLogLog()->setInternalDebugging(true);
+    Logger test = Logger::getInstance(LOG4CPLUS_TEXT("test"));
+    test.setAdditivity(false);
+    int ret = 0;
+
+    // Stalled reader: only the event that detects the stall may be
+    // slow, the rest go to the spill buffer.
+    std::remove ("Spill.fifo");
+    if (mkfifo ("Spill.fifo", 0600) != 0)
+    {
+        std::cerr << "mkfifo() failed" << std::endl;
+        return 1;
+    }
+
+    pid_t const pid = fork ();
+    if (pid == 0)
+        _exit (read_fifo ());
+
+    SharedAppenderPtr append = make_appender (LOG4CPLUS_TEXT("Spill.fifo"),
+        LOG4CPLUS_TEXT("16MB"));
+    test.addAppender(append);
+
+    Time const slow (0, 50 * 1000);
+    int slow_events = 0;
+    for (int i = 0; i < LOOP_COUNT; ++i)
+    {
+        Time const start = Time::gettimeofday ();
+        LOG4CPLUS_INFO(test, "record " << i);
+        if (Time::gettimeofday () - start > slow)
+            ++slow_events;
+    }
+
+    append->close ();
+    test.removeAllAppenders ();
+
+    int status = 0;
+    waitpid (pid, &status, 0);
+    unsigned long dropped = static_cast<FileAppender &>(*append)
+        .getDroppedEvents ();
+    std::cout << "Slow events: " << slow_events << ", dropped: " << dropped
+        << ", reader " << (WEXITSTATUS (status) == 0 ? "ok" : "failed")
+        << std::endl;
+    if (slow_events > 2 || dropped != 0 || ! WIFEXITED (status)
+        || WEXITSTATUS (status) != 0)
+        ret = 1;
+    std::remove ("Spill.fifo");
+
+    // Stalled reader with several threads logging: only the thread
+    // whose write has stalled waits for the reader, the others spill
+    // their events after SpillLatency.
+    if (mkfifo ("Spill.fifo", 0600) != 0)
+    {
+        std::cerr << "mkfifo() failed" << std::endl;
+        return 1;
+    }
+
+    pid_t const threads_pid = fork ();
+    if (threads_pid == 0)
+        _exit (read_threads_fifo ());
+
+    append = make_appender (LOG4CPLUS_TEXT("Spill.fifo"),
+        LOG4CPLUS_TEXT("16MB"));
+
+    std::vector<thread::AbstractThreadPtr> threads;
+    std::vector<Logger> loggers;
+    for (int i = 0; i < THREAD_COUNT; ++i)
+    {
+        tostringstream name;
+        name << LOG4CPLUS_TEXT("test.thread") << i;
+        loggers.push_back (Logger::getInstance (name.str ()));
+        loggers.back ().setAdditivity (false);
+        loggers.back ().addAppender (append);
+        threads.push_back (thread::AbstractThreadPtr (
+            new LoggingThread (i, loggers.back ())));
+        threads.back ()->start ();
+    }
+
+    slow_events = 0;
+    for (int i = 0; i < THREAD_COUNT; ++i)
+    {
+        threads[i]->join ();
+        slow_events += static_cast<LoggingThread &>(*threads[i])
+            .getSlow ();
+        loggers[i].removeAllAppenders ();
+    }
+
+    append->close ();
+
+    waitpid (threads_pid, &status, 0);
+    dropped = static_cast<FileAppender &>(*append).getDroppedEvents ();
+    std::cout << "Threads blocked by stalled write: " << slow_events
+        << ", dropped: " << dropped << ", reader "
+        << (WEXITSTATUS (status) == 0 ? "ok" : "failed") << std::endl;
+    if (slow_events > 1 || dropped != 0 || ! WIFEXITED (status)
+        || WEXITSTATUS (status) != 0)
+        ret = 1;
+    std::remove ("Spill.fifo");
+
+    if (! check_spill_reopen ())
+    {
+        std::cout << "Spill buffer has not been re-armed" << std::endl;
+        ret = 1;
+    }
+
+    // Full disk: every event is either written or counted as dropped.
+    append = make_appender (LOG4CPLUS_TEXT("/dev/full"),
+        LOG4CPLUS_TEXT("4KB"));
+    test.addAppender(append);
+    for (int i = 0; i < FULL_LOOP_COUNT; ++i)
+        LOG4CPLUS_INFO(test, "record " << i);
+
+    append->close ();
+    test.removeAllAppenders ();
+
+    dropped = static_cast<FileAppender &>(*append).getDroppedEvents ();
+    std::cout << "Dropped on full disk: " << dropped << std::endl;
+    if (dropped != static_cast<unsigned long>(FULL_LOOP_COUNT))
+        ret = 1;
+
+    return ret;
+#else
+    return 0;
+#endif
+}